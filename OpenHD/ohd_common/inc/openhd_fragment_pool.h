@@ -0,0 +1,122 @@
+#ifndef OPENHD_OPENHD_FRAGMENT_POOL_H
+#define OPENHD_OPENHD_FRAGMENT_POOL_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace openhd {
+
+/**
+ * Fixed size pool of MTU sized buffers for video fragments.
+ * On the air unit, we produce a couple of thousand rtp fragments per second -
+ * allocating a new vector (and shared_ptr control block) for each of them
+ * results in a lot of allocator churn on the core(s) that also do FEC.
+ * Here, each slot holds a pre-allocated buffer and in-place storage for the
+ * shared_ptr control block, and is recycled via a free-list once the last
+ * reference is gone. The handed out type is a plain
+ * std::shared_ptr<std::vector<uint8_t>>, such that it can be given to the
+ * wifibroadcast tx queue without any copy.
+ * If the pool is exhausted (or the data doesn't fit), we fall back to the heap.
+ */
+class FragmentPool {
+ public:
+  // Max size of a fragment that can be pooled (rtp fragments are ~1440 bytes)
+  static constexpr size_t FRAGMENT_CAPACITY = 1500;
+  // In-place storage for the shared_ptr control block (+ object)
+  static constexpr size_t SLOT_STORAGE_SIZE = 256;
+  explicit FragmentPool(int n_slots);
+  FragmentPool(const FragmentPool&) = delete;
+  FragmentPool& operator=(const FragmentPool&) = delete;
+  // We only have one instance of this class inside openhd
+  static FragmentPool& instance();
+  /**
+   * Thread-safe, returns a buffer holding a copy of the given data.
+   * Pooled unless the pool is exhausted or data_len > FRAGMENT_CAPACITY.
+   */
+  std::shared_ptr<std::vector<uint8_t>> copy(const uint8_t* data,
+                                             size_t data_len);
+  /**
+   * Thread-safe, returns a buffer of the given size to be written into by the
+   * caller (e.g. a packetizer). Same pooling rules as copy().
+   */
+  std::shared_ptr<std::vector<uint8_t>> allocate(size_t data_len);
+  /**
+   * Thread-safe, pooled equivalent of std::make_shared for small objects
+   * (<=SLOT_STORAGE_SIZE including control block) - the slot's buffer is
+   * unused in this case.
+   */
+  template <class T, class... Args>
+  std::shared_ptr<T> make_shared(Args&&... args) {
+    const int slot_idx = acquire_slot();
+    if (slot_idx < 0) {
+      m_n_heap_fallbacks++;
+      return std::make_shared<T>(std::forward<Args>(args)...);
+    }
+    return std::allocate_shared<T>(SlotAllocator<T>{this, slot_idx},
+                                   std::forward<Args>(args)...);
+  }
+  struct Stats {
+    int n_slots = 0;
+    // slots currently handed out
+    int n_in_use = 0;
+    // max n of slots that have been in use at the same time
+    int n_in_use_peak = 0;
+    // n of times we had to fall back to the heap
+    uint64_t n_heap_fallbacks = 0;
+  };
+  Stats get_stats();
+
+ private:
+  struct Slot {
+    alignas(std::max_align_t) uint8_t storage[SLOT_STORAGE_SIZE];
+    std::vector<uint8_t> buffer;
+  };
+  // Places the shared_ptr control block in the slot storage and returns the
+  // slot to the pool once the control block is destroyed
+  template <class T>
+  struct SlotAllocator {
+    using value_type = T;
+    FragmentPool* pool;
+    int slot_idx;
+    SlotAllocator(FragmentPool* pool1, int slot_idx1)
+        : pool(pool1), slot_idx(slot_idx1) {}
+    template <class U>
+    SlotAllocator(const SlotAllocator<U>& other)
+        : pool(other.pool), slot_idx(other.slot_idx) {}
+    T* allocate(size_t n) {
+      static_assert(sizeof(T) <= SLOT_STORAGE_SIZE);
+      static_assert(alignof(T) <= alignof(std::max_align_t));
+      assert(n == 1);
+      return reinterpret_cast<T*>(pool->m_slots[slot_idx].storage);
+    }
+    void deallocate(T* /*p*/, size_t /*n*/) { pool->release_slot(slot_idx); }
+    template <class U>
+    bool operator==(const SlotAllocator<U>& other) const {
+      return pool == other.pool && slot_idx == other.slot_idx;
+    }
+    template <class U>
+    bool operator!=(const SlotAllocator<U>& other) const {
+      return !(*this == other);
+    }
+  };
+  // returns -1 if the pool is exhausted
+  int acquire_slot();
+  void release_slot(int slot_idx);
+
+ private:
+  std::vector<Slot> m_slots;
+  std::mutex m_free_list_mutex;
+  std::vector<int> m_free_list;
+  int m_n_in_use_peak = 0;
+  std::atomic<uint64_t> m_n_heap_fallbacks = 0;
+};
+
+}  // namespace openhd
+
+#endif  // OPENHD_OPENHD_FRAGMENT_POOL_H
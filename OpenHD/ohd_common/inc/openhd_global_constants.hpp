@@ -40,6 +40,12 @@ static_assert(VIDEO_GROUND_VIDEO_STREAM_1_UDP !=
                   VIDEO_GROUND_VIDEO_STREAM_2_UDP,
               "Must be different");
 
+// The air unit writes link metrics (e.g. video frame drops per reason) in the
+// prometheus text format into this directory (tmpfs), for the textfile
+// collector of node_exporter (--collector.textfile.directory) - logging / post
+// flight analysis
+static constexpr auto LINK_METRICS_TEXTFILE_DIRECTORY = "/run/openhd/metrics/";
+
 static constexpr uint8_t MAJOR_VERSION = 2;
 static constexpr uint8_t MINOR_VERSION = 6;
 static constexpr uint8_t PATCH_VERSION = 2;
@@ -121,6 +121,8 @@ class OHDLink {
   }
 };
 
+// Only logs, nothing is delivered - see openhd::sim::SimLinkPair
+// (ohd_interface) for a simulated link between an air and a ground instance
 class DummyDebugLink : public OHDLink {
  public:
   openhd::ON_ENCODE_FRAME_CB m_opt_frame_cb = nullptr;
@@ -139,7 +141,7 @@ class DummyDebugLink : public OHDLink {
       const openhd::FragmentedVideoFrame& fragmented_video_frame) override {
     int64_t total_bytes = 0;
     for (const auto& fragment : fragmented_video_frame.rtp_fragments) {
-      total_bytes += fragment->size();
+      total_bytes += fragment.size();
     }
     m_console_video->debug("Got Frame. Fragments:{} total: {}Bytes",
                            fragmented_video_frame.rtp_fragments.size(),
@@ -5,10 +5,15 @@
 #ifndef OPENHD_OPENHD_OHD_COMMON_OPENHD_LINK_STATISTICS_HPP_
 #define OPENHD_OPENHD_OHD_COMMON_OPENHD_LINK_STATISTICS_HPP_
 
+#include <array>
 #include <cstring>
+#include <functional>
 #include <optional>
 #include <sstream>
 #include <string>
+#include <vector>
+
+#include "openhd_video_frame_trace.h"
 
 // NOTE: While annoying, we do not want mavlink as a direct dependency inside
 // ohd_common / ohd_interface, So we double-declare the mavlink message
@@ -75,7 +80,7 @@ struct Xmavlink_openhd_stats_wb_video_air_t {
   int16_t curr_fec_percentage;      /*<  curr_fec_percentage*/
   int16_t dummy1;                   /*<  for future use*/
   uint8_t link_index;               /*<  link_index*/
-  int8_t dummy0;                    /*<  for future use*/
+  int8_t dummy0;                    /*<  thermal protection level*/
 };
 struct Xmavlink_openhd_stats_wb_video_air_fec_performance_t {
   uint32_t curr_fec_encode_time_avg_us; /*<  curr_fec_encode_time_avg_us*/
@@ -164,6 +169,61 @@ struct Xmavlink_openhd_wifbroadcast_gnd_operating_mode_t {
 using StatsAllCards =
     std::array<Xmavlink_openhd_stats_monitor_mode_wifi_card_t, 4>;
 
+// Not a mavlink message (yet) - per stage frame latency of a video stream on
+// the air unit, sent as a generic mavlink message (see pack_vid_air_debug).
+struct StatsWbVideoAirLatency {
+  uint8_t link_index;
+  openhd::FrameTraceAggregator::Summary latency;
+};
+
+// Why a video frame has been dropped on the air unit instead of being
+// transmitted
+enum class VideoDropReason : uint8_t {
+  // More frames pending than the tx queue can take (e.g. encoder overshoot)
+  QUEUE_FULL = 0,
+  // Waited in the tx queue for too long (e.g. rf congestion)
+  DEADLINE,
+  // Not transmitted yet when a keyframe of the same stream came in
+  SUPERSEDED_BY_KEYFRAME,
+  // Removed from the wb tx queue to make space for a keyframe
+  ENQUEUE_DROPPING,
+  THERMAL_PROTECTION,
+  // Video input temporarily closed
+  VIDEO_CLOSED,
+  INVALID_STREAM_INDEX,
+};
+static constexpr int N_VIDEO_DROP_REASONS = 7;
+static const char* video_drop_reason_to_string(VideoDropReason reason) {
+  switch (reason) {
+    case VideoDropReason::QUEUE_FULL:
+      return "queue_full";
+    case VideoDropReason::DEADLINE:
+      return "deadline";
+    case VideoDropReason::SUPERSEDED_BY_KEYFRAME:
+      return "superseded_by_keyframe";
+    case VideoDropReason::ENQUEUE_DROPPING:
+      return "enqueue_dropping";
+    case VideoDropReason::THERMAL_PROTECTION:
+      return "thermal_protection";
+    case VideoDropReason::VIDEO_CLOSED:
+      return "video_closed";
+    case VideoDropReason::INVALID_STREAM_INDEX:
+      return "invalid_stream_index";
+  }
+  return "unknown";
+}
+
+// Dropped frames of a video stream on the air unit per reason (totals since
+// start) and how long frames spent in the tx queue per frame type (since the
+// last stats update). There is no openhd message for it, it is sent as
+// a generic mavlink message (see pack_vid_air_debug).
+struct StatsWbVideoAirDrops {
+  uint8_t link_index;
+  std::array<uint32_t, N_VIDEO_DROP_REASONS> n_dropped_total{};
+  openhd::LatencyHistogram::Summary queue_residency_keyframe;
+  openhd::LatencyHistogram::Summary queue_residency_other;
+};
+
 struct StatsAirGround {
   bool is_air = false;
   bool ready = false;
@@ -174,6 +234,8 @@ struct StatsAirGround {
   // for air
   std::vector<Xmavlink_openhd_stats_wb_video_air_t> stats_wb_video_air;
   Xmavlink_openhd_stats_wb_video_air_fec_performance_t air_fec_performance;
+  std::vector<StatsWbVideoAirLatency> stats_wb_video_air_latency;
+  std::vector<StatsWbVideoAirDrops> stats_wb_video_air_drops;
   // for ground
   std::vector<Xmavlink_openhd_stats_wb_video_ground_t> stats_wb_video_ground;
   Xmavlink_openhd_stats_wb_video_ground_fec_performance_t gnd_fec_performance;
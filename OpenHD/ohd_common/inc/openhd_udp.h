@@ -6,19 +6,55 @@
 #define OPENHD_OPENHD_UDP_H
 
 #include <netinet/in.h>
+#include <sys/uio.h>
 
+#include <atomic>
 #include <functional>
-#include <list>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
 #include <thread>
+#include <vector>
 
 //
 // openhd UDP helpers
 //
 namespace openhd {
+/**
+ * Packets that are sent together with one (or a few) syscall(s), see
+ * forwardPacketsViaUDP(). The data is copied into one re-used buffer, such
+ * that a batch can be filled from callbacks that only lend the data.
+ */
+class UDPPacketBatch {
+ public:
+  void add(const uint8_t *packet, std::size_t packetSize);
+  void clear();
+  [[nodiscard]] int size() const { return (int)m_packets.size(); }
+  [[nodiscard]] bool empty() const { return m_packets.empty(); }
+  [[nodiscard]] std::size_t size_bytes() const { return m_data.size(); }
+  // Valid until the batch is modified
+  const struct iovec *get_packets();
+
+ private:
+  std::vector<uint8_t> m_data;
+  // offset, size in m_data
+  std::vector<std::pair<std::size_t, std::size_t>> m_packets;
+  std::vector<struct iovec> m_iovecs;
+};
+
+/**
+ * Sends all packets to all destinations via the given socket, with as few
+ * syscalls as possible (sendmmsg and, if supported, UDP GSO). If the kernel
+ * rejects GSO (e.g. no checksum offload on the outgoing interface), GSO is
+ * disabled for the whole process and the packets are sent one by one.
+ */
+void sendPacketsViaUDP(int sockfd, const struct sockaddr_in *destinations,
+                       int n_destinations, const struct iovec *packets,
+                       int n_packets);
+// False if the kernel does not support UDP GSO or it has been disabled
+[[nodiscard]] bool isUdpGsoEnabled();
+
 // Wrapper around an UDP port you can send data to
 // opens port on construction, closes port on destruction
 class UDPForwarder {
@@ -28,6 +64,9 @@ class UDPForwarder {
   UDPForwarder &operator=(const UDPForwarder &) = delete;
   ~UDPForwarder();
   void forwardPacketViaUDP(const uint8_t *packet, std::size_t packetSize) const;
+  // Same as calling forwardPacketViaUDP for each packet, but batched
+  // (sendmmsg and if supported UDP GSO)
+  void forwardPacketsViaUDP(const struct iovec *packets, int n_packets) const;
 
  private:
   struct sockaddr_in saddr {};
@@ -44,7 +83,8 @@ class UDPForwarder {
  */
 class UDPMultiForwarder {
  public:
-  explicit UDPMultiForwarder() = default;
+  explicit UDPMultiForwarder();
+  ~UDPMultiForwarder();
   UDPMultiForwarder(const UDPMultiForwarder &) = delete;
   UDPMultiForwarder &operator=(const UDPMultiForwarder &) = delete;
   /**
@@ -60,14 +100,30 @@ class UDPMultiForwarder {
    * Forward data to all added IP::Port tuples via UDP
    */
   void forwardPacketViaUDP(const uint8_t *packet, std::size_t packetSize);
-  [[nodiscard]] const std::list<std::unique_ptr<UDPForwarder>> &getForwarders()
-      const;
+  /**
+   * Forward all the given packets to all added IP::Port tuples.
+   * Usually takes one syscall, no matter how many packets and destinations -
+   * e.g. all the rtp fragments of one video frame.
+   */
+  void forwardPacketsViaUDP(const struct iovec *packets, int n_packets);
+  struct Destinations {
+    // ip, port
+    std::vector<std::pair<std::string, int>> clients;
+    // Same order as clients
+    std::vector<struct sockaddr_in> saddrs;
+  };
+  // Copy of the current destinations
+  [[nodiscard]] Destinations getForwarders() const;
 
  private:
-  // list of host::port tuples where we send the data to.
-  std::list<std::unique_ptr<UDPForwarder>> udpForwarders;
-  // modifying the list of forwarders must be thread-safe
-  std::mutex udpForwardersLock;
+  // Immutable, replaced on add / remove - forwarding just takes a reference
+  // to the current snapshot (std::atomic_load / std::atomic_store). A
+  // replaced snapshot is freed once the last forwarding call using it is done.
+  std::shared_ptr<const Destinations> m_destinations;
+  // Only for add / remove
+  std::mutex m_modify_mutex;
+  // All data is sent via this socket, to each destination
+  int m_sockfd;
 };
 
 // Open the specified port for udp receiving
@@ -85,12 +141,20 @@ class UDPReceiver {
                              const std::size_t payloadSize)>
       OUTPUT_DATA_CALLBACK;
   static constexpr const size_t UDP_PACKET_MAX_SIZE = 65507;
+  // Biggest datagram that fits into one ethernet frame (1500 MTU)
+  static constexpr const size_t ETHERNET_DATAGRAM_MAX_SIZE = 1472;
+  // Max n of datagrams read with one syscall (recvmmsg)
+  static constexpr const int RECV_BATCH_SIZE = 16;
   /**
    * Receive data from socket and forward it via callback until stopLooping() is
    * called
+   * @param max_datagram_size receive buffer size per datagram - bigger ones
+   * are dropped. There are RECV_BATCH_SIZE of them, so use the biggest size
+   * that is actually expected, not UDP_PACKET_MAX_SIZE.
    */
   explicit UDPReceiver(std::string client_addr, int client_udp_port,
-                       OUTPUT_DATA_CALLBACK cb);
+                       OUTPUT_DATA_CALLBACK cb,
+                       std::size_t max_datagram_size = UDP_PACKET_MAX_SIZE);
   ~UDPReceiver();
   void loopUntilError();
   // Now this one is kinda special - for mavsdk we need to send messages from
@@ -105,6 +169,7 @@ class UDPReceiver {
 
  private:
   const OUTPUT_DATA_CALLBACK mCb;
+  const std::size_t m_max_datagram_size;
   bool receiving = true;
   int mSocket;
   std::unique_ptr<std::thread> receiverThread = nullptr;
@@ -6,18 +6,68 @@
 #define OPENHD_OPENHD_OHD_COMMON_OPENHD_VIDEO_FRAME_H_
 
 #include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <sstream>
+#include <utility>
 #include <vector>
 
+#include "openhd_fragment_pool.h"
+#include "openhd_video_frame_trace.h"
+
 namespace openhd {
 
+/**
+ * Read-only, reference counted view on the data of one (rtp) fragment.
+ * The memory is either owned by a std::vector (the "classic" way) or by an
+ * arbitrary owner (e.g. a mapped GstBuffer) that is released once the last
+ * copy of this fragment goes out of scope. This allows producer(s) to hand out
+ * their memory without copying it. Copying a VideoFragment is cheap (no copy
+ * of the data itself).
+ */
+class VideoFragment {
+ public:
+  VideoFragment() = default;
+  // Backed by a vector - as_vector() won't copy in this case
+  explicit VideoFragment(std::shared_ptr<std::vector<uint8_t>> buff)
+      : m_buff(std::move(buff)) {
+    if (m_buff) {
+      m_data = m_buff->data();
+      m_size = m_buff->size();
+    }
+  }
+  // Backed by an arbitrary owner, data needs to stay valid as long as owner is
+  // alive
+  VideoFragment(std::shared_ptr<const void> owner, const uint8_t* data,
+                size_t data_len)
+      : m_data(data), m_size(data_len), m_owner(std::move(owner)) {}
+  const uint8_t* data() const { return m_data; }
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  /**
+   * Some consumer(s) (e.g. the wifibroadcast tx queue) require the data as an
+   * owned vector. No copy is performed if this fragment is already backed by a
+   * vector, otherwise the data is copied (into a pooled buffer).
+   */
+  std::shared_ptr<std::vector<uint8_t>> as_vector() const {
+    if (m_buff) return m_buff;
+    return FragmentPool::instance().copy(m_data, m_size);
+  }
+
+ private:
+  const uint8_t* m_data = nullptr;
+  size_t m_size = 0;
+  std::shared_ptr<std::vector<uint8_t>> m_buff = nullptr;
+  std::shared_ptr<const void> m_owner = nullptr;
+};
+
 // R.n this is the best name i can come up with
 // This is not required to be exactly one frame, but should be
 // already packetized into rtp fragments
 // R.n it is always either h264,h265 or mjpeg fragmented using the RTP protocol
 struct FragmentedVideoFrame {
-  std::vector<std::shared_ptr<std::vector<uint8_t>>> rtp_fragments;
+  std::vector<VideoFragment> rtp_fragments;
   // Time point of when this frame was produced, as early as possible.
   // ideally, this would be the time point when the frame was generated by the
   // CMOS - but r.n no platform supports measurements this deep.
@@ -35,9 +85,11 @@ struct FragmentedVideoFrame {
   // Set to true if this frame is an IDR frame and therefore we can safely drop
   // previous frame(s) without having complete corruption
   bool is_idr_frame = false;
+  // Time points of the stages this frame passed so far, for latency tracing
+  FrameTrace trace;
   std::string to_string() const {
     int total_bytes = 0;
-    for (auto& fragment : rtp_fragments) total_bytes += fragment->size();
+    for (auto& fragment : rtp_fragments) total_bytes += fragment.size();
     if (dirty_frame) total_bytes += dirty_frame->size();
     std::stringstream ss;
     ss << "Bytes:" << total_bytes << " Fragments:" << rtp_fragments.size();
@@ -45,6 +97,18 @@ struct FragmentedVideoFrame {
     return ss.str();
   }
 };
+
+// See VideoFragment::as_vector()
+static std::vector<std::shared_ptr<std::vector<uint8_t>>> fragments_as_vectors(
+    const std::vector<VideoFragment>& fragments) {
+  std::vector<std::shared_ptr<std::vector<uint8_t>>> ret;
+  ret.reserve(fragments.size());
+  for (const auto& fragment : fragments) {
+    ret.push_back(fragment.as_vector());
+  }
+  return ret;
+}
+
 typedef std::function<void(int stream_index, const openhd::FragmentedVideoFrame&
                                                  fragmented_video_frame)>
     ON_ENCODE_FRAME_CB;
@@ -0,0 +1,98 @@
+#ifndef OPENHD_OPENHD_VIDEO_FRAME_TRACE_H
+#define OPENHD_OPENHD_VIDEO_FRAME_TRACE_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace openhd {
+
+/**
+ * Time points a video frame passes on the air unit, from the encoder to the
+ * wb tx queue. Each stage is optional, since not all producers / links can
+ * provide all of them.
+ */
+struct FrameTrace {
+  using TimePoint = std::chrono::steady_clock::time_point;
+  // Buffer PTS (or DTS if no PTS) of the first fragment of this frame,
+  // converted to the steady clock. Only available if the gstreamer pipeline
+  // runs on the (monotonic) system clock.
+  std::optional<TimePoint> buffer_timestamp;
+  // When the first / last fragment of this frame was pulled from the appsink
+  std::optional<TimePoint> first_fragment_pull;
+  std::optional<TimePoint> last_fragment_pull;
+  // When the end of the frame was detected and the frame was handed to the
+  // link
+  std::optional<TimePoint> aggregated;
+  // When the link started processing this frame (transmit_video_data)
+  std::optional<TimePoint> transmit_entry;
+  // When the frame was (successfully) enqueued as FEC block(s)
+  std::optional<TimePoint> fec_enqueued;
+};
+
+/**
+ * Fixed size latency histogram, thread-safe.
+ * Values are binned in 50us buckets up to 100ms (larger values go into the
+ * last bucket), min, max and avg are exact.
+ */
+class LatencyHistogram {
+ public:
+  struct Summary {
+    int count = 0;
+    uint32_t min_us = 0;
+    uint32_t avg_us = 0;
+    uint32_t p99_us = 0;
+    uint32_t max_us = 0;
+  };
+  void add(std::chrono::nanoseconds latency);
+  // Returns the summary since the last call and resets the histogram
+  Summary get_and_reset();
+
+ private:
+  static constexpr uint32_t BUCKET_WIDTH_US = 50;
+  static constexpr int N_BUCKETS = 2000;
+  std::mutex m_mutex;
+  std::array<uint32_t, N_BUCKETS> m_buckets{};
+  int m_count = 0;
+  uint32_t m_min_us = UINT32_MAX;
+  uint32_t m_max_us = 0;
+  uint64_t m_sum_us = 0;
+};
+
+/**
+ * Aggregates the per-stage latencies of all frames of one video stream.
+ */
+class FrameTraceAggregator {
+ public:
+  struct Summary {
+    // buffer timestamp -> last fragment pulled from the appsink
+    LatencyHistogram::Summary encoder_to_pull;
+    // first fragment pulled -> end of frame detected
+    LatencyHistogram::Summary aggregation;
+    // end of frame detected -> link transmit entry
+    LatencyHistogram::Summary handoff;
+    // link transmit entry -> enqueued as FEC block(s)
+    LatencyHistogram::Summary fec_enqueue;
+    // earliest available time point -> enqueued as FEC block(s)
+    LatencyHistogram::Summary total;
+    std::string to_string() const;
+  };
+  // Thread-safe, stages that are not available are skipped
+  void add(const FrameTrace& trace);
+  // Thread-safe, returns the summary since the last call and resets
+  Summary get_and_reset();
+
+ private:
+  LatencyHistogram m_encoder_to_pull;
+  LatencyHistogram m_aggregation;
+  LatencyHistogram m_handoff;
+  LatencyHistogram m_fec_enqueue;
+  LatencyHistogram m_total;
+};
+
+}  // namespace openhd
+
+#endif  // OPENHD_OPENHD_VIDEO_FRAME_TRACE_H
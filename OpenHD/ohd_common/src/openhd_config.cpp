@@ -59,6 +59,10 @@ static openhd::Config load_or_default() {
     ret.GEN_RF_METRICS_LEVEL = r.Get<int>("generic", "GEN_RF_METRICS_LEVEL");
     ret.GEN_NO_QOPENHD_AUTOSTART =
         r.Get<bool>("generic", "GEN_NO_QOPENHD_AUTOSTART");
+    ret.GEN_GROUND_RECORDING = r.Get<bool>("generic", "GEN_GROUND_RECORDING");
+    // Optional, not in older config files
+    ret.GEN_VIDEO_DEBUG_STATS =
+        r.Get<bool>("generic", "GEN_VIDEO_DEBUG_STATS", false);
     //
     ret.DEV_ENABLE_MICROHARD = r.Get<bool>("dev", "DEV_ENABLE_MICROHARD");
     return ret;
@@ -82,7 +86,8 @@ void openhd::debug_config(const openhd::Config& config) {
       "WIFI_LOCAL_NETWORK_SSID:[{}], WIFI_LOCAL_NETWORK_PASSWORD:[{}]\n"
       "NW_MANUAL_FORWARDING_IPS:{},NW_ETHERNET_CARD:{},NW_FORWARD_TO_LOCALHOST_"
       "58XX:{}\n"
-      "GEN_RF_METRICS_LEVEL:{}, GEN_NO_QOPENHD_AUTOSTART:{}\n",
+      "GEN_RF_METRICS_LEVEL:{}, GEN_NO_QOPENHD_AUTOSTART:{}, "
+      "GEN_GROUND_RECORDING:{}, GEN_VIDEO_DEBUG_STATS:{}\n",
       config.WIFI_ENABLE_AUTODETECT,
       OHDUtil::str_vec_as_string(config.WIFI_WB_LINK_CARDS),
       config.WIFI_WIFI_HOTSPOT_CARD, config.WIFI_MONITOR_CARD_EMULATE,
@@ -90,7 +95,8 @@ void openhd::debug_config(const openhd::Config& config) {
       config.WIFI_LOCAL_NETWORK_SSID, config.WIFI_LOCAL_NETWORK_PASSWORD,
       OHDUtil::str_vec_as_string(config.NW_MANUAL_FORWARDING_IPS),
       config.NW_ETHERNET_CARD, config.NW_FORWARD_TO_LOCALHOST_58XX,
-      config.GEN_RF_METRICS_LEVEL, config.GEN_NO_QOPENHD_AUTOSTART);
+      config.GEN_RF_METRICS_LEVEL, config.GEN_NO_QOPENHD_AUTOSTART,
+      config.GEN_GROUND_RECORDING, config.GEN_VIDEO_DEBUG_STATS);
 }
 
 void openhd::debug_config() {
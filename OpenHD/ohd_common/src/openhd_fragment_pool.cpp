@@ -0,0 +1,74 @@
+#include "openhd_fragment_pool.h"
+
+#include <algorithm>
+#include <cstring>
+
+openhd::FragmentPool::FragmentPool(int n_slots) : m_slots(n_slots) {
+  m_free_list.reserve(n_slots);
+  for (int i = n_slots - 1; i >= 0; i--) {
+    m_slots[i].buffer.reserve(FRAGMENT_CAPACITY);
+    m_free_list.push_back(i);
+  }
+}
+
+openhd::FragmentPool& openhd::FragmentPool::instance() {
+  // Intentionally never destroyed - fragments might be released by a thread
+  // that is still running during static destruction.
+  // 1024 slots -> ~1.7MB, enough for a couple of (big) frames in flight
+  static auto* instance = new FragmentPool(1024);
+  return *instance;
+}
+
+std::shared_ptr<std::vector<uint8_t>> openhd::FragmentPool::copy(
+    const uint8_t* data, size_t data_len) {
+  auto ret = allocate(data_len);
+  if (data_len > 0) {
+    std::memcpy(ret->data(), data, data_len);
+  }
+  return ret;
+}
+
+std::shared_ptr<std::vector<uint8_t>> openhd::FragmentPool::allocate(
+    size_t data_len) {
+  const int slot_idx = data_len <= FRAGMENT_CAPACITY ? acquire_slot() : -1;
+  if (slot_idx < 0) {
+    m_n_heap_fallbacks++;
+    return std::make_shared<std::vector<uint8_t>>(data_len);
+  }
+  auto& buffer = m_slots[slot_idx].buffer;
+  // Doesn't re-allocate, since capacity is large enough
+  buffer.resize(data_len);
+  // The buffer itself is not freed, the slot is recycled once the control
+  // block (living in the slot storage) is destroyed
+  return std::shared_ptr<std::vector<uint8_t>>(
+      &buffer, [](std::vector<uint8_t>* /*unused*/) {},
+      SlotAllocator<std::vector<uint8_t>>{this, slot_idx});
+}
+
+openhd::FragmentPool::Stats openhd::FragmentPool::get_stats() {
+  std::lock_guard<std::mutex> guard(m_free_list_mutex);
+  Stats ret{};
+  ret.n_slots = static_cast<int>(m_slots.size());
+  ret.n_in_use = static_cast<int>(m_slots.size() - m_free_list.size());
+  ret.n_in_use_peak = m_n_in_use_peak;
+  ret.n_heap_fallbacks = m_n_heap_fallbacks.load();
+  return ret;
+}
+
+int openhd::FragmentPool::acquire_slot() {
+  std::lock_guard<std::mutex> guard(m_free_list_mutex);
+  if (m_free_list.empty()) {
+    return -1;
+  }
+  const int slot_idx = m_free_list.back();
+  m_free_list.pop_back();
+  const int n_in_use = static_cast<int>(m_slots.size() - m_free_list.size());
+  m_n_in_use_peak = std::max(m_n_in_use_peak, n_in_use);
+  return slot_idx;
+}
+
+void openhd::FragmentPool::release_slot(int slot_idx) {
+  std::lock_guard<std::mutex> guard(m_free_list_mutex);
+  // Never re-allocates, since we reserved space for all slots
+  m_free_list.push_back(slot_idx);
+}
@@ -4,18 +4,201 @@
 #include "openhd_udp.h"
 
 #include <arpa/inet.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstring>
 #include <sstream>
 
 #include "openhd_spdlog.h"
+#include "openhd_spdlog_include.h"
 
 static std::shared_ptr<spdlog::logger> get_console() {
   return openhd::log::create_or_get("UDP");
 }
 
+namespace {
+
+// Max n of messages per sendmmsg call (UIO_MAXIOV)
+constexpr int SENDMMSG_MAX_N_MESSAGES = 1024;
+// With UDP GSO, one message holds multiple packets (segments) of the same
+// size - only the last one may be smaller - and the kernel (or the nic)
+// splits it up. Limited to 64 segments on older kernels. Only for segments
+// that fit into an ethernet frame, bigger packets are sent as they are.
+constexpr int GSO_MAX_N_SEGMENTS = 64;
+constexpr std::size_t GSO_MAX_SEGMENT_SIZE =
+    openhd::UDPReceiver::ETHERNET_DATAGRAM_MAX_SIZE;
+
+bool kernel_supports_udp_gso() {
+#ifdef UDP_SEGMENT
+  const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) return false;
+  int gso_size = 0;
+  socklen_t len = sizeof(gso_size);
+  const bool ret = getsockopt(fd, SOL_UDP, UDP_SEGMENT, &gso_size, &len) == 0;
+  close(fd);
+  return ret;
+#else
+  return false;
+#endif
+}
+
+std::atomic<bool> &udp_gso_enabled() {
+  static std::atomic<bool> enabled{kernel_supports_udp_gso()};
+  return enabled;
+}
+
+// Consecutive packets that are sent with one message
+struct PacketRun {
+  int begin;
+  int n_packets;
+  // 0 if the run is a single packet (no GSO)
+  uint16_t gso_size;
+};
+
+void make_runs(const struct iovec *packets, const int n_packets,
+               const bool use_gso, std::vector<PacketRun> &runs) {
+  runs.clear();
+  int i = 0;
+  while (i < n_packets) {
+    PacketRun run{i, 1, 0};
+    const std::size_t segment_size = packets[i].iov_len;
+    if (use_gso && segment_size > 0 && segment_size <= GSO_MAX_SEGMENT_SIZE) {
+      std::size_t total = segment_size;
+      int end = i + 1;
+      while (end < n_packets && end - i < GSO_MAX_N_SEGMENTS) {
+        const std::size_t len = packets[end].iov_len;
+        if (len == 0 || len > segment_size ||
+            total + len > openhd::UDPReceiver::UDP_PACKET_MAX_SIZE) {
+          break;
+        }
+        total += len;
+        end++;
+        // Only the last segment may be smaller
+        if (len < segment_size) break;
+      }
+      run.n_packets = end - i;
+      if (run.n_packets > 1) run.gso_size = (uint16_t)segment_size;
+    }
+    runs.push_back(run);
+    i += run.n_packets;
+  }
+}
+
+// Replaces the messages from begin on with one message per packet
+void split_messages(std::vector<struct mmsghdr> &msgs,
+                    const std::size_t begin) {
+  std::vector<struct mmsghdr> split;
+  for (std::size_t i = begin; i < msgs.size(); i++) {
+    const auto &hdr = msgs[i].msg_hdr;
+    for (std::size_t k = 0; k < hdr.msg_iovlen; k++) {
+      struct mmsghdr msg {};
+      msg.msg_hdr.msg_name = hdr.msg_name;
+      msg.msg_hdr.msg_namelen = hdr.msg_namelen;
+      msg.msg_hdr.msg_iov = hdr.msg_iov + k;
+      msg.msg_hdr.msg_iovlen = 1;
+      split.push_back(msg);
+    }
+  }
+  msgs.resize(begin);
+  msgs.insert(msgs.end(), split.begin(), split.end());
+}
+
+}  // namespace
+
+bool openhd::isUdpGsoEnabled() { return udp_gso_enabled(); }
+
+void openhd::sendPacketsViaUDP(const int sockfd,
+                               const struct sockaddr_in *destinations,
+                               const int n_destinations,
+                               const struct iovec *packets,
+                               const int n_packets) {
+  if (sockfd < 0 || n_destinations <= 0 || n_packets <= 0) return;
+  union GsoControl {
+    char buf[CMSG_SPACE(sizeof(uint16_t))];
+    struct cmsghdr align;
+  };
+  // Re-used, this is called for each video frame
+  thread_local std::vector<PacketRun> runs;
+  thread_local std::vector<GsoControl> controls;
+  thread_local std::vector<struct mmsghdr> msgs;
+  make_runs(packets, n_packets, udp_gso_enabled(), runs);
+  controls.resize(runs.size());
+  msgs.clear();
+  for (int dest = 0; dest < n_destinations; dest++) {
+    for (std::size_t i = 0; i < runs.size(); i++) {
+      const auto &run = runs[i];
+      struct mmsghdr msg {};
+      msg.msg_hdr.msg_name = (void *)&destinations[dest];
+      msg.msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+      // Not modified by the kernel
+      msg.msg_hdr.msg_iov = const_cast<struct iovec *>(&packets[run.begin]);
+      msg.msg_hdr.msg_iovlen = run.n_packets;
+#ifdef UDP_SEGMENT
+      if (run.gso_size != 0) {
+        msg.msg_hdr.msg_control = controls[i].buf;
+        msg.msg_hdr.msg_controllen = sizeof(controls[i].buf);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg.msg_hdr);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        std::memcpy(CMSG_DATA(cmsg), &run.gso_size, sizeof(uint16_t));
+      }
+#endif
+      msgs.push_back(msg);
+    }
+  }
+  std::size_t i = 0;
+  while (i < msgs.size()) {
+    const auto n = std::min(msgs.size() - i, (size_t)SENDMMSG_MAX_N_MESSAGES);
+    const int ret = sendmmsg(sockfd, &msgs[i], (unsigned int)n, 0);
+    if (ret > 0) {
+      i += ret;
+      continue;
+    }
+    if (ret < 0 && errno == EINTR) continue;
+    const auto &failed = msgs[i].msg_hdr;
+    if (failed.msg_controllen != 0 &&
+        (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT)) {
+      // E.g. no tx checksum offload on the outgoing interface
+      get_console()->warn("UDP GSO not usable ({}), disabled",
+                          strerror(errno));
+      udp_gso_enabled().store(false);
+      split_messages(msgs, i);
+      continue;
+    }
+    const auto &dest = *(const struct sockaddr_in *)failed.msg_name;
+    get_console()->warn("Error sending {} packet(s) to {}:{} code:{} {}",
+                        failed.msg_iovlen, inet_ntoa(dest.sin_addr),
+                        ntohs(dest.sin_port), ret, strerror(errno));
+    i++;
+  }
+}
+
+void openhd::UDPPacketBatch::add(const uint8_t *packet,
+                                 const std::size_t packetSize) {
+  m_packets.emplace_back(m_data.size(), packetSize);
+  m_data.insert(m_data.end(), packet, packet + packetSize);
+}
+
+void openhd::UDPPacketBatch::clear() {
+  m_data.clear();
+  m_packets.clear();
+}
+
+const struct iovec *openhd::UDPPacketBatch::get_packets() {
+  m_iovecs.resize(m_packets.size());
+  for (std::size_t i = 0; i < m_packets.size(); i++) {
+    m_iovecs[i].iov_base = m_data.data() + m_packets[i].first;
+    m_iovecs[i].iov_len = m_packets[i].second;
+  }
+  return m_iovecs.data();
+}
+
 openhd::UDPForwarder::UDPForwarder(std::string client_addr1,
                                    int client_udp_port1)
     : client_addr(std::move(client_addr1)), client_udp_port(client_udp_port1) {
@@ -50,51 +233,89 @@ void openhd::UDPForwarder::forwardPacketViaUDP(
   }
 }
 
+void openhd::UDPForwarder::forwardPacketsViaUDP(const struct iovec *packets,
+                                                const int n_packets) const {
+  sendPacketsViaUDP(sockfd, &saddr, 1, packets, n_packets);
+}
+
+openhd::UDPMultiForwarder::UDPMultiForwarder() {
+  m_destinations = std::make_shared<const Destinations>();
+  m_sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (m_sockfd < 0) {
+    get_console()->warn("Error opening socket:{}", strerror(errno));
+  }
+}
+
+openhd::UDPMultiForwarder::~UDPMultiForwarder() {
+  if (m_sockfd >= 0) close(m_sockfd);
+}
+
 void openhd::UDPMultiForwarder::addForwarder(const std::string &client_addr,
                                              int client_udp_port) {
-  std::lock_guard<std::mutex> guard(udpForwardersLock);
+  std::lock_guard<std::mutex> guard(m_modify_mutex);
+  // Only replaced with the lock held
+  const auto current = std::atomic_load(&m_destinations);
   // check if we already forward data to this IP::Port tuple
-  for (const auto &udpForwarder : udpForwarders) {
-    if (udpForwarder->client_addr == client_addr &&
-        udpForwarder->client_udp_port == client_udp_port) {
-      get_console()->info("UDPMultiForwarder: already forwarding to: {}:{}",
-                          client_addr, client_udp_port);
-      return;
-    }
+  const auto client = std::make_pair(client_addr, client_udp_port);
+  if (std::find(current->clients.begin(), current->clients.end(), client) !=
+      current->clients.end()) {
+    get_console()->info("UDPMultiForwarder: already forwarding to: {}:{}",
+                        client_addr, client_udp_port);
+    return;
   }
   get_console()->info("UDPMultiForwarder: add forwarding to: {}:{}",
                       client_addr, client_udp_port);
-  udpForwarders.emplace_back(
-      std::make_unique<openhd::UDPForwarder>(client_addr, client_udp_port));
+  struct sockaddr_in saddr {};
+  saddr.sin_family = AF_INET;
+  inet_aton(client_addr.c_str(), (in_addr *)&saddr.sin_addr.s_addr);
+  saddr.sin_port = htons((uint16_t)client_udp_port);
+  auto updated = std::make_shared<Destinations>(*current);
+  updated->clients.push_back(client);
+  updated->saddrs.push_back(saddr);
+  std::atomic_store(&m_destinations,
+                    std::shared_ptr<const Destinations>(std::move(updated)));
 }
 
 void openhd::UDPMultiForwarder::removeForwarder(const std::string &client_addr,
                                                 int client_udp_port) {
-  std::lock_guard<std::mutex> guard(udpForwardersLock);
-  udpForwarders.erase(
-      std::find_if(udpForwarders.begin(), udpForwarders.end(),
-                   [&client_addr, &client_udp_port](const auto &udpForwarder) {
-                     return udpForwarder->client_addr == client_addr &&
-                            udpForwarder->client_udp_port == client_udp_port;
-                   }));
+  std::lock_guard<std::mutex> guard(m_modify_mutex);
+  // Only replaced with the lock held
+  const auto current = std::atomic_load(&m_destinations);
+  const auto it = std::find(current->clients.begin(), current->clients.end(),
+                            std::make_pair(client_addr, client_udp_port));
+  if (it == current->clients.end()) return;
+  const auto index = it - current->clients.begin();
+  auto updated = std::make_shared<Destinations>(*current);
+  updated->clients.erase(updated->clients.begin() + index);
+  updated->saddrs.erase(updated->saddrs.begin() + index);
+  std::atomic_store(&m_destinations,
+                    std::shared_ptr<const Destinations>(std::move(updated)));
 }
 
 void openhd::UDPMultiForwarder::forwardPacketViaUDP(
     const uint8_t *packet, const std::size_t packetSize) {
-  std::lock_guard<std::mutex> guard(udpForwardersLock);
-  for (const auto &udpForwarder : udpForwarders) {
-    udpForwarder->forwardPacketViaUDP(packet, packetSize);
-  }
+  struct iovec iov {};
+  iov.iov_base = const_cast<uint8_t *>(packet);
+  iov.iov_len = packetSize;
+  forwardPacketsViaUDP(&iov, 1);
+}
+
+void openhd::UDPMultiForwarder::forwardPacketsViaUDP(
+    const struct iovec *packets, const int n_packets) {
+  const auto destinations = std::atomic_load(&m_destinations);
+  sendPacketsViaUDP(m_sockfd, destinations->saddrs.data(),
+                    (int)destinations->saddrs.size(), packets, n_packets);
 }
 
-const std::list<std::unique_ptr<openhd::UDPForwarder>> &
+openhd::UDPMultiForwarder::Destinations
 openhd::UDPMultiForwarder::getForwarders() const {
-  return udpForwarders;
+  return *std::atomic_load(&m_destinations);
 }
 
 openhd::UDPReceiver::UDPReceiver(std::string client_addr, int client_udp_port,
-                                 openhd::UDPReceiver::OUTPUT_DATA_CALLBACK cb)
-    : mCb(cb) {
+                                 openhd::UDPReceiver::OUTPUT_DATA_CALLBACK cb,
+                                 const std::size_t max_datagram_size)
+    : mCb(cb), m_max_datagram_size(max_datagram_size) {
   mSocket = openhd::openUdpSocketForReceiving(client_addr, client_udp_port);
   get_console()->info("UDPReceiver created with {}:{}", client_addr,
                       client_udp_port);
@@ -103,32 +324,50 @@ openhd::UDPReceiver::UDPReceiver(std::string client_addr, int client_udp_port,
 openhd::UDPReceiver::~UDPReceiver() { stopBackground(); }
 
 void openhd::UDPReceiver::loopUntilError() {
-  const auto buff =
-      std::make_unique<std::array<uint8_t, UDP_PACKET_MAX_SIZE>>();
-  // sockaddr_in source;
-  // socklen_t sourceLen= sizeof(sockaddr_in);
+  const auto log_error_throttled = [this](const std::string &message) {
+    if (std::chrono::steady_clock::now() - m_last_receive_error_log >=
+        std::chrono::seconds(3)) {
+      get_console()->warn("{} log_skip_count:{}", message,
+                          m_last_receive_error_log_skip_count);
+      m_last_receive_error_log = std::chrono::steady_clock::now();
+      m_last_receive_error_log_skip_count = 0;
+    } else {
+      m_last_receive_error_log_skip_count++;
+    }
+  };
+  // Not initialized - only the memory the kernel actually writes to is
+  // touched
+  const std::unique_ptr<uint8_t[]> buff(
+      new uint8_t[RECV_BATCH_SIZE * m_max_datagram_size]);
+  std::array<struct iovec, RECV_BATCH_SIZE> iovecs{};
+  std::array<struct mmsghdr, RECV_BATCH_SIZE> msgs{};
+  for (int i = 0; i < RECV_BATCH_SIZE; i++) {
+    iovecs[i].iov_base = buff.get() + i * m_max_datagram_size;
+    iovecs[i].iov_len = m_max_datagram_size;
+    msgs[i].msg_hdr.msg_iov = &iovecs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
   while (receiving) {
-    // const ssize_t message_length =
-    // recvfrom(mSocket,buff->data(),UDP_PACKET_MAX_SIZE,
-    // MSG_WAITALL,(sockaddr*)&source,&sourceLen);
-    const ssize_t message_length =
-        recv(mSocket, buff->data(), buff->size(), MSG_WAITALL);
-    if (message_length > 0) {
-      mCb(buff->data(), (size_t)message_length);
+    // Blocks until there is at least one datagram, then also takes whatever
+    // else has been queued up in the meantime
+    const int n_messages = recvmmsg(mSocket, msgs.data(), RECV_BATCH_SIZE,
+                                    MSG_WAITFORONE, nullptr);
+    if (n_messages > 0) {
+      for (int i = 0; i < n_messages; i++) {
+        if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+          log_error_throttled(fmt::format(
+              "Dropped datagram bigger than {}", m_max_datagram_size));
+          continue;
+        }
+        if (msgs[i].msg_len == 0) continue;
+        mCb((const uint8_t *)iovecs[i].iov_base, msgs[i].msg_len);
+      }
     } else {
       // this can also come from the shutdown, in which case it is not an error.
       // But this way we break out of the loop.
       if (receiving) {
-        if (std::chrono::steady_clock::now() - m_last_receive_error_log >=
-            std::chrono::seconds(3)) {
-          get_console()->warn("Got message length of: {} log_skip_count:{}",
-                              message_length,
-                              m_last_receive_error_log_skip_count);
-          m_last_receive_error_log = std::chrono::steady_clock::now();
-          m_last_receive_error_log_skip_count = 0;
-        } else {
-          m_last_receive_error_log_skip_count++;
-        }
+        log_error_throttled(
+            fmt::format("Got message length of: {}", n_messages));
       }
     }
   }
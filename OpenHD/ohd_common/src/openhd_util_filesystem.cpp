@@ -117,7 +117,8 @@ void OHDFilesystemUtil::make_file_read_write_everyone(
         "Cannot change file {} rw anybody, file does not exist", filename);
     return;
   }
-  const auto res = chmod(filename.c_str(), S_IROTH | S_IWOTH);
+  const auto res = chmod(filename.c_str(), S_IRUSR | S_IWUSR | S_IRGRP |
+                                               S_IWGRP | S_IROTH | S_IWOTH);
   if (res != 0) {
     openhd::log::get_default()->warn("Cannot change file {} rw anybody, ret:{}",
                                      filename, res);
@@ -0,0 +1,105 @@
+#include "openhd_video_frame_trace.h"
+
+#include <algorithm>
+#include <sstream>
+
+void openhd::LatencyHistogram::add(std::chrono::nanoseconds latency) {
+  const auto latency_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::max(latency, std::chrono::nanoseconds(0)))
+                              .count();
+  const auto value_us =
+      static_cast<uint32_t>(std::min<int64_t>(latency_us, UINT32_MAX));
+  const int bucket =
+      std::min(static_cast<int>(value_us / BUCKET_WIDTH_US), N_BUCKETS - 1);
+  std::lock_guard<std::mutex> guard(m_mutex);
+  m_buckets[bucket]++;
+  m_count++;
+  m_min_us = std::min(m_min_us, value_us);
+  m_max_us = std::max(m_max_us, value_us);
+  m_sum_us += value_us;
+}
+
+openhd::LatencyHistogram::Summary openhd::LatencyHistogram::get_and_reset() {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  Summary ret{};
+  if (m_count > 0) {
+    ret.count = m_count;
+    ret.min_us = m_min_us;
+    ret.max_us = m_max_us;
+    ret.avg_us = static_cast<uint32_t>(m_sum_us / m_count);
+    // Walk the buckets until we have 99% of all values
+    const uint64_t target = (static_cast<uint64_t>(m_count) * 99 + 99) / 100;
+    uint64_t n_seen = 0;
+    for (int i = 0; i < N_BUCKETS; i++) {
+      n_seen += m_buckets[i];
+      if (n_seen >= target) {
+        // Upper bound of the bucket, but never more than the actual max
+        ret.p99_us = std::min((i + 1) * BUCKET_WIDTH_US, m_max_us);
+        break;
+      }
+    }
+  }
+  m_buckets.fill(0);
+  m_count = 0;
+  m_min_us = UINT32_MAX;
+  m_max_us = 0;
+  m_sum_us = 0;
+  return ret;
+}
+
+void openhd::FrameTraceAggregator::add(const openhd::FrameTrace& trace) {
+  if (trace.buffer_timestamp.has_value() &&
+      trace.last_fragment_pull.has_value()) {
+    m_encoder_to_pull.add(trace.last_fragment_pull.value() -
+                          trace.buffer_timestamp.value());
+  }
+  if (trace.first_fragment_pull.has_value() && trace.aggregated.has_value()) {
+    m_aggregation.add(trace.aggregated.value() -
+                      trace.first_fragment_pull.value());
+  }
+  if (trace.aggregated.has_value() && trace.transmit_entry.has_value()) {
+    m_handoff.add(trace.transmit_entry.value() - trace.aggregated.value());
+  }
+  if (trace.transmit_entry.has_value() && trace.fec_enqueued.has_value()) {
+    m_fec_enqueue.add(trace.fec_enqueued.value() -
+                      trace.transmit_entry.value());
+  }
+  if (trace.fec_enqueued.has_value()) {
+    std::optional<FrameTrace::TimePoint> earliest = trace.buffer_timestamp;
+    if (!earliest.has_value()) earliest = trace.first_fragment_pull;
+    if (!earliest.has_value()) earliest = trace.aggregated;
+    if (earliest.has_value()) {
+      m_total.add(trace.fec_enqueued.value() - earliest.value());
+    }
+  }
+}
+
+openhd::FrameTraceAggregator::Summary
+openhd::FrameTraceAggregator::get_and_reset() {
+  Summary ret{};
+  ret.encoder_to_pull = m_encoder_to_pull.get_and_reset();
+  ret.aggregation = m_aggregation.get_and_reset();
+  ret.handoff = m_handoff.get_and_reset();
+  ret.fec_enqueue = m_fec_enqueue.get_and_reset();
+  ret.total = m_total.get_and_reset();
+  return ret;
+}
+
+static std::string summary_to_string(
+    const openhd::LatencyHistogram::Summary& summary) {
+  std::stringstream ss;
+  ss << summary.min_us << "/" << summary.avg_us << "/" << summary.p99_us
+     << "us";
+  return ss.str();
+}
+
+std::string openhd::FrameTraceAggregator::Summary::to_string() const {
+  std::stringstream ss;
+  ss << "min/avg/p99 frames:" << total.count;
+  ss << " enc->pull:" << summary_to_string(encoder_to_pull);
+  ss << " aggregate:" << summary_to_string(aggregation);
+  ss << " handoff:" << summary_to_string(handoff);
+  ss << " fec enqueue:" << summary_to_string(fec_enqueue);
+  ss << " total:" << summary_to_string(total);
+  return ss.str();
+}
@@ -0,0 +1,90 @@
+#include <array>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "openhd_fragment_pool.h"
+#include "openhd_video_frame.h"
+
+static void print_stats(openhd::FragmentPool& pool) {
+  const auto stats = pool.get_stats();
+  std::cout << "Slots:" << stats.n_slots << " in use:" << stats.n_in_use
+            << " peak:" << stats.n_in_use_peak
+            << " heap fallbacks:" << stats.n_heap_fallbacks << "\n";
+}
+
+static void test_recycle() {
+  openhd::FragmentPool pool(4);
+  std::vector<uint8_t> data(1440, 0x0A);
+  {
+    auto fragment = pool.copy(data.data(), data.size());
+    if (*fragment != data) throw std::runtime_error("copy content");
+    if (pool.get_stats().n_in_use != 1) throw std::runtime_error("in use");
+    auto copy = fragment;
+    if (pool.get_stats().n_in_use != 1) throw std::runtime_error("in use");
+  }
+  if (pool.get_stats().n_in_use != 0) throw std::runtime_error("not recycled");
+  // Exhaust the pool, then fall back to the heap
+  std::vector<std::shared_ptr<std::vector<uint8_t>>> fragments;
+  for (int i = 0; i < 6; i++) {
+    fragments.push_back(pool.copy(data.data(), data.size()));
+  }
+  if (pool.get_stats().n_in_use != 4) throw std::runtime_error("exhausted");
+  if (pool.get_stats().n_heap_fallbacks != 2) {
+    throw std::runtime_error("heap fallback");
+  }
+  fragments.resize(0);
+  // Too big for a slot
+  std::vector<uint8_t> big(openhd::FragmentPool::FRAGMENT_CAPACITY + 1);
+  auto big_fragment = pool.copy(big.data(), big.size());
+  if (big_fragment->size() != big.size()) {
+    throw std::runtime_error("big fragment size");
+  }
+  if (pool.get_stats().n_heap_fallbacks != 3) {
+    throw std::runtime_error("big fragment fallback");
+  }
+  // Small objects
+  {
+    auto obj = pool.make_shared<std::array<int, 8>>();
+    if (pool.get_stats().n_in_use != 1) throw std::runtime_error("in use");
+  }
+  if (pool.get_stats().n_in_use != 0) throw std::runtime_error("not recycled");
+  print_stats(pool);
+}
+
+// Allocate on one thread, release on another (like camera -> wb tx thread)
+static void test_multi_threaded() {
+  auto& pool = openhd::FragmentPool::instance();
+  std::vector<uint8_t> data(1000, 0x0B);
+  std::mutex mutex;
+  std::vector<openhd::VideoFragment> queue;
+  bool done = false;
+  std::thread consumer([&]() {
+    while (true) {
+      std::lock_guard<std::mutex> guard(mutex);
+      queue.resize(0);
+      if (done) break;
+    }
+  });
+  for (int i = 0; i < 100000; i++) {
+    auto fragment = openhd::VideoFragment(pool.copy(data.data(), data.size()));
+    std::lock_guard<std::mutex> guard(mutex);
+    queue.push_back(fragment);
+  }
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    done = true;
+  }
+  consumer.join();
+  queue.resize(0);
+  if (pool.get_stats().n_in_use != 0) throw std::runtime_error("not recycled");
+  print_stats(pool);
+}
+
+int main(int argc, char *argv[]) {
+  test_recycle();
+  test_multi_threaded();
+  std::cout << "Done\n";
+  return 0;
+}
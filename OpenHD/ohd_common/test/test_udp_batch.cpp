@@ -0,0 +1,174 @@
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "openhd_udp.h"
+
+static constexpr int TEST_PORT = 5620;
+
+// Collects everything the receiver gets
+class Collector {
+ public:
+  void add(const uint8_t* data, std::size_t len) {
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      m_received.emplace_back(data, data + len);
+    }
+    m_cv.notify_one();
+  }
+  // Waits for n datagrams (or a timeout), then takes all of them
+  std::vector<std::vector<uint8_t>> take(const std::size_t n) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait_for(lock, std::chrono::seconds(2),
+                  [this, n] { return m_received.size() >= n; });
+    // Anything unexpected (e.g. duplicates) should show up by now
+    lock.unlock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    lock.lock();
+    auto ret = std::move(m_received);
+    m_received.clear();
+    return ret;
+  }
+
+ private:
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::vector<std::vector<uint8_t>> m_received;
+};
+
+// Packets of the given sizes, the content tells them apart
+static std::vector<std::vector<uint8_t>> make_packets(
+    const std::vector<std::size_t>& sizes) {
+  std::vector<std::vector<uint8_t>> ret;
+  for (std::size_t i = 0; i < sizes.size(); i++) {
+    ret.emplace_back(sizes[i], (uint8_t)(i + 1));
+  }
+  return ret;
+}
+
+static openhd::UDPPacketBatch to_batch(
+    const std::vector<std::vector<uint8_t>>& packets) {
+  openhd::UDPPacketBatch batch;
+  for (const auto& packet : packets) batch.add(packet.data(), packet.size());
+  return batch;
+}
+
+static void check_received(const std::vector<std::vector<uint8_t>>& sent,
+                           Collector& collector, const char* what) {
+  const auto received = collector.take(sent.size());
+  if (received.size() != sent.size()) {
+    std::cerr << what << ": sent " << sent.size() << " got "
+              << received.size() << "\n";
+    throw std::runtime_error(what);
+  }
+  // Loopback keeps the order
+  for (std::size_t i = 0; i < sent.size(); i++) {
+    if (received[i] != sent[i]) throw std::runtime_error(what);
+  }
+}
+
+// All segments the same size, one GSO message
+static void test_equal_size(openhd::UDPForwarder& forwarder,
+                            Collector& collector) {
+  const auto size = openhd::UDPReceiver::ETHERNET_DATAGRAM_MAX_SIZE;
+  const auto sent = make_packets(std::vector<std::size_t>(40, size));
+  auto batch = to_batch(sent);
+  forwarder.forwardPacketsViaUDP(batch.get_packets(), batch.size());
+  check_received(sent, collector, "equal size");
+}
+
+// The last segment of a GSO message is smaller, followed by packets that
+// need a new message (bigger again / not GSO at all)
+static void test_shorter_last(openhd::UDPForwarder& forwarder,
+                              Collector& collector) {
+  std::vector<std::size_t> sizes(10, 1200);
+  sizes.push_back(300);
+  sizes.push_back(1000);
+  sizes.push_back(1000);
+  sizes.push_back(1);
+  const auto sent = make_packets(sizes);
+  auto batch = to_batch(sent);
+  forwarder.forwardPacketsViaUDP(batch.get_packets(), batch.size());
+  check_received(sent, collector, "shorter last");
+}
+
+// Fewer datagrams than one recvmmsg call can take, queued up before the
+// receiver starts. A datagram bigger than the receive buffer is dropped.
+static void test_recv_few() {
+  Collector collector;
+  openhd::UDPReceiver receiver(
+      openhd::ADDRESS_LOCALHOST, TEST_PORT + 1,
+      [&collector](const uint8_t* data, std::size_t len) {
+        collector.add(data, len);
+      },
+      1000);
+  openhd::UDPForwarder forwarder(openhd::ADDRESS_LOCALHOST, TEST_PORT + 1);
+  const auto sent = make_packets({100, 1000, 5, 999, 1});
+  const std::vector<uint8_t> too_big(1001, 0xFF);
+  forwarder.forwardPacketViaUDP(too_big.data(), too_big.size());
+  for (const auto& packet : sent) {
+    forwarder.forwardPacketViaUDP(packet.data(), packet.size());
+  }
+  receiver.runInBackground();
+  check_received(sent, collector, "recv few");
+  receiver.stopBackground();
+}
+
+// The kernel rejects GSO on a socket without udp checksums - everything
+// still arrives, and GSO is disabled from then on
+static void test_gso_rejected(Collector& collector) {
+  const bool gso_was_enabled = openhd::isUdpGsoEnabled();
+  const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) throw std::runtime_error("socket");
+  int enable = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_NO_CHECK, &enable, sizeof(enable)) != 0) {
+    throw std::runtime_error("SO_NO_CHECK");
+  }
+  struct sockaddr_in saddr {};
+  saddr.sin_family = AF_INET;
+  inet_aton(openhd::ADDRESS_LOCALHOST.c_str(), &saddr.sin_addr);
+  saddr.sin_port = htons(TEST_PORT);
+  std::vector<std::size_t> sizes(30, 1000);
+  sizes.push_back(500);
+  const auto sent = make_packets(sizes);
+  auto batch = to_batch(sent);
+  openhd::sendPacketsViaUDP(fd, &saddr, 1, batch.get_packets(), batch.size());
+  check_received(sent, collector, "gso rejected");
+  if (gso_was_enabled && openhd::isUdpGsoEnabled()) {
+    throw std::runtime_error("gso not disabled");
+  }
+  // And without GSO from the start
+  openhd::sendPacketsViaUDP(fd, &saddr, 1, batch.get_packets(), batch.size());
+  check_received(sent, collector, "gso disabled");
+  close(fd);
+}
+
+int main() {
+  std::cout << "UDP GSO " << (openhd::isUdpGsoEnabled() ? "" : "not ")
+            << "supported\n";
+  Collector collector;
+  openhd::UDPReceiver receiver(
+      openhd::ADDRESS_LOCALHOST, TEST_PORT,
+      [&collector](const uint8_t* data, std::size_t len) {
+        collector.add(data, len);
+      },
+      openhd::UDPReceiver::ETHERNET_DATAGRAM_MAX_SIZE);
+  receiver.runInBackground();
+  openhd::UDPForwarder forwarder(openhd::ADDRESS_LOCALHOST, TEST_PORT);
+  test_equal_size(forwarder, collector);
+  test_shorter_last(forwarder, collector);
+  test_recv_few();
+  // Last, this disables GSO for the process
+  test_gso_rejected(collector);
+  receiver.stopBackground();
+  std::cout << "UDP batch tests passed\n";
+  return 0;
+}
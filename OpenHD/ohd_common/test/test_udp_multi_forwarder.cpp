@@ -0,0 +1,113 @@
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "openhd_udp.h"
+
+static constexpr int TEST_PORT = 5630;
+static constexpr int N_DESTINATIONS = 4;
+
+// N of datagrams waiting on the socket, drops them
+static int drain(const int fd) {
+  int ret = 0;
+  uint8_t buff[1500];
+  while (recv(fd, buff, sizeof(buff), MSG_DONTWAIT) > 0) ret++;
+  return ret;
+}
+
+// Destinations are added / removed while other threads forward (like
+// ground stations connecting while video is running)
+static void test_add_remove_while_forwarding() {
+  std::vector<int> sockets;
+  for (int i = 0; i < N_DESTINATIONS; i++) {
+    const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) throw std::runtime_error("socket");
+    struct sockaddr_in saddr {};
+    saddr.sin_family = AF_INET;
+    inet_aton(openhd::ADDRESS_LOCALHOST.c_str(), &saddr.sin_addr);
+    saddr.sin_port = htons(TEST_PORT + i);
+    if (bind(fd, (struct sockaddr*)&saddr, sizeof(saddr)) != 0) {
+      throw std::runtime_error("bind");
+    }
+    // Big enough for what arrives between the drain() calls
+    const int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    sockets.push_back(fd);
+  }
+  openhd::UDPMultiForwarder forwarder;
+  std::atomic<bool> run = true;
+  std::vector<std::thread> forwarding;
+  for (int t = 0; t < 2; t++) {
+    forwarding.emplace_back([&forwarder, &run] {
+      openhd::UDPPacketBatch batch;
+      const std::vector<uint8_t> data(1000, 0x0C);
+      for (int i = 0; i < 8; i++) batch.add(data.data(), data.size());
+      while (run) {
+        forwarder.forwardPacketsViaUDP(batch.get_packets(), batch.size());
+        forwarder.forwardPacketViaUDP(data.data(), data.size());
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+      }
+    });
+  }
+  const auto end =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+  int n_changes = 0;
+  while (std::chrono::steady_clock::now() < end) {
+    const int port = TEST_PORT + n_changes % N_DESTINATIONS;
+    forwarder.addForwarder(openhd::ADDRESS_LOCALHOST, port);
+    // Already added
+    forwarder.addForwarder(openhd::ADDRESS_LOCALHOST, port);
+    const auto destinations = forwarder.getForwarders();
+    if (destinations.clients.size() != destinations.saddrs.size()) {
+      throw std::runtime_error("inconsistent snapshot");
+    }
+    if (destinations.clients.size() > N_DESTINATIONS) {
+      throw std::runtime_error("duplicates");
+    }
+    if (n_changes % 3 == 0) {
+      forwarder.removeForwarder(openhd::ADDRESS_LOCALHOST, port);
+    }
+    for (const int fd : sockets) drain(fd);
+    n_changes++;
+    std::this_thread::sleep_for(std::chrono::microseconds(500));
+  }
+  // Only the first destination is left
+  for (int i = 0; i < N_DESTINATIONS; i++) {
+    forwarder.removeForwarder(openhd::ADDRESS_LOCALHOST, TEST_PORT + i);
+  }
+  forwarder.addForwarder(openhd::ADDRESS_LOCALHOST, TEST_PORT);
+  if (forwarder.getForwarders().clients.size() != 1) {
+    throw std::runtime_error("n destinations");
+  }
+  // Anything sent with an older snapshot arrives in the meantime
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  for (const int fd : sockets) drain(fd);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  run = false;
+  for (auto& thread : forwarding) thread.join();
+  std::vector<int> n_received;
+  for (const int fd : sockets) n_received.push_back(drain(fd));
+  std::cout << "Changes:" << n_changes << " received:";
+  for (const int n : n_received) std::cout << " " << n;
+  std::cout << "\n";
+  if (n_received[0] == 0) throw std::runtime_error("nothing received");
+  for (int i = 1; i < N_DESTINATIONS; i++) {
+    if (n_received[i] != 0) {
+      throw std::runtime_error("removed destination received");
+    }
+  }
+  for (const int fd : sockets) close(fd);
+}
+
+int main() {
+  test_add_remove_while_forwarding();
+  std::cout << "UDP multi forwarder tests passed\n";
+  return 0;
+}
@@ -0,0 +1,136 @@
+#ifndef OPENHD_SIM_LINK_H
+#define OPENHD_SIM_LINK_H
+
+#include <memory>
+#include <mutex>
+
+#include "openhd_link.hpp"
+#include "sim_link_channel.h"
+#include "wb_link_frame_coalescer.h"
+#include "wb_link_rate_controller.h"
+#include "wb_link_tx_scheduler.h"
+
+namespace openhd::sim {
+
+// The air transmit path of WBLink that is replayed in the simulation
+struct AirTxConfig {
+  // Latency budget for coalescing the frames of the secondary video stream,
+  // 0 = disabled
+  std::chrono::milliseconds secondary_coalesce_budget{0};
+  int max_fec_block_size = 20;
+  // The theoretical max video rate (what WBLink derives from MCS / channel
+  // width), the ceiling of the rate control. 0 = rate control disabled.
+  int max_video_rate_kbits = 0;
+  int video_rate_floor_kbits = 1000;
+  int video_rate_headroom_perc = 10;
+  // Loss the (real) FEC could recover, for the rate control - there is no FEC
+  // in the simulation
+  int video_fec_perc = 20;
+};
+
+class SimLinkPair;
+
+/**
+ * One side (air or ground) of a simulated link, see SimLinkPair.
+ */
+class SimLink : public OHDLink {
+ public:
+  SimLink(SimLinkPair& pair, bool is_air);
+  void transmit_telemetry_data(TelemetryTxPacket packet) override;
+  // Only valid on air - each rtp fragment is one packet on the channel
+  void transmit_video_data(
+      int stream_index,
+      const openhd::FragmentedVideoFrame& fragmented_video_frame) override;
+  void transmit_audio_data(const openhd::AudioPacket& audio_packet) override;
+
+ private:
+  friend class SimLinkPair;
+  void on_receive(const SimChannel::Packet& packet);
+
+ private:
+  SimLinkPair& m_pair;
+  const bool m_is_air;
+  std::shared_ptr<spdlog::logger> m_console;
+};
+
+/**
+ * Connects an air and a ground OHDLink in one process through a simulated
+ * channel for each direction - e.g. for benchmarking rate control, queueing
+ * and ground forwarding without any wifi cards, reproducibly.
+ * Time does not pass by itself, it is advanced by the user (see advance()),
+ * and packets that have arrived are delivered to the receiving side during
+ * that call. Anything transmitted happens at the current (virtual) time.
+ * The air transmit path runs the same components as WBLink, on the virtual
+ * clock: the secondary video stream is coalesced (FrameCoalescer), all air
+ * data goes through the TxPriorityScheduler (without its thread, dispatched
+ * on transmit and on advance()) and the VideoBitrateController is updated
+ * every RATE_ADJUSTMENT_INTERVAL. Not covered: FEC / the wifibroadcast
+ * stream classes (the channel loss is what the receiver sees, and it is fed
+ * to the rate control directly instead of being reported back by the
+ * ground), tx errors of a card and the encoder, which has to be emulated by
+ * the user (see get_video_bitrate_kbits()). The coalesce flush and the retry
+ * of blocked items only happen on advance().
+ * Thread-safe, and the receive callbacks may transmit.
+ */
+class SimLinkPair {
+ public:
+  SimLinkPair(ChannelConfig downlink, ChannelConfig uplink,
+              AirTxConfig air_tx = {});
+  std::shared_ptr<SimLink> get_air() { return m_air; }
+  std::shared_ptr<SimLink> get_ground() { return m_ground; }
+  // Moves the virtual clock forward and delivers everything that arrived
+  void advance(std::chrono::nanoseconds duration);
+  Time get_now();
+  // Air to ground
+  ChannelStats get_downlink_stats();
+  // Ground to air
+  ChannelStats get_uplink_stats();
+  // Bytes air has enqueued that have not been put on air yet
+  int get_downlink_queue_bytes();
+  // The bitrate the rate control recommends to the encoder
+  int get_video_bitrate_kbits();
+  int get_n_video_rate_decreases();
+  // Dropped by the tx scheduler or (in parts) by the full downlink tx queue
+  int64_t get_n_video_frames_dropped();
+  static constexpr auto RATE_ADJUSTMENT_INTERVAL =
+      std::chrono::milliseconds(50);
+
+ private:
+  friend class SimLink;
+  bool send(bool from_air, SimChannel::Packet packet, int n_injections);
+  // The tx scheduler and the coalescer are fed on the virtual clock
+  static std::chrono::steady_clock::time_point to_time_point(Time time);
+  bool downlink_has_space();
+  // Air, everything below is called with m_tx_mutex held
+  void air_submit(openhd::wb::TxPriorityScheduler::Lane lane,
+                  SimChannel::Packet packet, int n_injections);
+  void air_submit_video(int stream_index,
+                        openhd::wb::FrameCoalescer::Frame frame);
+  void air_submit_video_block(int stream_index,
+                              openhd::wb::FrameCoalescer::Block block);
+  void air_update(Time now);
+
+ private:
+  const AirTxConfig m_air_tx_config;
+  std::mutex m_mutex;
+  Time m_now{0};
+  SimChannel m_downlink;
+  SimChannel m_uplink;
+  const int m_max_downlink_queue_bytes;
+  // Serializes the air transmit path (one producer for the tx scheduler).
+  // Taken before m_mutex, never while holding it.
+  std::mutex m_tx_mutex;
+  openhd::wb::FrameCoalescer m_secondary_coalescer;
+  std::unique_ptr<openhd::wb::TxPriorityScheduler> m_tx_scheduler;
+  openhd::wb::VideoBitrateController m_rate_controller;
+  Time m_next_rate_update{0};
+  int m_n_dropped_frames_since_update = 0;
+  int64_t m_n_dropped_frames = 0;
+  ChannelStats m_last_downlink_stats{};
+  std::shared_ptr<SimLink> m_air;
+  std::shared_ptr<SimLink> m_ground;
+};
+
+}  // namespace openhd::sim
+
+#endif  // OPENHD_SIM_LINK_H
@@ -0,0 +1,113 @@
+#ifndef OPENHD_SIM_LINK_CHANNEL_H
+#define OPENHD_SIM_LINK_CHANNEL_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include <random>
+#include <vector>
+
+namespace openhd::sim {
+
+// Everything in the simulation runs on a virtual clock (time since the start
+// of the simulation), which makes runs reproducible and independent of the
+// speed of the machine.
+using Time = std::chrono::nanoseconds;
+
+struct ChannelConfig {
+  // Serialization rate of the air interface, 0 = unlimited
+  int64_t bandwidth_bits_per_second = 10 * 1000 * 1000;
+  std::chrono::nanoseconds latency = std::chrono::milliseconds(2);
+  // Uniformly distributed in [0,jitter], added to the latency. Packets still
+  // arrive in order (unless reordered, see below), like on a real link.
+  std::chrono::nanoseconds jitter{0};
+  // Gilbert-Elliott burst loss: two states (good, bad) with their own loss
+  // probability, the state changes before each packet with the given
+  // transition probability.
+  double p_good_to_bad = 0;
+  double p_bad_to_good = 1;
+  double loss_good = 0;
+  double loss_bad = 1;
+  // Probability that a packet is held back by reorder_delay (and therefore
+  // overtaken by the packets after it)
+  double p_reorder = 0;
+  std::chrono::nanoseconds reorder_delay = std::chrono::milliseconds(5);
+  // Packets are dropped once this many bytes are waiting for transmission
+  // (like the tx queue of a card), 0 = unlimited
+  int max_queue_bytes = 256 * 1024;
+  uint32_t seed = 0;
+};
+
+struct ChannelStats {
+  int64_t n_packets = 0;
+  // Dropped because the tx queue was full
+  int64_t n_dropped_queue = 0;
+  // Lost on air (all injections, in case of multiple)
+  int64_t n_lost = 0;
+  int64_t n_reordered = 0;
+  int64_t n_delivered = 0;
+  int64_t bytes_delivered = 0;
+};
+
+/**
+ * Unidirectional simulated radio channel with limited bandwidth, latency,
+ * jitter, burst loss and reordering. Decisions (loss, jitter, reordering) are
+ * made when a packet is sent, from a seeded generator - the same sequence of
+ * sends always results in the same sequence of deliveries.
+ * Not thread-safe.
+ */
+class SimChannel {
+ public:
+  enum class PacketType { TELEMETRY, VIDEO, AUDIO };
+  struct Packet {
+    PacketType type = PacketType::TELEMETRY;
+    int stream_index = 0;
+    std::shared_ptr<std::vector<uint8_t>> data;
+  };
+  explicit SimChannel(ChannelConfig config);
+  /**
+   * The packet is injected n_injections times (bandwidth is consumed for each)
+   * and delivered (once) if at least one injection survives.
+   * Returns false if the packet was dropped due to a full tx queue.
+   */
+  bool send(Packet packet, Time now, int n_injections = 1);
+  // All packets that have arrived until now, in order of arrival
+  std::vector<Packet> receive(Time now);
+  // Bytes that have not been put on air yet
+  int get_queue_bytes(Time now) const;
+  int get_n_packets_in_flight() const { return (int)m_in_flight.size(); }
+  const ChannelStats& get_stats() const { return m_stats; }
+
+ private:
+  double random_uniform();
+  bool is_lost();
+  Time get_serialization_time(size_t n_bytes) const;
+
+ private:
+  struct InFlight {
+    Time arrival;
+    // tie breaker, keeps the order of packets arriving at the same time
+    uint64_t seq;
+    Packet packet;
+    bool operator>(const InFlight& other) const {
+      if (arrival != other.arrival) return arrival > other.arrival;
+      return seq > other.seq;
+    }
+  };
+  const ChannelConfig m_config;
+  std::mt19937 m_rng;
+  bool m_bad_state = false;
+  // When the air interface is done with the packets enqueued so far
+  Time m_tx_free{0};
+  // Arrival of the last packet that has not been reordered
+  Time m_last_in_order_arrival{0};
+  uint64_t m_seq = 0;
+  std::priority_queue<InFlight, std::vector<InFlight>, std::greater<>>
+      m_in_flight;
+  ChannelStats m_stats{};
+};
+
+}  // namespace openhd::sim
+
+#endif  // OPENHD_SIM_LINK_CHANNEL_H
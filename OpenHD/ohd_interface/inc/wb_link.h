@@ -3,6 +3,7 @@
 
 #include <array>
 #include <chrono>
+#include <condition_variable>
 #include <optional>
 #include <utility>
 #include <vector>
@@ -18,10 +19,18 @@
 #include "openhd_profile.h"
 #include "openhd_settings_imp.h"
 #include "openhd_spdlog.h"
+#include "openhd_udp.h"
 #include "openhd_util_time.h"
+#include "wb_link_drop_stats.h"
+#include "wb_link_frame_coalescer.h"
 #include "wb_link_helper.h"
+#include "wb_link_interference_map.h"
 #include "wb_link_manager.h"
+#include "wb_link_rate_controller.h"
+#include "wb_link_scan_helper.h"
+#include "wb_link_scheduler.h"
 #include "wb_link_settings.h"
+#include "wb_link_tx_scheduler.h"
 #include "wb_link_work_item.hpp"
 #include "wifi_card.h"
 
@@ -93,6 +102,9 @@ class WBLink : public OHDLink {
   bool set_air_enable_wb_video_variable_bitrate(int value);
   bool set_air_max_fec_block_size_for_platform(int value);
   bool set_air_wb_video_rate_for_mcs_adjustment_percent(int value);
+  bool set_air_wb_video_rate_floor_kbits(int value);
+  bool set_air_wb_video_rate_headroom_perc(int value);
+  bool set_air_wb_video_secondary_coalesce_ms(int value);
   bool set_dev_air_set_high_retransmit_count(int value);
   // Initiate channel scan / channel analyze.
   // Those operations run asynchronous until completed, and during this time
@@ -115,14 +127,32 @@ class WBLink : public OHDLink {
    * the main thread updates the tx power
    */
   void update_arming_state(bool armed);
-  // Recalculate stats, apply settings asynchronously and more
-  void loop_do_work();
+  // Executes the queued up work item(s), one at a time
+  void loop_work_items();
+  // Apply the tx power / mcs index if requested (e.g. arming state changed)
+  void wt_apply_requested_settings();
   // update statistics, done in regular intervals, updated data is given to the
   // ohd_telemetry module via the action handler
   void wt_update_statistics();
+  // Ground: calculate the video loss since the last call, which is reported
+  // back to the air via the management frames
+  void wt_gnd_update_reported_loss(int64_t count_blocks_lost,
+                                   int64_t count_blocks_total);
   // Do rate adjustments, does nothing if variable bitrate is disabled
   void wt_perform_rate_adjustment();
   void wt_gnd_perform_channel_management();
+  // Ground, only scheduled when enabled (needs a spare card): sample the
+  // interference on the current channel and, with the spare card, on all the
+  // other channels one after another. Unlike perform_channel_analyze, video
+  // keeps working.
+  void wt_gnd_perform_background_analysis();
+  // The card used for background analysis, never the tx card
+  int select_background_analysis_spare_card();
+  // Once per round of the background analysis - tells the user (statustext)
+  // if there is a channel with much less interference
+  void wt_gnd_recommend_frequency(
+      const std::vector<openhd::WifiChannel>& channels);
+  bool set_gnd_background_analyze(int value);
   // this is special, mcs index can not only be changed via mavlink param, but
   // also via RC channel (if enabled)
   void wt_perform_mcs_via_rc_channel_if_enabled();
@@ -154,6 +184,25 @@ class WBLink : public OHDLink {
   // to this frequency if found. continuously broadcasts progress via mavlink.
   void perform_channel_scan(
       const openhd::LinkActionHandler::ScanChannelsParam& scan_channels_params);
+  struct ChannelScanResult {
+    bool success = false;
+    int frequency = 0;
+    int channel_width = 0;
+  };
+  // One channel after another, all cards on the same channel
+  ChannelScanResult scan_channels_sequential(
+      const std::vector<openhd::WifiChannel>& channels_to_scan,
+      const std::vector<uint16_t>& channel_widths_to_scan);
+  // Ground with more than one card: the channels are split between the cards
+  // and scanned concurrently, all cards stop once any card found the air unit
+  ChannelScanResult scan_channels_parallel(
+      const std::vector<openhd::WifiChannel>& channels_to_scan,
+      uint16_t channel_width);
+  bool can_scan_channels_in_parallel() const;
+  // Evidence of the air unit on a channel (ScanDwell), the same for both
+  // scans: valid packets since the dwell began, plus the packets that likely
+  // come from an openhd air unit (only known for all cards together)
+  int64_t get_scan_n_openhd_packets(int64_t n_valid_packets);
   // similar to channel scan, analyze channel(s) for interference
   void perform_channel_analyze(int channels_to_scan);
   void reset_all_rx_stats();
@@ -162,6 +211,22 @@ class WBLink : public OHDLink {
   // and passive mode is enabled by the user
   void re_enable_injection_unless_user_passive_mode_enabled();
   int get_max_fec_block_size();
+  // Hands a video block to the tx scheduler, the trace (if any) is recorded
+  // once it has been enqueued
+  void submit_video_block(int stream_index,
+                          openhd::wb::FrameCoalescer::Block block,
+                          std::optional<openhd::FrameTrace> trace);
+  // Air: transmits the coalesced frames of the secondary video stream once
+  // the oldest one has used up its latency budget
+  void wt_flush_coalesced_video();
+  // Snapshots the video tx configuration, called whenever it changes
+  void update_video_tx_config();
+  // Tx scheduler thread only, does nothing if unchanged
+  void wt_video_tx_set_encryption(int stream_index, bool enable);
+  // Thread-safe, accounts dropped video frames for the rate control and stats
+  void on_video_frames_dropped(int stream_index,
+                               openhd::link_statistics::VideoDropReason reason,
+                               int n_dropped_frames);
   // Called when the wifi card (really really likely) disconneccted
   void on_wifi_card_fatal_error();
 
@@ -185,26 +250,113 @@ class WBLink : public OHDLink {
   // For audio or custom data
   std::unique_ptr<WBStreamTx> m_wb_audio_tx;
   std::unique_ptr<WBStreamRx> m_wb_audio_rx;
-  // We have one worker thread for asynchronously performing operation(s) like
-  // changing the frequency but also recalculating statistics that are then
-  // forwarded to openhd_telemetry for broadcast
-  bool m_work_thread_run;
-  std::unique_ptr<std::thread> m_work_thread;
+  // Everything we transmit goes through here, in priority order
+  std::unique_ptr<openhd::wb::TxPriorityScheduler> m_tx_scheduler;
+  // Read for each video frame, replaced as a whole (never modified) when the
+  // settings change - use std::atomic_load / std::atomic_store
+  struct VideoTxConfig {
+    int max_fec_block_size = 0;
+    int fec_percentage = 0;
+    std::chrono::milliseconds secondary_coalesce_budget{0};
+  };
+  std::shared_ptr<const VideoTxConfig> m_video_tx_config;
+  // Encryption state of the primary / secondary video tx, tx scheduler thread
+  // only (encryption is disabled on creation)
+  std::array<bool, 2> m_video_tx_encryption{false, false};
+  static constexpr int SECONDARY_VIDEO_STREAM_INDEX = 1;
+  // The secondary camera thread and wt_flush_coalesced_video both add / flush
+  // and submit - the lock also serializes them for the tx scheduler.
+  std::mutex m_secondary_coalescer_mutex;
+  openhd::wb::FrameCoalescer m_secondary_coalescer;
+  // Period of the coalesce flush task for the given latency budget, 0 (task
+  // paused) if coalescing is disabled. A frame is sent at most a quarter of
+  // its budget late.
+  static std::chrono::milliseconds coalesce_flush_interval(
+      std::chrono::milliseconds budget);
+  // Periodic work (rate adjustment, statistics that are then forwarded to
+  // openhd_telemetry for broadcast, ...), each wt_ task with its own period
+  std::unique_ptr<openhd::wb::TaskScheduler> m_scheduler;
+  // Operation(s) like changing the frequency or a channel scan can take
+  // seconds, they are performed on their own thread such that the periodic
+  // work keeps running.
+  bool m_work_item_thread_run;
+  std::unique_ptr<std::thread> m_work_item_thread;
   std::mutex m_work_item_queue_mutex;
+  std::condition_variable m_work_item_queue_cv;
   // NOTE: We only support one active work item at a time,
   // otherwise, we reject any changes requested by the user.
   std::queue<std::shared_ptr<WorkItem>> m_work_item_queue;
+  // Held while a work item is executed and by the periodic tasks that
+  // (re-)configure the card(s) or change the wb settings. Those tasks only
+  // try to lock it and skip their run if it is taken, such that the other
+  // periodic tasks (e.g. statistics, which only read thread-safe counters and
+  // report the scan progress) keep running during a multi-second work item.
+  std::mutex m_card_config_mutex;
+  // Ground: set during channel scan / analyze, reported in the stats
+  std::atomic<uint8_t> m_gnd_operating_mode = 0;
+  // Ground: where the air unit has been found before, to speed up the scan
+  openhd::wb::ScanChannelHistory m_scan_channel_history{
+      openhd::get_interface_settings_directory() +
+      "channel_scan_history.txt"};
+  // Ground: interference (foreign packets) per channel, continuously updated
+  // in the background, and by a channel analyze
+  openhd::wb::InterferenceMap m_interference_map{
+      openhd::get_interface_settings_directory() + "interference_map.txt"};
+  // Incremented on each frequency / channel width change of all cards,
+  // background samples that overlap with a change are discarded
+  std::atomic<int> m_n_frequency_changes = 0;
+  struct BackgroundAnalysis {
+    bool dwelling = false;
+    std::chrono::steady_clock::time_point dwell_begin;
+    int n_frequency_changes = 0;
+    uint64_t link_count_p_any = 0;
+    uint64_t link_count_p_valid = 0;
+    // The frequency the spare card has been tuned to, 0 if the spare card is
+    // on the link frequency
+    uint32_t spare_frequency = 0;
+    uint64_t spare_count_p_any = 0;
+    uint64_t spare_count_p_valid = 0;
+    size_t next_channel_index = 0;
+    // Selected once the analysis is enabled, -1 if not yet
+    int spare_card_index = -1;
+    // 0 if none
+    uint32_t last_recommended_frequency = 0;
+    std::chrono::steady_clock::time_point last_persist =
+        std::chrono::steady_clock::now();
+  };
+  BackgroundAnalysis m_bg_analysis;
+  static constexpr auto BACKGROUND_ANALYSIS_INTERVAL =
+      std::chrono::milliseconds(200);
+  static constexpr auto BACKGROUND_ANALYSIS_DWELL = std::chrono::seconds(2);
+  static constexpr auto INTERFERENCE_MAP_PERSIST_INTERVAL =
+      std::chrono::seconds(60);
   static constexpr auto RECALCULATE_STATISTICS_INTERVAL =
       std::chrono::milliseconds(500);
-  std::chrono::steady_clock::time_point m_last_stats_recalculation =
-      std::chrono::steady_clock::now();
+  // 20Hz, the controller itself decides how fast to react
+  static constexpr auto RATE_ADJUSTMENT_INTERVAL =
+      std::chrono::milliseconds(50);
+  static constexpr auto APPLY_SETTINGS_INTERVAL =
+      std::chrono::milliseconds(100);
+  static constexpr auto THERMAL_PROTECTION_INTERVAL = std::chrono::seconds(1);
   std::atomic<int> m_max_total_rate_for_current_wifi_config_kbits = 0;
   std::atomic<int> m_max_video_rate_for_current_wifi_fec_config = 0;
   // Whenever the frequency has been changed, we reset tx errors and start new
-  bool m_rate_adjustment_frequency_changed = false;
+  std::atomic_bool m_rate_adjustment_frequency_changed = false;
+  // Floor / headroom of the variable bitrate changed
+  std::atomic_bool m_request_reset_rate_controller = false;
   // bitrate we recommend to the encoder / camera(s)
   int m_recommended_video_bitrate_kbits = 0;
   std::atomic<int> m_curr_n_rate_adjustments = 0;
+  openhd::wb::VideoBitrateController m_rate_controller;
+  // The controller runs every RATE_ADJUSTMENT_INTERVAL, the encoder is only
+  // told about changes (at ~10Hz)
+  openhd::wb::EncoderBitrateFilter m_encoder_bitrate_filter;
+  // To calculate the tx errors since the last rate adjustment
+  int64_t m_rate_last_count_tx_errors = 0;
+  // Ground: to calculate the video loss since the last stats update, which is
+  // reported back to the air
+  int64_t m_gnd_last_count_blocks_lost = 0;
+  int64_t m_gnd_last_count_blocks_total = 0;
   // Set to true when armed, disarmed by default
   // Used to differentiate between different tx power levels when armed /
   // disarmed
@@ -245,6 +397,15 @@ class WBLink : public OHDLink {
   openhd::wb::FrameDropsHelper m_frame_drop_helper;
   std::atomic_int m_primary_total_dropped_frames = 0;
   std::atomic_int m_secondary_total_dropped_frames = 0;
+  // Per-stage latency of the frames of the primary / secondary video stream
+  std::array<openhd::FrameTraceAggregator, 2> m_video_frame_trace;
+  // Dropped frames per reason and tx queue residency, primary / secondary
+  openhd::wb::VideoDropStats m_video_drop_stats{2};
+  // Air: the link metrics are written to this file (for node_exporter), empty
+  // if that is not possible
+  std::string m_link_metrics_filename;
+  std::chrono::steady_clock::time_point m_last_video_frame_trace_log =
+      std::chrono::steady_clock::now();
 
  private:
   const bool DIRTY_forward_gapped_fragments = false;
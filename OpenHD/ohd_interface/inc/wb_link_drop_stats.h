@@ -0,0 +1,67 @@
+#ifndef OPENHD_WB_LINK_DROP_STATS_H
+#define OPENHD_WB_LINK_DROP_STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "openhd_link_statistics.hpp"
+#include "openhd_video_frame_trace.h"
+
+namespace openhd::wb {
+
+/**
+ * Dropped video frames per stream and reason, and the time frames spend in
+ * the tx queue (transmit entry until handed to the wb tx queue) per frame
+ * type. Together with the tx errors, this allows telling an encoder overshoot
+ * (queue full, short residency) apart from rf congestion (deadline drops, long
+ * residency). Thread-safe.
+ */
+class VideoDropStats {
+ public:
+  using VideoDropReason = openhd::link_statistics::VideoDropReason;
+  explicit VideoDropStats(int n_streams);
+  // Frames with an invalid stream index are counted separately
+  void add_dropped(int stream_index, VideoDropReason reason,
+                   int n_dropped_frames = 1);
+  // Total since start
+  uint32_t get_n_dropped_invalid_stream() const {
+    return m_n_dropped_invalid_stream.load(std::memory_order_relaxed);
+  }
+  void add_queue_residency(int stream_index, bool is_keyframe,
+                           std::chrono::nanoseconds residency);
+  // The drop counters are totals, the residency histograms are reset
+  std::vector<openhd::link_statistics::StatsWbVideoAirDrops> get_and_reset();
+  // Prometheus text format, frames with an invalid stream index are reported
+  // as stream="invalid"
+  static std::string to_metrics_text(
+      const std::vector<openhd::link_statistics::StatsWbVideoAirDrops>& stats,
+      uint32_t n_dropped_invalid_stream);
+  /**
+   * Replaces the file (e.g. <dir>/openhd.prom) with the given metrics text
+   * in one step (write a temporary file, then rename it), such that a
+   * reader (node_exporter) never sees a partially written file.
+   * Returns false on error.
+   */
+  static bool write_metrics_textfile(const std::string& filename,
+                                     const std::string& text);
+
+ private:
+  struct Stream {
+    std::array<std::atomic<uint32_t>, openhd::link_statistics::
+                                          N_VIDEO_DROP_REASONS>
+        n_dropped{};
+    openhd::LatencyHistogram residency_keyframe;
+    openhd::LatencyHistogram residency_other;
+  };
+  // Not movable
+  std::vector<std::unique_ptr<Stream>> m_streams;
+  std::atomic<uint32_t> m_n_dropped_invalid_stream = 0;
+};
+
+}  // namespace openhd::wb
+
+#endif  // OPENHD_WB_LINK_DROP_STATS_H
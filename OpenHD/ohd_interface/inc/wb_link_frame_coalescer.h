@@ -0,0 +1,68 @@
+#ifndef OPENHD_WB_LINK_FRAME_COALESCER_H
+#define OPENHD_WB_LINK_FRAME_COALESCER_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace openhd::wb {
+
+/**
+ * Packs several small consecutive frames of one video stream into one FEC
+ * block. A low bitrate stream (e.g. a thermal camera at 2Mbit/s, 30fps) has
+ * frames of only one or two fragments - one FEC block per frame means the
+ * FEC overhead and the n of injected packets dwarf the payload. The receiver
+ * does not need to know, each fragment is forwarded on its own anyways.
+ * Frames are held back until the block is full or the oldest frame has
+ * waited for the latency budget. Keyframes, large frames and a change of
+ * encryption are never held back. Not thread-safe.
+ */
+class FrameCoalescer {
+ public:
+  using Fragments = std::vector<std::shared_ptr<std::vector<uint8_t>>>;
+  struct Frame {
+    Fragments fragments;
+    bool is_keyframe = false;
+    bool enable_encryption = false;
+    std::chrono::steady_clock::time_point creation_time;
+    // When the link got the frame
+    std::chrono::steady_clock::time_point arrival;
+  };
+  struct Block {
+    Fragments fragments;
+    // At least one frame is a keyframe
+    bool is_keyframe = false;
+    bool enable_encryption = false;
+    int n_frames = 0;
+    // Of the oldest frame in this block
+    std::chrono::steady_clock::time_point creation_time;
+    std::chrono::steady_clock::time_point arrival;
+  };
+  /**
+   * Returns the block(s) that are ready to be transmitted (if any).
+   * @param latency_budget 0 disables coalescing (all frames are passed on)
+   * @param max_fragments_per_block the max FEC block size
+   */
+  std::vector<Block> add(Frame frame, std::chrono::milliseconds latency_budget,
+                         int max_fragments_per_block);
+  // Returns the pending block if the oldest frame has waited for the latency
+  // budget (or coalescing has been disabled in the meantime)
+  std::optional<Block> flush_if_due(std::chrono::steady_clock::time_point now,
+                                    std::chrono::milliseconds latency_budget);
+  std::optional<Block> flush();
+  // A block of just this frame
+  static Block to_block(Frame frame);
+  int get_n_pending_frames() const { return m_pending.n_frames; }
+
+ private:
+  void append(Frame& frame);
+
+ private:
+  Block m_pending;
+};
+
+}  // namespace openhd::wb
+
+#endif  // OPENHD_WB_LINK_FRAME_COALESCER_H
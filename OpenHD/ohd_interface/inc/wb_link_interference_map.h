@@ -0,0 +1,61 @@
+#ifndef OPENHD_WB_LINK_INTERFERENCE_MAP_H
+#define OPENHD_WB_LINK_INTERFERENCE_MAP_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "wifi_channel.h"
+
+namespace openhd::wb {
+
+/**
+ * Per-channel interference (foreign packets per second, aka packets from
+ * other wifi networks / other openhd systems) as seen by the ground, built up
+ * from continuous background sampling and channel analyze results.
+ * Each channel keeps a smoothed value of its samples. The confidence in it
+ * decays with the age of the last sample (half-life), old values are
+ * eventually dropped. Persisted, such that it survives a reboot.
+ * Thread-safe.
+ */
+class InterferenceMap {
+ public:
+  explicit InterferenceMap(std::string filename);
+  void add_sample(uint32_t frequency, int foreign_packets_per_second);
+  // Smoothed foreign packets per second, std::nullopt if this channel has
+  // not been sampled (recently enough)
+  std::optional<int> get_foreign_packets_per_second(uint32_t frequency) const;
+  // The channel with the least interference out of the given channels that
+  // have a (recent enough) value
+  std::optional<uint32_t> get_cleanest_frequency(
+      const std::vector<openhd::WifiChannel>& channels) const;
+  // Writes the map if it changed since the last call
+  void persist_if_changed();
+  static constexpr int64_t HALF_LIFE_S = 60 * 60;
+  // Values with less confidence (2 half-lives) are not used anymore
+  static constexpr double MIN_CONFIDENCE = 0.25;
+  // Weight of a new sample
+  static constexpr double SMOOTHING_ALPHA = 0.3;
+
+ private:
+  struct Entry {
+    double foreign_packets_per_second;
+    // system clock, such that it can be persisted
+    int64_t last_sample_epoch_s;
+  };
+  static double get_confidence(const Entry& entry, int64_t now_epoch_s);
+  void load();
+
+ private:
+  const std::string m_filename;
+  mutable std::mutex m_mutex;
+  std::map<uint32_t, Entry> m_entries;
+  bool m_changed = false;
+};
+
+}  // namespace openhd::wb
+
+#endif  // OPENHD_WB_LINK_INTERFERENCE_MAP_H
@@ -39,6 +39,10 @@ class ManagementAir {
  public:
   std::atomic<uint32_t> m_curr_frequency_mhz;
   std::atomic<uint8_t> m_curr_channel_width_mhz;
+  // Loss as seen by the ground, only valid if we have received a management
+  // frame recently
+  std::atomic<int> m_gnd_reported_video_block_loss_perc = 0;
+  std::atomic<int> m_gnd_reported_packet_loss_perc = 0;
   int get_last_received_packet_ts_ms();
 
  private:
@@ -68,6 +72,9 @@ class ManagementGround {
  public:
   std::atomic<int> m_air_reported_curr_frequency = -1;
   std::atomic<int> m_air_reported_curr_channel_width = -1;
+  // Reported back to the air (for the variable bitrate), updated by wb_link
+  std::atomic<int> m_curr_video_block_loss_perc = 0;
+  std::atomic<int> m_curr_packet_loss_perc = 0;
   int get_last_received_packet_ts_ms();
 
  private:
@@ -0,0 +1,124 @@
+#ifndef OPENHD_WB_LINK_RATE_CONTROLLER_H
+#define OPENHD_WB_LINK_RATE_CONTROLLER_H
+
+#include <chrono>
+#include <cstdint>
+
+namespace openhd::wb {
+
+/**
+ * Closed loop (AIMD) video bitrate controller, run on the air unit.
+ * The theoretical max rate for the current MCS / channel width / FEC config is
+ * only the upper bound - the rate that actually goes through depends on
+ * interference, range and more. Instead of waiting for the user to notice
+ * video freezes, we back off multiplicatively as soon as the link shows
+ * signs of congestion (frames dropped before / during injection, a filling tx
+ * queue, tx errors or the ground reporting unrecoverable loss) and probe
+ * upwards again additively once the link has been clean for a while.
+ * Pure logic, not thread-safe - meant to be driven by the wb_link worker
+ * thread, which makes it easy to test.
+ */
+class VideoBitrateController {
+ public:
+  struct Input {
+    // Occupancy of the video tx queue, 0..100
+    int tx_queue_fill_perc = 0;
+    // Since the last update
+    int n_dropped_frames = 0;
+    // Injection error hint(s) and packets dropped by the driver, since the
+    // last update
+    int n_tx_errors = 0;
+    // Loss reported back from the ground (-1 if unknown, e.g. no uplink)
+    int gnd_video_block_loss_perc = -1;
+    int gnd_packet_loss_perc = -1;
+  };
+  // Give the encoder time to react to a new bitrate, dropped frames in
+  // this period are not the link's fault.
+  static constexpr auto SETTLE_TIME = std::chrono::milliseconds(1000);
+  // The link has to be clean for this long before we increase the bitrate
+  static constexpr auto STABLE_TIME_BEFORE_INCREASE =
+      std::chrono::milliseconds(2000);
+  // Multiplicative decrease
+  static constexpr int DECREASE_PERC = 80;
+  // Additive increase, in percent of the ceiling
+  static constexpr int INCREASE_PERC_OF_CEILING = 5;
+  static constexpr int MIN_INCREASE_KBITS = 250;
+  // Thresholds for the (smoothed) tx queue fill
+  static constexpr int QUEUE_FILL_CONGESTED_PERC = 60;
+  static constexpr int QUEUE_FILL_LOADED_PERC = 30;
+  // A single injection error hint is common on a healthy link and only holds
+  // the bitrate. Tx errors mean congestion once they are sustained (in this
+  // many consecutive updates) or come in a burst of at least this many.
+  static constexpr int TX_ERRORS_CONGESTED_N_UPDATES = 3;
+  static constexpr int TX_ERRORS_CONGESTED_BURST = 10;
+
+  /**
+   * (Re-) start with the ceiling derived from the max video rate for the
+   * current config. Should be called whenever the config changes.
+   * @param max_video_rate_kbits theoretical max (FEC overhead already
+   * subtracted)
+   * @param floor_kbits the bitrate never goes below this value
+   * @param headroom_perc the bitrate never goes above max minus headroom
+   * @param fec_perc packet loss the ground can still recover from
+   */
+  void reset(int max_video_rate_kbits, int floor_kbits, int headroom_perc,
+             int fec_perc, std::chrono::steady_clock::time_point now);
+  /**
+   * Feed the link state since the last update (every 20..500ms is fine).
+   * Returns the bitrate to recommend to the encoder.
+   */
+  int update(const Input& input, std::chrono::steady_clock::time_point now);
+  int get_bitrate_kbits() const { return m_bitrate_kbits; }
+  int get_ceiling_kbits() const { return m_ceiling_kbits; }
+  // N of times the bitrate has been reduced since the last reset
+  int get_n_decreases() const { return m_n_decreases; }
+  enum class LinkState { CLEAN, LOADED, CONGESTED };
+  LinkState get_last_link_state() const { return m_last_link_state; }
+
+ private:
+  LinkState classify(const Input& input);
+
+ private:
+  int m_ceiling_kbits = 0;
+  int m_floor_kbits = 0;
+  int m_fec_perc = 0;
+  int m_bitrate_kbits = 0;
+  int m_n_decreases = 0;
+  // Exponentially smoothed tx queue fill, the queue is small and a single
+  // sample is noisy
+  int m_queue_fill_smoothed_perc = 0;
+  // Consecutive updates with tx errors
+  int m_n_updates_with_tx_errors = 0;
+  std::chrono::steady_clock::time_point m_last_change;
+  std::chrono::steady_clock::time_point m_last_congestion;
+  LinkState m_last_link_state = LinkState::CLEAN;
+};
+
+/**
+ * Decides when a bitrate is passed on to the encoder. The controller runs at
+ * 20Hz, but each recommendation goes through the camera / encoder control
+ * path - changes smaller than the hysteresis are not passed on, and the
+ * encoder is told at most every MIN_INTERVAL. The current value is repeated
+ * every REFRESH_INTERVAL, such that a (re-started) encoder catches up.
+ * Pure logic, not thread-safe.
+ */
+class EncoderBitrateFilter {
+ public:
+  static constexpr auto MIN_INTERVAL = std::chrono::milliseconds(100);
+  static constexpr auto REFRESH_INTERVAL = std::chrono::milliseconds(1000);
+  // Of the last recommended bitrate, but at least MIN_HYSTERESIS_KBITS
+  static constexpr int HYSTERESIS_PERC = 3;
+  static constexpr int MIN_HYSTERESIS_KBITS = 100;
+  // Returns true if bitrate_kbits should be recommended to the encoder now
+  bool should_recommend(int bitrate_kbits,
+                        std::chrono::steady_clock::time_point now);
+
+ private:
+  // 0 if nothing has been recommended yet
+  int m_last_bitrate_kbits = 0;
+  std::chrono::steady_clock::time_point m_last_recommendation;
+};
+
+}  // namespace openhd::wb
+
+#endif  // OPENHD_WB_LINK_RATE_CONTROLLER_H
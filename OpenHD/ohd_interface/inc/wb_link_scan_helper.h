@@ -0,0 +1,86 @@
+#ifndef OPENHD_WB_LINK_SCAN_HELPER_H
+#define OPENHD_WB_LINK_SCAN_HELPER_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "wifi_channel.h"
+
+namespace openhd::wb {
+
+/**
+ * Decides how long to listen on a channel during a channel scan, instead of
+ * a fixed sleep per channel. A running air unit constantly sends packets
+ * (telemetry, session key and management frames at least twice per second),
+ * so if nothing that looks like openhd has been received after a short time,
+ * it is not on this channel. If there are openhd packets, we listen until we
+ * get a management frame (which tells us the exact frequency / channel width)
+ * or give up after a while.
+ */
+class ScanDwell {
+ public:
+  enum class Result { LISTEN, FOUND, NOT_FOUND };
+  // More than 2 session key / management frame intervals
+  static constexpr auto ABSENT_AFTER = std::chrono::milliseconds(1200);
+  static constexpr auto MAX_DWELL = std::chrono::milliseconds(6000);
+  explicit ScanDwell(std::chrono::steady_clock::time_point begin)
+      : m_begin(begin) {}
+  /**
+   * @param n_openhd_packets (likely) openhd packets received since begin
+   * @param has_management a management frame has been received since begin
+   */
+  Result update(std::chrono::steady_clock::time_point now,
+                int64_t n_openhd_packets, bool has_management) const;
+
+ private:
+  const std::chrono::steady_clock::time_point m_begin;
+};
+
+/**
+ * Remembers where the air unit has been found before (persisted) and what a
+ * recent channel analyze has seen on each channel (in memory), such that a
+ * channel scan can start with the most likely channel(s). Thread-safe.
+ */
+class ScanChannelHistory {
+ public:
+  explicit ScanChannelHistory(std::string filename);
+  // The air unit has been found on this frequency
+  void on_air_found(uint32_t frequency);
+  void on_channel_analyzed(uint32_t frequency, int64_t n_packets_any,
+                           int64_t n_packets_valid);
+  /**
+   * Most likely first: where the air unit has been found before (most recent
+   * first), then channels a recent analyze has seen openhd packets on, then
+   * channels without a recent analyze result, and last channels a recent
+   * analyze has seen no packets on at all. Otherwise, the order is kept.
+   */
+  std::vector<openhd::WifiChannel> order_by_likelihood(
+      const std::vector<openhd::WifiChannel>& channels) const;
+  // Analyze results older than this are not used
+  static constexpr auto ANALYZE_RESULT_MAX_AGE = std::chrono::minutes(10);
+  static constexpr int MAX_N_FOUND_FREQUENCIES = 8;
+
+ private:
+  void load();
+  void persist();
+  struct AnalyzeResult {
+    bool any_packets;
+    bool openhd_packets;
+    std::chrono::steady_clock::time_point timestamp;
+  };
+
+ private:
+  const std::string m_filename;
+  mutable std::mutex m_mutex;
+  // Most recent first
+  std::vector<uint32_t> m_found_frequencies;
+  std::map<uint32_t, AnalyzeResult> m_analyze_results;
+};
+
+}  // namespace openhd::wb
+
+#endif  // OPENHD_WB_LINK_SCAN_HELPER_H
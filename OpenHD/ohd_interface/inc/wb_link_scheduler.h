@@ -0,0 +1,76 @@
+#ifndef OPENHD_WB_LINK_SCHEDULER_H
+#define OPENHD_WB_LINK_SCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "openhd_spdlog.h"
+
+namespace openhd::wb {
+
+/**
+ * Runs a fixed set of periodic tasks on one thread, each with its own period.
+ * The thread sleeps until the next task is due (no fixed sleep / polling), so
+ * a fast task (e.g. rate adjustment at 20Hz) is not limited by the slow ones.
+ * Tasks run one after another, a task that takes longer than the period of
+ * another task only delays it, and missed runs are skipped instead of being
+ * run in a burst afterwards.
+ * Tasks must not block for long - long-running operations belong on a
+ * separate thread.
+ */
+class TaskScheduler {
+ public:
+  explicit TaskScheduler(std::string tag);
+  // Stops, if still running
+  ~TaskScheduler();
+  TaskScheduler(const TaskScheduler&) = delete;
+  TaskScheduler& operator=(const TaskScheduler&) = delete;
+  // All tasks have to be added before calling start().
+  // The first run is one period after start(), a period of 0 adds the task
+  // paused (see set_task_period).
+  void add_periodic_task(std::string name, std::chrono::milliseconds period,
+                         std::function<void()> task);
+  void start();
+  // Changes the period of an existing task, the next run is one period from
+  // now. 0 pauses the task - a paused task does not wake the thread at all.
+  // Thread-safe, can be called from within a task.
+  void set_task_period(const std::string& name,
+                       std::chrono::milliseconds period);
+  // Blocks until the task that is currently executed (if any) has finished
+  void stop();
+
+ private:
+  struct Task {
+    std::string name;
+    std::chrono::milliseconds period;
+    std::function<void()> task;
+    std::chrono::steady_clock::time_point next_run;
+  };
+  void loop();
+  // Index of the (not paused) task that is due next, NONE if all tasks are
+  // paused
+  static constexpr size_t NONE = SIZE_MAX;
+  size_t next_due_task() const;
+
+ private:
+  std::shared_ptr<spdlog::logger> m_console;
+  std::vector<Task> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_run = false;
+  // Set by set_task_period, such that the loop re-evaluates which task is
+  // due next
+  bool m_schedule_changed = false;
+  std::unique_ptr<std::thread> m_thread;
+};
+
+}  // namespace openhd::wb
+
+#endif  // OPENHD_WB_LINK_SCHEDULER_H
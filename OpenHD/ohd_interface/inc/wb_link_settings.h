@@ -61,6 +61,8 @@ static constexpr auto DEFAULT_WB_VIDEO_FEC_BLOCK_LENGTH =
 static constexpr auto DEFAULT_WB_VIDEO_FEC_PERCENTAGE = 20;
 // -1 = use openhd recommended for this platform
 static constexpr uint32_t DEFAULT_MAX_FEC_BLK_SIZE = -1;
+// Below this the encoder won't be able to produce a usable image anyways
+static constexpr auto DEFAULT_WB_VIDEO_RATE_FLOOR_KBITS = 2000;
 // 0 means disabled (default), the rc channel used for setting the mcs index
 // otherwise
 static constexpr auto WB_MCS_INDEX_VIA_RC_CHANNEL_OFF = 0;
@@ -108,11 +110,24 @@ struct WBLinkSettings {
   int wb_bw_via_rc_channel = WB_BW_VIA_RC_CHANNEL_OFF;
   // wb link recommends bitrate(s) to the encoder.
   bool enable_wb_video_variable_bitrate = true;
+  // variable bitrate never recommends less than this to the encoder
+  int wb_video_rate_floor_kbits = DEFAULT_WB_VIDEO_RATE_FLOOR_KBITS;
+  // variable bitrate never recommends more than the max rate for the current
+  // mcs / fec config minus this percentage, leaving room for interference and
+  // other traffic
+  int wb_video_rate_headroom_perc = 0;
+  // Secondary video stream: small consecutive frames are packed into one FEC
+  // block, as long as no frame is held back for longer than this. 0 = off.
+  int wb_video_secondary_coalesce_ms = 0;
   // !!!!
   // This allows the ground station to become completely passive (aka tune in on
   // someone elses feed) but obviosuly you cannot reach your air unit anymore
   // when this mode is enabled (disable it to re-gain control)
   bool wb_enable_listen_only_mode = false;
+  // Ground with more than one card: one card continuously samples the
+  // interference on the other channels (while the other card(s) keep
+  // receiving), which makes that card useless for diversity.
+  bool wb_gnd_background_analyze = false;
   // NOTE: Really complicated, for developers only
   bool wb_dev_air_set_high_retransmit_count = false;
 };
@@ -178,6 +193,9 @@ static constexpr auto WB_RTL8812AU_TX_PWR_IDX_OVERRIDE = "TX_POWER_I";
 static constexpr auto WB_RTL8812AU_TX_PWR_IDX_ARMED = "TX_POWER_I_ARMED";
 //
 static constexpr auto WB_VIDEO_VARIABLE_BITRATE = "VARIABLE_BITRATE";
+static constexpr auto WB_VIDEO_RATE_FLOOR_KBITS = "WB_V_RATE_FLOOR";
+static constexpr auto WB_VIDEO_RATE_HEADROOM_PERC = "WB_V_RATE_HEADR";
+static constexpr auto WB_VIDEO_SECONDARY_COALESCE_MS = "WB_V2_COALESCE";
 //
 static constexpr auto WB_ENABLE_STBC = "WB_E_STBC";
 static constexpr auto WB_ENABLE_LDPC = "WB_E_LDPC";
@@ -185,6 +203,7 @@ static constexpr auto WB_ENABLE_SHORT_GUARD = "WB_E_SHORT_GUARD";
 static constexpr auto WB_MCS_INDEX_VIA_RC_CHANNEL = "MCS_VIA_RC";
 static constexpr auto WB_BW_VIA_RC_CHANNEL = "BW_VIA_RC";
 static constexpr auto WB_PASSIVE_MODE = "WB_PASSIVE_MODE";
+static constexpr auto WB_GND_BACKGROUND_ANALYZE = "WB_BG_ANALYZE";
 static constexpr auto WB_DEV_AIR_SET_HIGH_RETRANSMIT_COUNT = "DEV_HIGH_RETR";
 
 }  // namespace openhd
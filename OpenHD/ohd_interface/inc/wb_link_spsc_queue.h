@@ -0,0 +1,62 @@
+#ifndef OPENHD_WB_LINK_SPSC_QUEUE_H
+#define OPENHD_WB_LINK_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace openhd::wb {
+
+/**
+ * Bounded, lock-free queue for exactly one producer thread and one consumer
+ * thread (e.g. a camera thread handing frames to the injector thread).
+ * Capacity is rounded up to a power of 2.
+ */
+template <typename T>
+class SPSCQueue {
+ public:
+  explicit SPSCQueue(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) size *= 2;
+    m_buffer.resize(size);
+    m_mask = size - 1;
+  }
+  SPSCQueue(const SPSCQueue&) = delete;
+  SPSCQueue& operator=(const SPSCQueue&) = delete;
+  // Producer only. Returns false (and leaves item untouched) if full.
+  bool try_push(T& item) {
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) > m_mask) return false;
+    m_buffer[head & m_mask] = std::move(item);
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+  // Consumer only
+  std::optional<T> try_pop() {
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail == m_head.load(std::memory_order_acquire)) return std::nullopt;
+    std::optional<T> ret = std::move(m_buffer[tail & m_mask]);
+    m_buffer[tail & m_mask] = T{};
+    m_tail.store(tail + 1, std::memory_order_release);
+    return ret;
+  }
+  // Any thread, approximate
+  size_t size_approximate() const {
+    // Tail first, the head can only have moved further since
+    const size_t tail = m_tail.load(std::memory_order_acquire);
+    return m_head.load(std::memory_order_acquire) - tail;
+  }
+
+ private:
+  std::vector<T> m_buffer;
+  size_t m_mask;
+  // Written by the producer / consumer only, on their own cache line
+  alignas(64) std::atomic<size_t> m_head{0};
+  alignas(64) std::atomic<size_t> m_tail{0};
+};
+
+}  // namespace openhd::wb
+
+#endif  // OPENHD_WB_LINK_SPSC_QUEUE_H
@@ -0,0 +1,130 @@
+#ifndef OPENHD_WB_LINK_TX_SCHEDULER_H
+#define OPENHD_WB_LINK_TX_SCHEDULER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "openhd_link_statistics.hpp"
+#include "openhd_spdlog.h"
+#include "wb_link_spsc_queue.h"
+
+namespace openhd::wb {
+
+/**
+ * All data that is transmitted goes through here before it is handed to the
+ * wifibroadcast tx queue of its stream. Each of those queues is served by its
+ * own thread, and they all compete for the card(s) - once a video block is in
+ * there, everything else has to wait until it is out. The video queues are
+ * therefore kept short, and the backlog is kept here, where we know what the
+ * data is:
+ * - Strict priority: telemetry (which includes RC) before audio before video.
+ *   Nothing of a lower lane is handed on while items of a higher lane are
+ *   waiting here. WBLink hands telemetry / audio on with drop-oldest, so
+ *   they never wait - a full telemetry queue does not stall video.
+ * - Video: a keyframe supersedes all frames of the same stream that have not
+ *   been handed on yet, such that it goes out first. Other frames that have
+ *   been waiting for longer than VIDEO_FRAME_DEADLINE are dropped. A keyframe
+ *   is never dropped in favour of older frames.
+ * Each video stream is handed from its (camera) thread to the scheduler thread
+ * via its own lock-free queue, such that multiple cameras do not contend with
+ * each other or with telemetry.
+ */
+class TxPriorityScheduler {
+ public:
+  enum class Lane { TELEMETRY, AUDIO, VIDEO };
+  struct Item {
+    Lane lane = Lane::TELEMETRY;
+    // Video only
+    int stream_index = 0;
+    bool is_keyframe = false;
+    std::chrono::steady_clock::time_point creation_time;
+    // Hands the data to the wifibroadcast tx queue of the stream. Returns
+    // false if that queue is full, in which case it is retried later.
+    std::function<bool()> try_enqueue;
+  };
+  using VideoDropReason = openhd::link_statistics::VideoDropReason;
+  // Called with the n of video frames dropped (not on the thread submitting
+  // them)
+  using VIDEO_DROPPED_CB = std::function<void(
+      int stream_index, VideoDropReason reason, int n_dropped)>;
+  TxPriorityScheduler(std::string tag, int n_video_streams,
+                      VIDEO_DROPPED_CB video_dropped_cb);
+  // Stops, if still running
+  ~TxPriorityScheduler();
+  TxPriorityScheduler(const TxPriorityScheduler&) = delete;
+  TxPriorityScheduler& operator=(const TxPriorityScheduler&) = delete;
+  void start();
+  // Pending items are discarded
+  void stop();
+  // Thread-safe for telemetry / audio. Video frames of one stream must always
+  // be submitted from the same thread (or externally serialized).
+  void submit(Item item);
+  // Thread-safe, video frames of this stream that have not been handed on yet
+  int get_n_pending_video_frames(int stream_index);
+  /**
+   * Hands on as much as possible, in priority order. Returns true if
+   * something is left because a wifibroadcast queue is full.
+   * Called by the scheduler thread, exposed for testing.
+   */
+  bool dispatch(std::chrono::steady_clock::time_point now);
+  static constexpr auto VIDEO_FRAME_DEADLINE = std::chrono::milliseconds(150);
+  static constexpr size_t MAX_PENDING_VIDEO_FRAMES = 8;
+  static constexpr size_t MAX_PENDING_PACKETS = 64;
+  static constexpr size_t VIDEO_HANDOFF_CAPACITY = 16;
+  // The wifibroadcast queues have no notification when there is space again.
+  // While blocked, the thread waits for a new item or, if none arrives, a
+  // retry interval that doubles (up to the max) with each blocked retry - a
+  // full queue holds at least one more frame, so a late retry does not leave
+  // the card idle.
+  static constexpr auto MIN_BLOCKED_RETRY_INTERVAL =
+      std::chrono::milliseconds(1);
+  static constexpr auto MAX_BLOCKED_RETRY_INTERVAL =
+      std::chrono::milliseconds(8);
+
+ private:
+  void loop();
+  // Returns false if the first item is blocked
+  static bool dispatch_packets(std::deque<Item>& queue);
+  // Wakes up the scheduler thread, takes the lock only if it might be asleep
+  void wakeup();
+  using DropCounts =
+      std::array<int, openhd::link_statistics::N_VIDEO_DROP_REASONS>;
+  struct VideoStream {
+    VideoStream() : handoff(VIDEO_HANDOFF_CAPACITY) {}
+    // Submitting thread -> scheduler thread
+    SPSCQueue<Item> handoff;
+    // Frames the submitting thread dropped since the handoff was full
+    std::atomic<int> n_handoff_full{0};
+    // Scheduler thread only
+    std::deque<Item> pending;
+    std::atomic<int> n_pending{0};
+  };
+  // Moves the handed over frames to pending, applying the keyframe policy
+  static void drain_handoff(VideoStream& stream, DropCounts& n_dropped);
+
+ private:
+  std::shared_ptr<spdlog::logger> m_console;
+  const VIDEO_DROPPED_CB m_video_dropped_cb;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::deque<Item> m_telemetry;
+  std::deque<Item> m_audio;
+  // Not movable
+  std::vector<std::unique_ptr<VideoStream>> m_video;
+  std::atomic_bool m_wakeup = false;
+  bool m_run = false;
+  std::unique_ptr<std::thread> m_thread;
+};
+
+}  // namespace openhd::wb
+
+#endif  // OPENHD_WB_LINK_TX_SCHEDULER_H
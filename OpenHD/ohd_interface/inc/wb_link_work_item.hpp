@@ -27,6 +27,9 @@ class WorkItem {
   bool ready_to_be_executed() {
     return std::chrono::steady_clock::now() >= m_earliest_execution_time;
   }
+  std::chrono::steady_clock::time_point get_earliest_execution_time() const {
+    return m_earliest_execution_time;
+  }
   const std::string TAG;
 
  private:
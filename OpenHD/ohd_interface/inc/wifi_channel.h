@@ -6,10 +6,12 @@
 #define OPENHD_OPENHD_OHD_INTERFACE_INC_WIFI_CHANNEL_H_
 
 #include <cstdint>
+#include <optional>
 #include <sstream>
 #include <vector>
 
 #include "openhd_spdlog.h"
+#include "openhd_util.h"
 
 // USefully links:
 // https://www.bundesnetzagentur.de/SharedDocs/Downloads/DE/Sachgebiete/Telekommunikation/Unternehmen_Institutionen/Frequenzen/20190705_Frequenzplan_EntwurfStandMai.pdf?__blob=publicationFile&v=1
@@ -403,13 +403,15 @@ MicrohardLink::MicrohardLink(OHDProfile profile) : m_profile(profile) {
       on_receive_telemetry_data(shared);
     };
     m_telemetry_tx_rx = std::make_unique<openhd::UDPReceiver>(
-        DEVICE_IP_AIR, MICROHARD_UDP_PORT_TELEMETRY_AIR_TX, cb_telemetry_rx);
+        DEVICE_IP_AIR, MICROHARD_UDP_PORT_TELEMETRY_AIR_TX, cb_telemetry_rx,
+        openhd::UDPReceiver::ETHERNET_DATAGRAM_MAX_SIZE);
   } else {
     auto cb_video_rx = [this](const uint8_t* payload, std::size_t payloadSize) {
       on_receive_video_data(0, payload, payloadSize);
     };
     m_video_rx = std::make_unique<openhd::UDPReceiver>(
-        DEVICE_IP_GND, MICROHARD_UDP_PORT_VIDEO_AIR_TX, cb_video_rx);
+        DEVICE_IP_GND, MICROHARD_UDP_PORT_VIDEO_AIR_TX, cb_video_rx,
+        openhd::UDPReceiver::ETHERNET_DATAGRAM_MAX_SIZE);
 
     auto cb_telemetry_rx = [this](const uint8_t* data, std::size_t data_len) {
       auto shared =
@@ -417,7 +419,8 @@ MicrohardLink::MicrohardLink(OHDProfile profile) : m_profile(profile) {
       on_receive_telemetry_data(shared);
     };
     m_telemetry_tx_rx = std::make_unique<openhd::UDPReceiver>(
-        DEVICE_IP_GND, MICROHARD_UDP_PORT_TELEMETRY_AIR_TX, cb_telemetry_rx);
+        DEVICE_IP_GND, MICROHARD_UDP_PORT_TELEMETRY_AIR_TX, cb_telemetry_rx,
+        openhd::UDPReceiver::ETHERNET_DATAGRAM_MAX_SIZE);
   }
 
   if (m_telemetry_tx_rx) {
@@ -450,9 +453,11 @@ void MicrohardLink::transmit_video_data(
     const openhd::FragmentedVideoFrame& fragmented_video_frame) {
   assert(m_profile.is_air);
   if (stream_index == 0) {
+    std::vector<struct iovec> packets;
     for (const auto& fragment : fragmented_video_frame.rtp_fragments) {
-      m_video_tx->forwardPacketViaUDP(fragment->data(), fragment->size());
+      packets.push_back({(void*)fragment.data(), fragment.size()});
     }
+    m_video_tx->forwardPacketsViaUDP(packets.data(), (int)packets.size());
   }
 }
 
@@ -0,0 +1,259 @@
+#include "sim_link.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace openhd::sim {
+
+SimLink::SimLink(SimLinkPair& pair, const bool is_air)
+    : m_pair(pair), m_is_air(is_air) {
+  m_console = openhd::log::create_or_get(is_air ? "sim_link_air"
+                                                : "sim_link_gnd");
+}
+
+void SimLink::transmit_telemetry_data(TelemetryTxPacket packet) {
+  SimChannel::Packet sim_packet{};
+  sim_packet.type = SimChannel::PacketType::TELEMETRY;
+  sim_packet.data = std::move(packet.data);
+  if (!m_is_air) {
+    m_pair.send(false, std::move(sim_packet), packet.n_injections);
+    return;
+  }
+  std::lock_guard<std::mutex> guard(m_pair.m_tx_mutex);
+  m_pair.air_submit(openhd::wb::TxPriorityScheduler::Lane::TELEMETRY,
+                    std::move(sim_packet), packet.n_injections);
+}
+
+void SimLink::transmit_video_data(
+    const int stream_index,
+    const openhd::FragmentedVideoFrame& fragmented_video_frame) {
+  if (!m_is_air) {
+    m_console->warn("Ground cannot transmit video");
+    return;
+  }
+  openhd::wb::FrameCoalescer::Frame frame{};
+  if (fragmented_video_frame.dirty_frame != nullptr) {
+    frame.fragments.push_back(fragmented_video_frame.dirty_frame);
+  } else {
+    frame.fragments =
+        openhd::fragments_as_vectors(fragmented_video_frame.rtp_fragments);
+  }
+  frame.is_keyframe = fragmented_video_frame.is_intra_stream ||
+                      fragmented_video_frame.is_idr_frame;
+  std::lock_guard<std::mutex> guard(m_pair.m_tx_mutex);
+  m_pair.air_submit_video(stream_index, std::move(frame));
+}
+
+void SimLink::transmit_audio_data(const openhd::AudioPacket& audio_packet) {
+  SimChannel::Packet sim_packet{};
+  sim_packet.type = SimChannel::PacketType::AUDIO;
+  sim_packet.data = audio_packet.data;
+  if (!m_is_air) {
+    m_pair.send(false, std::move(sim_packet), 1);
+    return;
+  }
+  std::lock_guard<std::mutex> guard(m_pair.m_tx_mutex);
+  m_pair.air_submit(openhd::wb::TxPriorityScheduler::Lane::AUDIO,
+                    std::move(sim_packet), 1);
+}
+
+void SimLink::on_receive(const SimChannel::Packet& packet) {
+  switch (packet.type) {
+    case SimChannel::PacketType::TELEMETRY:
+      on_receive_telemetry_data(packet.data);
+      break;
+    case SimChannel::PacketType::VIDEO:
+      on_receive_video_data(packet.stream_index, packet.data->data(),
+                            (int)packet.data->size());
+      break;
+    case SimChannel::PacketType::AUDIO:
+      on_receive_audio_data(packet.data->data(), (int)packet.data->size());
+      break;
+  }
+}
+
+SimLinkPair::SimLinkPair(ChannelConfig downlink, ChannelConfig uplink,
+                         AirTxConfig air_tx)
+    : m_air_tx_config(air_tx),
+      m_downlink(downlink),
+      m_uplink(uplink),
+      m_max_downlink_queue_bytes(downlink.max_queue_bytes) {
+  m_air = std::make_shared<SimLink>(*this, true);
+  m_ground = std::make_shared<SimLink>(*this, false);
+  // Only called from within dispatch(), with m_tx_mutex held
+  m_tx_scheduler = std::make_unique<openhd::wb::TxPriorityScheduler>(
+      "sim_tx_scheduler", 2,
+      [this](int, openhd::wb::TxPriorityScheduler::VideoDropReason,
+             int n_dropped) {
+        m_n_dropped_frames_since_update += n_dropped;
+        m_n_dropped_frames += n_dropped;
+      });
+  m_rate_controller.reset(
+      m_air_tx_config.max_video_rate_kbits,
+      m_air_tx_config.video_rate_floor_kbits,
+      m_air_tx_config.video_rate_headroom_perc,
+      m_air_tx_config.video_fec_perc, to_time_point(m_now));
+  m_next_rate_update = RATE_ADJUSTMENT_INTERVAL;
+}
+
+void SimLinkPair::advance(const std::chrono::nanoseconds duration) {
+  std::vector<SimChannel::Packet> to_ground;
+  std::vector<SimChannel::Packet> to_air;
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_now += duration;
+    to_ground = m_downlink.receive(m_now);
+    to_air = m_uplink.receive(m_now);
+  }
+  // Without holding the lock, such that the callbacks can transmit (they
+  // are delivered with the next call to advance() at the earliest)
+  for (const auto& packet : to_ground) m_ground->on_receive(packet);
+  for (const auto& packet : to_air) m_air->on_receive(packet);
+  std::lock_guard<std::mutex> guard(m_tx_mutex);
+  air_update(get_now());
+}
+
+Time SimLinkPair::get_now() {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  return m_now;
+}
+
+ChannelStats SimLinkPair::get_downlink_stats() {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  return m_downlink.get_stats();
+}
+
+ChannelStats SimLinkPair::get_uplink_stats() {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  return m_uplink.get_stats();
+}
+
+int SimLinkPair::get_downlink_queue_bytes() {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  return m_downlink.get_queue_bytes(m_now);
+}
+
+int SimLinkPair::get_video_bitrate_kbits() {
+  std::lock_guard<std::mutex> guard(m_tx_mutex);
+  return m_rate_controller.get_bitrate_kbits();
+}
+
+int SimLinkPair::get_n_video_rate_decreases() {
+  std::lock_guard<std::mutex> guard(m_tx_mutex);
+  return m_rate_controller.get_n_decreases();
+}
+
+int64_t SimLinkPair::get_n_video_frames_dropped() {
+  std::lock_guard<std::mutex> guard(m_tx_mutex);
+  return m_n_dropped_frames;
+}
+
+bool SimLinkPair::send(const bool from_air, SimChannel::Packet packet,
+                       const int n_injections) {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  auto& channel = from_air ? m_downlink : m_uplink;
+  return channel.send(std::move(packet), m_now, n_injections);
+}
+
+std::chrono::steady_clock::time_point SimLinkPair::to_time_point(
+    const Time time) {
+  return std::chrono::steady_clock::time_point(
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(time));
+}
+
+bool SimLinkPair::downlink_has_space() {
+  if (m_max_downlink_queue_bytes <= 0) return true;
+  return get_downlink_queue_bytes() < m_max_downlink_queue_bytes;
+}
+
+void SimLinkPair::air_submit(const openhd::wb::TxPriorityScheduler::Lane lane,
+                             SimChannel::Packet packet,
+                             const int n_injections) {
+  openhd::wb::TxPriorityScheduler::Item item{};
+  item.lane = lane;
+  // Like WBLink, telemetry / audio are never held back (their wb queues drop
+  // the oldest packet instead)
+  item.try_enqueue = [this, packet = std::move(packet), n_injections]() {
+    send(true, packet, n_injections);
+    return true;
+  };
+  m_tx_scheduler->submit(std::move(item));
+  m_tx_scheduler->dispatch(to_time_point(get_now()));
+}
+
+void SimLinkPair::air_submit_video(const int stream_index,
+                                   openhd::wb::FrameCoalescer::Frame frame) {
+  // Unlike the camera creation time, the transmit time is on the virtual clock
+  frame.creation_time = to_time_point(get_now());
+  frame.arrival = frame.creation_time;
+  if (stream_index != 1) {
+    air_submit_video_block(
+        stream_index, openhd::wb::FrameCoalescer::to_block(std::move(frame)));
+  } else {
+    auto blocks = m_secondary_coalescer.add(
+        std::move(frame), m_air_tx_config.secondary_coalesce_budget,
+        m_air_tx_config.max_fec_block_size);
+    for (auto& block : blocks) {
+      air_submit_video_block(stream_index, std::move(block));
+    }
+  }
+  m_tx_scheduler->dispatch(to_time_point(get_now()));
+}
+
+void SimLinkPair::air_submit_video_block(
+    const int stream_index, openhd::wb::FrameCoalescer::Block block) {
+  openhd::wb::TxPriorityScheduler::Item item{};
+  item.lane = openhd::wb::TxPriorityScheduler::Lane::VIDEO;
+  item.stream_index = stream_index;
+  item.is_keyframe = block.is_keyframe;
+  item.creation_time = block.creation_time;
+  // Copyable, as required by std::function
+  auto shared_block =
+      std::make_shared<openhd::wb::FrameCoalescer::Block>(std::move(block));
+  item.try_enqueue = [this, stream_index, shared_block]() {
+    // Like the wb tx queue, a keyframe is enqueued no matter what
+    if (!shared_block->is_keyframe && !downlink_has_space()) return false;
+    bool any_dropped = false;
+    for (const auto& fragment : shared_block->fragments) {
+      SimChannel::Packet packet{};
+      packet.type = SimChannel::PacketType::VIDEO;
+      packet.stream_index = stream_index;
+      packet.data = fragment;
+      if (!send(true, std::move(packet), 1)) any_dropped = true;
+    }
+    if (any_dropped) {
+      m_n_dropped_frames_since_update += shared_block->n_frames;
+      m_n_dropped_frames += shared_block->n_frames;
+    }
+    return true;
+  };
+  m_tx_scheduler->submit(std::move(item));
+}
+
+void SimLinkPair::air_update(const Time now) {
+  auto block = m_secondary_coalescer.flush_if_due(
+      to_time_point(now), m_air_tx_config.secondary_coalesce_budget);
+  if (block.has_value()) air_submit_video_block(1, std::move(block.value()));
+  m_tx_scheduler->dispatch(to_time_point(now));
+  if (m_air_tx_config.max_video_rate_kbits <= 0 || now < m_next_rate_update) {
+    return;
+  }
+  m_next_rate_update = now + RATE_ADJUSTMENT_INTERVAL;
+  const auto stats = get_downlink_stats();
+  const int64_t n_packets = stats.n_packets - m_last_downlink_stats.n_packets;
+  const int64_t n_lost = stats.n_lost - m_last_downlink_stats.n_lost;
+  m_last_downlink_stats = stats;
+  openhd::wb::VideoBitrateController::Input input{};
+  if (m_max_downlink_queue_bytes > 0) {
+    input.tx_queue_fill_perc = std::min(
+        get_downlink_queue_bytes() * 100 / m_max_downlink_queue_bytes, 100);
+  }
+  input.n_dropped_frames = m_n_dropped_frames_since_update;
+  m_n_dropped_frames_since_update = 0;
+  // The block loss is unknown without FEC
+  input.gnd_packet_loss_perc =
+      n_packets > 0 ? (int)(n_lost * 100 / n_packets) : -1;
+  m_rate_controller.update(input, to_time_point(now));
+}
+
+}  // namespace openhd::sim
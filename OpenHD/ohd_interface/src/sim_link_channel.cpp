@@ -0,0 +1,87 @@
+#include "sim_link_channel.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace openhd::sim {
+
+SimChannel::SimChannel(ChannelConfig config)
+    : m_config(config), m_rng(config.seed) {}
+
+bool SimChannel::send(Packet packet, const Time now, const int n_injections) {
+  m_stats.n_packets++;
+  const size_t n_bytes = packet.data ? packet.data->size() : 0;
+  const Time serialization_time = get_serialization_time(n_bytes);
+  if (m_config.max_queue_bytes > 0 &&
+      get_queue_bytes(now) + (int)n_bytes > m_config.max_queue_bytes) {
+    m_stats.n_dropped_queue++;
+    return false;
+  }
+  bool lost = true;
+  for (int i = 0; i < std::max(n_injections, 1); i++) {
+    m_tx_free = std::max(m_tx_free, now) + serialization_time;
+    // Each injection goes through the loss model (and moves its state)
+    if (!is_lost()) lost = false;
+  }
+  if (lost) {
+    m_stats.n_lost++;
+    return true;
+  }
+  Time jitter{0};
+  if (m_config.jitter.count() > 0) {
+    jitter = Time((int64_t)(random_uniform() * m_config.jitter.count()));
+  }
+  Time arrival = m_tx_free + m_config.latency + jitter;
+  if (m_config.p_reorder > 0 && random_uniform() < m_config.p_reorder) {
+    arrival += m_config.reorder_delay;
+    m_stats.n_reordered++;
+  } else {
+    // Jitter alone never reorders
+    arrival = std::max(arrival, m_last_in_order_arrival);
+    m_last_in_order_arrival = arrival;
+  }
+  m_in_flight.push(InFlight{arrival, m_seq++, std::move(packet)});
+  return true;
+}
+
+std::vector<SimChannel::Packet> SimChannel::receive(const Time now) {
+  std::vector<Packet> ret;
+  while (!m_in_flight.empty() && m_in_flight.top().arrival <= now) {
+    // top() is const, but the element is popped right after
+    auto& packet = const_cast<InFlight&>(m_in_flight.top()).packet;
+    m_stats.n_delivered++;
+    m_stats.bytes_delivered += packet.data ? (int64_t)packet.data->size() : 0;
+    ret.push_back(std::move(packet));
+    m_in_flight.pop();
+  }
+  return ret;
+}
+
+int SimChannel::get_queue_bytes(const Time now) const {
+  if (m_config.bandwidth_bits_per_second <= 0 || m_tx_free <= now) return 0;
+  const auto backlog = m_tx_free - now;
+  return (int)(backlog.count() * m_config.bandwidth_bits_per_second / 8 /
+               1000000000LL);
+}
+
+double SimChannel::random_uniform() {
+  // The output of mt19937 is specified by the standard, the distributions
+  // are not - this way the results are the same with every std library
+  return (double)(m_rng() >> 8) / (double)(1 << 24);
+}
+
+bool SimChannel::is_lost() {
+  const double p_transition =
+      m_bad_state ? m_config.p_bad_to_good : m_config.p_good_to_bad;
+  if (random_uniform() < p_transition) m_bad_state = !m_bad_state;
+  return random_uniform() < (m_bad_state ? m_config.loss_bad
+                                         : m_config.loss_good);
+}
+
+Time SimChannel::get_serialization_time(const size_t n_bytes) const {
+  if (m_config.bandwidth_bits_per_second <= 0) return Time{0};
+  return Time((int64_t)n_bytes * 8 * 1000000000LL /
+              m_config.bandwidth_bits_per_second);
+}
+
+}  // namespace openhd::sim
@@ -3,11 +3,14 @@
 #include "wifi_command_helper.h"
 // #include "wifi_command_helper2.h"
 
+#include <algorithm>
+#include <deque>
 #include <utility>
 
 #include "config_paths.h"
 #include "openhd_bitrate.h"
 #include "openhd_config.h"
+#include "openhd_fragment_pool.h"
 #include "openhd_global_constants.hpp"
 #include "openhd_platform.h"
 #include "openhd_reboot_util.h"
@@ -19,6 +22,27 @@
 #include "wifi_card.h"
 
 static constexpr auto WB_LINK_ARM_CHANGED_TX_POWER_TAG = "wb_link_tx_power";
+// In blocks (frames), the fill level is one of the inputs of the variable
+// bitrate
+static constexpr int VIDEO_TX_QUEUE_SIZE = 2;
+// The ground sends its management frames every 100ms
+static constexpr int GND_REPORTED_LOSS_TIMEOUT_MS = 1000;
+
+// Prometheus text format, the pool is shared by all video streams
+static std::string fragment_pool_metrics_text(
+    const openhd::FragmentPool::Stats& stats) {
+  return fmt::format(
+      "# TYPE openhd_fragment_pool_slots gauge\n"
+      "openhd_fragment_pool_slots {}\n"
+      "# TYPE openhd_fragment_pool_slots_in_use gauge\n"
+      "openhd_fragment_pool_slots_in_use {}\n"
+      "# TYPE openhd_fragment_pool_slots_in_use_peak gauge\n"
+      "openhd_fragment_pool_slots_in_use_peak {}\n"
+      "# TYPE openhd_fragment_pool_heap_fallbacks_total counter\n"
+      "openhd_fragment_pool_heap_fallbacks_total {}\n",
+      stats.n_slots, stats.n_in_use, stats.n_in_use_peak,
+      stats.n_heap_fallbacks);
+}
 
 WBLink::WBLink(OHDProfile profile, std::vector<WiFiCard> broadcast_cards)
     : m_profile(std::move(profile)),
@@ -27,7 +51,6 @@ WBLink::WBLink(OHDProfile profile, std::vector<WiFiCard> broadcast_cards)
           get_fec_max_block_size_for_platform()) {
   m_console = openhd::log::create_or_get("wb_streams");
   assert(m_console);
-  m_frame_drop_helper.set_console(m_console);
   m_console->info("Broadcast cards:{}", debug_cards(m_broadcast_cards));
   // sanity checks
   if (m_broadcast_cards.empty() ||
@@ -181,7 +204,7 @@ WBLink::WBLink(OHDProfile profile, std::vector<WiFiCard> broadcast_cards)
       // bitrate overshoot
       // TODO: In ohd_video,  differentiate between "frame" and NALU (nalu can
       // also be config data) such that we can make this queue smaller.
-      options_video_tx.block_data_queue_size = 2;
+      options_video_tx.block_data_queue_size = VIDEO_TX_QUEUE_SIZE;
       options_video_tx.radio_port = openhd::VIDEO_PRIMARY_RADIO_PORT;
       auto primary = std::make_unique<WBStreamTx>(m_wb_txrx, options_video_tx,
                                                   m_tx_header_1);
@@ -267,9 +290,57 @@ WBLink::WBLink(OHDProfile profile, std::vector<WiFiCard> broadcast_cards)
     m_management_air->m_tx_header = m_tx_header_2;
     m_management_air->start();
   }
+  update_video_tx_config();
+  m_tx_scheduler = std::make_unique<openhd::wb::TxPriorityScheduler>(
+      "wb_tx_scheduler", (int)m_wb_video_tx_list.size(),
+      [this](int stream_index, openhd::link_statistics::VideoDropReason reason,
+             int n_dropped_frames) {
+        on_video_frames_dropped(stream_index, reason, n_dropped_frames);
+      });
+  if (m_profile.is_air) {
+    OHDFilesystemUtil::create_directories(
+        openhd::LINK_METRICS_TEXTFILE_DIRECTORY);
+    m_link_metrics_filename =
+        std::string(openhd::LINK_METRICS_TEXTFILE_DIRECTORY) + "openhd.prom";
+  }
+  m_tx_scheduler->start();
   m_wb_txrx->start_receiving();
-  m_work_thread_run = true;
-  m_work_thread = std::make_unique<std::thread>(&WBLink::loop_do_work, this);
+  m_work_item_thread_run = true;
+  m_work_item_thread =
+      std::make_unique<std::thread>(&WBLink::loop_work_items, this);
+  m_scheduler = std::make_unique<openhd::wb::TaskScheduler>("wb_scheduler");
+  m_scheduler->add_periodic_task("apply_settings", APPLY_SETTINGS_INTERVAL,
+                                 [this] { wt_apply_requested_settings(); });
+  if (m_profile.is_air) {
+    m_scheduler->add_periodic_task(
+        "mcs_via_rc", APPLY_SETTINGS_INTERVAL,
+        [this] { wt_perform_mcs_via_rc_channel_if_enabled(); });
+    m_scheduler->add_periodic_task(
+        "thermal", THERMAL_PROTECTION_INTERVAL,
+        [this] { wt_perform_update_thermal_protection(); });
+    m_scheduler->add_periodic_task("rate_adjustment", RATE_ADJUSTMENT_INTERVAL,
+                                   [this] { wt_perform_rate_adjustment(); });
+    m_scheduler->add_periodic_task(
+        "video_coalesce",
+        coalesce_flush_interval(m_video_tx_config->secondary_coalesce_budget),
+        [this] { wt_flush_coalesced_video(); });
+  } else {
+    m_scheduler->add_periodic_task(
+        "channel_management", APPLY_SETTINGS_INTERVAL,
+        [this] { wt_gnd_perform_channel_management(); });
+    if (m_broadcast_cards.size() > 1) {
+      // Paused unless enabled, see set_gnd_background_analyze
+      m_scheduler->add_periodic_task(
+          "background_analysis",
+          m_settings->get_settings().wb_gnd_background_analyze
+              ? BACKGROUND_ANALYSIS_INTERVAL
+              : std::chrono::milliseconds(0),
+          [this] { wt_gnd_perform_background_analysis(); });
+    }
+  }
+  m_scheduler->add_periodic_task("statistics", RECALCULATE_STATISTICS_INTERVAL,
+                                 [this] { wt_update_statistics(); });
+  m_scheduler->start();
   std::function<bool(openhd::LinkActionHandler::ScanChannelsParam)> cb_scan =
       [this](openhd::LinkActionHandler::ScanChannelsParam param) {
         return request_start_scan_channels(param);
@@ -307,12 +378,22 @@ WBLink::WBLink(OHDProfile profile, std::vector<WiFiCard> broadcast_cards)
 
 WBLink::~WBLink() {
   m_console->debug("WBLink::~WBLink() begin");
-  if (m_work_thread) {
-    m_work_thread_run = false;
-    m_work_thread->join();
+  m_scheduler = nullptr;
+  if (m_work_item_thread) {
+    {
+      std::lock_guard<std::mutex> guard(m_work_item_queue_mutex);
+      m_work_item_thread_run = false;
+    }
+    m_work_item_queue_cv.notify_one();
+    m_work_item_thread->join();
+  }
+  if (m_profile.is_ground()) {
+    m_interference_map.persist_if_changed();
   }
   m_management_air = nullptr;
   m_management_gnd = nullptr;
+  // Keep the instance, telemetry might still be submitted
+  m_tx_scheduler->stop();
   openhd::FCRcChannelsHelper::instance().action_on_any_rc_channel_register(
       nullptr);
   openhd::ArmingStateHelper::instance().unregister_listener(
@@ -473,6 +554,7 @@ bool WBLink::set_air_video_fec_percentage(int fec_percentage) {
   if (!openhd::is_valid_fec_percentage(fec_percentage)) return false;
   m_settings->unsafe_get_settings().wb_video_fec_percentage = fec_percentage;
   m_settings->persist();
+  update_video_tx_config();
   // The next rate adjustment will adjust the bitrate accordingly
   return true;
 }
@@ -482,12 +564,14 @@ bool WBLink::set_air_enable_wb_video_variable_bitrate(int value) {
   // value is read in regular intervals.
   m_settings->unsafe_get_settings().enable_wb_video_variable_bitrate = value;
   m_settings->persist();
+  m_request_reset_rate_controller = true;
   return true;
 }
 
 bool WBLink::set_air_max_fec_block_size_for_platform(int value) {
   m_settings->unsafe_get_settings().wb_max_fec_block_size = value;
   m_settings->persist();
+  update_video_tx_config();
   return true;
 }
 
@@ -498,6 +582,41 @@ bool WBLink::set_air_wb_video_rate_for_mcs_adjustment_percent(int value) {
   m_settings->persist();
   return true;
 }
+bool WBLink::set_air_wb_video_rate_floor_kbits(int value) {
+  if (value < 500 || value > 100 * 1000) return false;
+  m_settings->unsafe_get_settings().wb_video_rate_floor_kbits = value;
+  m_settings->persist();
+  m_request_reset_rate_controller = true;
+  return true;
+}
+bool WBLink::set_air_wb_video_rate_headroom_perc(int value) {
+  if (value < 0 || value > 50) return false;
+  m_settings->unsafe_get_settings().wb_video_rate_headroom_perc = value;
+  m_settings->persist();
+  m_request_reset_rate_controller = true;
+  return true;
+}
+bool WBLink::set_air_wb_video_secondary_coalesce_ms(int value) {
+  if (value < 0 || value > 100) return false;
+  m_settings->unsafe_get_settings().wb_video_secondary_coalesce_ms = value;
+  m_settings->persist();
+  update_video_tx_config();
+  const auto budget = std::chrono::milliseconds(value);
+  if (m_scheduler) {
+    m_scheduler->set_task_period("video_coalesce",
+                                 coalesce_flush_interval(budget));
+  }
+  if (budget.count() == 0) {
+    // The flush task is paused now - send what has been coalesced so far
+    std::lock_guard<std::mutex> guard(m_secondary_coalescer_mutex);
+    auto block = m_secondary_coalescer.flush();
+    if (block.has_value()) {
+      submit_video_block(SECONDARY_VIDEO_STREAM_INDEX,
+                         std::move(block.value()), std::nullopt);
+    }
+  }
+  return true;
+}
 bool WBLink::set_dev_air_set_high_retransmit_count(int value) {
   assert(m_profile.is_air);
   if (!openhd::validate_yes_or_no(value)) return false;
@@ -507,6 +626,24 @@ bool WBLink::set_dev_air_set_high_retransmit_count(int value) {
   m_tx_header_1->update_set_flag_tx_no_ack(!value);
   return true;
 }
+bool WBLink::set_gnd_background_analyze(int value) {
+  assert(m_profile.is_ground());
+  if (!openhd::validate_yes_or_no(value)) return false;
+  if (value && m_broadcast_cards.size() < 2) {
+    m_console->warn("Background analyze needs a spare card");
+    return false;
+  }
+  m_settings->unsafe_get_settings().wb_gnd_background_analyze = value;
+  m_settings->persist();
+  if (value) {
+    m_scheduler->set_task_period("background_analysis",
+                                 BACKGROUND_ANALYSIS_INTERVAL);
+  }
+  // When disabled, the task gives the spare card back to the link and pauses
+  // itself
+  return true;
+}
+
 bool WBLink::request_start_scan_channels(
     openhd::LinkActionHandler::ScanChannelsParam scan_channels_params) {
   auto work_item = std::make_shared<WorkItem>(
@@ -538,6 +675,7 @@ bool WBLink::apply_frequency_and_channel_width(int frequency,
       100));  // Dirty - wait for any tx packets to drain
   const auto res = openhd::wb::set_frequency_and_channel_width_for_all_cards(
       frequency, channel_width_rx, m_broadcast_cards);
+  m_n_frequency_changes++;
   m_tx_header_1->update_channel_width(channel_width_tx);
   m_wb_txrx->tx_reset_stats();
   m_wb_txrx->rx_reset_stats();
@@ -656,6 +794,27 @@ std::vector<openhd::Setting> WBLink::get_all_settings() {
                 openhd::IntSetting{
                     (int)settings.wb_video_rate_for_mcs_adjustment_percent,
                     cb_wb_video_rate_for_mcs_adjustment_percent}});
+    auto cb_wb_video_rate_floor_kbits = [this](std::string, int value) {
+      return set_air_wb_video_rate_floor_kbits(value);
+    };
+    ret.push_back(Setting{
+        WB_VIDEO_RATE_FLOOR_KBITS,
+        openhd::IntSetting{settings.wb_video_rate_floor_kbits,
+                           cb_wb_video_rate_floor_kbits}});
+    auto cb_wb_video_rate_headroom_perc = [this](std::string, int value) {
+      return set_air_wb_video_rate_headroom_perc(value);
+    };
+    ret.push_back(Setting{
+        WB_VIDEO_RATE_HEADROOM_PERC,
+        openhd::IntSetting{settings.wb_video_rate_headroom_perc,
+                           cb_wb_video_rate_headroom_perc}});
+    auto cb_wb_video_secondary_coalesce_ms = [this](std::string, int value) {
+      return set_air_wb_video_secondary_coalesce_ms(value);
+    };
+    ret.push_back(Setting{
+        WB_VIDEO_SECONDARY_COALESCE_MS,
+        openhd::IntSetting{settings.wb_video_secondary_coalesce_ms,
+                           cb_wb_video_secondary_coalesce_ms}});
     // changing the mcs index via rc channel only makes sense on air,
     // and is only possible if the card supports it
     if (m_broadcast_cards.at(0).supports_openhd_wifibroadcast()) {
@@ -713,6 +872,15 @@ std::vector<openhd::Setting> WBLink::get_all_settings() {
         Setting{openhd::WB_PASSIVE_MODE,
                 openhd::IntSetting{(int)settings.wb_enable_listen_only_mode,
                                    cb_passive}});
+    if (n_rx_cards > 1) {
+      auto cb_background_analyze = [this](std::string, int value) {
+        return set_gnd_background_analyze(value);
+      };
+      ret.push_back(
+          Setting{openhd::WB_GND_BACKGROUND_ANALYZE,
+                  openhd::IntSetting{(int)settings.wb_gnd_background_analyze,
+                                     cb_background_analyze}});
+    }
   }
   const bool any_card_supports_stbc_ldpc_sgi =
       openhd::wb::any_card_supports_stbc_ldpc_sgi(m_broadcast_cards);
@@ -793,62 +961,55 @@ std::vector<openhd::Setting> WBLink::get_all_settings() {
 }
 #pragma clang diagnostic pop
 
-void WBLink::loop_do_work() {
-  while (m_work_thread_run) {
-    // Perform any queued up work if it exists
+void WBLink::loop_work_items() {
+  while (true) {
+    std::shared_ptr<WorkItem> work_item;
     {
-      m_work_item_queue_mutex.lock();
-      if (!m_work_item_queue.empty()) {
-        auto front = m_work_item_queue.front();
-        if (front->ready_to_be_executed()) {
-          m_console->debug("Start execute work item {}", front->TAG);
-          front->execute();
-          m_console->debug("Done executing work item {}", front->TAG);
-          m_work_item_queue.pop();
-        }
-      }
-      m_work_item_queue_mutex.unlock();
+      std::unique_lock<std::mutex> lock(m_work_item_queue_mutex);
+      m_work_item_queue_cv.wait(lock, [this] {
+        return !m_work_item_thread_run || !m_work_item_queue.empty();
+      });
+      if (!m_work_item_thread_run) break;
+      // Only this thread removes work items, the front one stays the same
+      m_work_item_queue_cv.wait_until(
+          lock, m_work_item_queue.front()->get_earliest_execution_time(),
+          [this] { return !m_work_item_thread_run; });
+      if (!m_work_item_thread_run) break;
+      work_item = m_work_item_queue.front();
     }
-    // If needed, apply the proper tx power (depending on armed / disarmed
-    // state).
-    bool tmp_true = true;
-    if (m_request_apply_tx_power.compare_exchange_strong(tmp_true, false)) {
-      apply_txpower();
-    }
-    wt_perform_mcs_via_rc_channel_if_enabled();
-    // wt_perform_bw_via_rc_channel_if_enabled();
-    wt_gnd_perform_channel_management();
-    // air_perform_reset_frequency();
-    // Perform thermal protection level calculation before rate adjustment !
-    wt_perform_update_thermal_protection();
-    wt_perform_rate_adjustment();
-    //  After we've applied the rate, we update the tx header mcs index if
-    //  necessary
-    tmp_true = true;
-    if (m_request_apply_air_mcs_index.compare_exchange_strong(tmp_true,
-                                                              false)) {
-      const int mcs_index = m_settings->unsafe_get_settings().wb_air_mcs_index;
-      m_tx_header_1->update_mcs_index(mcs_index);
-      m_tx_header_2->update_mcs_index(mcs_index);
+    // The work item stays in the queue while it is executed, such that no
+    // other work item can be added in the meantime
+    {
+      std::lock_guard<std::mutex> guard(m_card_config_mutex);
+      m_console->debug("Start execute work item {}", work_item->TAG);
+      work_item->execute();
+      m_console->debug("Done executing work item {}", work_item->TAG);
     }
-    tmp_true = true;
-    /*if (m_request_apply_air_bw.compare_exchange_strong(tmp_true,
-                                                              false)) {
-      apply_frequency_and_channel_width_from_settings();
-    }*/
-    // update statistics in regular intervals
-    wt_update_statistics();
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::lock_guard<std::mutex> guard(m_work_item_queue_mutex);
+    m_work_item_queue.pop();
   }
 }
 
-void WBLink::wt_update_statistics() {
-  const auto elapsed_since_last =
-      std::chrono::steady_clock::now() - m_last_stats_recalculation;
-  if (elapsed_since_last < RECALCULATE_STATISTICS_INTERVAL) {
-    return;
+void WBLink::wt_apply_requested_settings() {
+  // Wait until the work item (which might change the card config itself) is
+  // done
+  std::unique_lock<std::mutex> lock(m_card_config_mutex, std::try_to_lock);
+  if (!lock.owns_lock()) return;
+  // If needed, apply the proper tx power (depending on armed / disarmed
+  // state).
+  bool tmp_true = true;
+  if (m_request_apply_tx_power.compare_exchange_strong(tmp_true, false)) {
+    apply_txpower();
+  }
+  tmp_true = true;
+  if (m_request_apply_air_mcs_index.compare_exchange_strong(tmp_true, false)) {
+    const int mcs_index = m_settings->unsafe_get_settings().wb_air_mcs_index;
+    m_tx_header_1->update_mcs_index(mcs_index);
+    m_tx_header_2->update_mcs_index(mcs_index);
   }
-  m_last_stats_recalculation = std::chrono::steady_clock::now();
+}
+
+void WBLink::wt_update_statistics() {
   // telemetry is available on both air and ground
   openhd::link_statistics::StatsAirGround stats{};
   if (m_wb_tele_tx) {
@@ -863,6 +1024,12 @@ void WBLink::wt_update_statistics() {
   }
   if (m_profile.is_air) {
     // video on air
+    const bool log_video_frame_trace =
+        std::chrono::steady_clock::now() - m_last_video_frame_trace_log >
+        std::chrono::seconds(5);
+    if (log_video_frame_trace) {
+      m_last_video_frame_trace_log = std::chrono::steady_clock::now();
+    }
     for (int i = 0; i < m_wb_video_tx_list.size(); i++) {
       auto& wb_tx = *m_wb_video_tx_list.at(i);
       // auto& air_video=i==0 ? stats.air_video0 : stats.air_video1;
@@ -908,9 +1075,33 @@ void WBLink::wt_update_statistics() {
       air_fec.curr_tx_delay_avg_us = curr_tx_stats.curr_block_until_tx_avg_us;
       air_video.curr_fec_percentage =
           m_settings->unsafe_get_settings().wb_video_fec_percentage;
+      if (i < m_video_frame_trace.size()) {
+        const auto latency = m_video_frame_trace[i].get_and_reset();
+        stats.stats_wb_video_air_latency.push_back(
+            openhd::link_statistics::StatsWbVideoAirLatency{(uint8_t)i,
+                                                            latency});
+        if (log_video_frame_trace) {
+          m_console->debug("Video{} latency {}", i, latency.to_string());
+        }
+      }
       stats.stats_wb_video_air.push_back(air_video);
       if (i == 0) stats.air_fec_performance = air_fec;
     }
+    stats.stats_wb_video_air_drops = m_video_drop_stats.get_and_reset();
+    if (!m_link_metrics_filename.empty()) {
+      const auto metrics =
+          openhd::wb::VideoDropStats::to_metrics_text(
+              stats.stats_wb_video_air_drops,
+              m_video_drop_stats.get_n_dropped_invalid_stream()) +
+          fragment_pool_metrics_text(
+              openhd::FragmentPool::instance().get_stats());
+      if (!openhd::wb::VideoDropStats::write_metrics_textfile(
+              m_link_metrics_filename, metrics)) {
+        m_console->warn("Cannot write link metrics to [{}]",
+                        m_link_metrics_filename);
+        m_link_metrics_filename.clear();
+      }
+    }
   } else {
     // video on ground
     for (int i = 0; i < m_wb_video_rx_list.size(); i++) {
@@ -939,7 +1130,11 @@ void WBLink::wt_update_statistics() {
           openhd::util::get_micros(fec_stats.curr_fec_decode_time.max);
       // TODO otimization: Only send stats for an active link
       stats.stats_wb_video_ground.push_back(ground_video);
-      if (i == 0) stats.gnd_fec_performance = gnd_fec;
+      if (i == 0) {
+        stats.gnd_fec_performance = gnd_fec;
+        wt_gnd_update_reported_loss(fec_stats.count_blocks_lost,
+                                    fec_stats.count_blocks_total);
+      }
     }
   }
   const auto& curr_settings = m_settings->unsafe_get_settings();
@@ -988,7 +1183,7 @@ void WBLink::wt_update_statistics() {
       openhd::link_statistics::write_monitor_link_bitfield(bitfield);
   {
     // Operating mode
-    stats.gnd_operating_mode.operating_mode = 0;
+    stats.gnd_operating_mode.operating_mode = m_gnd_operating_mode;
     stats.gnd_operating_mode.tx_passive_mode_is_enabled =
         curr_settings.wb_enable_listen_only_mode ? 1 : 0;
     stats.gnd_operating_mode.progress = 0;
@@ -1058,9 +1253,30 @@ void WBLink::wt_update_statistics() {
   // chan_width:{}",rxStats.last_received_packet_mcs_index,rxStats.last_received_packet_channel_width);
 }
 
+void WBLink::wt_gnd_update_reported_loss(const int64_t count_blocks_lost,
+                                         const int64_t count_blocks_total) {
+  const int64_t lost = count_blocks_lost - m_gnd_last_count_blocks_lost;
+  const int64_t total = count_blocks_total - m_gnd_last_count_blocks_total;
+  m_gnd_last_count_blocks_lost = count_blocks_lost;
+  m_gnd_last_count_blocks_total = count_blocks_total;
+  int video_block_loss_perc = 0;
+  if (total > 0 && lost > 0) {
+    // Round up, any unrecoverable block is worth reporting
+    video_block_loss_perc =
+        (int)std::min<int64_t>((lost * 100 + total - 1) / total, 100);
+  }
+  m_management_gnd->m_curr_video_block_loss_perc = video_block_loss_perc;
+  m_management_gnd->m_curr_packet_loss_perc =
+      std::clamp((int)m_wb_txrx->get_rx_stats().curr_lowest_packet_loss, 0,
+                 100);
+}
+
 void WBLink::wt_perform_rate_adjustment() {
   using namespace openhd::wb;
   if (!m_profile.is_air) return;  // Only done on air unit
+  // A work item might change the frequency / channel width in the meantime
+  std::unique_lock<std::mutex> lock(m_card_config_mutex, std::try_to_lock);
+  if (!lock.owns_lock()) return;
   // Rate adjustment is done on air and only if enabled
   if (!(m_profile.is_air &&
         m_settings->get_settings().enable_wb_video_variable_bitrate)) {
@@ -1085,13 +1301,21 @@ void WBLink::wt_perform_rate_adjustment() {
   // m_foreign_p_helper.update(stats.count_p_any,stats.count_p_valid);
   // m_console->debug("N foreign packets per second
   // :{}",m_foreign_p_helper.get_foreign_packets_per_second());
+  const auto tx_stats = m_wb_txrx->get_tx_stats();
+  const int64_t count_tx_errors =
+      (int64_t)tx_stats.count_tx_injections_error_hint +
+      (int64_t)tx_stats.count_tx_dropped_packets;
+  const int n_tx_errors = (int)(count_tx_errors - m_rate_last_count_tx_errors);
+  m_rate_last_count_tx_errors = count_tx_errors;
+  const int n_dropped_frames = m_frame_drop_helper.take_dropped_frames();
+  const auto now = std::chrono::steady_clock::now();
   if (m_max_video_rate_for_current_wifi_fec_config !=
           max_video_rate_for_current_wifi_fec_config ||
-      m_rate_adjustment_frequency_changed) {
+      m_rate_adjustment_frequency_changed ||
+      m_request_reset_rate_controller.exchange(false)) {
     m_rate_adjustment_frequency_changed = false;
-    // Apply the default for this configuration, then return - we will start the
-    // auto-adjustment depending on tx error(s) next time the rate adjustment is
-    // called
+    // Start with the max rate for this configuration, then we adjust depending
+    // on the link state
     m_console->debug(
         "MCS:{} ch_width:{} Calculated max_rate:{}, max_video_rate:{}",
         settings.wb_air_mcs_index, settings.wb_air_tx_channel_width,
@@ -1100,57 +1324,70 @@ void WBLink::wt_perform_rate_adjustment() {
             max_video_rate_for_current_wifi_fec_config));
     m_max_video_rate_for_current_wifi_fec_config =
         max_video_rate_for_current_wifi_fec_config;
-    m_recommended_video_bitrate_kbits =
-        m_max_video_rate_for_current_wifi_fec_config;
-    m_curr_n_rate_adjustments = 0;
-    recommend_bitrate_to_encoder(m_recommended_video_bitrate_kbits);
-    // We 'give' the camera up to X seconds to adjust to the newly set rate. If
-    // we drop frames during this period, we do not count it as errors that need
-    // bitrate reduction.
-    m_frame_drop_helper.delay_for(std::chrono::seconds(5));
+    m_rate_controller.reset(max_video_rate_for_current_wifi_fec_config,
+                            settings.wb_video_rate_floor_kbits,
+                            settings.wb_video_rate_headroom_perc,
+                            (int)settings.wb_video_fec_percentage, now);
     m_primary_total_dropped_frames = 0;
     m_secondary_total_dropped_frames = 0;
-    return;
-  }
-  // const bool
-  // dropping_many_frames=m_frame_drop_helper.needs_bitrate_reduction();
-  const bool dropping_many_frames = false;
-  // m_console->debug("Dropped since last check:{}",dropped_since_last_check);
-  if (dropping_many_frames) {
-    // We are dropping frames / too many tx error hint(s), we need to reduce
-    // bitrate. Reduce video bitrate by 1MBit/s
-    m_recommended_video_bitrate_kbits -= 1000;
-    m_curr_n_rate_adjustments++;
-    // Safety, in case we fall below a certain threshold the encoder won't be
-    // able to produce an image at some point anyways.
-    static constexpr auto MIN_BITRATE_KBITS = 1000 * 2;
-    if (m_recommended_video_bitrate_kbits < MIN_BITRATE_KBITS) {
-      m_console->warn("Reached minimum bitrate {}",
-                      openhd::kbits_per_second_to_string(MIN_BITRATE_KBITS));
-      m_recommended_video_bitrate_kbits = MIN_BITRATE_KBITS;
-      m_curr_n_rate_adjustments--;
+  } else {
+    openhd::wb::VideoBitrateController::Input input{};
+    auto& primary_tx = *m_wb_video_tx_list.at(0);
+    const int available =
+        (int)primary_tx.get_tx_queue_available_size_approximate();
+    // Frames waiting in front of the wb queue count as well
+    const int n_queued = VIDEO_TX_QUEUE_SIZE - available +
+                         m_tx_scheduler->get_n_pending_video_frames(0);
+    input.tx_queue_fill_perc =
+        std::clamp(n_queued, 0, VIDEO_TX_QUEUE_SIZE) * 100 /
+        VIDEO_TX_QUEUE_SIZE;
+    input.n_dropped_frames = n_dropped_frames;
+    input.n_tx_errors = n_tx_errors;
+    const int elapsed_since_gnd_report_ms =
+        openhd::util::steady_clock_time_epoch_ms() -
+        m_management_air->get_last_received_packet_ts_ms();
+    if (elapsed_since_gnd_report_ms < GND_REPORTED_LOSS_TIMEOUT_MS) {
+      input.gnd_video_block_loss_perc =
+          m_management_air->m_gnd_reported_video_block_loss_perc;
+      input.gnd_packet_loss_perc =
+          m_management_air->m_gnd_reported_packet_loss_perc;
+    }
+    const int before = m_rate_controller.get_bitrate_kbits();
+    m_rate_controller.update(input, now);
+    const int after = m_rate_controller.get_bitrate_kbits();
+    if (after < before) {
+      m_console->warn(
+          "Link congested (dropped:{} tx_err:{} queue:{}% gnd_loss:{}%), "
+          "reducing video bitrate to {}",
+          n_dropped_frames, n_tx_errors, input.tx_queue_fill_perc,
+          input.gnd_video_block_loss_perc,
+          openhd::kbits_per_second_to_string(after));
+    } else if (after > before) {
+      m_console->debug("Link clean, increasing video bitrate to {}",
+                       openhd::kbits_per_second_to_string(after));
     }
-    m_console->warn("TX errors, reducing video bitrate to {}",
-                    m_recommended_video_bitrate_kbits);
   }
+  m_recommended_video_bitrate_kbits = m_rate_controller.get_bitrate_kbits();
+  m_curr_n_rate_adjustments = m_rate_controller.get_n_decreases();
+  int encoder_bitrate_kbits = m_recommended_video_bitrate_kbits;
   // Extra x20 - thermal protection
   if (OHDPlatform::instance().is_x20()) {
     const int factor = !m_is_armed ? 50 : 100;
-    const int x20_rate =
+    encoder_bitrate_kbits =
         m_thermal_protection_level > 0
             ? m_recommended_video_bitrate_kbits * 30 / 100 * factor / 100
             : m_recommended_video_bitrate_kbits * 70 / 100 * factor / 100;
-    recommend_bitrate_to_encoder(x20_rate);
-    return;
   }
-  recommend_bitrate_to_encoder(m_recommended_video_bitrate_kbits);
+  if (m_encoder_bitrate_filter.should_recommend(encoder_bitrate_kbits, now)) {
+    recommend_bitrate_to_encoder(encoder_bitrate_kbits);
+  }
 }
 
 void WBLink::recommend_bitrate_to_encoder(int recommended_video_bitrate_kbits) {
-  // Since settings might change dynamically at run time, we constantly
-  // recommend a bitrate to the encoder / camera - The camera is responsible for
-  // "not doing anything" when we recommend the same bitrate to it multiple
-  // times
+  // Since settings might change dynamically at run time, we regularly
+  // recommend a bitrate to the encoder / camera (see EncoderBitrateFilter) -
+  // The camera is responsible for "not doing anything" when we recommend the
+  // same bitrate to it multiple times
   /*if(!m_opt_action_handler){
       m_console->debug("No action handler,cannot recommend bitrate to camera");
       return;
@@ -1163,21 +1400,18 @@ void WBLink::recommend_bitrate_to_encoder(int recommended_video_bitrate_kbits) {
 
 bool WBLink::try_schedule_work_item(
     const std::shared_ptr<WorkItem>& work_item) {
-  std::unique_lock<std::mutex> lock(m_work_item_queue_mutex, std::try_to_lock);
-  if (lock.owns_lock()) {
+  {
+    std::lock_guard<std::mutex> guard(m_work_item_queue_mutex);
     if (m_work_item_queue.empty()) {
       m_console->debug("Adding work item {} to queue", work_item->TAG);
       m_work_item_queue.push(work_item);
+      m_work_item_queue_cv.notify_one();
       return true;
     }
-    m_console->debug("Work queue full,cannot add {}", work_item->TAG);
-    m_console->warn("Please try again later");
-    return false;
   }
-  // Most likely, the lock is hold by the wb_link thread currently performing a
-  // previous work item - this is not an error, the user has to try changing
-  // param X later.
-  m_console->debug("Cannot get lock,cannot add {}", work_item->TAG);
+  // Most likely, the work item thread is currently performing a previous work
+  // item - this is not an error, the user has to try changing param X later.
+  m_console->debug("Work queue full,cannot add {}", work_item->TAG);
   m_console->warn("Please try again later");
   return false;
 }
@@ -1185,85 +1419,239 @@ bool WBLink::try_schedule_work_item(
 void WBLink::transmit_telemetry_data(TelemetryTxPacket packet) {
   assert(packet.n_injections >= 1);
   // m_console->debug("N injections:{}",packet.n_injections);
-  const auto n_dropped =
-      m_wb_tele_tx->enqueue_packet_dropping(packet.data, packet.n_injections);
-  if (n_dropped > 0) {
-    m_console->debug("Telemetry queue jam, dropped {}", n_dropped);
-  }
+  openhd::wb::TxPriorityScheduler::Item item{};
+  item.lane = openhd::wb::TxPriorityScheduler::Lane::TELEMETRY;
+  // Newer telemetry is more valuable - if the wb telemetry queue is full, the
+  // oldest packet in there is dropped. Never blocks, so it can't hold back
+  // audio / video.
+  item.try_enqueue = [this, packet]() {
+    m_wb_tele_tx->enqueue_packet_dropping(packet.data, packet.n_injections);
+    return true;
+  };
+  m_tx_scheduler->submit(std::move(item));
 }
 
 void WBLink::transmit_video_data(
     int stream_index,
     const openhd::FragmentedVideoFrame& fragmented_video_frame) {
   assert(m_profile.is_air);
-  if (stream_index < 0 || stream_index > m_wb_video_tx_list.size()) {
+  using openhd::link_statistics::VideoDropReason;
+  openhd::FrameTrace trace = fragmented_video_frame.trace;
+  const auto transmit_entry = std::chrono::steady_clock::now();
+  trace.transmit_entry = transmit_entry;
+  if (stream_index < 0 || stream_index >= (int)m_wb_video_tx_list.size()) {
     m_console->debug("Invalid camera stream_index {}", stream_index);
+    on_video_frames_dropped(stream_index,
+                            VideoDropReason::INVALID_STREAM_INDEX, 1);
     return;
   }
   if (m_air_close_video_in.load(std::memory_order_relaxed)) {
     m_console->debug("Video TX temporarily disabled");
+    on_video_frames_dropped(stream_index, VideoDropReason::VIDEO_CLOSED, 1);
     return;
   }
   if (m_thermal_protection_level.load(std::memory_order_relaxed) >=
       THERMAL_PROTECTION_VIDEO_DISABLED) {
     // Thermal protection disable video active, don't transmit video
+    on_video_frames_dropped(stream_index, VideoDropReason::THERMAL_PROTECTION,
+                            1);
     return;
   }
   // m_console->debug("Got {}",fragmented_video_frame.rtp_fragments.size());
-  auto& tx = *m_wb_video_tx_list[stream_index];
-  tx.set_encryption(fragmented_video_frame.enable_ultra_secure_encryption);
-  const int max_fec_block_size = get_max_fec_block_size();
-  const int fec_perc = m_settings->get_settings().wb_video_fec_percentage;
-  int n_dropped_frames = 0;
+  const bool is_keyframe = fragmented_video_frame.is_intra_stream ||
+                           fragmented_video_frame.is_idr_frame;
+  const bool enable_encryption =
+      fragmented_video_frame.enable_ultra_secure_encryption;
   if (fragmented_video_frame.dirty_frame != nullptr) {
     // non rtp
-    const auto res = tx.try_enqueue_frame(fragmented_video_frame.dirty_frame,
-                                          max_fec_block_size, fec_perc,
-                                          fragmented_video_frame.creation_time);
-    if (!res) {
-      // We dropped this frame
-      n_dropped_frames = 1;
+    openhd::wb::TxPriorityScheduler::Item item{};
+    item.lane = openhd::wb::TxPriorityScheduler::Lane::VIDEO;
+    item.stream_index = stream_index;
+    item.is_keyframe = is_keyframe;
+    item.creation_time = fragmented_video_frame.creation_time;
+    item.try_enqueue = [this, stream_index, enable_encryption, is_keyframe,
+                        transmit_entry,
+                        frame = fragmented_video_frame.dirty_frame,
+                        creation_time =
+                            fragmented_video_frame.creation_time]() {
+      auto& tx = *m_wb_video_tx_list[stream_index];
+      wt_video_tx_set_encryption(stream_index, enable_encryption);
+      const auto config = std::atomic_load(&m_video_tx_config);
+      if (!tx.try_enqueue_frame(frame, config->max_fec_block_size,
+                                config->fec_percentage, creation_time)) {
+        return false;
+      }
+      m_video_drop_stats.add_queue_residency(
+          stream_index, is_keyframe,
+          std::chrono::steady_clock::now() - transmit_entry);
+      return true;
+    };
+    if (stream_index != SECONDARY_VIDEO_STREAM_INDEX) {
+      m_tx_scheduler->submit(std::move(item));
+      return;
     }
-  } else {
-    // Pushes out previous enqueued frames if there is not enough space in the
-    // queue
-    const bool use_dropping_enqueue = fragmented_video_frame.is_intra_stream ||
-                                      fragmented_video_frame.is_idr_frame;
+    // The coalesce flush task submits to this stream, too - one producer at a
+    // time, and what has been coalesced so far goes out first
+    std::lock_guard<std::mutex> guard(m_secondary_coalescer_mutex);
+    auto block = m_secondary_coalescer.flush();
+    if (block.has_value()) {
+      submit_video_block(stream_index, std::move(block.value()), std::nullopt);
+    }
+    m_tx_scheduler->submit(std::move(item));
+    return;
+  }
+  openhd::wb::FrameCoalescer::Frame frame{};
+  // The wb tx queue requires owned buffers - this is a no-op for vector
+  // backed fragments and the only copy for zero-copy (gst) fragments
+  frame.fragments =
+      openhd::fragments_as_vectors(fragmented_video_frame.rtp_fragments);
+  frame.is_keyframe = is_keyframe;
+  frame.enable_encryption = enable_encryption;
+  frame.creation_time = fragmented_video_frame.creation_time;
+  frame.arrival = transmit_entry;
+  if (stream_index != SECONDARY_VIDEO_STREAM_INDEX) {
+    submit_video_block(stream_index,
+                       openhd::wb::FrameCoalescer::to_block(std::move(frame)),
+                       trace);
+    return;
+  }
+  const auto config = std::atomic_load(&m_video_tx_config);
+  std::lock_guard<std::mutex> guard(m_secondary_coalescer_mutex);
+  auto blocks = m_secondary_coalescer.add(std::move(frame),
+                                          config->secondary_coalesce_budget,
+                                          config->max_fec_block_size);
+  for (size_t i = 0; i < blocks.size(); i++) {
+    // The last block contains this frame, we only trace frames that have not
+    // been coalesced
+    const bool traced = i + 1 == blocks.size() && blocks[i].n_frames == 1;
+    submit_video_block(stream_index, std::move(blocks[i]),
+                       traced ? std::make_optional(trace) : std::nullopt);
+  }
+}
 
-    if (use_dropping_enqueue) {
+void WBLink::submit_video_block(int stream_index,
+                                openhd::wb::FrameCoalescer::Block block,
+                                std::optional<openhd::FrameTrace> trace) {
+  using openhd::link_statistics::VideoDropReason;
+  openhd::wb::TxPriorityScheduler::Item item{};
+  item.lane = openhd::wb::TxPriorityScheduler::Lane::VIDEO;
+  item.stream_index = stream_index;
+  item.is_keyframe = block.is_keyframe;
+  item.creation_time = block.creation_time;
+  // Copyable, as required by std::function
+  auto shared_block =
+      std::make_shared<openhd::wb::FrameCoalescer::Block>(std::move(block));
+  item.try_enqueue = [this, stream_index, shared_block,
+                      trace = std::move(trace)]() mutable {
+    auto& block = *shared_block;
+    auto& tx = *m_wb_video_tx_list[stream_index];
+    wt_video_tx_set_encryption(stream_index, block.enable_encryption);
+    const auto config = std::atomic_load(&m_video_tx_config);
+    const int max_fec_block_size = config->max_fec_block_size;
+    const int fec_perc = config->fec_percentage;
+    if (block.is_keyframe) {
+      // Pushes out previous enqueued frames if there is not enough space in
+      // the queue - a keyframe has to go out as soon as possible
       const auto count_removed = tx.enqueue_block_dropping(
-          fragmented_video_frame.rtp_fragments, max_fec_block_size, fec_perc,
-          fragmented_video_frame.creation_time);
+          std::move(block.fragments), max_fec_block_size, fec_perc,
+          block.creation_time);
       if (count_removed != 0) {
-        openhd::log::get_default()->debug(
-            "Cleared {} frames to make space for frame {}", count_removed,
-            fragmented_video_frame.to_string());
-        n_dropped_frames = count_removed;
+        m_console->debug("Cleared {} frames to make space for keyframe",
+                         count_removed);
+        on_video_frames_dropped(stream_index,
+                                VideoDropReason::ENQUEUE_DROPPING,
+                                count_removed);
       }
     } else {
-      const auto res = tx.try_enqueue_block(
-          fragmented_video_frame.rtp_fragments, max_fec_block_size, fec_perc,
-          fragmented_video_frame.creation_time);
-      if (!res) {
-        n_dropped_frames = 1;
+      // Stays with the scheduler (which drops it once it is too old) if the
+      // queue is full
+      if (tx.get_tx_queue_available_size_approximate() <= 0) return false;
+      if (!tx.try_enqueue_block(std::move(block.fragments), max_fec_block_size,
+                                fec_perc, block.creation_time)) {
         m_console->debug("TX enqueue video frame failed, queue size:{}",
                          tx.get_tx_queue_available_size_approximate());
+        on_video_frames_dropped(stream_index, VideoDropReason::QUEUE_FULL,
+                                block.n_frames);
+        return true;
       }
     }
-  }
-  if (n_dropped_frames != 0) {
-    m_frame_drop_helper.notify_dropped_frame(n_dropped_frames);
-    if (stream_index == 0) {
-      m_primary_total_dropped_frames += n_dropped_frames;
-    } else {
-      m_secondary_total_dropped_frames += n_dropped_frames;
+    const auto enqueued = std::chrono::steady_clock::now();
+    m_video_drop_stats.add_queue_residency(stream_index, block.is_keyframe,
+                                           enqueued - block.arrival);
+    if (trace.has_value() && stream_index < m_video_frame_trace.size()) {
+      trace->fec_enqueued = enqueued;
+      m_video_frame_trace[stream_index].add(trace.value());
     }
+    return true;
+  };
+  m_tx_scheduler->submit(std::move(item));
+}
+
+void WBLink::wt_flush_coalesced_video() {
+  const auto config = std::atomic_load(&m_video_tx_config);
+  std::lock_guard<std::mutex> guard(m_secondary_coalescer_mutex);
+  auto block = m_secondary_coalescer.flush_if_due(
+      std::chrono::steady_clock::now(), config->secondary_coalesce_budget);
+  if (block.has_value()) {
+    submit_video_block(SECONDARY_VIDEO_STREAM_INDEX, std::move(block.value()),
+                       std::nullopt);
+  }
+}
+
+std::chrono::milliseconds WBLink::coalesce_flush_interval(
+    const std::chrono::milliseconds budget) {
+  if (budget.count() <= 0) return std::chrono::milliseconds(0);
+  return std::clamp(budget / 4, std::chrono::milliseconds(1),
+                    std::chrono::milliseconds(5));
+}
+
+void WBLink::update_video_tx_config() {
+  auto config = std::make_shared<VideoTxConfig>();
+  config->max_fec_block_size = get_max_fec_block_size();
+  config->fec_percentage =
+      (int)m_settings->get_settings().wb_video_fec_percentage;
+  config->secondary_coalesce_budget = std::chrono::milliseconds(
+      m_settings->get_settings().wb_video_secondary_coalesce_ms);
+  std::atomic_store(&m_video_tx_config,
+                    std::shared_ptr<const VideoTxConfig>(std::move(config)));
+}
+
+void WBLink::wt_video_tx_set_encryption(int stream_index, bool enable) {
+  if (m_video_tx_encryption.at(stream_index) == enable) return;
+  m_video_tx_encryption[stream_index] = enable;
+  m_wb_video_tx_list[stream_index]->set_encryption(enable);
+}
+
+void WBLink::on_video_frames_dropped(
+    int stream_index, openhd::link_statistics::VideoDropReason reason,
+    int n_dropped_frames) {
+  using openhd::link_statistics::VideoDropReason;
+  m_video_drop_stats.add_dropped(stream_index, reason, n_dropped_frames);
+  // Only the drops caused by the link (and not e.g. by thermal protection)
+  // are a reason for the rate control to reduce the bitrate
+  if (reason == VideoDropReason::THERMAL_PROTECTION ||
+      reason == VideoDropReason::VIDEO_CLOSED ||
+      reason == VideoDropReason::INVALID_STREAM_INDEX) {
+    return;
+  }
+  m_frame_drop_helper.notify_dropped_frame(n_dropped_frames);
+  if (stream_index == 0) {
+    m_primary_total_dropped_frames += n_dropped_frames;
+  } else {
+    m_secondary_total_dropped_frames += n_dropped_frames;
   }
 }
 
 void WBLink::transmit_audio_data(const openhd::AudioPacket& audio_packet) {
   if (m_wb_audio_tx) {
-    m_wb_audio_tx->try_enqueue_packet(audio_packet.data);
+    openhd::wb::TxPriorityScheduler::Item item{};
+    item.lane = openhd::wb::TxPriorityScheduler::Lane::AUDIO;
+    // Same as telemetry, drops the oldest audio packet if the queue is full
+    item.try_enqueue = [this, data = audio_packet.data]() {
+      m_wb_audio_tx->enqueue_packet_dropping(data, 1);
+      return true;
+    };
+    m_tx_scheduler->submit(std::move(item));
   }
 }
 
@@ -1283,8 +1671,10 @@ openhd::WifiSpace WBLink::get_current_frequency_channel_space() const {
 void WBLink::perform_channel_scan(
     const openhd::LinkActionHandler::ScanChannelsParam& scan_channels_params) {
   const WiFiCard& card = m_broadcast_cards.at(0);
-  const auto channels_to_scan = openhd::wb::get_scan_channels_frequencies(
-      card, scan_channels_params.channels_to_scan);
+  // Most likely channel(s) first
+  const auto channels_to_scan = m_scan_channel_history.order_by_likelihood(
+      openhd::wb::get_scan_channels_frequencies(
+          card, scan_channels_params.channels_to_scan));
   if (channels_to_scan.empty()) {
     m_console->warn("No channels to scan, return early");
     return;
@@ -1299,20 +1689,54 @@ void WBLink::perform_channel_scan(
   //  We only scan 40Mhz, this way we get both 20Mhz and 40Mhz air unit(s)
   const std::vector<uint16_t> channel_widths_to_scan = {40};
 
+  m_gnd_operating_mode = 1;
   auto stats_current = openhd::LinkActionHandler::instance().get_link_stats();
   stats_current.gnd_operating_mode.operating_mode = 1;
   openhd::LinkActionHandler::instance().update_link_stats(stats_current);
 
-  struct ScanResult {
-    bool success = false;
-    int frequency = 0;
-    int channel_width = 0;
-  };
-  ScanResult result{false, 0, 0};
   // Note: We intentionally do not modify the persistent settings here
   m_console->debug(
       "Channel scan N channels to scan:{} N channel widths to scan:{}",
       channels_to_scan.size(), channel_widths_to_scan.size());
+  const auto scan_begin = std::chrono::steady_clock::now();
+  ChannelScanResult result;
+  if (can_scan_channels_in_parallel()) {
+    result = scan_channels_parallel(channels_to_scan,
+                                    channel_widths_to_scan.at(0));
+  } else {
+    result = scan_channels_sequential(channels_to_scan, channel_widths_to_scan);
+  }
+  m_console->debug(
+      "Channel scan took:{}",
+      MyTimeHelper::R(std::chrono::steady_clock::now() - scan_begin));
+  re_enable_injection_unless_user_passive_mode_enabled();
+  if (!result.success) {
+    m_console->warn("Channel scan failure, restore local settings");
+    apply_frequency_and_channel_width_from_settings();
+    result.success = false;
+    result.frequency = 0;
+  } else {
+    m_console->debug("Channel scan success, {}@{}Mhz", result.frequency,
+                     result.channel_width);
+    m_settings->unsafe_get_settings().wb_frequency = result.frequency;
+    m_settings->persist();
+    m_scan_channel_history.on_air_found(result.frequency);
+    m_gnd_curr_rx_channel_width = result.channel_width;
+    apply_frequency_and_channel_width_from_settings();
+  }
+  openhd::LinkActionHandler::ScanChannelsProgress tmp{};
+  tmp.channel_mhz = (int)result.frequency;
+  tmp.channel_width_mhz = result.channel_width;
+  tmp.success = result.success;
+  tmp.progress = 100;
+  openhd::LinkActionHandler::instance().add_scan_channels_progress(tmp);
+  m_gnd_operating_mode = 0;
+}
+
+WBLink::ChannelScanResult WBLink::scan_channels_sequential(
+    const std::vector<openhd::WifiChannel>& channels_to_scan,
+    const std::vector<uint16_t>& channel_widths_to_scan) {
+  ChannelScanResult result{};
   bool done_early = false;
   // We need to loop through all possible channels
   for (int i = 0; i < channels_to_scan.size(); i++) {
@@ -1353,27 +1777,20 @@ void WBLink::perform_channel_scan(
       reset_all_rx_stats();
       m_management_gnd->m_air_reported_curr_frequency = -1;
       m_management_gnd->m_air_reported_curr_channel_width = -1;
-      std::this_thread::sleep_for(std::chrono::seconds(2));
-      const auto n_likely_openhd_packets =
-          m_wb_txrx->get_rx_stats().curr_n_likely_openhd_packets;
-      // If we got what looks to be openhd packets, sleep a bit more such that
-      // we can reliably get a management frame
-      if (n_likely_openhd_packets > 0) {
-        m_console->debug("Got {} likely openhd packets, sleep a bit more",
-                         n_likely_openhd_packets);
-        const auto begin_long_listen = std::chrono::steady_clock::now();
-        while (std::chrono::steady_clock::now() - begin_long_listen <
-               std::chrono::seconds(5)) {
-          const int air_center_frequency =
-              m_management_gnd->m_air_reported_curr_frequency;
-          const int air_tx_channel_width =
-              m_management_gnd->m_air_reported_curr_channel_width;
-          const bool has_received_management =
-              air_center_frequency > 0 && air_tx_channel_width > 0;
-          if (has_received_management) {
-            break;
-          }
-          std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      // Listen until we are confident the air unit is (not) on this channel
+      const openhd::wb::ScanDwell dwell(std::chrono::steady_clock::now());
+      while (true) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        // The rx stats have been reset when the dwell began
+        const int64_t n_openhd_packets = get_scan_n_openhd_packets(
+            (int64_t)m_wb_txrx->get_rx_stats().count_p_valid);
+        const bool has_received_management =
+            m_management_gnd->m_air_reported_curr_frequency > 0 &&
+            m_management_gnd->m_air_reported_curr_channel_width > 0;
+        if (dwell.update(std::chrono::steady_clock::now(), n_openhd_packets,
+                         has_received_management) !=
+            openhd::wb::ScanDwell::Result::LISTEN) {
+          break;
         }
       }
       const auto packet_loss =
@@ -1398,26 +1815,145 @@ void WBLink::perform_channel_scan(
       }
     }
   }
-  re_enable_injection_unless_user_passive_mode_enabled();
-  if (!result.success) {
-    m_console->warn("Channel scan failure, restore local settings");
-    apply_frequency_and_channel_width_from_settings();
-    result.success = false;
-    result.frequency = 0;
-  } else {
-    m_console->debug("Channel scan success, {}@{}Mhz", result.frequency,
-                     result.channel_width);
-    m_settings->unsafe_get_settings().wb_frequency = result.frequency;
-    m_settings->persist();
-    m_gnd_curr_rx_channel_width = result.channel_width;
-    apply_frequency_and_channel_width_from_settings();
+  return result;
+}
+
+int64_t WBLink::get_scan_n_openhd_packets(const int64_t n_valid_packets) {
+  return n_valid_packets +
+         (int64_t)m_wb_txrx->get_rx_stats().curr_n_likely_openhd_packets;
+}
+
+bool WBLink::can_scan_channels_in_parallel() const {
+  if (m_broadcast_cards.size() < 2) return false;
+  for (const auto& card : m_broadcast_cards) {
+    if (card.type == WiFiCardType::OPENHD_EMULATED) return false;
   }
-  openhd::LinkActionHandler::ScanChannelsProgress tmp{};
-  tmp.channel_mhz = (int)result.frequency;
-  tmp.channel_width_mhz = result.channel_width;
-  tmp.success = result.success;
-  tmp.progress = 100;
-  openhd::LinkActionHandler::instance().add_scan_channels_progress(tmp);
+  return true;
+}
+
+WBLink::ChannelScanResult WBLink::scan_channels_parallel(
+    const std::vector<openhd::WifiChannel>& channels_to_scan,
+    const uint16_t channel_width) {
+  // Disable injection during scan
+  m_wb_txrx->set_passive_mode(true);
+  reset_all_rx_stats();
+  m_management_gnd->m_air_reported_curr_frequency = -1;
+  m_management_gnd->m_air_reported_curr_channel_width = -1;
+  // The management frame contains the frequency the air unit is on, no matter
+  // which card received it - as soon as any card got one, all workers stop.
+  auto air_reported_channel = [this, &channels_to_scan]() {
+    const int air_center_frequency =
+        m_management_gnd->m_air_reported_curr_frequency;
+    const int air_tx_channel_width =
+        m_management_gnd->m_air_reported_curr_channel_width;
+    if (air_center_frequency <= 0 ||
+        !(air_tx_channel_width == 20 || air_tx_channel_width == 40)) {
+      return false;
+    }
+    for (const auto& channel : channels_to_scan) {
+      if (channel.frequency == air_center_frequency) return true;
+    }
+    return false;
+  };
+  std::atomic_bool found = false;
+  // Returns true if the air unit has been found (by any card) in the meantime
+  auto listen_for = [&found,
+                     &air_reported_channel](std::chrono::milliseconds duration) {
+    const auto begin = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - begin < duration) {
+      if (found) return true;
+      if (air_reported_channel()) {
+        found = true;
+        return true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return found.load();
+  };
+  // Each card takes the next channel (it supports) that hasn't been scanned
+  // yet, such that a slow card doesn't hold up the others.
+  std::mutex pending_mutex;
+  std::deque<openhd::WifiChannel> pending(channels_to_scan.begin(),
+                                          channels_to_scan.end());
+  int n_channels_taken = 0;
+  auto worker = [&](const int card_index) {
+    const WiFiCard& card = m_broadcast_cards.at(card_index);
+    while (!found) {
+      std::optional<openhd::WifiChannel> channel;
+      int progress = 0;
+      {
+        std::lock_guard<std::mutex> guard(pending_mutex);
+        for (auto it = pending.begin(); it != pending.end(); ++it) {
+          if (wifi_card_supports_frequency(card, it->frequency)) {
+            channel = *it;
+            pending.erase(it);
+            progress = OHDUtil::calculate_progress_perc(
+                n_channels_taken++, (int)channels_to_scan.size());
+            break;
+          }
+        }
+      }
+      if (!channel.has_value()) break;
+      const bool freq_success =
+          openhd::wb::set_frequency_and_channel_width_for_all_cards(
+              channel->frequency, channel_width, {card});
+      if (!freq_success) {
+        m_console->warn("{} cannot scan [{}] {}Mhz@{}Mhz", card.device_name,
+                        channel->channel, channel->frequency, channel_width);
+        continue;
+      }
+      openhd::LinkActionHandler::ScanChannelsProgress tmp{};
+      tmp.channel_mhz = (int)channel->frequency;
+      tmp.channel_width_mhz = channel_width;
+      tmp.success = false;
+      tmp.progress = progress;
+      openhd::LinkActionHandler::instance().add_scan_channels_progress(tmp);
+      // sleeep a bit - some cards /drivers might need time switching
+      if (listen_for(std::chrono::milliseconds(200))) break;
+      m_console->debug("{} scanning [{}] {}Mhz@{}Mhz", card.device_name,
+                       channel->channel, channel->frequency, channel_width);
+      // The stats of all cards are only reset once, use the delta
+      const auto count_p_valid_begin =
+          m_wb_txrx->get_rx_stats_for_card(card_index).count_p_valid;
+      auto n_valid_packets = [&]() {
+        return m_wb_txrx->get_rx_stats_for_card(card_index).count_p_valid -
+               count_p_valid_begin;
+      };
+      // Listen until we are confident the air unit is (not) on this channel
+      const openhd::wb::ScanDwell dwell(std::chrono::steady_clock::now());
+      while (!listen_for(std::chrono::milliseconds(100))) {
+        // The management frame is checked by listen_for, no matter which card
+        // received it. Likely openhd packets seen by any card keep all the
+        // cards listening a bit longer, rather than missing the air unit.
+        if (dwell.update(std::chrono::steady_clock::now(),
+                         get_scan_n_openhd_packets(n_valid_packets()),
+                         false) != openhd::wb::ScanDwell::Result::LISTEN) {
+          break;
+        }
+      }
+      if (found) break;
+      if (n_valid_packets() > 0) {
+        m_console->debug("{} got {} packets on {}Mhz, but no management",
+                         card.device_name, n_valid_packets(),
+                         channel->frequency);
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  for (int i = 0; i < m_broadcast_cards.size(); i++) {
+    workers.emplace_back(worker, i);
+  }
+  for (auto& thread : workers) {
+    thread.join();
+  }
+  ChannelScanResult result{};
+  if (found) {
+    m_console->debug("Found air unit");
+    result.success = true;
+    result.frequency = m_management_gnd->m_air_reported_curr_frequency;
+    result.channel_width = m_management_gnd->m_air_reported_curr_channel_width;
+  }
+  return result;
 }
 
 void WBLink::perform_channel_analyze(int channels_to_scan) {
@@ -1429,6 +1965,7 @@ void WBLink::perform_channel_analyze(int channels_to_scan) {
   const WiFiCard& card = m_broadcast_cards.at(0);
   const auto channels_to_analyze =
       openhd::wb::get_analyze_channels_frequencies(card, channels_to_scan);
+  m_gnd_operating_mode = 2;
   auto stats_current = openhd::LinkActionHandler::instance().get_link_stats();
   stats_current.gnd_operating_mode.operating_mode = 2;
   openhd::LinkActionHandler::instance().update_link_stats(stats_current);
@@ -1452,6 +1989,10 @@ void WBLink::perform_channel_analyze(int channels_to_scan) {
     const auto n_foreign_packets = stats.count_p_any - stats.count_p_valid;
     m_console->debug("Got {} foreign packets {}:{}", n_foreign_packets,
                      stats.count_p_any, stats.count_p_valid);
+    m_scan_channel_history.on_channel_analyzed(
+        channel.frequency, stats.count_p_any, stats.count_p_valid);
+    m_interference_map.add_sample(channel.frequency,
+                                  (int)(n_foreign_packets / 4));
     results.push_back(
         AnalyzeResult{(int)channel.frequency, (int)n_foreign_packets});
 
@@ -1480,12 +2021,16 @@ void WBLink::perform_channel_analyze(int channels_to_scan) {
       MyTimeHelper::R(std::chrono::steady_clock::now() - analyze_begin));
   // Go back to the previous frequency
   apply_frequency_and_channel_width_from_settings();
+  m_gnd_operating_mode = 0;
 }
 
 void WBLink::wt_perform_mcs_via_rc_channel_if_enabled() {
   if (!m_profile.is_air) {
     return;
   }
+  // Changes the wb settings, which a work item might do at the same time
+  std::unique_lock<std::mutex> lock(m_card_config_mutex, std::try_to_lock);
+  if (!lock.owns_lock()) return;
   const auto& settings = m_settings->get_settings();
   if (settings.wb_mcs_index_via_rc_channel <=
       openhd::WB_MCS_INDEX_VIA_RC_CHANNEL_OFF) {
@@ -1536,6 +2081,9 @@ void WBLink::update_arming_state(bool armed) {
 }
 
 void WBLink::wt_gnd_perform_channel_management() {
+  // A channel scan / analyze changes the frequency itself
+  std::unique_lock<std::mutex> lock(m_card_config_mutex, std::try_to_lock);
+  if (!lock.owns_lock()) return;
   if (m_profile.is_ground()) {
     // Ground: Listen on the channel width the air reports (always works due to
     // management always on 20Mhz) And switch "up" to 40Mhz if needed
@@ -1559,6 +2107,7 @@ void WBLink::wt_gnd_perform_channel_management() {
         m_gnd_curr_rx_channel_width = air_reported_channel_width;
         m_settings->unsafe_get_settings().wb_frequency = air_reported_frequency;
         m_settings->persist(false);
+        m_scan_channel_history.on_air_found(air_reported_frequency);
         apply_frequency_and_channel_width(air_reported_frequency,
                                           air_reported_channel_width, 20);
       }
@@ -1566,6 +2115,163 @@ void WBLink::wt_gnd_perform_channel_management() {
   }
 }
 
+void WBLink::wt_gnd_perform_background_analysis() {
+  auto& bg = m_bg_analysis;
+  // A channel scan / analyze uses all the cards
+  std::unique_lock<std::mutex> lock(m_card_config_mutex, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    bg.dwelling = false;
+    bg.spare_frequency = 0;
+    return;
+  }
+  const auto now = std::chrono::steady_clock::now();
+  // Not switched (auto switch tx card is disabled), therefore stays on the
+  // link frequency
+  const int link_card_index = m_wb_txrx->get_curr_active_tx_card_idx();
+  if (bg.spare_card_index < 0) {
+    bg.spare_card_index = select_background_analysis_spare_card();
+    m_console->info("Background analyze using card {} ({})",
+                    bg.spare_card_index,
+                    m_broadcast_cards.at(bg.spare_card_index).device_name);
+  }
+  const int spare_card_index = bg.spare_card_index;
+  // All cards have been re-tuned (and their stats reset) in the meantime
+  if (bg.dwelling && bg.n_frequency_changes != m_n_frequency_changes) {
+    bg.dwelling = false;
+    bg.spare_frequency = 0;
+  }
+  if (bg.dwelling && now - bg.dwell_begin >= BACKGROUND_ANALYSIS_DWELL) {
+    bg.dwelling = false;
+    const int elapsed_ms =
+        (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+            now - bg.dwell_begin)
+            .count();
+    auto foreign_pps = [elapsed_ms](uint64_t any_begin, uint64_t valid_begin,
+                                    const auto& card_stats) {
+      const int64_t n_any = (int64_t)card_stats.count_p_any - any_begin;
+      const int64_t n_valid = (int64_t)card_stats.count_p_valid - valid_begin;
+      if (n_any < 0 || n_valid < 0) return -1;
+      const int64_t n_foreign = std::max<int64_t>(n_any - n_valid, 0);
+      return (int)(n_foreign * 1000 / elapsed_ms);
+    };
+    const uint32_t link_frequency = m_gnd_curr_rx_frequency;
+    const int link_pps =
+        foreign_pps(bg.link_count_p_any, bg.link_count_p_valid,
+                    m_wb_txrx->get_rx_stats_for_card(link_card_index));
+    if (link_pps >= 0) {
+      m_interference_map.add_sample(link_frequency, link_pps);
+    }
+    if (bg.spare_frequency != 0) {
+      const auto spare_stats =
+          m_wb_txrx->get_rx_stats_for_card(spare_card_index);
+      const int spare_pps = foreign_pps(
+          bg.spare_count_p_any, bg.spare_count_p_valid, spare_stats);
+      if (spare_pps >= 0) {
+        m_interference_map.add_sample(bg.spare_frequency, spare_pps);
+        m_scan_channel_history.on_channel_analyzed(
+            bg.spare_frequency,
+            (int64_t)spare_stats.count_p_any - bg.spare_count_p_any,
+            (int64_t)spare_stats.count_p_valid - bg.spare_count_p_valid);
+      }
+      m_console->debug("Background analyze {}Mhz:{} foreign pps",
+                       bg.spare_frequency, spare_pps);
+    }
+  }
+  const uint32_t link_frequency = m_gnd_curr_rx_frequency;
+  const auto& spare_card = m_broadcast_cards.at(spare_card_index);
+  if (!m_settings->get_settings().wb_gnd_background_analyze) {
+    // Disabled - give the card back to the link and stop until re-enabled
+    if (bg.spare_frequency != 0) {
+      openhd::wb::set_frequency_and_channel_width_for_all_cards(
+          link_frequency, m_gnd_curr_rx_channel_width, {spare_card});
+    }
+    bg = BackgroundAnalysis{};
+    m_interference_map.persist_if_changed();
+    m_scheduler->set_task_period("background_analysis",
+                                 std::chrono::milliseconds(0));
+    return;
+  }
+  if (!bg.dwelling) {
+    const auto channels =
+        openhd::wb::get_analyze_channels_frequencies(spare_card, 2);
+    if (bg.next_channel_index >= channels.size()) {
+      bg.next_channel_index = 0;
+      wt_gnd_recommend_frequency(channels);
+    }
+    uint32_t frequency = 0;
+    if (!channels.empty()) {
+      frequency = channels.at(bg.next_channel_index++).frequency;
+    }
+    if (frequency == link_frequency) {
+      // Sampled by the link card anyways
+      frequency = 0;
+    }
+    if (frequency != 0 &&
+        openhd::wb::set_frequency_and_channel_width_for_all_cards(
+            frequency, 40, {spare_card})) {
+      bg.spare_frequency = frequency;
+    } else if (bg.spare_frequency != 0) {
+      openhd::wb::set_frequency_and_channel_width_for_all_cards(
+          link_frequency, m_gnd_curr_rx_channel_width, {spare_card});
+      bg.spare_frequency = 0;
+    }
+    const auto link_stats = m_wb_txrx->get_rx_stats_for_card(link_card_index);
+    bg.link_count_p_any = link_stats.count_p_any;
+    bg.link_count_p_valid = link_stats.count_p_valid;
+    const auto spare_stats = m_wb_txrx->get_rx_stats_for_card(spare_card_index);
+    bg.spare_count_p_any = spare_stats.count_p_any;
+    bg.spare_count_p_valid = spare_stats.count_p_valid;
+    bg.n_frequency_changes = m_n_frequency_changes;
+    bg.dwell_begin = std::chrono::steady_clock::now();
+    bg.dwelling = true;
+  }
+  if (now - bg.last_persist >= INTERFERENCE_MAP_PERSIST_INTERVAL) {
+    bg.last_persist = now;
+    m_interference_map.persist_if_changed();
+  }
+}
+
+int WBLink::select_background_analysis_spare_card() {
+  // Never the card we transmit with, out of the others the last one (on a
+  // ground station with mixed cards, the first card is usually the "good" one)
+  const int tx_card_index = m_wb_txrx->get_curr_active_tx_card_idx();
+  for (int i = (int)m_broadcast_cards.size() - 1; i >= 0; i--) {
+    if (i != tx_card_index) return i;
+  }
+  return 0;
+}
+
+void WBLink::wt_gnd_recommend_frequency(
+    const std::vector<openhd::WifiChannel>& channels) {
+  auto& bg = m_bg_analysis;
+  const uint32_t link_frequency = m_gnd_curr_rx_frequency;
+  const auto cleanest = m_interference_map.get_cleanest_frequency(channels);
+  const auto link_pps =
+      m_interference_map.get_foreign_packets_per_second(link_frequency);
+  uint32_t recommended_frequency = 0;
+  if (cleanest.has_value() && link_pps.has_value() &&
+      cleanest.value() != link_frequency) {
+    const int cleanest_pps =
+        m_interference_map.get_foreign_packets_per_second(cleanest.value())
+            .value_or(0);
+    if (link_pps.value() > 2 * cleanest_pps + 50) {
+      recommended_frequency = cleanest.value();
+      m_console->debug("Interference on {}Mhz:{} pps, {}Mhz:{} pps",
+                       link_frequency, link_pps.value(), cleanest.value(),
+                       cleanest_pps);
+    }
+  }
+  if (recommended_frequency != 0 &&
+      recommended_frequency != bg.last_recommended_frequency) {
+    // The air unit decides the frequency, we can only tell the user (once
+    // per recommendation, not every round)
+    openhd::log::log_via_mavlink(
+        (int)openhd::log::STATUS_LEVEL::INFO,
+        fmt::format("Less interference on {}Mhz", recommended_frequency));
+  }
+  bg.last_recommended_frequency = recommended_frequency;
+}
+
 void WBLink::re_enable_injection_unless_user_passive_mode_enabled() {
   bool enable_passive_mode = false;
   if (m_profile.is_ground() &&
@@ -0,0 +1,124 @@
+#include "wb_link_drop_stats.h"
+
+#include <cstdio>
+#include <sstream>
+
+namespace openhd::wb {
+
+VideoDropStats::VideoDropStats(const int n_streams) {
+  for (int i = 0; i < n_streams; i++) {
+    m_streams.push_back(std::make_unique<Stream>());
+  }
+}
+
+void VideoDropStats::add_dropped(const int stream_index,
+                                 const VideoDropReason reason,
+                                 const int n_dropped_frames) {
+  if (m_streams.empty() || n_dropped_frames <= 0) return;
+  if (stream_index < 0 || stream_index >= (int)m_streams.size()) {
+    m_n_dropped_invalid_stream.fetch_add(n_dropped_frames,
+                                         std::memory_order_relaxed);
+    return;
+  }
+  m_streams[stream_index]->n_dropped[(int)reason].fetch_add(
+      n_dropped_frames, std::memory_order_relaxed);
+}
+
+void VideoDropStats::add_queue_residency(
+    const int stream_index, const bool is_keyframe,
+    const std::chrono::nanoseconds residency) {
+  if (stream_index < 0 || stream_index >= (int)m_streams.size()) return;
+  auto& stream = *m_streams[stream_index];
+  if (is_keyframe) {
+    stream.residency_keyframe.add(residency);
+  } else {
+    stream.residency_other.add(residency);
+  }
+}
+
+std::vector<openhd::link_statistics::StatsWbVideoAirDrops>
+VideoDropStats::get_and_reset() {
+  std::vector<openhd::link_statistics::StatsWbVideoAirDrops> ret;
+  for (size_t i = 0; i < m_streams.size(); i++) {
+    auto& stream = *m_streams[i];
+    openhd::link_statistics::StatsWbVideoAirDrops tmp{};
+    tmp.link_index = (uint8_t)i;
+    for (size_t j = 0; j < tmp.n_dropped_total.size(); j++) {
+      tmp.n_dropped_total[j] =
+          stream.n_dropped[j].load(std::memory_order_relaxed);
+    }
+    tmp.queue_residency_keyframe = stream.residency_keyframe.get_and_reset();
+    tmp.queue_residency_other = stream.residency_other.get_and_reset();
+    ret.push_back(tmp);
+  }
+  return ret;
+}
+
+static void write_residency(std::stringstream& ss, int stream_index,
+                            const char* frame_type,
+                            const openhd::LatencyHistogram::Summary& summary) {
+  auto write = [&](const char* stat, uint32_t value) {
+    ss << "openhd_video_queue_residency_us{stream=\"" << stream_index
+       << "\",frame_type=\"" << frame_type << "\",stat=\"" << stat << "\"} "
+       << value << "\n";
+  };
+  write("min", summary.min_us);
+  write("avg", summary.avg_us);
+  write("p99", summary.p99_us);
+  write("max", summary.max_us);
+}
+
+std::string VideoDropStats::to_metrics_text(
+    const std::vector<openhd::link_statistics::StatsWbVideoAirDrops>& stats,
+    const uint32_t n_dropped_invalid_stream) {
+  std::stringstream ss;
+  ss << "# TYPE openhd_video_dropped_frames_total counter\n";
+  for (const auto& stream : stats) {
+    for (int j = 0; j < openhd::link_statistics::N_VIDEO_DROP_REASONS; j++) {
+      if ((VideoDropReason)j == VideoDropReason::INVALID_STREAM_INDEX) {
+        continue;
+      }
+      ss << "openhd_video_dropped_frames_total{stream=\""
+         << (int)stream.link_index << "\",reason=\""
+         << openhd::link_statistics::video_drop_reason_to_string(
+                (VideoDropReason)j)
+         << "\"} " << stream.n_dropped_total[j] << "\n";
+    }
+  }
+  ss << "openhd_video_dropped_frames_total{stream=\"invalid\",reason=\""
+     << openhd::link_statistics::video_drop_reason_to_string(
+            VideoDropReason::INVALID_STREAM_INDEX)
+     << "\"} " << n_dropped_invalid_stream << "\n";
+  // Since the last update
+  ss << "# TYPE openhd_video_queue_frames gauge\n";
+  for (const auto& stream : stats) {
+    ss << "openhd_video_queue_frames{stream=\"" << (int)stream.link_index
+       << "\",frame_type=\"key\"} " << stream.queue_residency_keyframe.count
+       << "\n";
+    ss << "openhd_video_queue_frames{stream=\"" << (int)stream.link_index
+       << "\",frame_type=\"other\"} " << stream.queue_residency_other.count
+       << "\n";
+  }
+  ss << "# TYPE openhd_video_queue_residency_us gauge\n";
+  for (const auto& stream : stats) {
+    write_residency(ss, stream.link_index, "key",
+                    stream.queue_residency_keyframe);
+    write_residency(ss, stream.link_index, "other",
+                    stream.queue_residency_other);
+  }
+  return ss.str();
+}
+
+bool VideoDropStats::write_metrics_textfile(const std::string& filename,
+                                            const std::string& text) {
+  // node_exporter only reads *.prom files
+  const std::string tmp_filename = filename + ".tmp";
+  FILE* file = fopen(tmp_filename.c_str(), "w");
+  if (file == nullptr) return false;
+  const bool written =
+      fwrite(text.data(), 1, text.size(), file) == text.size();
+  if (fclose(file) != 0 || !written) return false;
+  return rename(tmp_filename.c_str(), filename.c_str()) == 0;
+}
+
+}  // namespace openhd::wb
@@ -0,0 +1,68 @@
+#include "wb_link_frame_coalescer.h"
+
+#include <utility>
+
+namespace openhd::wb {
+
+std::vector<FrameCoalescer::Block> FrameCoalescer::add(
+    Frame frame, const std::chrono::milliseconds latency_budget,
+    const int max_fragments_per_block) {
+  std::vector<Block> ret;
+  if (m_pending.n_frames > 0 &&
+      (m_pending.enable_encryption != frame.enable_encryption ||
+       (int)(m_pending.fragments.size() + frame.fragments.size()) >
+           max_fragments_per_block)) {
+    ret.push_back(flush().value());
+  }
+  // Only frames that leave room for at least one more frame are held back
+  const bool small = (int)frame.fragments.size() * 2 <= max_fragments_per_block;
+  const auto arrival = frame.arrival;
+  append(frame);
+  if (frame.is_keyframe || !small || latency_budget.count() <= 0 ||
+      (int)m_pending.fragments.size() >= max_fragments_per_block ||
+      arrival - m_pending.arrival >= latency_budget) {
+    ret.push_back(flush().value());
+  }
+  return ret;
+}
+
+std::optional<FrameCoalescer::Block> FrameCoalescer::flush_if_due(
+    const std::chrono::steady_clock::time_point now,
+    const std::chrono::milliseconds latency_budget) {
+  if (m_pending.n_frames == 0) return std::nullopt;
+  if (now - m_pending.arrival < latency_budget) return std::nullopt;
+  return flush();
+}
+
+std::optional<FrameCoalescer::Block> FrameCoalescer::flush() {
+  if (m_pending.n_frames == 0) return std::nullopt;
+  Block ret = std::move(m_pending);
+  m_pending = Block{};
+  return ret;
+}
+
+FrameCoalescer::Block FrameCoalescer::to_block(Frame frame) {
+  Block ret{};
+  ret.fragments = std::move(frame.fragments);
+  ret.is_keyframe = frame.is_keyframe;
+  ret.enable_encryption = frame.enable_encryption;
+  ret.n_frames = 1;
+  ret.creation_time = frame.creation_time;
+  ret.arrival = frame.arrival;
+  return ret;
+}
+
+void FrameCoalescer::append(Frame& frame) {
+  if (m_pending.n_frames == 0) {
+    m_pending.enable_encryption = frame.enable_encryption;
+    m_pending.creation_time = frame.creation_time;
+    m_pending.arrival = frame.arrival;
+  }
+  m_pending.is_keyframe |= frame.is_keyframe;
+  m_pending.n_frames++;
+  m_pending.fragments.insert(m_pending.fragments.end(),
+                             std::make_move_iterator(frame.fragments.begin()),
+                             std::make_move_iterator(frame.fragments.end()));
+}
+
+}  // namespace openhd::wb
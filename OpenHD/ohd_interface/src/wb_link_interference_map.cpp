@@ -0,0 +1,112 @@
+#include "wb_link_interference_map.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <utility>
+
+#include "openhd_util_filesystem.h"
+
+static int64_t get_epoch_s() {
+  return std::chrono::duration_cast<std::chrono::seconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+namespace openhd::wb {
+
+InterferenceMap::InterferenceMap(std::string filename)
+    : m_filename(std::move(filename)) {
+  load();
+}
+
+void InterferenceMap::add_sample(const uint32_t frequency,
+                                 const int foreign_packets_per_second) {
+  if (foreign_packets_per_second < 0) return;
+  std::lock_guard<std::mutex> guard(m_mutex);
+  const int64_t now = get_epoch_s();
+  auto it = m_entries.find(frequency);
+  if (it == m_entries.end() ||
+      get_confidence(it->second, now) < MIN_CONFIDENCE) {
+    m_entries[frequency] = Entry{(double)foreign_packets_per_second, now};
+  } else {
+    // Trust the old value less the older it is
+    const double alpha =
+        1.0 - (1.0 - SMOOTHING_ALPHA) * get_confidence(it->second, now);
+    auto& entry = it->second;
+    entry.foreign_packets_per_second =
+        entry.foreign_packets_per_second * (1.0 - alpha) +
+        foreign_packets_per_second * alpha;
+    entry.last_sample_epoch_s = now;
+  }
+  m_changed = true;
+}
+
+std::optional<int> InterferenceMap::get_foreign_packets_per_second(
+    const uint32_t frequency) const {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  const auto it = m_entries.find(frequency);
+  if (it == m_entries.end() ||
+      get_confidence(it->second, get_epoch_s()) < MIN_CONFIDENCE) {
+    return std::nullopt;
+  }
+  return (int)std::lround(it->second.foreign_packets_per_second);
+}
+
+std::optional<uint32_t> InterferenceMap::get_cleanest_frequency(
+    const std::vector<openhd::WifiChannel>& channels) const {
+  std::optional<uint32_t> ret;
+  int ret_pps = 0;
+  for (const auto& channel : channels) {
+    const auto pps = get_foreign_packets_per_second(channel.frequency);
+    if (!pps.has_value()) continue;
+    if (!ret.has_value() || pps.value() < ret_pps) {
+      ret = channel.frequency;
+      ret_pps = pps.value();
+    }
+  }
+  return ret;
+}
+
+void InterferenceMap::persist_if_changed() {
+  std::stringstream ss;
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (!m_changed) return;
+    m_changed = false;
+    const int64_t now = get_epoch_s();
+    for (const auto& [frequency, entry] : m_entries) {
+      if (get_confidence(entry, now) < MIN_CONFIDENCE) continue;
+      ss << frequency << " " << std::lround(entry.foreign_packets_per_second)
+         << " " << entry.last_sample_epoch_s << "\n";
+    }
+  }
+  OHDFilesystemUtil::write_file(m_filename, ss.str());
+}
+
+double InterferenceMap::get_confidence(const Entry& entry,
+                                       const int64_t now_epoch_s) {
+  // The clock might have been adjusted (e.g. no RTC) - treat as fresh
+  const int64_t age_s =
+      std::max<int64_t>(now_epoch_s - entry.last_sample_epoch_s, 0);
+  return std::pow(0.5, (double)age_s / HALF_LIFE_S);
+}
+
+void InterferenceMap::load() {
+  const auto content = OHDFilesystemUtil::opt_read_file(m_filename, false);
+  if (!content.has_value()) return;
+  std::istringstream iss(content.value());
+  uint32_t frequency;
+  int64_t foreign_packets_per_second;
+  int64_t last_sample_epoch_s;
+  // <frequency> <foreign packets per second> <last sample, epoch s>
+  while (iss >> frequency >> foreign_packets_per_second >>
+         last_sample_epoch_s) {
+    if (foreign_packets_per_second < 0) continue;
+    m_entries[frequency] =
+        Entry{(double)foreign_packets_per_second, last_sample_epoch_s};
+  }
+}
+
+}  // namespace openhd::wb
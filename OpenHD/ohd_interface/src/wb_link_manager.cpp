@@ -18,9 +18,13 @@ struct DataManagementTxBandwidth {
   uint32_t center_frequency_mhz;
   uint8_t bandwidth_mhz;
 } __attribute__((packed));
+// Sent by the ground, allows the air to react to (video) loss it cannot see
+// itself. Older releases sent 0,0 - which reads as no loss.
 struct DataManagementSensitivityStatus {
-  uint16_t dummy_0;
-  uint16_t dummy_1;
+  // unrecoverable FEC blocks, in percent
+  uint16_t video_block_loss_perc;
+  // packet loss before FEC, in percent
+  uint16_t packet_loss_perc;
 } __attribute__((packed));
 static std::vector<uint8_t> pack_management_frame(
     const DataManagementTxBandwidth &data) {
@@ -124,7 +128,8 @@ void ManagementAir::on_new_management_packet(const uint8_t *data,
         openhd::util::steady_clock_time_epoch_ms();
     DataManagementSensitivityStatus packet{};
     std::memcpy(&packet, &data[1], data_len - 1);
-    // TODO
+    m_gnd_reported_video_block_loss_perc = packet.video_block_loss_perc;
+    m_gnd_reported_packet_loss_perc = packet.packet_loss_perc;
   }
 }
 
@@ -169,7 +174,9 @@ void ManagementGround::on_new_management_packet(const uint8_t *data,
 
 void ManagementGround::loop() {
   while (m_tx_thread_run) {
-    auto tmp = DataManagementSensitivityStatus{0, 0};
+    auto tmp = DataManagementSensitivityStatus{
+        (uint16_t)m_curr_video_block_loss_perc.load(),
+        (uint16_t)m_curr_packet_loss_perc.load()};
     auto data = pack_management_frame(tmp);
     auto radiotap_header = m_tx_header->thread_safe_get();
     m_wb_txrx->tx_inject_packet(openhd::MANAGEMENT_RADIO_PORT_GND_TX,
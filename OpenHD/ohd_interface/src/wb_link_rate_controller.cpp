@@ -0,0 +1,107 @@
+#include "wb_link_rate_controller.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace openhd::wb {
+
+void VideoBitrateController::reset(
+    const int max_video_rate_kbits, const int floor_kbits,
+    const int headroom_perc, const int fec_perc,
+    const std::chrono::steady_clock::time_point now) {
+  m_floor_kbits = floor_kbits;
+  m_ceiling_kbits = std::max(
+      max_video_rate_kbits * (100 - headroom_perc) / 100, m_floor_kbits);
+  m_fec_perc = fec_perc;
+  // Start optimistic, if the link cannot do it we back off fast enough
+  m_bitrate_kbits = m_ceiling_kbits;
+  m_n_decreases = 0;
+  m_queue_fill_smoothed_perc = 0;
+  m_n_updates_with_tx_errors = 0;
+  m_last_change = now;
+  m_last_congestion = now;
+  m_last_link_state = LinkState::CLEAN;
+}
+
+int VideoBitrateController::update(
+    const Input& input, const std::chrono::steady_clock::time_point now) {
+  m_queue_fill_smoothed_perc =
+      (m_queue_fill_smoothed_perc * 3 + input.tx_queue_fill_perc) / 4;
+  m_n_updates_with_tx_errors =
+      input.n_tx_errors > 0 ? m_n_updates_with_tx_errors + 1 : 0;
+  if (now - m_last_change < SETTLE_TIME) {
+    // The encoder is still adjusting
+    return m_bitrate_kbits;
+  }
+  m_last_link_state = classify(input);
+  switch (m_last_link_state) {
+    case LinkState::CONGESTED: {
+      m_last_congestion = now;
+      const int reduced = std::max(m_bitrate_kbits * DECREASE_PERC / 100,
+                                   m_floor_kbits);
+      if (reduced != m_bitrate_kbits) {
+        m_bitrate_kbits = reduced;
+        m_n_decreases++;
+        m_last_change = now;
+      }
+      break;
+    }
+    case LinkState::LOADED:
+      // Close to the limit, hold the current bitrate
+      m_last_congestion = now;
+      break;
+    case LinkState::CLEAN:
+      if (m_bitrate_kbits < m_ceiling_kbits &&
+          now - m_last_congestion >= STABLE_TIME_BEFORE_INCREASE &&
+          now - m_last_change >= STABLE_TIME_BEFORE_INCREASE) {
+        const int step =
+            std::max(m_ceiling_kbits * INCREASE_PERC_OF_CEILING / 100,
+                     MIN_INCREASE_KBITS);
+        m_bitrate_kbits = std::min(m_bitrate_kbits + step, m_ceiling_kbits);
+        m_last_change = now;
+      }
+      break;
+  }
+  return m_bitrate_kbits;
+}
+
+VideoBitrateController::LinkState VideoBitrateController::classify(
+    const Input& input) {
+  if (input.n_dropped_frames > 0 ||
+      m_queue_fill_smoothed_perc >= QUEUE_FILL_CONGESTED_PERC) {
+    return LinkState::CONGESTED;
+  }
+  if (input.n_tx_errors >= TX_ERRORS_CONGESTED_BURST ||
+      m_n_updates_with_tx_errors >= TX_ERRORS_CONGESTED_N_UPDATES) {
+    return LinkState::CONGESTED;
+  }
+  // Blocks the ground could not recover (FEC)
+  if (input.gnd_video_block_loss_perc > 0) {
+    return LinkState::CONGESTED;
+  }
+  // Still recoverable, but not much margin left
+  if (m_queue_fill_smoothed_perc >= QUEUE_FILL_LOADED_PERC ||
+      input.gnd_packet_loss_perc > m_fec_perc / 2 || input.n_tx_errors > 0) {
+    return LinkState::LOADED;
+  }
+  return LinkState::CLEAN;
+}
+
+bool EncoderBitrateFilter::should_recommend(
+    const int bitrate_kbits, const std::chrono::steady_clock::time_point now) {
+  if (m_last_bitrate_kbits != 0) {
+    const auto elapsed = now - m_last_recommendation;
+    if (elapsed < MIN_INTERVAL) return false;
+    const int hysteresis_kbits = std::max(
+        m_last_bitrate_kbits * HYSTERESIS_PERC / 100, MIN_HYSTERESIS_KBITS);
+    if (std::abs(bitrate_kbits - m_last_bitrate_kbits) < hysteresis_kbits &&
+        elapsed < REFRESH_INTERVAL) {
+      return false;
+    }
+  }
+  m_last_bitrate_kbits = bitrate_kbits;
+  m_last_recommendation = now;
+  return true;
+}
+
+}  // namespace openhd::wb
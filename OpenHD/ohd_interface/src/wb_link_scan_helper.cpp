@@ -0,0 +1,105 @@
+#include "wb_link_scan_helper.h"
+
+#include <algorithm>
+#include <sstream>
+#include <utility>
+
+#include "openhd_util_filesystem.h"
+
+namespace openhd::wb {
+
+ScanDwell::Result ScanDwell::update(
+    const std::chrono::steady_clock::time_point now,
+    const int64_t n_openhd_packets, const bool has_management) const {
+  if (has_management) return Result::FOUND;
+  const auto elapsed = now - m_begin;
+  if (n_openhd_packets <= 0 && elapsed >= ABSENT_AFTER) {
+    return Result::NOT_FOUND;
+  }
+  if (elapsed >= MAX_DWELL) {
+    // Something that looks like openhd, but no management frame (e.g. a
+    // different bind phrase)
+    return Result::NOT_FOUND;
+  }
+  return Result::LISTEN;
+}
+
+ScanChannelHistory::ScanChannelHistory(std::string filename)
+    : m_filename(std::move(filename)) {
+  load();
+}
+
+void ScanChannelHistory::on_air_found(const uint32_t frequency) {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  if (!m_found_frequencies.empty() && m_found_frequencies[0] == frequency) {
+    return;
+  }
+  m_found_frequencies.erase(std::remove(m_found_frequencies.begin(),
+                                        m_found_frequencies.end(), frequency),
+                            m_found_frequencies.end());
+  m_found_frequencies.insert(m_found_frequencies.begin(), frequency);
+  if (m_found_frequencies.size() > MAX_N_FOUND_FREQUENCIES) {
+    m_found_frequencies.resize(MAX_N_FOUND_FREQUENCIES);
+  }
+  persist();
+}
+
+void ScanChannelHistory::on_channel_analyzed(const uint32_t frequency,
+                                             const int64_t n_packets_any,
+                                             const int64_t n_packets_valid) {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  m_analyze_results[frequency] = AnalyzeResult{
+      n_packets_any > 0, n_packets_valid > 0, std::chrono::steady_clock::now()};
+}
+
+std::vector<openhd::WifiChannel> ScanChannelHistory::order_by_likelihood(
+    const std::vector<openhd::WifiChannel>& channels) const {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  const auto now = std::chrono::steady_clock::now();
+  // Lower is more likely
+  auto rank = [&](const openhd::WifiChannel& channel) {
+    const auto found = std::find(m_found_frequencies.begin(),
+                                 m_found_frequencies.end(), channel.frequency);
+    if (found != m_found_frequencies.end()) {
+      return (int)(found - m_found_frequencies.begin());
+    }
+    const auto analyzed = m_analyze_results.find(channel.frequency);
+    if (analyzed == m_analyze_results.end() ||
+        now - analyzed->second.timestamp > ANALYZE_RESULT_MAX_AGE) {
+      return MAX_N_FOUND_FREQUENCIES + 1;
+    }
+    if (analyzed->second.openhd_packets) return MAX_N_FOUND_FREQUENCIES;
+    // Nothing at all on this channel - we still scan it (the air unit might
+    // have been switched on since), but last
+    if (!analyzed->second.any_packets) return MAX_N_FOUND_FREQUENCIES + 2;
+    return MAX_N_FOUND_FREQUENCIES + 1;
+  };
+  auto ret = channels;
+  std::stable_sort(ret.begin(), ret.end(),
+                   [&](const openhd::WifiChannel& lhs,
+                       const openhd::WifiChannel& rhs) {
+                     return rank(lhs) < rank(rhs);
+                   });
+  return ret;
+}
+
+void ScanChannelHistory::load() {
+  const auto content = OHDFilesystemUtil::opt_read_file(m_filename, false);
+  if (!content.has_value()) return;
+  std::istringstream iss(content.value());
+  uint32_t frequency;
+  while (iss >> frequency) {
+    if (m_found_frequencies.size() >= MAX_N_FOUND_FREQUENCIES) break;
+    m_found_frequencies.push_back(frequency);
+  }
+}
+
+void ScanChannelHistory::persist() {
+  std::stringstream ss;
+  for (const auto frequency : m_found_frequencies) {
+    ss << frequency << "\n";
+  }
+  OHDFilesystemUtil::write_file(m_filename, ss.str());
+}
+
+}  // namespace openhd::wb
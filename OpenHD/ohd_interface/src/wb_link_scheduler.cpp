@@ -0,0 +1,105 @@
+#include "wb_link_scheduler.h"
+
+#include <cassert>
+#include <utility>
+
+#include "openhd_spdlog_include.h"
+
+namespace openhd::wb {
+
+TaskScheduler::TaskScheduler(std::string tag) {
+  m_console = openhd::log::create_or_get(tag);
+}
+
+TaskScheduler::~TaskScheduler() { stop(); }
+
+void TaskScheduler::add_periodic_task(std::string name,
+                                      std::chrono::milliseconds period,
+                                      std::function<void()> task) {
+  assert(m_thread == nullptr);
+  assert(period.count() >= 0);
+  m_tasks.push_back(Task{std::move(name), period, std::move(task), {}});
+}
+
+void TaskScheduler::start() {
+  assert(m_thread == nullptr);
+  const auto now = std::chrono::steady_clock::now();
+  for (auto& task : m_tasks) {
+    task.next_run = now + task.period;
+  }
+  m_run = true;
+  m_thread = std::make_unique<std::thread>(&TaskScheduler::loop, this);
+}
+
+void TaskScheduler::stop() {
+  if (m_thread == nullptr) return;
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_run = false;
+  }
+  m_cv.notify_one();
+  m_thread->join();
+  m_thread = nullptr;
+}
+
+void TaskScheduler::set_task_period(const std::string& name,
+                                    const std::chrono::milliseconds period) {
+  assert(period.count() >= 0);
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for (auto& task : m_tasks) {
+      if (task.name != name) continue;
+      task.period = period;
+      task.next_run = std::chrono::steady_clock::now() + period;
+    }
+    m_schedule_changed = true;
+  }
+  m_cv.notify_one();
+}
+
+size_t TaskScheduler::next_due_task() const {
+  size_t ret = NONE;
+  for (size_t i = 0; i < m_tasks.size(); i++) {
+    if (m_tasks[i].period.count() == 0) continue;
+    if (ret == NONE || m_tasks[i].next_run < m_tasks[ret].next_run) ret = i;
+  }
+  return ret;
+}
+
+void TaskScheduler::loop() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  const auto wake_up = [this] { return !m_run || m_schedule_changed; };
+  while (m_run) {
+    m_schedule_changed = false;
+    const size_t index = next_due_task();
+    if (index == NONE) {
+      m_cv.wait(lock, wake_up);
+      continue;
+    }
+    if (m_cv.wait_until(lock, m_tasks[index].next_run, wake_up)) continue;
+    // The task itself (the function) is never modified after start(), only
+    // its period - run it without holding the lock
+    auto& task = m_tasks[index];
+    const auto period = task.period;
+    lock.unlock();
+    const auto begin = std::chrono::steady_clock::now();
+    task.task();
+    const auto end = std::chrono::steady_clock::now();
+    lock.lock();
+    if (end - begin > period) {
+      m_console->debug("Task {} took {}ms", task.name,
+                       std::chrono::duration_cast<std::chrono::milliseconds>(
+                           end - begin)
+                           .count());
+    }
+    // Re-scheduled while running
+    if (task.period != period) continue;
+    task.next_run += period;
+    if (task.next_run <= end) {
+      // Skip the missed run(s)
+      task.next_run = end + period;
+    }
+  }
+}
+
+}  // namespace openhd::wb
@@ -7,15 +7,19 @@
 
 namespace openhd {
 
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(
+// Settings files written by an older version lack the newer keys, those get
+// the default value instead of failing to parse (which resets everything).
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
     WBLinkSettings, wb_frequency, wb_air_tx_channel_width, wb_air_mcs_index,
     wb_enable_stbc, wb_enable_ldpc, wb_enable_short_guard,
     wb_tx_power_milli_watt, wb_tx_power_milli_watt_armed,
     wb_rtl8812au_tx_pwr_idx_override, wb_rtl8812au_tx_pwr_idx_override_armed,
     wb_video_fec_percentage, wb_video_rate_for_mcs_adjustment_percent,
     wb_max_fec_block_size, wb_mcs_index_via_rc_channel, wb_bw_via_rc_channel,
-    enable_wb_video_variable_bitrate, wb_enable_listen_only_mode,
-    wb_dev_air_set_high_retransmit_count);
+    enable_wb_video_variable_bitrate, wb_video_rate_floor_kbits,
+    wb_video_rate_headroom_perc, wb_video_secondary_coalesce_ms,
+    wb_enable_listen_only_mode,
+    wb_gnd_background_analyze, wb_dev_air_set_high_retransmit_count);
 
 std::optional<WBLinkSettings> openhd::WBLinkSettingsHolder::impl_deserialize(
     const std::string &file_as_string) const {
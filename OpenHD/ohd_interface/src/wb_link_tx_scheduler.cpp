@@ -0,0 +1,192 @@
+#include "wb_link_tx_scheduler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+#include "openhd_spdlog_include.h"
+
+namespace openhd::wb {
+
+TxPriorityScheduler::TxPriorityScheduler(std::string tag,
+                                         const int n_video_streams,
+                                         VIDEO_DROPPED_CB video_dropped_cb)
+    : m_video_dropped_cb(std::move(video_dropped_cb)) {
+  m_console = openhd::log::create_or_get(tag);
+  for (int i = 0; i < n_video_streams; i++) {
+    m_video.push_back(std::make_unique<VideoStream>());
+  }
+}
+
+TxPriorityScheduler::~TxPriorityScheduler() { stop(); }
+
+void TxPriorityScheduler::start() {
+  assert(m_thread == nullptr);
+  m_run = true;
+  m_thread = std::make_unique<std::thread>(&TxPriorityScheduler::loop, this);
+}
+
+void TxPriorityScheduler::stop() {
+  if (m_thread == nullptr) return;
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_run = false;
+  }
+  m_cv.notify_one();
+  m_thread->join();
+  m_thread = nullptr;
+  std::lock_guard<std::mutex> guard(m_mutex);
+  m_telemetry.clear();
+  m_audio.clear();
+  // The scheduler thread is gone, we are the consumer now
+  for (auto& video : m_video) {
+    while (video->handoff.try_pop().has_value()) {
+    }
+    video->pending.clear();
+    video->n_pending = 0;
+  }
+}
+
+void TxPriorityScheduler::wakeup() {
+  // Pairs with the fence in dispatch(), such that either the scheduler thread
+  // sees the new item or we see that it (might have) reset the flag
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (m_wakeup.exchange(true)) return;
+  { std::lock_guard<std::mutex> guard(m_mutex); }
+  m_cv.notify_one();
+}
+
+void TxPriorityScheduler::submit(Item item) {
+  switch (item.lane) {
+    case Lane::TELEMETRY: {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      // Newer telemetry is more valuable, drop the oldest
+      if (m_telemetry.size() >= MAX_PENDING_PACKETS) {
+        m_telemetry.pop_front();
+        m_console->debug("Telemetry queue jam, dropped 1");
+      }
+      m_telemetry.push_back(std::move(item));
+      break;
+    }
+    case Lane::AUDIO: {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      if (m_audio.size() >= MAX_PENDING_PACKETS) return;
+      m_audio.push_back(std::move(item));
+      break;
+    }
+    case Lane::VIDEO: {
+      if (item.stream_index < 0 || item.stream_index >= (int)m_video.size()) {
+        return;
+      }
+      auto& stream = *m_video[item.stream_index];
+      if (!stream.handoff.try_push(item)) {
+        stream.n_handoff_full.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      break;
+    }
+  }
+  wakeup();
+}
+
+int TxPriorityScheduler::get_n_pending_video_frames(const int stream_index) {
+  if (stream_index < 0 || stream_index >= (int)m_video.size()) return 0;
+  const auto& stream = *m_video[stream_index];
+  return stream.n_pending.load(std::memory_order_relaxed) +
+         (int)stream.handoff.size_approximate();
+}
+
+bool TxPriorityScheduler::dispatch_packets(std::deque<Item>& queue) {
+  while (!queue.empty()) {
+    if (!queue.front().try_enqueue()) return false;
+    queue.pop_front();
+  }
+  return true;
+}
+
+void TxPriorityScheduler::drain_handoff(VideoStream& stream,
+                                        DropCounts& n_dropped) {
+  n_dropped[(int)VideoDropReason::QUEUE_FULL] +=
+      stream.n_handoff_full.exchange(0, std::memory_order_relaxed);
+  while (true) {
+    auto item = stream.handoff.try_pop();
+    if (!item.has_value()) break;
+    if (item->is_keyframe) {
+      n_dropped[(int)VideoDropReason::SUPERSEDED_BY_KEYFRAME] +=
+          (int)stream.pending.size();
+      stream.pending.clear();
+    } else if (stream.pending.size() >= MAX_PENDING_VIDEO_FRAMES) {
+      n_dropped[(int)VideoDropReason::QUEUE_FULL]++;
+      continue;
+    }
+    stream.pending.push_back(std::move(item.value()));
+    stream.n_pending.store((int)stream.pending.size(),
+                           std::memory_order_relaxed);
+  }
+}
+
+bool TxPriorityScheduler::dispatch(
+    const std::chrono::steady_clock::time_point now) {
+  m_wakeup.store(false);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  bool packets_blocked = false;
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    packets_blocked =
+        !dispatch_packets(m_telemetry) || !dispatch_packets(m_audio);
+  }
+  bool blocked = packets_blocked;
+  std::vector<DropCounts> n_dropped(m_video.size(), DropCounts{});
+  for (size_t i = 0; i < m_video.size(); i++) {
+    auto& stream = *m_video[i];
+    // Always, such that the handoff does not run full while blocked
+    drain_handoff(stream, n_dropped[i]);
+    // Strict priority - nothing is handed on while telemetry / audio is
+    // blocked
+    while (!packets_blocked && !stream.pending.empty()) {
+      const auto& frame = stream.pending.front();
+      if (!frame.is_keyframe &&
+          now - frame.creation_time > VIDEO_FRAME_DEADLINE) {
+        n_dropped[i][(int)VideoDropReason::DEADLINE]++;
+        stream.pending.pop_front();
+        continue;
+      }
+      if (!frame.try_enqueue()) {
+        blocked = true;
+        break;
+      }
+      stream.pending.pop_front();
+    }
+    stream.n_pending.store((int)stream.pending.size(),
+                           std::memory_order_relaxed);
+  }
+  if (m_video_dropped_cb) {
+    for (size_t i = 0; i < n_dropped.size(); i++) {
+      for (size_t j = 0; j < n_dropped[i].size(); j++) {
+        if (n_dropped[i][j] > 0) {
+          m_video_dropped_cb((int)i, (VideoDropReason)j, n_dropped[i][j]);
+        }
+      }
+    }
+  }
+  return blocked;
+}
+
+void TxPriorityScheduler::loop() {
+  const auto wake_up = [this] { return !m_run || m_wakeup.load(); };
+  auto retry_interval = MIN_BLOCKED_RETRY_INTERVAL;
+  while (true) {
+    const bool blocked = dispatch(std::chrono::steady_clock::now());
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (blocked) {
+      m_cv.wait_for(lock, retry_interval, wake_up);
+      retry_interval = std::min(retry_interval * 2, MAX_BLOCKED_RETRY_INTERVAL);
+    } else {
+      m_cv.wait(lock, wake_up);
+      retry_interval = MIN_BLOCKED_RETRY_INTERVAL;
+    }
+    if (!m_run) break;
+  }
+}
+
+}  // namespace openhd::wb
@@ -0,0 +1,85 @@
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+#include "wb_link_frame_coalescer.h"
+
+// Checks when the frame coalescer holds frames back and when it flushes.
+
+using namespace std::chrono_literals;
+using openhd::wb::FrameCoalescer;
+
+static FrameCoalescer::Frame make_frame(
+    int n_fragments, std::chrono::steady_clock::time_point arrival,
+    bool is_keyframe = false, bool enable_encryption = false) {
+  FrameCoalescer::Frame frame{};
+  for (int i = 0; i < n_fragments; i++) {
+    frame.fragments.push_back(std::make_shared<std::vector<uint8_t>>(1024));
+  }
+  frame.is_keyframe = is_keyframe;
+  frame.enable_encryption = enable_encryption;
+  frame.creation_time = arrival;
+  frame.arrival = arrival;
+  return frame;
+}
+
+int main(int argc, char* argv[]) {
+  static constexpr int MAX_BLOCK = 20;
+  static constexpr auto BUDGET = 10ms;
+  const auto now = std::chrono::steady_clock::now();
+  FrameCoalescer coalescer;
+  // Disabled - every frame is passed on
+  auto blocks = coalescer.add(make_frame(2, now), 0ms, MAX_BLOCK);
+  if (blocks.size() != 1 || blocks[0].n_frames != 1) {
+    throw std::runtime_error("disabled");
+  }
+  // Small frames are packed together
+  if (!coalescer.add(make_frame(2, now), BUDGET, MAX_BLOCK).empty()) {
+    throw std::runtime_error("first frame not held back");
+  }
+  if (!coalescer.add(make_frame(3, now + 3ms), BUDGET, MAX_BLOCK).empty()) {
+    throw std::runtime_error("second frame not held back");
+  }
+  if (coalescer.get_n_pending_frames() != 2) {
+    throw std::runtime_error("pending");
+  }
+  // Not due yet, then due once the oldest frame has waited for the budget
+  if (coalescer.flush_if_due(now + 9ms, BUDGET).has_value()) {
+    throw std::runtime_error("too early");
+  }
+  auto block = coalescer.flush_if_due(now + BUDGET, BUDGET);
+  if (!block.has_value() || block->n_frames != 2 ||
+      block->fragments.size() != 5 || block->arrival != now) {
+    throw std::runtime_error("budget");
+  }
+  // A keyframe goes out immediately, together with what is pending
+  coalescer.add(make_frame(2, now), BUDGET, MAX_BLOCK);
+  blocks = coalescer.add(make_frame(4, now, true), BUDGET, MAX_BLOCK);
+  if (blocks.size() != 1 || blocks[0].n_frames != 2 ||
+      !blocks[0].is_keyframe) {
+    throw std::runtime_error("keyframe");
+  }
+  // Overflow - the pending block goes out on its own
+  coalescer.add(make_frame(8, now), BUDGET, MAX_BLOCK);
+  coalescer.add(make_frame(8, now), BUDGET, MAX_BLOCK);
+  blocks = coalescer.add(make_frame(8, now), BUDGET, MAX_BLOCK);
+  if (blocks.size() != 1 || blocks[0].fragments.size() != 16) {
+    throw std::runtime_error("overflow");
+  }
+  if (coalescer.get_n_pending_frames() != 1) {
+    throw std::runtime_error("overflow pending");
+  }
+  // A change of encryption is never mixed into one block
+  blocks = coalescer.add(make_frame(2, now, false, true), BUDGET, MAX_BLOCK);
+  if (blocks.size() != 1 || blocks[0].enable_encryption) {
+    throw std::runtime_error("encryption");
+  }
+  // Large frames are never held back
+  blocks = coalescer.add(make_frame(11, now), BUDGET, MAX_BLOCK);
+  if (blocks.size() != 2 || blocks[1].n_frames != 1) {
+    throw std::runtime_error("large frame");
+  }
+  if (coalescer.flush().has_value()) throw std::runtime_error("flush");
+  std::cout << "frame coalescer ok" << std::endl;
+  return 0;
+}
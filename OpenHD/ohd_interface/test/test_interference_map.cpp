@@ -0,0 +1,47 @@
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+#include "wb_link_interference_map.h"
+
+// Checks the smoothing, the cleanest channel selection and that the map
+// survives a restart.
+
+using openhd::wb::InterferenceMap;
+
+int main(int argc, char* argv[]) {
+  const std::string filename = "/tmp/test_interference_map.txt";
+  std::remove(filename.c_str());
+  const auto channels = openhd::frequencies_to_channels({5180, 5220, 5260});
+  {
+    InterferenceMap map(filename);
+    if (map.get_foreign_packets_per_second(5180).has_value()) {
+      throw std::runtime_error("value without sample");
+    }
+    if (map.get_cleanest_frequency(channels).has_value()) {
+      throw std::runtime_error("cleanest without sample");
+    }
+    map.add_sample(5180, 100);
+    map.add_sample(5180, 0);
+    const int smoothed = map.get_foreign_packets_per_second(5180).value();
+    if (smoothed <= 0 || smoothed >= 100) {
+      throw std::runtime_error("not smoothed");
+    }
+    map.add_sample(5220, 500);
+    map.add_sample(5260, 10);
+    if (map.get_cleanest_frequency(channels).value() != 5260) {
+      throw std::runtime_error("wrong cleanest");
+    }
+    map.persist_if_changed();
+  }
+  InterferenceMap map(filename);
+  if (map.get_foreign_packets_per_second(5220).value_or(-1) != 500) {
+    throw std::runtime_error("not persisted");
+  }
+  if (map.get_cleanest_frequency(channels).value() != 5260) {
+    throw std::runtime_error("wrong cleanest after restart");
+  }
+  std::remove(filename.c_str());
+  std::cout << "interference map ok" << std::endl;
+  return 0;
+}
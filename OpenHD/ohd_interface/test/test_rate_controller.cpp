@@ -0,0 +1,168 @@
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+#include "wb_link_rate_controller.h"
+
+// Drives the variable bitrate controller with a simulated link that can only
+// carry a fixed rate and checks it backs off below it, holds and probes upwards
+// again once the link allows.
+
+using namespace std::chrono_literals;
+using Controller = openhd::wb::VideoBitrateController;
+
+// Simulate N ticks of 100ms of a link that can carry link_capacity_kbits
+static int run(Controller& controller,
+               std::chrono::steady_clock::time_point& now, int n_ticks,
+               int link_capacity_kbits, int gnd_block_loss_perc = 0) {
+  for (int i = 0; i < n_ticks; i++) {
+    now += 100ms;
+    Controller::Input input{};
+    input.gnd_video_block_loss_perc = gnd_block_loss_perc;
+    input.gnd_packet_loss_perc = 0;
+    if (controller.get_bitrate_kbits() > link_capacity_kbits) {
+      input.tx_queue_fill_perc = 100;
+      input.n_dropped_frames = 1;
+    }
+    controller.update(input, now);
+  }
+  return controller.get_bitrate_kbits();
+}
+
+static void test_backs_off_and_recovers() {
+  const char* TAG = "backs_off_and_recovers";
+  Controller controller;
+  auto now = std::chrono::steady_clock::now();
+  controller.reset(20000, 2000, 10, 20, now);
+  if (controller.get_ceiling_kbits() != 18000) {
+    throw std::runtime_error("headroom");
+  }
+  if (controller.get_bitrate_kbits() != 18000) {
+    throw std::runtime_error("start at ceiling");
+  }
+  // Link can only do 8MBit/s
+  int rate = run(controller, now, 100, 8000);
+  if (rate > 8000) throw std::runtime_error("did not back off");
+  if (rate < 8000 * Controller::DECREASE_PERC / 100 * 80 / 100) {
+    throw std::runtime_error("backed off too far");
+  }
+  if (controller.get_n_decreases() == 0) {
+    throw std::runtime_error("n decreases");
+  }
+  // Link clears up
+  rate = run(controller, now, 1000, 100000);
+  if (rate != controller.get_ceiling_kbits()) {
+    throw std::runtime_error("did not recover");
+  }
+  std::cout << TAG << " ok" << std::endl;
+}
+
+static void test_floor() {
+  const char* TAG = "floor";
+  Controller controller;
+  auto now = std::chrono::steady_clock::now();
+  controller.reset(20000, 3000, 0, 20, now);
+  const int rate = run(controller, now, 200, 500);
+  if (rate != 3000) throw std::runtime_error("floor not respected");
+  std::cout << TAG << " ok" << std::endl;
+}
+
+static void test_settle_time() {
+  const char* TAG = "settle_time";
+  Controller controller;
+  auto now = std::chrono::steady_clock::now();
+  controller.reset(10000, 2000, 0, 20, now);
+  // The encoder is still adjusting to the new rate
+  const int rate = run(controller, now, 9, 0);
+  if (rate != 10000) throw std::runtime_error("reduced during settle time");
+  std::cout << TAG << " ok" << std::endl;
+}
+
+static void test_ground_loss() {
+  const char* TAG = "ground_loss";
+  Controller controller;
+  auto now = std::chrono::steady_clock::now();
+  controller.reset(10000, 2000, 0, 20, now);
+  const int rate = run(controller, now, 20, 100000, 5);
+  if (rate >= 10000) throw std::runtime_error("ground loss ignored");
+  // Loss the ground can still recover from - hold, but don't increase
+  const int before = controller.get_bitrate_kbits();
+  for (int i = 0; i < 50; i++) {
+    now += 100ms;
+    Controller::Input input{};
+    input.gnd_video_block_loss_perc = 0;
+    input.gnd_packet_loss_perc = 15;
+    controller.update(input, now);
+  }
+  if (controller.get_bitrate_kbits() != before) {
+    throw std::runtime_error("did not hold");
+  }
+  std::cout << TAG << " ok" << std::endl;
+}
+
+// Isolated tx errors only hold the bitrate, sustained ones reduce it
+static void test_tx_errors() {
+  const char* TAG = "tx_errors";
+  Controller controller;
+  auto now = std::chrono::steady_clock::now();
+  controller.reset(10000, 2000, 0, 20, now);
+  run(controller, now, 10, 100000);
+  for (int i = 0; i < 50; i++) {
+    now += 100ms;
+    Controller::Input input{};
+    input.gnd_video_block_loss_perc = 0;
+    input.gnd_packet_loss_perc = 0;
+    input.n_tx_errors = i % 2 == 0 ? 1 : 0;
+    controller.update(input, now);
+  }
+  if (controller.get_bitrate_kbits() != 10000) {
+    throw std::runtime_error("isolated errors");
+  }
+  for (int i = 0; i < Controller::TX_ERRORS_CONGESTED_N_UPDATES; i++) {
+    now += 100ms;
+    Controller::Input input{};
+    input.n_tx_errors = 1;
+    controller.update(input, now);
+  }
+  if (controller.get_bitrate_kbits() >= 10000) {
+    throw std::runtime_error("sustained errors");
+  }
+  std::cout << TAG << " ok" << std::endl;
+}
+
+// Small changes are not passed on to the encoder, big ones at most at ~10Hz,
+// the current value is repeated now and then
+static void test_encoder_bitrate_filter() {
+  const char* TAG = "encoder_bitrate_filter";
+  using Filter = openhd::wb::EncoderBitrateFilter;
+  Filter filter;
+  auto now = std::chrono::steady_clock::now();
+  if (!filter.should_recommend(10000, now)) throw std::runtime_error("first");
+  now += 50ms;
+  if (filter.should_recommend(8000, now)) throw std::runtime_error("too fast");
+  now += 50ms;
+  if (!filter.should_recommend(8000, now)) {
+    throw std::runtime_error("big change");
+  }
+  int n_recommendations = 0;
+  for (int i = 0; i < 20; i++) {
+    now += 50ms;
+    // Within the hysteresis
+    if (filter.should_recommend(8000 + (i % 2) * 100, now)) {
+      n_recommendations++;
+    }
+  }
+  // Only the refresh, after 1s
+  if (n_recommendations != 1) throw std::runtime_error("hysteresis / refresh");
+  std::cout << TAG << " ok" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  test_backs_off_and_recovers();
+  test_floor();
+  test_settle_time();
+  test_ground_loss();
+  test_tx_errors();
+  test_encoder_bitrate_filter();
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+#include "wb_link_scan_helper.h"
+
+// Checks the adaptive dwell decisions and the channel ordering of the channel
+// scan, including the persisted history.
+
+using namespace std::chrono_literals;
+using openhd::wb::ScanChannelHistory;
+using openhd::wb::ScanDwell;
+
+static void test_dwell() {
+  const char* TAG = "dwell";
+  const auto begin = std::chrono::steady_clock::now();
+  const ScanDwell dwell(begin);
+  if (dwell.update(begin + 100ms, 0, true) != ScanDwell::Result::FOUND) {
+    throw std::runtime_error("management");
+  }
+  if (dwell.update(begin + 500ms, 0, false) != ScanDwell::Result::LISTEN) {
+    throw std::runtime_error("gave up too early");
+  }
+  if (dwell.update(begin + ScanDwell::ABSENT_AFTER, 0, false) !=
+      ScanDwell::Result::NOT_FOUND) {
+    throw std::runtime_error("silent channel");
+  }
+  // Packets - wait for the management frame
+  if (dwell.update(begin + 3s, 10, false) != ScanDwell::Result::LISTEN) {
+    throw std::runtime_error("gave up despite packets");
+  }
+  if (dwell.update(begin + ScanDwell::MAX_DWELL, 10, false) !=
+      ScanDwell::Result::NOT_FOUND) {
+    throw std::runtime_error("max dwell");
+  }
+  std::cout << TAG << " ok" << std::endl;
+}
+
+static void test_order() {
+  const char* TAG = "order";
+  const std::string filename = "/tmp/test_channel_scan_history.txt";
+  std::remove(filename.c_str());
+  const auto channels =
+      openhd::frequencies_to_channels({5180, 5200, 5220, 5240, 5260});
+  {
+    ScanChannelHistory history(filename);
+    if (history.order_by_likelihood(channels)[0].frequency != 5180) {
+      throw std::runtime_error("order not kept");
+    }
+    history.on_channel_analyzed(5180, 0, 0);
+    history.on_channel_analyzed(5220, 100, 10);
+    history.on_air_found(5260);
+    history.on_air_found(5240);
+    const auto ordered = history.order_by_likelihood(channels);
+    // found (most recent first), openhd packets, unknown, silent
+    const uint32_t expected[] = {5240, 5260, 5220, 5200, 5180};
+    for (int i = 0; i < 5; i++) {
+      if (ordered[i].frequency != expected[i]) {
+        throw std::runtime_error("wrong order");
+      }
+    }
+  }
+  // The analyze results are not persisted, where the air unit was found is
+  ScanChannelHistory history(filename);
+  const auto ordered = history.order_by_likelihood(channels);
+  const uint32_t expected[] = {5240, 5260, 5180, 5200, 5220};
+  for (int i = 0; i < 5; i++) {
+    if (ordered[i].frequency != expected[i]) {
+      throw std::runtime_error("not persisted");
+    }
+  }
+  std::remove(filename.c_str());
+  std::cout << TAG << " ok" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  test_dwell();
+  test_order();
+  return 0;
+}
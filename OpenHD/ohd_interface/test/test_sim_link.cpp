@@ -0,0 +1,190 @@
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "sim_link.h"
+
+// Checks the bandwidth, loss and reordering model of the simulated link, that
+// a run is reproducible and that the air transmit path (rate control,
+// coalescing) runs on the virtual clock.
+
+using namespace std::chrono_literals;
+using openhd::sim::AirTxConfig;
+using openhd::sim::ChannelConfig;
+using openhd::sim::SimLinkPair;
+
+static openhd::FragmentedVideoFrame make_frame(int n_fragments,
+                                               int fragment_size,
+                                               uint8_t& counter) {
+  openhd::FragmentedVideoFrame frame{};
+  for (int i = 0; i < n_fragments; i++) {
+    auto data = std::make_shared<std::vector<uint8_t>>(fragment_size, 0);
+    data->at(0) = counter++;
+    frame.rtp_fragments.emplace_back(data);
+  }
+  return frame;
+}
+
+// 30fps, 10 fragments per frame for one second, returns the first byte of
+// each fragment that arrived on the ground
+static std::vector<uint8_t> run(const ChannelConfig& config) {
+  SimLinkPair pair(config, ChannelConfig{});
+  std::vector<uint8_t> received;
+  pair.get_ground()->register_on_receive_video_data_cb(
+      [&received](int stream_index, const uint8_t* data, int data_len) {
+        received.push_back(data[0]);
+      });
+  uint8_t counter = 0;
+  for (int i = 0; i < 30; i++) {
+    pair.get_air()->transmit_video_data(0, make_frame(10, 1000, counter));
+    pair.advance(33ms);
+  }
+  pair.advance(1s);
+  return received;
+}
+
+int main(int argc, char* argv[]) {
+  {
+    // 1000 bytes at 1MBit/s take 8ms on air
+    ChannelConfig config{};
+    config.bandwidth_bits_per_second = 1000 * 1000;
+    config.latency = 1ms;
+    SimLinkPair pair(config, config);
+    int n_received = 0;
+    pair.get_ground()->register_on_receive_video_data_cb(
+        [&n_received](int, const uint8_t*, int) { n_received++; });
+    uint8_t counter = 0;
+    pair.get_air()->transmit_video_data(0, make_frame(10, 1000, counter));
+    if (pair.get_downlink_queue_bytes() != 10 * 1000) {
+      throw std::runtime_error("queue bytes");
+    }
+    pair.advance(50ms);
+    if (n_received != 6) throw std::runtime_error("bandwidth");
+    pair.advance(50ms);
+    if (n_received != 10) throw std::runtime_error("not all delivered");
+  }
+  {
+    // The tx queue is limited
+    ChannelConfig config{};
+    config.bandwidth_bits_per_second = 1000 * 1000;
+    config.max_queue_bytes = 5 * 1000;
+    SimLinkPair pair(config, config);
+    uint8_t counter = 0;
+    pair.get_air()->transmit_video_data(0, make_frame(10, 1000, counter));
+    if (pair.get_downlink_stats().n_dropped_queue != 5) {
+      throw std::runtime_error("queue full");
+    }
+  }
+  {
+    // Telemetry round trip, the ground answers from within the callback
+    SimLinkPair pair(ChannelConfig{}, ChannelConfig{});
+    auto ground = pair.get_ground();
+    ground->register_on_receive_telemetry_data_cb(
+        [&ground](std::shared_ptr<std::vector<uint8_t>> data) {
+          ground->transmit_telemetry_data({data, 2});
+        });
+    int n_answers = 0;
+    pair.get_air()->register_on_receive_telemetry_data_cb(
+        [&n_answers](std::shared_ptr<std::vector<uint8_t>>) { n_answers++; });
+    pair.get_air()->transmit_telemetry_data(
+        {std::make_shared<std::vector<uint8_t>>(100), 1});
+    pair.advance(10ms);
+    pair.advance(10ms);
+    if (n_answers != 1) throw std::runtime_error("telemetry round trip");
+    if (pair.get_uplink_stats().n_delivered != 1) {
+      throw std::runtime_error("injections");
+    }
+  }
+  {
+    // Burst loss converges to the stationary loss of the model
+    ChannelConfig config{};
+    config.bandwidth_bits_per_second = 0;
+    config.max_queue_bytes = 0;
+    config.p_good_to_bad = 0.05;
+    config.p_bad_to_good = 0.2;
+    config.loss_good = 0.01;
+    config.loss_bad = 0.5;
+    config.seed = 42;
+    SimLinkPair pair(config, config);
+    uint8_t counter = 0;
+    for (int i = 0; i < 1000; i++) {
+      pair.get_air()->transmit_video_data(0, make_frame(100, 100, counter));
+    }
+    pair.advance(1s);
+    const auto stats = pair.get_downlink_stats();
+    const double loss = (double)stats.n_lost / stats.n_packets;
+    // 0.8 * 0.01 + 0.2 * 0.5
+    if (loss < 0.098 || loss > 0.118) throw std::runtime_error("burst loss");
+    std::cout << "burst loss " << loss << std::endl;
+  }
+  {
+    // Jitter alone keeps the order, reordering does not - and the same seed
+    // always gives the same result
+    ChannelConfig config{};
+    config.jitter = 3ms;
+    config.loss_good = 0.05;
+    config.seed = 7;
+    const auto in_order = run(config);
+    for (size_t i = 1; i < in_order.size(); i++) {
+      if ((uint8_t)(in_order[i] - in_order[i - 1]) > 128) {
+        throw std::runtime_error("jitter order");
+      }
+    }
+    if (in_order.size() >= 300) throw std::runtime_error("no loss");
+    config.p_reorder = 0.1;
+    const auto reordered = run(config);
+    bool any_reordered = false;
+    for (size_t i = 1; i < reordered.size(); i++) {
+      if ((uint8_t)(reordered[i] - reordered[i - 1]) > 128) {
+        any_reordered = true;
+      }
+    }
+    if (!any_reordered) throw std::runtime_error("reordering");
+    if (run(config) != reordered) throw std::runtime_error("not reproducible");
+  }
+  {
+    // The encoder follows the recommended bitrate, the link can do less than
+    // the theoretical max
+    ChannelConfig config{};
+    config.bandwidth_bits_per_second = 4 * 1000 * 1000;
+    config.max_queue_bytes = 64 * 1024;
+    AirTxConfig air_tx{};
+    air_tx.max_video_rate_kbits = 8000;
+    SimLinkPair pair(config, ChannelConfig{}, air_tx);
+    uint8_t counter = 0;
+    for (int i = 0; i < 30 * 20; i++) {
+      const int frame_bytes = pair.get_video_bitrate_kbits() * 1000 / 8 / 30;
+      pair.get_air()->transmit_video_data(
+          0, make_frame(frame_bytes / 1000 + 1, 1000, counter));
+      pair.advance(33ms);
+    }
+    const int rate = pair.get_video_bitrate_kbits();
+    if (pair.get_n_video_rate_decreases() == 0) {
+      throw std::runtime_error("rate not reduced");
+    }
+    if (rate > 4000) throw std::runtime_error("rate above link capacity");
+    if (rate < 4000 / 2) throw std::runtime_error("rate reduced too far");
+    std::cout << "rate control " << rate << "kbit/s" << std::endl;
+  }
+  {
+    // Frames of the secondary stream are held back for the coalesce budget
+    AirTxConfig air_tx{};
+    air_tx.secondary_coalesce_budget = 20ms;
+    SimLinkPair pair(ChannelConfig{}, ChannelConfig{}, air_tx);
+    int n_received = 0;
+    pair.get_ground()->register_on_receive_video_data_cb(
+        [&n_received](int, const uint8_t*, int) { n_received++; });
+    uint8_t counter = 0;
+    pair.get_air()->transmit_video_data(1, make_frame(1, 100, counter));
+    pair.get_air()->transmit_video_data(1, make_frame(1, 100, counter));
+    pair.advance(10ms);
+    if (n_received != 0) throw std::runtime_error("not coalesced");
+    pair.advance(10ms);
+    pair.advance(10ms);
+    if (n_received != 2) {
+      throw std::runtime_error("coalesced frames not flushed");
+    }
+  }
+  std::cout << "sim link ok" << std::endl;
+  return 0;
+}
@@ -0,0 +1,54 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#include "wb_link_scheduler.h"
+
+// Checks that paused tasks never run and that tasks can be paused /
+// resumed while the scheduler is running.
+
+using namespace std::chrono_literals;
+using openhd::wb::TaskScheduler;
+
+int main(int argc, char* argv[]) {
+  std::atomic<int> n_fast{0};
+  std::atomic<int> n_paused{0};
+  TaskScheduler scheduler("test_task_scheduler");
+  scheduler.add_periodic_task("fast", 5ms, [&] { n_fast++; });
+  scheduler.add_periodic_task("paused", 0ms, [&] { n_paused++; });
+  scheduler.start();
+  std::this_thread::sleep_for(100ms);
+  if (n_fast < 10) throw std::runtime_error("fast task did not run");
+  if (n_paused != 0) throw std::runtime_error("paused task ran");
+  // Resume
+  scheduler.set_task_period("paused", 5ms);
+  std::this_thread::sleep_for(100ms);
+  if (n_paused < 10) throw std::runtime_error("resumed task did not run");
+  // Pause all, nothing may run afterwards
+  scheduler.set_task_period("fast", 0ms);
+  scheduler.set_task_period("paused", 0ms);
+  // A run might still be in progress
+  std::this_thread::sleep_for(20ms);
+  const int n_fast_paused = n_fast;
+  const int n_paused_paused = n_paused;
+  std::this_thread::sleep_for(100ms);
+  if (n_fast != n_fast_paused || n_paused != n_paused_paused) {
+    throw std::runtime_error("task ran while paused");
+  }
+  // A task that pauses itself
+  std::atomic<int> n_once{0};
+  TaskScheduler scheduler2("test_task_scheduler2");
+  scheduler2.add_periodic_task("once", 5ms, [&] {
+    n_once++;
+    scheduler2.set_task_period("once", 0ms);
+  });
+  scheduler2.start();
+  std::this_thread::sleep_for(100ms);
+  if (n_once != 1) throw std::runtime_error("self-paused task ran again");
+  scheduler2.stop();
+  scheduler.stop();
+  std::cout << "task scheduler: ok" << std::endl;
+  return 0;
+}
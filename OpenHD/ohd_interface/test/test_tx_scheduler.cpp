@@ -0,0 +1,142 @@
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "wb_link_tx_scheduler.h"
+
+// Checks the priority order and the video dropping policy of the tx
+// scheduler, without its thread (dispatch is called directly).
+
+using namespace std::chrono_literals;
+using openhd::wb::TxPriorityScheduler;
+
+// Two camera threads, each frame of each stream has to arrive in order
+static void test_threads() {
+  static constexpr int N_FRAMES = 10000;
+  TxPriorityScheduler scheduler("test_tx_scheduler", 2, nullptr);
+  std::vector<int> received[2];
+  scheduler.start();
+  auto camera = [&](int stream_index) {
+    for (int i = 0; i < N_FRAMES; i++) {
+      TxPriorityScheduler::Item item{};
+      item.lane = TxPriorityScheduler::Lane::VIDEO;
+      item.stream_index = stream_index;
+      item.creation_time = std::chrono::steady_clock::now();
+      // Only called on the scheduler thread
+      item.try_enqueue = [&received, stream_index, i]() {
+        received[stream_index].push_back(i);
+        return true;
+      };
+      // Never drop due to a full queue (one frame might be in transit
+      // between handoff and pending)
+      while (scheduler.get_n_pending_video_frames(stream_index) >=
+             (int)TxPriorityScheduler::MAX_PENDING_VIDEO_FRAMES - 1) {
+        std::this_thread::yield();
+      }
+      scheduler.submit(std::move(item));
+    }
+  };
+  std::thread camera0(camera, 0);
+  std::thread camera1(camera, 1);
+  camera0.join();
+  camera1.join();
+  while (scheduler.get_n_pending_video_frames(0) > 0 ||
+         scheduler.get_n_pending_video_frames(1) > 0) {
+    std::this_thread::sleep_for(1ms);
+  }
+  scheduler.stop();
+  for (const auto& frames : received) {
+    if (frames.size() != N_FRAMES) throw std::runtime_error("frames lost");
+    for (int i = 0; i < N_FRAMES; i++) {
+      if (frames[i] != i) throw std::runtime_error("frames out of order");
+    }
+  }
+}
+
+int main(int argc, char* argv[]) {
+  test_threads();
+  int n_dropped = 0;
+  TxPriorityScheduler scheduler(
+      "test_tx_scheduler", 1,
+      [&n_dropped](int, TxPriorityScheduler::VideoDropReason, int n) {
+        n_dropped += n;
+      });
+  std::vector<std::string> sent;
+  // Emulates the wb queue, 'full' rejects video
+  bool full = false;
+  const auto now = std::chrono::steady_clock::now();
+  auto video = [&](const std::string& name, bool keyframe,
+                   std::chrono::steady_clock::time_point creation_time) {
+    TxPriorityScheduler::Item item{};
+    item.lane = TxPriorityScheduler::Lane::VIDEO;
+    item.is_keyframe = keyframe;
+    item.creation_time = creation_time;
+    item.try_enqueue = [&, name]() {
+      if (full) return false;
+      sent.push_back(name);
+      return true;
+    };
+    scheduler.submit(std::move(item));
+  };
+  // Emulates the wb telemetry queue, 'telemetry_full' rejects telemetry
+  bool telemetry_full = false;
+  auto telemetry = [&](const std::string& name) {
+    TxPriorityScheduler::Item item{};
+    item.lane = TxPriorityScheduler::Lane::TELEMETRY;
+    item.try_enqueue = [&, name]() {
+      if (telemetry_full) return false;
+      sent.push_back(name);
+      return true;
+    };
+    scheduler.submit(std::move(item));
+  };
+  // Telemetry first, no matter when it was submitted
+  video("p1", false, now);
+  telemetry("t1");
+  scheduler.dispatch(now);
+  if (sent != std::vector<std::string>{"t1", "p1"}) {
+    throw std::runtime_error("priority");
+  }
+  sent.clear();
+  // Saturated: frames pile up, a keyframe supersedes the older ones
+  full = true;
+  video("p2", false, now);
+  video("p3", false, now);
+  if (!scheduler.dispatch(now)) throw std::runtime_error("not blocked");
+  video("i1", true, now);
+  video("p4", false, now);
+  if (n_dropped != 0) throw std::runtime_error("dropped too early");
+  scheduler.dispatch(now);
+  if (n_dropped != 2) throw std::runtime_error("keyframe did not supersede");
+  if (scheduler.get_n_pending_video_frames(0) != 2) {
+    throw std::runtime_error("pending");
+  }
+  // Too old for the non key frame, but the keyframe is never dropped
+  full = false;
+  scheduler.dispatch(now + TxPriorityScheduler::VIDEO_FRAME_DEADLINE + 1ms);
+  if (sent != std::vector<std::string>{"i1"}) {
+    throw std::runtime_error("deadline");
+  }
+  if (n_dropped != 3) throw std::runtime_error("deadline drop not counted");
+  sent.clear();
+  // Strict priority: video waits while telemetry is blocked
+  telemetry_full = true;
+  telemetry("t2");
+  video("p5", false, now);
+  if (!scheduler.dispatch(now)) {
+    throw std::runtime_error("telemetry not blocked");
+  }
+  if (!sent.empty()) {
+    throw std::runtime_error("video sent while telemetry blocked");
+  }
+  telemetry_full = false;
+  if (scheduler.dispatch(now)) throw std::runtime_error("still blocked");
+  if (sent != std::vector<std::string>{"t2", "p5"}) {
+    throw std::runtime_error("blocked priority");
+  }
+  std::cout << "tx scheduler ok" << std::endl;
+  return 0;
+}
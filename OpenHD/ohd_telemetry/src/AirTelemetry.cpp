@@ -4,6 +4,7 @@
 
 #include "AirTelemetry.h"
 
+#include <array>
 #include <chrono>
 
 #include "mav_helper.h"
@@ -16,6 +17,7 @@ AirTelemetry::AirTelemetry() : MavlinkSystem(OHD_SYS_ID_AIR) {
   m_console = openhd::log::create_or_get("air_tele");
   assert(m_console);
   m_air_settings = std::make_unique<openhd::telemetry::air::SettingsHolder>();
+  setup_router();
   m_fc_serial = std::make_unique<SerialEndpointManager>();
   m_ohd_main_component = std::make_shared<OHDMainComponent>(_sys_id, true);
   m_components.push_back(m_ohd_main_component);
@@ -34,9 +36,8 @@ AirTelemetry::AirTelemetry() : MavlinkSystem(OHD_SYS_ID_AIR) {
       openhd::TCPServer::Config{TCPEndpoint::DEFAULT_PORT});  // 1445
   if (m_tcp_server) {
     m_tcp_server->registerCallback(
-        [this](std::vector<MavlinkMessage> messages) {
-          // Technically not correct, but works
-          on_messages_ground_unit(messages);
+        [this](const std::vector<MavlinkMessage>& messages) {
+          on_messages_ground_unit(ROUTE_TCP, messages);
         });
   }
   setup_uart();
@@ -45,58 +46,33 @@ AirTelemetry::AirTelemetry() : MavlinkSystem(OHD_SYS_ID_AIR) {
 
 AirTelemetry::~AirTelemetry() {}
 
-void AirTelemetry::send_messages_fc(std::vector<MavlinkMessage>& messages) {
-  auto [generic, local_only] =
-      split_into_generic_and_local_only(messages, OHD_SYS_ID_AIR);
+void AirTelemetry::send_messages_fc(
+    const std::vector<MavlinkMessage>& messages) {
   // NOTE: Remember there is a hack in place for rc channels override in regards
   // to the sender sys id
-  m_fc_serial->send_messages_if_enabled(generic);
+  m_fc_serial->send_messages_if_enabled(messages);
 }
 
 void AirTelemetry::send_messages_ground_unit(
-    std::vector<MavlinkMessage>& messages) {
-  if (m_wb_endpoint) {
-    // Optimization: Increase reliability of responding to mavlink (extended)
-    // parameter set responses
-    for (auto& msg : messages) {
-      const auto msg_id = msg.m.msgid;
-      if (msg_id == MAVLINK_MSG_ID_PARAM_EXT_VALUE ||
-          msg_id == MAVLINK_MSG_ID_PARAM_VALUE) {
-        msg.recommended_n_injections = 2;
-      }
-    }
-    m_wb_endpoint->sendMessages(messages);
-  }
-  // Not technically correct, but works
-  if (m_tcp_server) {
-    m_tcp_server->sendMessages(messages);
-  }
+    const std::vector<MavlinkMessage>& messages) {
+  route_messages(ROUTE_LOCAL, messages);
 }
 
-void AirTelemetry::on_messages_fc(std::vector<MavlinkMessage>& messages) {
+void AirTelemetry::on_messages_fc(
+    const std::vector<MavlinkMessage>& messages) {
   // openhd::log::get_default()->debug("on_messages_fc {}",messages.size());
-  // debugMavlinkMessage(message.m,"AirTelemetry::onMessageFC");
+  // debugMavlinkMessage(message.m(),"AirTelemetry::onMessageFC");
   //  Note: No OpenHD component ever talks to the FC, FC is completely passed
   //  through
   // debugMavlinkMessages(messages,"FC");
-  send_messages_ground_unit(messages);
+  route_messages(ROUTE_FC, messages);
   m_ohd_main_component->check_fc_messages_for_actions(messages);
 }
 
 void AirTelemetry::on_messages_ground_unit(
-    std::vector<MavlinkMessage>& messages) {
+    const int route_endpoint, const std::vector<MavlinkMessage>& messages) {
   // m_console->debug("on_messages_ground_unit {}", messages.size());
-  //   filter out heartbeats from the openhd ground unit,we do not need to send
-  //   them to the FC
-  std::vector<MavlinkMessage> filtered_messages_fc;
-  for (const auto& msg : messages) {
-    const mavlink_message_t& m = msg.m;
-    if (static_cast<int>(m.msgid) == MAVLINK_MSG_ID_HEARTBEAT &&
-        m.sysid == OHD_SYS_ID_GROUND)
-      continue;
-    filtered_messages_fc.push_back(msg);
-  }
-  send_messages_fc(filtered_messages_fc);
+  route_messages(route_endpoint, messages);
   // any data created by an OpenHD component on the air pi only needs to be sent
   // to the ground pi, the FC cannot do anything with it anyways.
   std::lock_guard<std::mutex> guard(m_components_lock);
@@ -108,6 +84,54 @@ void AirTelemetry::on_messages_ground_unit(
   }
 }
 
+void AirTelemetry::setup_router() {
+  using openhd::telemetry::MavlinkRouter;
+  // Filter out heartbeats (and anything else) from the openhd ground unit and
+  // the openhd air unit itself, the FC cannot do anything with it anyways.
+  MavlinkRouter::Filter fc_filter{};
+  fc_filter.deny_source_sys_ids = {OHD_SYS_ID_GROUND, OHD_SYS_ID_AIR};
+  m_router.add_endpoint(ROUTE_FC, fc_filter);
+  m_router.add_endpoint(ROUTE_GROUND_UNIT);
+  m_router.add_endpoint(ROUTE_TCP);
+  m_router.add_endpoint(ROUTE_LOCAL);
+  m_router.add_static_route(OHD_SYS_ID_AIR, ROUTE_LOCAL);
+}
+
+void AirTelemetry::route_messages(
+    const int source_endpoint, const std::vector<MavlinkMessage>& messages) {
+  if (messages.empty()) return;
+  std::array<std::vector<MavlinkMessage>, N_ROUTE_ENDPOINTS> routed;
+  for (const auto& msg : messages) {
+    const auto mask = m_router.route(source_endpoint, get_route_info(msg.m()));
+    // Serialize once, all the copies below share it
+    if (mask != 0) msg.pack();
+    for (int i = 0; i < N_ROUTE_ENDPOINTS; i++) {
+      if (openhd::telemetry::MavlinkRouter::contains(mask, i)) {
+        routed[i].push_back(msg);
+      }
+    }
+  }
+  if (!routed[ROUTE_FC].empty()) {
+    send_messages_fc(routed[ROUTE_FC]);
+  }
+  auto& to_ground_unit = routed[ROUTE_GROUND_UNIT];
+  if (m_wb_endpoint && !to_ground_unit.empty()) {
+    // Optimization: Increase reliability of responding to mavlink (extended)
+    // parameter set responses
+    for (auto& msg : to_ground_unit) {
+      const auto msg_id = msg.m().msgid;
+      if (msg_id == MAVLINK_MSG_ID_PARAM_EXT_VALUE ||
+          msg_id == MAVLINK_MSG_ID_PARAM_VALUE) {
+        msg.recommended_n_injections = 2;
+      }
+    }
+    m_wb_endpoint->sendMessages(to_ground_unit);
+  }
+  if (m_tcp_server && !routed[ROUTE_TCP].empty()) {
+    m_tcp_server->sendMessages(routed[ROUTE_TCP]);
+  }
+}
+
 void AirTelemetry::loop_infinite(bool& terminate,
                                  const bool enableExtendedLogging) {
   const auto log_intervall = std::chrono::seconds(5);
@@ -123,6 +147,9 @@ void AirTelemetry::loop_infinite(bool& terminate,
       if (enableExtendedLogging && m_wb_endpoint) {
         m_console->debug(m_wb_endpoint->createInfo());
       }
+      if (enableExtendedLogging) {
+        m_console->debug(m_router.create_debug());
+      }
     }
     // send messages to the ground pi in regular intervals, includes heartbeat.
     // everything else is handled by the callbacks and their threads
@@ -155,6 +182,7 @@ std::string AirTelemetry::create_debug() {
   if (m_wb_endpoint) {
     ss << m_wb_endpoint->createInfo();
   }
+  ss << m_router.create_debug();
   return ss.str();
 }
 
@@ -265,10 +293,11 @@ void AirTelemetry::setup_uart() {
     options.baud_rate = m_air_settings->get_settings().fc_uart_baudrate;
     options.flow_control = m_air_settings->get_settings().fc_uart_flow_control;
     options.enable_reading = true;
-    m_fc_serial->configure(options, "fc_ser",
-                           [this](std::vector<MavlinkMessage> messages) {
-                             this->on_messages_fc(messages);
-                           });
+    m_fc_serial->configure(
+        options, "fc_ser",
+        [this](const std::vector<MavlinkMessage>& messages) {
+          this->on_messages_fc(messages);
+        });
   } else {
     m_fc_serial->disable();
   }
@@ -276,7 +305,8 @@ void AirTelemetry::setup_uart() {
 
 void AirTelemetry::set_link_handle(std::shared_ptr<OHDLink> link) {
   m_wb_endpoint = std::make_unique<WBEndpoint>(link, "wb_tx");
-  m_wb_endpoint->registerCallback([this](std::vector<MavlinkMessage> messages) {
-    on_messages_ground_unit(messages);
-  });
+  m_wb_endpoint->registerCallback(
+      [this](const std::vector<MavlinkMessage>& messages) {
+        on_messages_ground_unit(ROUTE_GROUND_UNIT, messages);
+      });
 }
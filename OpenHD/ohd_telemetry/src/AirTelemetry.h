@@ -12,6 +12,7 @@
 #include "openhd_link_statistics.hpp"
 #include "openhd_platform.h"
 #include "openhd_settings_imp.h"
+#include "routing/MavlinkRouter.h"
 #include "routing/MavlinkSystem.hpp"
 //
 #include "AirTelemetrySettings.h"
@@ -70,14 +71,30 @@ class AirTelemetry : public MavlinkSystem {
  private:
   // send a mavlink message to the flight controller connected to the air unit
   // via UART, if connected.
-  void send_messages_fc(std::vector<MavlinkMessage>& messages);
-  // send mavlink messages to the ground unit, lossy
-  void send_messages_ground_unit(std::vector<MavlinkMessage>& messages);
+  void send_messages_fc(const std::vector<MavlinkMessage>& messages);
+  // send mavlink messages created by the openhd components on the air unit to
+  // the ground unit, lossy
+  void send_messages_ground_unit(const std::vector<MavlinkMessage>& messages);
   // called every time one or more messages from the flight controller are
   // received
-  void on_messages_fc(std::vector<MavlinkMessage>& messages);
+  void on_messages_fc(const std::vector<MavlinkMessage>& messages);
   // called every time one or more messages from the ground unit are received
-  void on_messages_ground_unit(std::vector<MavlinkMessage>& messages);
+  void on_messages_ground_unit(int route_endpoint,
+                               const std::vector<MavlinkMessage>& messages);
+  // Endpoint ids for m_router
+  enum RouteEndpoint {
+    ROUTE_FC = 0,
+    ROUTE_GROUND_UNIT,
+    ROUTE_TCP,
+    // The openhd components on the air unit
+    ROUTE_LOCAL,
+    N_ROUTE_ENDPOINTS
+  };
+  void setup_router();
+  // Forwards the messages received on the given endpoint to where m_router
+  // routes them (except ROUTE_LOCAL, the components see all messages anyways)
+  void route_messages(int source_endpoint,
+                      const std::vector<MavlinkMessage>& messages);
   // R.N only on air, and only FC uart settings
   std::vector<openhd::Setting> get_all_settings();
   void setup_uart();
@@ -92,6 +109,7 @@ class AirTelemetry : public MavlinkSystem {
   std::mutex m_components_lock;
   std::vector<std::shared_ptr<MavlinkComponent>> m_components;
   std::shared_ptr<XMavlinkParamProvider> m_generic_mavlink_param_provider;
+  openhd::telemetry::MavlinkRouter m_router;
   // rpi only, allow changing gpios via settings
   std::unique_ptr<openhd::telemetry::rpi::GPIOControl> m_opt_gpio_control =
       nullptr;
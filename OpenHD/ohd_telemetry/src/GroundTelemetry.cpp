@@ -4,6 +4,7 @@
 
 #include "GroundTelemetry.h"
 
+#include <array>
 #include <chrono>
 #include <iostream>
 
@@ -17,6 +18,7 @@ GroundTelemetry::GroundTelemetry() : MavlinkSystem(OHD_SYS_ID_GROUND) {
   assert(m_console);
   m_gnd_settings =
       std::make_unique<openhd::telemetry::ground::SettingsHolder>();
+  setup_router();
   m_endpoint_tracker = std::make_unique<SerialEndpointManager>();
   m_gcs_endpoint = std::make_unique<UDPEndpoint>(
       "GroundStationUDP", OHD_GROUND_CLIENT_UDP_PORT_OUT,
@@ -26,16 +28,16 @@ GroundTelemetry::GroundTelemetry() : MavlinkSystem(OHD_SYS_ID_GROUND) {
       // and we accept udp data from anybody on 14551
       "0.0.0.0");
   m_gcs_endpoint->registerCallback(
-      [this](std::vector<MavlinkMessage> messages) {
-        on_messages_ground_station_clients(messages);
+      [this](const std::vector<MavlinkMessage>& messages) {
+        on_messages_ground_station_clients(ROUTE_GCS_UDP, messages);
       });
   m_tcp_server = std::make_unique<TCPEndpoint>(
       openhd::TCPServer::Config{TCPEndpoint::DEFAULT_PORT});  // 1445
   // m_tcp_server= nullptr;
   if (m_tcp_server) {
     m_tcp_server->registerCallback(
-        [this](std::vector<MavlinkMessage> messages) {
-          on_messages_ground_station_clients(messages);
+        [this](const std::vector<MavlinkMessage>& messages) {
+          on_messages_ground_station_clients(ROUTE_GCS_TCP, messages);
         });
   }
   m_ohd_main_component = std::make_shared<OHDMainComponent>(_sys_id, false);
@@ -82,51 +84,18 @@ GroundTelemetry::~GroundTelemetry() {
   }
 }
 
-void GroundTelemetry::on_messages_air_unit(
-    const std::vector<MavlinkMessage>& messages) {
-  // All messages we get from the Air pi (they might come from the AirPi itself
-  // or the FC connected to the air pi) get forwarded straight to all the
-  // client(s) connected to the ground station.
-  send_messages_ground_station_clients(messages);
-  // Note: No OpenHD component ever talks to another OpenHD component or the FC,
-  // so we do not need to do anything else here. tracker serial out - we are
-  // only interested in message(s) coming from the FC
-  // 17.April: One exception - timesync
-  for (const auto& msg : messages) {
-    if (msg.m.msgid == MAVLINK_MSG_ID_TIMESYNC) {
-      m_ohd_main_component->handle_timesync_message(msg);
-    }
-  }
-  if (m_endpoint_tracker != nullptr) {
-    auto msges_from_fc = filter_by_source_sys_id(messages, OHD_SYS_ID_FC);
-    if (msges_from_fc.empty()) {
-      msges_from_fc =
-          filter_by_source_sys_id(messages, OHD_SYS_ID_FC_BETAFLIGHT);
-    }
-    if (!msges_from_fc.empty()) {
-      m_endpoint_tracker->send_messages_if_enabled(msges_from_fc);
-    }
-  }
-  m_ohd_main_component->check_fc_messages_for_actions(messages);
-}
-
-void GroundTelemetry::on_messages_ground_station_clients(
-    const std::vector<MavlinkMessage>& messages) {
-  // debugMavlinkMessages(messages,"GSC");
-  //  All messages from the ground station(s) are forwarded to the air unit,
-  //  unless they have a target sys id of the ohd ground unit itself
-  auto [generic, local_only] =
-      split_into_generic_and_local_only(messages, OHD_SYS_ID_GROUND);
-  for (auto& msg_generic : generic) {
+// Messages from the ground station client(s) to the air unit
+static void set_uplink_n_injections(std::vector<MavlinkMessage>& messages) {
+  for (auto& msg : messages) {
     // In general, since the uplink suffers that much from over-talking by the
     // video from the air unit, send each message twice by default - we do not
     // send much mavlink to the air unit anyway. We do this for all messages
     // unless it's a heartbeat.
-    const auto msg_id = msg_generic.m.msgid;
+    const auto msg_id = msg.m().msgid;
     if (msg_id == MAVLINK_MSG_ID_HEARTBEAT) {
-      msg_generic.recommended_n_injections = 1;
+      msg.recommended_n_injections = 1;
     } else {
-      msg_generic.recommended_n_injections = 2;
+      msg.recommended_n_injections = 2;
     }
     // optimization: The telemetry link is quite lossy, here we help QOpenHD (or
     // anybody else) on special message(s). WB link makes sure duplicates are
@@ -143,10 +112,34 @@ void GroundTelemetry::on_messages_ground_station_clients(
         // mission protocol
         || msg_id == MAVLINK_MSG_ID_MISSION_REQUEST_LIST ||
         msg_id == MAVLINK_MSG_ID_MISSION_REQUEST_INT) {
-      msg_generic.recommended_n_injections = 4;
+      msg.recommended_n_injections = 4;
     }
   }
-  send_messages_air_unit(generic);
+}
+
+void GroundTelemetry::on_messages_air_unit(
+    const std::vector<MavlinkMessage>& messages) {
+  // All messages we get from the Air pi (they might come from the AirPi itself
+  // or the FC connected to the air pi) get forwarded to the client(s)
+  // connected to the ground station (and the tracker, if enabled) they are
+  // meant for.
+  route_messages(ROUTE_AIR_UNIT, messages);
+  // Note: No OpenHD component ever talks to another OpenHD component or the FC,
+  // so we do not need to do anything else here.
+  // 17.April: One exception - timesync
+  for (const auto& msg : messages) {
+    if (msg.m().msgid == MAVLINK_MSG_ID_TIMESYNC) {
+      m_ohd_main_component->handle_timesync_message(msg);
+    }
+  }
+  m_ohd_main_component->check_fc_messages_for_actions(messages);
+}
+
+void GroundTelemetry::on_messages_ground_station_clients(
+    const int route_endpoint, const std::vector<MavlinkMessage>& messages) {
+  // debugMavlinkMessages(messages,"GSC");
+  // Messages targeted at the ground unit never go to the air unit
+  route_messages(route_endpoint, messages);
   // OpenHD components running on the ground station don't need to talk to the
   // air unit. This is not exactly following the mavlink routing standard, but
   // saves a lot of bandwidth.
@@ -160,11 +153,56 @@ void GroundTelemetry::on_messages_ground_station_clients(
 
 void GroundTelemetry::send_messages_ground_station_clients(
     const std::vector<MavlinkMessage>& messages) {
-  if (m_gcs_endpoint) {
-    m_gcs_endpoint->sendMessages(messages);
+  route_messages(ROUTE_LOCAL, messages);
+}
+
+void GroundTelemetry::setup_router() {
+  using openhd::telemetry::MavlinkRouter;
+  // OpenHD components running on the ground station don't need to talk to the
+  // air unit (timesync and rc are sent there explicitly)
+  MavlinkRouter::Filter air_unit_filter{};
+  air_unit_filter.deny_source_sys_ids = {OHD_SYS_ID_GROUND};
+  m_router.add_endpoint(ROUTE_AIR_UNIT, air_unit_filter);
+  m_router.add_endpoint(ROUTE_GCS_UDP);
+  m_router.add_endpoint(ROUTE_GCS_TCP);
+  // tracker serial out - we are only interested in message(s) coming from the
+  // FC
+  MavlinkRouter::Filter tracker_filter{};
+  tracker_filter.deny_source_sys_ids = {OHD_SYS_ID_GROUND, OHD_SYS_ID_AIR,
+                                        QOPENHD_SYS_ID};
+  m_router.add_endpoint(ROUTE_TRACKER, tracker_filter);
+  m_router.add_endpoint(ROUTE_LOCAL);
+  m_router.add_static_route(OHD_SYS_ID_GROUND, ROUTE_LOCAL);
+}
+
+void GroundTelemetry::route_messages(
+    const int source_endpoint, const std::vector<MavlinkMessage>& messages) {
+  if (messages.empty()) return;
+  std::array<std::vector<MavlinkMessage>, N_ROUTE_ENDPOINTS> routed;
+  for (const auto& msg : messages) {
+    const auto mask = m_router.route(source_endpoint, get_route_info(msg.m()));
+    // Serialize once, all the copies below share it
+    if (mask != 0) msg.pack();
+    for (int i = 0; i < N_ROUTE_ENDPOINTS; i++) {
+      if (openhd::telemetry::MavlinkRouter::contains(mask, i)) {
+        routed[i].push_back(msg);
+      }
+    }
   }
-  if (m_tcp_server) {
-    m_tcp_server->sendMessages(messages);
+  if (!routed[ROUTE_AIR_UNIT].empty()) {
+    if (source_endpoint == ROUTE_GCS_UDP || source_endpoint == ROUTE_GCS_TCP) {
+      set_uplink_n_injections(routed[ROUTE_AIR_UNIT]);
+    }
+    send_messages_air_unit(routed[ROUTE_AIR_UNIT]);
+  }
+  if (m_gcs_endpoint && !routed[ROUTE_GCS_UDP].empty()) {
+    m_gcs_endpoint->sendMessages(routed[ROUTE_GCS_UDP]);
+  }
+  if (m_tcp_server && !routed[ROUTE_GCS_TCP].empty()) {
+    m_tcp_server->sendMessages(routed[ROUTE_GCS_TCP]);
+  }
+  if (m_endpoint_tracker && !routed[ROUTE_TRACKER].empty()) {
+    m_endpoint_tracker->send_messages_if_enabled(routed[ROUTE_TRACKER]);
   }
 }
 
@@ -194,6 +232,9 @@ void GroundTelemetry::loop_infinite(bool& terminate,
       if (enableExtendedLogging && m_gcs_endpoint) {
         m_console->debug(m_gcs_endpoint->createInfo());
       }
+      if (enableExtendedLogging) {
+        m_console->debug(m_router.create_debug());
+      }
     }
     // send messages to the ground station in regular intervals, includes
     // heartbeat. everything else is handled by the callbacks and their threads
@@ -207,7 +248,7 @@ void GroundTelemetry::loop_infinite(bool& terminate,
         send_messages_ground_station_clients(messages);
         // exception: timesync
         for (const auto& msg : messages) {
-          if (msg.m.msgid == MAVLINK_MSG_ID_TIMESYNC) {
+          if (msg.m().msgid == MAVLINK_MSG_ID_TIMESYNC) {
             m_console->debug("Sending timesync to air");
             send_messages_air_unit({msg});
           }
@@ -239,6 +280,7 @@ std::string GroundTelemetry::create_debug() const {
   if (m_gcs_endpoint) {
     ss << m_gcs_endpoint->createInfo();
   }
+  ss << m_router.create_debug();
   return ss.str();
 }
 
@@ -371,12 +413,12 @@ void GroundTelemetry::setup_uart() {
     options.baud_rate = m_gnd_settings->get_settings().gnd_uart_baudrate;
     options.flow_control = false;
     options.enable_reading = false;
-    m_endpoint_tracker->configure(options, "gnd_ser",
-                                  [this](std::vector<MavlinkMessage> messages) {
-                                    // We ignore any incoming messages here for
-                                    // now, since it is only for mavlink out via
-                                    // serial
-                                  });
+    m_endpoint_tracker->configure(
+        options, "gnd_ser",
+        [this](const std::vector<MavlinkMessage>& messages) {
+          // We ignore any incoming messages here for now, since it is only for
+          // mavlink out via serial
+        });
   } else {
     m_endpoint_tracker->disable();
   }
@@ -386,9 +428,10 @@ void GroundTelemetry::set_link_handle(std::shared_ptr<OHDLink> link) {
   // only call this once, we do not support changing the link handle at run time
   assert(m_wb_endpoint == nullptr);
   m_wb_endpoint = std::make_unique<WBEndpoint>(link, "wb_tx");
-  m_wb_endpoint->registerCallback([this](std::vector<MavlinkMessage> messages) {
-    on_messages_air_unit(messages);
-  });
+  m_wb_endpoint->registerCallback(
+      [this](const std::vector<MavlinkMessage>& messages) {
+        on_messages_air_unit(messages);
+      });
 }
 
 #ifdef OPENHD_TELEMETRY_SDL_FOR_JOYSTICK_FOUND
@@ -17,6 +17,7 @@
 #include "openhd_link.hpp"
 #include "openhd_settings_imp.h"
 #include "openhd_spdlog.h"
+#include "routing/MavlinkRouter.h"
 
 #ifdef OPENHD_TELEMETRY_SDL_FOR_JOYSTICK_FOUND
 #include "rc/JoystickReader.h"
@@ -72,11 +73,27 @@ class GroundTelemetry : public MavlinkSystem {
   // called every time one or more messages are received from any of the clients
   // connected to the Ground Station (For Example QOpenHD)
   void on_messages_ground_station_clients(
-      const std::vector<MavlinkMessage>& messages);
-  // send one or more messages to all clients connected to the ground station,
-  // for example QOpenHD
+      int route_endpoint, const std::vector<MavlinkMessage>& messages);
+  // send one or more messages created by the openhd components on the ground to
+  // the client(s) connected to the ground station they are meant for, for
+  // example QOpenHD
   void send_messages_ground_station_clients(
       const std::vector<MavlinkMessage>& messages);
+  // Endpoint ids for m_router
+  enum RouteEndpoint {
+    ROUTE_AIR_UNIT = 0,
+    ROUTE_GCS_UDP,
+    ROUTE_GCS_TCP,
+    ROUTE_TRACKER,
+    // The openhd components on the ground
+    ROUTE_LOCAL,
+    N_ROUTE_ENDPOINTS
+  };
+  void setup_router();
+  // Forwards the messages received on the given endpoint to where m_router
+  // routes them (except ROUTE_LOCAL, the components see all messages anyways)
+  void route_messages(int source_endpoint,
+                      const std::vector<MavlinkMessage>& messages);
   std::vector<openhd::Setting> get_all_settings();
   void setup_uart();
 #ifdef OPENHD_TELEMETRY_SDL_FOR_JOYSTICK_FOUND
@@ -98,6 +115,7 @@ class GroundTelemetry : public MavlinkSystem {
   std::mutex m_components_lock;
   std::vector<std::shared_ptr<MavlinkComponent>> m_components;
   std::shared_ptr<XMavlinkParamProvider> m_generic_mavlink_param_provider;
+  openhd::telemetry::MavlinkRouter m_router;
   //
 #ifdef OPENHD_TELEMETRY_SDL_FOR_JOYSTICK_FOUND
   std::unique_ptr<RcJoystickSender> m_rc_joystick_sender = nullptr;
@@ -13,6 +13,8 @@ MEndpoint::MEndpoint(std::string tag, bool debug_mavlink_msg_packet_loss)
     : TAG(std::move(tag)),
       m_mavlink_channel(checkoutFreeChannel()),
       m_debug_mavlink_msg_packet_loss(debug_mavlink_msg_packet_loss) {
+  // Enough for a full (aggregated) wb telemetry packet of small messages
+  m_rx_messages.reserve(64);
   openhd::log::get_default()->debug(
       "{} using channel:{} debug_mavlink_msg_packet_los:{}", TAG,
       m_mavlink_channel, m_debug_mavlink_msg_packet_loss);
@@ -22,7 +24,7 @@ void MEndpoint::sendMessages(const std::vector<MavlinkMessage>& messages) {
   if (messages.empty()) return;
   m_tx_n_bytes += get_size(messages);
   /*for(const auto& msg: messages){
-    if(msg.m.msgid==MAVLINK_MSG_ID_RC_CHANNELS_OVERRIDE){
+    if(msg.m().msgid==MAVLINK_MSG_ID_RC_CHANNELS_OVERRIDE){
       openhd::log::get_default()->debug("Send rc channels override");
     }
   }*/
@@ -62,13 +64,13 @@ void MEndpoint::parseNewData(const uint8_t* data, const int data_len) {
   //<<TAG<<" received data:"<<data_len<<"
   //"<<MavlinkHelpers::raw_content(data,data_len)<<"\n";
   m_rx_n_bytes += data_len;
-  std::vector<MavlinkMessage> messages;
+  m_rx_messages.clear();
   mavlink_message_t msg;
   for (int i = 0; i < data_len; i++) {
     uint8_t res = mavlink_parse_char(m_mavlink_channel, (uint8_t)data[i], &msg,
                                      &receiveMavlinkStatus);
     if (res) {
-      messages.push_back(MavlinkMessage{msg});
+      m_rx_messages.push_back(MavlinkMessage{msg});
       // From
       // https://github.com/mavlink/c_uart_interface_example/blob/master/serial_port.cpp
       if ((m_last_status.packet_rx_drop_count !=
@@ -80,10 +82,11 @@ void MEndpoint::parseNewData(const uint8_t* data, const int data_len) {
       m_last_status = receiveMavlinkStatus;
     }
   }
-  onNewMavlinkMessages(messages);
+  onNewMavlinkMessages(m_rx_messages);
 }
 
-void MEndpoint::onNewMavlinkMessages(std::vector<MavlinkMessage> messages) {
+void MEndpoint::onNewMavlinkMessages(
+    const std::vector<MavlinkMessage>& messages) {
   if (messages.empty()) return;
   // openhd::log::create_or_get(TAG)->debug("N messages
   // receive:{}",messages.size());
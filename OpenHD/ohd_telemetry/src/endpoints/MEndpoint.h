@@ -72,11 +72,14 @@ class MEndpoint {
  protected:
   // parse new data as it comes in, extract mavlink messages and forward them on
   // the registered callback (if it has been registered)
+  // Must not be called concurrently (the parsed messages are re-used).
   void parseNewData(const uint8_t* data, int data_len);
   // this one is special, since mavsdk in this case has already done the message
   // parsing
-  void parseNewDataEmulateForMavsdk(mavlink_message_t msg) {
-    onNewMavlinkMessages({MavlinkMessage{msg}});
+  void parseNewDataEmulateForMavsdk(const mavlink_message_t& msg) {
+    m_rx_messages.clear();
+    m_rx_messages.push_back(MavlinkMessage{msg});
+    onNewMavlinkMessages(m_rx_messages);
   }
   // Must be overridden by the implementation
   // Returns true if the message(s) have been properly sent (e.g. a connection
@@ -88,7 +91,11 @@ class MEndpoint {
   MAV_MSG_CALLBACK m_callback = nullptr;
   // increases message count and forwards the messages via the callback if
   // registered.
-  void onNewMavlinkMessages(std::vector<MavlinkMessage> messages);
+  void onNewMavlinkMessages(const std::vector<MavlinkMessage>& messages);
+  // Messages parsed from the last received data. Cleared (but not freed) on
+  // each new data, such that there is no heap allocation per message once
+  // warmed up.
+  std::vector<MavlinkMessage> m_rx_messages;
   mavlink_status_t receiveMavlinkStatus{};
   const uint8_t m_mavlink_channel;
   std::chrono::steady_clock::time_point lastMessage{};
@@ -62,13 +62,14 @@ SerialEndpoint::~SerialEndpoint() { stop(); }
 
 bool SerialEndpoint::sendMessagesImpl(
     const std::vector<MavlinkMessage>& messages) {
-  auto message_buffers = aggregate_pack_messages(messages);
   bool success = true;
-  for (const auto& message_buffer : message_buffers) {
-    if (!write_data_serial(*message_buffer.aggregated_data)) {
-      success = false;
-    }
-  }
+  aggregate_pack_messages(messages, 1024,
+                          [this, &success](const std::vector<uint8_t>& data,
+                                           int, int) {
+                            if (!write_data_serial(data)) {
+                              success = false;
+                            }
+                          });
   return success;
 }
 
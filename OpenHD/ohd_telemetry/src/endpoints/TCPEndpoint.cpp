@@ -18,11 +18,11 @@ TCPEndpoint::TCPEndpoint(openhd::TCPServer::Config config)
 
 bool TCPEndpoint::sendMessagesImpl(
     const std::vector<MavlinkMessage>& messages) {
-  auto message_buffers = aggregate_pack_messages(messages, 1024);
-  for (const auto& message_buffer : message_buffers) {
-    const auto& buff = message_buffer.aggregated_data;
-    send_message_to_all_clients(buff->data(), buff->size());
-  }
+  aggregate_pack_messages(messages, 1024,
+                          [this](const std::vector<uint8_t>& data, int, int) {
+                            send_message_to_all_clients(data.data(),
+                                                        data.size());
+                          });
   return true;
 }
 
@@ -23,8 +23,9 @@ UDPEndpoint::UDPEndpoint(const std::string& TAG, int senderPort,
                          const std::size_t payloadSize) mutable {
     this->parseNewData(payload, (int)payloadSize);
   };
-  m_receiver_sender =
-      std::make_unique<openhd::UDPReceiver>(RECV_IP, RECV_PORT, cb);
+  // One mavlink message (or a few) per datagram
+  m_receiver_sender = std::make_unique<openhd::UDPReceiver>(
+      RECV_IP, RECV_PORT, cb, openhd::UDPReceiver::ETHERNET_DATAGRAM_MAX_SIZE);
   m_receiver_sender->runInBackground();
 }
 
@@ -32,18 +33,17 @@ UDPEndpoint::~UDPEndpoint() { m_receiver_sender->stopBackground(); }
 
 bool UDPEndpoint::sendMessagesImpl(
     const std::vector<MavlinkMessage>& messages) {
-  auto message_buffers = aggregate_pack_messages(messages);
   const auto other_ips = get_all_curr_dest_ips();
-  for (const auto& message_buffer : message_buffers) {
-    m_receiver_sender->forwardPacketViaUDP(
-        SENDER_IP, SEND_PORT, message_buffer.aggregated_data->data(),
-        message_buffer.aggregated_data->size());
-    for (const auto& ip : other_ips) {
-      m_receiver_sender->forwardPacketViaUDP(
-          ip, SEND_PORT, message_buffer.aggregated_data->data(),
-          message_buffer.aggregated_data->size());
-    }
-  }
+  aggregate_pack_messages(
+      messages, 1024,
+      [this, &other_ips](const std::vector<uint8_t>& data, int, int) {
+        m_receiver_sender->forwardPacketViaUDP(SENDER_IP, SEND_PORT,
+                                               data.data(), data.size());
+        for (const auto& ip : other_ips) {
+          m_receiver_sender->forwardPacketViaUDP(ip, SEND_PORT, data.data(),
+                                                 data.size());
+        }
+      });
   return true;
 }
 
@@ -72,7 +72,7 @@ std::vector<std::string> UDPEndpoint::get_all_curr_dest_ips() {
 /// android ??!!
 //      // QGroundControll defaults to 255
 //      // QOpenHD defaults to 225;
-//      const bool is_from_ground_controll=msg.m.sysid==255 || msg.m.sysid==225;
+//      const bool is_from_ground_controll=msg.m().sysid==255 || msg.m().sysid==225;
 //      if(!is_from_ground_controll){
 //        // This can't really be a message from a ground controll application
 //        //m_console->debug("Dropping message");
@@ -30,13 +30,13 @@ static void logOnboardComputerStatus(
 
 static void logOpenHDMessages(const std::vector<MavlinkMessage> &msges) {
   for (const auto &msg : msges) {
-    if (msg.m.msgid == MAVLINK_MSG_ID_ONBOARD_COMPUTER_STATUS) {
+    if (msg.m().msgid == MAVLINK_MSG_ID_ONBOARD_COMPUTER_STATUS) {
       mavlink_onboard_computer_status_t decoded;
-      mavlink_msg_onboard_computer_status_decode(&msg.m, &decoded);
+      mavlink_msg_onboard_computer_status_decode(&msg.m(), &decoded);
       logOnboardComputerStatus(decoded);
     } else {
       std::stringstream ss;
-      ss << "unknown ohd msg with msgid:" << (int)msg.m.msgid;
+      ss << "unknown ohd msg with msgid:" << (int)msg.m().msgid;
       openhd::log::debug_log(ss.str());
     }
   }
@@ -5,6 +5,8 @@
 #ifndef OPENHD_OPENHD_OHD_TELEMETRY_SRC_INTERNAL_OHDLINKSTATISTICSHELPER_H_
 #define OPENHD_OPENHD_OHD_TELEMETRY_SRC_INTERNAL_OHDLINKSTATISTICSHELPER_H_
 
+#include <algorithm>
+
 #include "../mav_include.h"
 #include "openhd_action_handler.h"
 #include "openhd_external_device.h"
@@ -36,7 +38,7 @@ static MavlinkMessage pack_card(
   tmp.tx_active = card_stats.tx_active;
   // openhd::log::get_default()->debug("XX {}",card_stats.to_string(0));
   mavlink_msg_openhd_stats_monitor_mode_wifi_card_encode(
-      system_id, component_id, &msg.m, &tmp);
+      system_id, component_id, msg.mutable_m(), &tmp);
   return msg;
 }
 
@@ -71,7 +73,7 @@ static MavlinkMessage pack_link_general(
   // tmp.unused2=stats_monitor_mode_link.unused2;
   // tmp.unused3=stats_monitor_mode_link.unused3;
   mavlink_msg_openhd_stats_monitor_mode_wifi_link_encode(
-      system_id, component_id, &msg.m, &tmp);
+      system_id, component_id, msg.mutable_m(), &tmp);
   return msg;
 }
 
@@ -87,8 +89,8 @@ static MavlinkMessage pack_tele(
   tmp.curr_rx_packet_loss_perc = stats.curr_rx_packet_loss_perc;
   // tmp.unused_0=stats.unused_0;
   // tmp.unused_1=stats.unused_1;
-  mavlink_msg_openhd_stats_telemetry_encode(system_id, component_id, &msg.m,
-                                            &tmp);
+  mavlink_msg_openhd_stats_telemetry_encode(system_id, component_id,
+                                            msg.mutable_m(), &tmp);
   return msg;
 }
 
@@ -105,11 +107,12 @@ static MavlinkMessage pack_vid_air(
   tmp.curr_injected_pps = stats.curr_injected_pps;
   tmp.curr_dropped_frames = stats.curr_dropped_frames;
   tmp.curr_fec_percentage = stats.curr_fec_percentage;
+  // dummy0: thermal protection level (see WBLink::wt_update_statistics)
   tmp.dummy0 = stats.dummy0;
   tmp.dummy1 = stats.dummy1;
   tmp.dummy2 = stats.dummy2;
-  mavlink_msg_openhd_stats_wb_video_air_encode(system_id, component_id, &msg.m,
-                                               &tmp);
+  mavlink_msg_openhd_stats_wb_video_air_encode(system_id, component_id,
+                                               msg.mutable_m(), &tmp);
   return msg;
 }
 
@@ -130,7 +133,54 @@ static MavlinkMessage pack_vid_air_fec_performance(
   tmp.curr_tx_delay_max_us = stats.curr_tx_delay_max_us;
   tmp.curr_tx_delay_avg_us = stats.curr_tx_delay_avg_us;
   mavlink_msg_openhd_stats_wb_video_air_fec_performance_encode(
-      system_id, component_id, &msg.m, &tmp);
+      system_id, component_id, msg.mutable_m(), &tmp);
+  return msg;
+}
+
+// Debug statistics of the air video pipeline of one stream (see
+// GEN_VIDEO_DEBUG_STATS), there is no openhd message for it.
+// One DEBUG_FLOAT_ARRAY named v<link_index>_dbg, array_id = link_index.
+// Latencies are in us, summaries of the last statistics interval (0 if
+// there was no frame):
+// data[0..14]:  min / avg / p99 of the pipeline stages enc, agg, hnd, fec,
+//               tot (see FrameTraceAggregator::Summary)
+// data[15..20]: min / avg / p99 tx queue residency of keyframes, then of
+//               all other frames
+// data[21..27]: dropped frames per VideoDropReason, totals since start
+static MavlinkMessage pack_vid_air_debug(
+    const uint8_t system_id, const uint8_t component_id,
+    const uint8_t link_index,
+    const openhd::link_statistics::StatsWbVideoAirLatency* latency,
+    const openhd::link_statistics::StatsWbVideoAirDrops* drops) {
+  MavlinkMessage msg;
+  mavlink_debug_float_array_t tmp{};
+  tmp.time_usec = get_time_microseconds();
+  tmp.array_id = link_index;
+  const auto name = "v" + std::to_string(link_index) + "_dbg";
+  // Not necessarily null terminated
+  memcpy(tmp.name, name.data(), std::min(name.size(), sizeof(tmp.name)));
+  int idx = 0;
+  const auto add_summary =
+      [&tmp, &idx](const openhd::LatencyHistogram::Summary& summary) {
+        tmp.data[idx++] = (float)summary.min_us;
+        tmp.data[idx++] = (float)summary.avg_us;
+        tmp.data[idx++] = (float)summary.p99_us;
+      };
+  const openhd::LatencyHistogram::Summary none{};
+  const auto& stages = latency ? latency->latency
+                               : openhd::FrameTraceAggregator::Summary{};
+  add_summary(stages.encoder_to_pull);
+  add_summary(stages.aggregation);
+  add_summary(stages.handoff);
+  add_summary(stages.fec_enqueue);
+  add_summary(stages.total);
+  add_summary(drops ? drops->queue_residency_keyframe : none);
+  add_summary(drops ? drops->queue_residency_other : none);
+  for (int i = 0; i < openhd::link_statistics::N_VIDEO_DROP_REASONS; i++) {
+    tmp.data[idx++] = drops ? (float)drops->n_dropped_total[i] : 0;
+  }
+  mavlink_msg_debug_float_array_encode(system_id, component_id,
+                                       msg.mutable_m(), &tmp);
   return msg;
 }
 
@@ -149,7 +199,7 @@ static MavlinkMessage pack_vid_gnd(
   // tmp.unused0=stats.unused0;
   // tmp.unused1=stats.unused1;
   mavlink_msg_openhd_stats_wb_video_ground_encode(system_id, component_id,
-                                                  &msg.m, &tmp);
+                                                  msg.mutable_m(), &tmp);
   return msg;
 }
 
@@ -166,7 +216,7 @@ static MavlinkMessage pack_vid_gnd_fec_performance(
   // tmp.unused0=stats.unused0;
   // tmp.unused1=stats.unused1;
   mavlink_msg_openhd_stats_wb_video_ground_fec_performance_encode(
-      system_id, component_id, &msg.m, &tmp);
+      system_id, component_id, msg.mutable_m(), &tmp);
   return msg;
 }
 
@@ -186,8 +236,8 @@ static MavlinkMessage pack_camera_stats(
   tmp.encoding_format = cam_info.encoding_format;
   tmp.cam_status = cam_info.cam_status;
   tmp.supports_variable_bitrate = cam_info.supports_variable_bitrate;
-  mavlink_msg_openhd_camera_status_air_encode(system_id, component_id, &msg.m,
-                                              &tmp);
+  mavlink_msg_openhd_camera_status_air_encode(system_id, component_id,
+                                              msg.mutable_m(), &tmp);
   return msg;
 }
 static MavlinkMessage pack_mavlink_openhd_wifbroadcast_gnd_operating_mode(
@@ -199,7 +249,7 @@ static MavlinkMessage pack_mavlink_openhd_wifbroadcast_gnd_operating_mode(
   tmp.operating_mode = stats.operating_mode;
   tmp.tx_passive_mode_is_enabled = stats.tx_passive_mode_is_enabled;
   mavlink_msg_openhd_wifbroadcast_gnd_operating_mode_encode(
-      system_id, component_id, &msg.m, &tmp);
+      system_id, component_id, msg.mutable_m(), &tmp);
   return msg;
 }
 
@@ -216,7 +266,7 @@ static MavlinkMessage generate_msg_openhd_wifibroadcast_supported_channels(
     }
   }
   mavlink_msg_openhd_wifbroadcast_supported_channels_encode(
-      system_id, component_id, &msg.m, &tmp);
+      system_id, component_id, msg.mutable_m(), &tmp);
   return msg;
 }
 
@@ -234,7 +284,7 @@ static MavlinkMessage generate_msg_analyze_channels_progress(
          sizeof(tmp.foreign_packets));
   tmp.progress_perc = progress.progress;
   mavlink_msg_openhd_wifbroadcast_analyze_channels_progress_encode(
-      system_id, component_id, &msg.m, &tmp);
+      system_id, component_id, msg.mutable_m(), &tmp);
   return msg;
 }
 
@@ -248,7 +298,7 @@ static MavlinkMessage generate_msg_scan_channels_progress(
   tmp.channel_width_mhz = progress.channel_width_mhz;
   tmp.success = progress.success;
   mavlink_msg_openhd_wifbroadcast_scan_channels_progress_encode(
-      system_id, component_id, &msg.m, &tmp);
+      system_id, component_id, msg.mutable_m(), &tmp);
   return msg;
 }
 
@@ -262,7 +312,8 @@ static MavlinkMessage generate_sys_status1(
   tmp.ethernet_hotspot_state = action_handler.m_ethernet_hotspot_state;
   tmp.external_devices_count =
       openhd::ExternalDeviceManager::instance().get_external_device_count();
-  mavlink_msg_openhd_sys_status1_encode(system_id, component_id, &msg.m, &tmp);
+  mavlink_msg_openhd_sys_status1_encode(system_id, component_id,
+                                        msg.mutable_m(), &tmp);
   return msg;
 }
 
@@ -33,6 +33,7 @@ OHDMainComponent::OHDMainComponent(uint8_t parent_sys_id, bool runsOnAir)
   if (!RUNS_ON_AIR && config.GEN_ENABLE_LAST_KNOWN_POSITION) {
     m_last_known_position = std::make_unique<LastKnowPosition>();
   }
+  m_send_video_debug_stats = RUNS_ON_AIR && config.GEN_VIDEO_DEBUG_STATS;
 }
 
 OHDMainComponent::~OHDMainComponent() {}
@@ -57,10 +58,10 @@ std::vector<MavlinkMessage> OHDMainComponent::generate_mavlink_messages() {
 }
 
 std::vector<MavlinkMessage> OHDMainComponent::process_mavlink_messages(
-    std::vector<MavlinkMessage> messages) {
+    const std::vector<MavlinkMessage>& messages) {
   std::vector<MavlinkMessage> ret{};
   for (const auto& msg : messages) {
-    switch (msg.m.msgid) {  // NOLINT(cppcoreguidelines-narrowing-conversions)
+    switch (msg.m().msgid) {  // NOLINT(cppcoreguidelines-narrowing-conversions)
       case MAVLINK_MSG_ID_TIMESYNC: {
         // makes ping obsolete
         auto response = handle_timesync_message(msg);
@@ -70,17 +71,17 @@ std::vector<MavlinkMessage> OHDMainComponent::process_mavlink_messages(
       } break;
       case MAVLINK_MSG_ID_COMMAND_LONG: {
         mavlink_command_long_t command;
-        mavlink_msg_command_long_decode(&msg.m, &command);
+        mavlink_msg_command_long_decode(&msg.m(), &command);
         if (command.target_system == m_sys_id &&
             command.target_component == m_comp_id) {
-          process_command_self(command, msg.m.sysid, msg.m.compid, ret);
+          process_command_self(command, msg.m().sysid, msg.m().compid, ret);
         }
         // TODO have an ack response.
       } break;
       case MAVLINK_MSG_ID_GLOBAL_POSITION_INT: {
         // Writes last known position to file(s) for crash recovery
         mavlink_global_position_int_t global_position_int;
-        mavlink_msg_global_position_int_decode(&msg.m, &global_position_int);
+        mavlink_msg_global_position_int_decode(&msg.m(), &global_position_int);
         const double lat =
             static_cast<double>(global_position_int.lat) / 10000000.0;
         const double lon =
@@ -134,6 +135,24 @@ std::vector<MavlinkMessage> OHDMainComponent::generate_mav_wb_stats() {
     }
     ret.push_back(openhd::LinkStatisticsHelper::pack_vid_air_fec_performance(
         m_sys_id, m_comp_id, latest_stats.air_fec_performance));
+    const auto now = std::chrono::steady_clock::now();
+    if (m_send_video_debug_stats &&
+        now - m_last_video_debug_stats >= VIDEO_DEBUG_STATS_INTERVAL) {
+      m_last_video_debug_stats = now;
+      for (const auto& stats : latest_stats.stats_wb_video_air) {
+        const openhd::link_statistics::StatsWbVideoAirLatency* latency =
+            nullptr;
+        for (const auto& tmp : latest_stats.stats_wb_video_air_latency) {
+          if (tmp.link_index == stats.link_index) latency = &tmp;
+        }
+        const openhd::link_statistics::StatsWbVideoAirDrops* drops = nullptr;
+        for (const auto& tmp : latest_stats.stats_wb_video_air_drops) {
+          if (tmp.link_index == stats.link_index) drops = &tmp;
+        }
+        ret.push_back(openhd::LinkStatisticsHelper::pack_vid_air_debug(
+            m_sys_id, m_comp_id, stats.link_index, latency, drops));
+      }
+    }
   } else {
     for (const auto& ground_video : latest_stats.stats_wb_video_ground) {
       ret.push_back(openhd::LinkStatisticsHelper::pack_vid_gnd(
@@ -200,8 +219,8 @@ std::vector<MavlinkMessage> OHDMainComponent::generateLogMessages() {
 MavlinkMessage OHDMainComponent::generate_ohd_version() const {
   MavlinkMessage msg;
   mavlink_msg_openhd_version_message_pack(
-      m_sys_id, m_comp_id, &msg.m, openhd::MAJOR_VERSION, openhd::MINOR_VERSION,
-      openhd::PATCH_VERSION, openhd::RELEASE_TYPE, 0);
+      m_sys_id, m_comp_id, msg.mutable_m(), openhd::MAJOR_VERSION,
+      openhd::MINOR_VERSION, openhd::PATCH_VERSION, openhd::RELEASE_TYPE, 0);
   return msg;
 }
 
@@ -211,14 +230,15 @@ MavlinkMessage OHDMainComponent::ack_command(const uint8_t source_sys_id,
                                              bool success) {
   MavlinkMessage ret{};
   const auto result = success ? MAV_RESULT_ACCEPTED : MAV_RESULT_UNSUPPORTED;
-  mavlink_msg_command_ack_pack(m_sys_id, m_comp_id, &ret.m, command_id, result,
-                               255, 0, source_sys_id, source_comp_id);
+  mavlink_msg_command_ack_pack(m_sys_id, m_comp_id, ret.mutable_m(),
+                               command_id, result, 255, 0, source_sys_id,
+                               source_comp_id);
   return ret;
 }
 
 std::optional<MavlinkMessage> OHDMainComponent::handle_timesync_message(
     const MavlinkMessage& message) {
-  const auto msg = message.m;
+  const auto msg = message.m();
   assert(msg.msgid == MAVLINK_MSG_ID_TIMESYNC);
   mavlink_timesync_t tsync;
   mavlink_msg_timesync_decode(&msg, &tsync);
@@ -254,16 +274,16 @@ std::optional<MavlinkMessage> OHDMainComponent::handle_timesync_message(
 void OHDMainComponent::check_fc_messages_for_actions(
     const std::vector<MavlinkMessage>& messages) {
   for (const auto& msg : messages) {
-    if (msg.m.msgid == MAVLINK_MSG_ID_HEARTBEAT) {
+    if (msg.m().msgid == MAVLINK_MSG_ID_HEARTBEAT) {
       // This is mainly for the user to debug
       if (RUNS_ON_AIR) {
-        m_air_fc_sys_id = msg.m.sysid;
+        m_air_fc_sys_id = msg.m().sysid;
       }
       // We filter a bit more to not accidentally set armed state
-      if (((msg.m.sysid == OHD_SYS_ID_FC) ||
-           (msg.m.sysid == OHD_SYS_ID_FC_BETAFLIGHT))) {
+      if (((msg.m().sysid == OHD_SYS_ID_FC) ||
+           (msg.m().sysid == OHD_SYS_ID_FC_BETAFLIGHT))) {
         mavlink_heartbeat_t heartbeat;
-        mavlink_msg_heartbeat_decode(&msg.m, &heartbeat);
+        mavlink_msg_heartbeat_decode(&msg.m(), &heartbeat);
         const auto mode = (MAV_MODE_FLAG)heartbeat.base_mode;
         const bool armed = (mode & MAV_MODE_FLAG_SAFETY_ARMED);
         openhd::ArmingStateHelper::instance().update_arming_state_if_changed(
@@ -273,16 +293,16 @@ void OHDMainComponent::check_fc_messages_for_actions(
     // We only change the mcs on the air unit (since downlink is the only thing
     // that requires 'higher' bandwidth)
     if (RUNS_ON_AIR) {
-      if ((msg.m.sysid == OHD_SYS_ID_FC) ||
-          (msg.m.sysid == OHD_SYS_ID_FC_BETAFLIGHT)) {
-        if (msg.m.msgid == MAVLINK_MSG_ID_RC_CHANNELS) {
+      if ((msg.m().sysid == OHD_SYS_ID_FC) ||
+          (msg.m().sysid == OHD_SYS_ID_FC_BETAFLIGHT)) {
+        if (msg.m().msgid == MAVLINK_MSG_ID_RC_CHANNELS) {
           mavlink_rc_channels_t rc_channels;
-          mavlink_msg_rc_channels_decode(&msg.m, &rc_channels);
+          mavlink_msg_rc_channels_decode(&msg.m(), &rc_channels);
           const auto tmp = mavlink_msg_rc_channels_to_array(rc_channels);
           openhd::FCRcChannelsHelper::instance().update_rc_channels(tmp);
-        } else if (msg.m.msgid == MAVLINK_MSG_ID_RC_CHANNELS_RAW) {
+        } else if (msg.m().msgid == MAVLINK_MSG_ID_RC_CHANNELS_RAW) {
           mavlink_rc_channels_raw_t rc_channels;
-          mavlink_msg_rc_channels_raw_decode(&msg.m, &rc_channels);
+          mavlink_msg_rc_channels_raw_decode(&msg.m(), &rc_channels);
           const auto tmp = mavlink_msg_rc_channels_raw_to_array(rc_channels);
           openhd::FCRcChannelsHelper::instance().update_rc_channels(tmp);
         }
@@ -464,7 +484,8 @@ std::vector<MavlinkMessage> OHDMainComponent::perform_time_synchronisation() {
     m_last_timesync_out_us = get_time_microseconds();
     timesync.ts1 = m_last_timesync_out_us;
     MavlinkMessage msg;
-    mavlink_msg_timesync_encode(m_sys_id, m_comp_id, &msg.m, &timesync);
+    mavlink_msg_timesync_encode(m_sys_id, m_comp_id, msg.mutable_m(),
+                                &timesync);
     m_last_timesync_request = std::chrono::steady_clock::now();
     m_console->debug("Sending timesync");
     return {msg};
@@ -43,7 +43,7 @@ class OHDMainComponent : public MavlinkComponent {
   std::vector<MavlinkMessage> generate_mavlink_messages() override;
   // override from component
   std::vector<MavlinkMessage> process_mavlink_messages(
-      std::vector<MavlinkMessage> messages) override;
+      const std::vector<MavlinkMessage>& messages) override;
   void process_command_self(const mavlink_command_long_t& command,
                             int source_sys_id, int source_comp_id,
                             std::vector<MavlinkMessage>& message_buffer);
@@ -74,6 +74,12 @@ class OHDMainComponent : public MavlinkComponent {
   const std::chrono::milliseconds m_wb_stats_interval;
   std::chrono::steady_clock::time_point m_last_wb_stats =
       std::chrono::steady_clock::now();
+  // Air video pipeline debug statistics, only if GEN_VIDEO_DEBUG_STATS is
+  // enabled and at a much lower rate than the other link statistics
+  bool m_send_video_debug_stats = false;
+  static constexpr auto VIDEO_DEBUG_STATS_INTERVAL = std::chrono::seconds(5);
+  std::chrono::steady_clock::time_point m_last_video_debug_stats =
+      std::chrono::steady_clock::now();
   std::vector<MavlinkMessage> create_broadcast_stats_if_needed();
   [[nodiscard]] std::vector<MavlinkMessage> generate_mav_wb_stats();
   [[nodiscard]] MavlinkMessage generate_ohd_version() const;
@@ -231,7 +231,8 @@ OnboardComputerStatusProvider::get_current_status_as_mavlink_message(
     tmp.fan_speed[0] = extra_uart.fc_sys_id;
     tmp.fan_speed[1] = extra_uart.operating_mode;
   }
-  mavlink_msg_onboard_computer_status_encode(sys_id, comp_id, &msg.m, &tmp);
+  mavlink_msg_onboard_computer_status_encode(sys_id, comp_id, msg.mutable_m(),
+                                             &tmp);
   return msg;
 }
 
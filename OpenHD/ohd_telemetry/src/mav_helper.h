@@ -11,6 +11,7 @@
 
 #include "mav_include.h"
 #include "openhd_spdlog.h"
+#include "routing/MavlinkRouter.h"
 
 namespace MExampleMessage {
 // mostly from
@@ -22,23 +23,24 @@ static uint64_t microsSinceEpoch() {
 }
 static MavlinkMessage heartbeat(const int sys_id = 255, const int comp_id = 0) {
   MavlinkMessage msg{};
-  mavlink_msg_heartbeat_pack(sys_id, comp_id, &msg.m, MAV_TYPE_HELICOPTER,
-                             MAV_AUTOPILOT_GENERIC, MAV_MODE_GUIDED_ARMED, 0,
-                             MAV_STATE_ACTIVE);
+  mavlink_msg_heartbeat_pack(sys_id, comp_id, msg.mutable_m(),
+                             MAV_TYPE_HELICOPTER, MAV_AUTOPILOT_GENERIC,
+                             MAV_MODE_GUIDED_ARMED, 0, MAV_STATE_ACTIVE);
   return msg;
 }
 static MavlinkMessage position(const int sys_id = 255, const int comp_id = 0) {
   MavlinkMessage msg{};
   float position[6] = {};
   mavlink_msg_local_position_ned_pack(
-      sys_id, comp_id, &msg.m, microsSinceEpoch(), position[0], position[1],
-      position[2], position[3], position[4], position[5]);
+      sys_id, comp_id, msg.mutable_m(), microsSinceEpoch(), position[0],
+      position[1], position[2], position[3], position[4], position[5]);
   return msg;
 }
 static MavlinkMessage attitude(const int sys_id = 255, const int comp_id = 0) {
   MavlinkMessage msg{};
-  mavlink_msg_attitude_pack(sys_id, comp_id, &msg.m, microsSinceEpoch(), 1.2,
-                            1.7, 3.14, 0.01, 0.02, 0.03);
+  mavlink_msg_attitude_pack(sys_id, comp_id, msg.mutable_m(),
+                            microsSinceEpoch(), 1.2, 1.7, 3.14, 0.01, 0.02,
+                            0.03);
   return msg;
 }
 }  // namespace MExampleMessage
@@ -55,9 +57,9 @@ namespace OHDMessages {
  */
 static MavlinkMessage createHeartbeat(const int sys_id, const int comp_id) {
   MavlinkMessage heartbeat;
-  mavlink_msg_heartbeat_pack(sys_id, comp_id, &heartbeat.m, MAV_TYPE_GENERIC,
-                             MAV_AUTOPILOT_GENERIC, MAV_MODE_GUIDED_ARMED, 0,
-                             MAV_STATE_ACTIVE);
+  mavlink_msg_heartbeat_pack(sys_id, comp_id, heartbeat.mutable_m(),
+                             MAV_TYPE_GENERIC, MAV_AUTOPILOT_GENERIC,
+                             MAV_MODE_GUIDED_ARMED, 0, MAV_STATE_ACTIVE);
   return heartbeat;
 }
 
@@ -103,7 +105,7 @@ static void parseAndLog(const uint8_t* data, int data_len,
                                      &receiveMavlinkStatus);
     if (res) {
       MavlinkMessage message{msg};
-      // debugMavlinkMessage(message.m,"XYZ");
+      // debugMavlinkMessage(message.m(),"XYZ");
       nMessages++;
     }
   }
@@ -129,7 +131,7 @@ static void debugMavlinkMessage(const mavlink_message_t& msg, const char* TAG) {
 static void debugMavlinkMessages(const std::vector<MavlinkMessage>& messages,
                                  const char* TAG) {
   for (const auto& msg : messages) {
-    debugMavlinkMessage(msg.m, TAG);
+    debugMavlinkMessage(msg.m(), TAG);
   }
   std::cout << std::endl;
 }
@@ -165,7 +167,7 @@ static MavlinkMessage rc_channels_override_from_array(
   mavlink_rc_channels_override.chan16_raw = rc_data[15];
   mavlink_rc_channels_override.chan17_raw = rc_data[16];
   mavlink_rc_channels_override.chan18_raw = rc_data[17];
-  mavlink_msg_rc_channels_override_encode(sys_id, comp_id, &ret.m,
+  mavlink_msg_rc_channels_override_encode(sys_id, comp_id, ret.mutable_m(),
                                           &mavlink_rc_channels_override);
   return ret;
 }
@@ -215,66 +217,37 @@ struct MTarget {
   uint16_t comp_id;
   bool has_target() const { return sys_id != 0; }
 };
+// Works for any message, using the target offsets from the generated
+// message table (same as mavlink-router / mavsdk do)
 static MTarget get_target_from_message_if_available(
     const mavlink_message_t& msg) {
-  // if(msg.incompat_flags)
-  if (msg.msgid == MAVLINK_MSG_ID_COMMAND_LONG) {
-    mavlink_command_long_t command;
-    mavlink_msg_command_long_decode(&msg, &command);
-    return {command.target_system, command.target_component};
+  const mavlink_msg_entry_t* entry = mavlink_get_msg_entry(msg.msgid);
+  if (entry == nullptr) return {0, 0};
+  const auto* payload = reinterpret_cast<const uint8_t*>(_MAV_PAYLOAD(&msg));
+  // mavlink2 truncates trailing zeros of the payload
+  auto get_byte = [&msg, payload](uint8_t offset) -> uint16_t {
+    return offset < msg.len ? payload[offset] : 0;
+  };
+  MTarget ret{0, 0};
+  if (entry->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_SYSTEM) {
+    ret.sys_id = get_byte(entry->target_system_ofs);
   }
-  if (msg.msgid == MAVLINK_MSG_ID_PARAM_EXT_SET) {
-    mavlink_param_ext_set_t tmp;
-    mavlink_msg_param_ext_set_decode(&msg, &tmp);
-    return {tmp.target_system, tmp.target_component};
-  }
-  if (msg.msgid == MAVLINK_MSG_ID_PARAM_EXT_REQUEST_READ) {
-    mavlink_param_ext_request_read_t tmp;
-    mavlink_msg_param_ext_request_read_decode(&msg, &tmp);
-    return {tmp.target_system, tmp.target_component};
-  }
-  if (msg.msgid == MAVLINK_MSG_ID_PARAM_EXT_REQUEST_LIST) {
-    mavlink_param_ext_request_list_t tmp;
-    mavlink_msg_param_ext_request_list_decode(&msg, &tmp);
-    return {tmp.target_system, tmp.target_component};
+  if (entry->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_COMPONENT) {
+    ret.comp_id = get_byte(entry->target_component_ofs);
   }
   // 0 == broadcast
-  return {0, 0};
-}
-
-// The optimization we want to achieve is to "consume" messages with a given
-// target sys and comp id that matches the given target sys id (e.g. the openhd
-// ground unit) instead of forwarding them to all endpoints, e.g. the FC (those
-// other endpoints won't do anything with the given message anyway) pictorial
-// speaking, we fill 2 buckets (generic and local_only) with the given
-// message(s)
-static std::tuple<std::vector<MavlinkMessage>, std::vector<MavlinkMessage>>
-split_into_generic_and_local_only(const std::vector<MavlinkMessage>& messages,
-                                  uint16_t local_target_sys_id) {
-  std::vector<MavlinkMessage> generic{};
-  generic.reserve(messages.size());
-  std::vector<MavlinkMessage> local_only{};
-  for (const auto& msg : messages) {
-    const auto target = get_target_from_message_if_available(msg.m);
-    if (target.has_target() && target.sys_id == local_target_sys_id) {
-      // openhd::log::get_default()->debug("local only message");
-      local_only.push_back(msg);
-    } else {
-      generic.push_back(msg);
-    }
-  }
-  return {generic, local_only};
+  return ret;
 }
 
-// Return all messages where the source sys id matches the given sys id
-static std::vector<MavlinkMessage> filter_by_source_sys_id(
-    const std::vector<MavlinkMessage>& messages, uint16_t source_sys_id) {
-  std::vector<MavlinkMessage> ret;
-  for (const auto& msg : messages) {
-    if (msg.m.sysid == source_sys_id) {
-      ret.push_back(msg);
-    }
-  }
+static openhd::telemetry::MavlinkRouter::RouteInfo get_route_info(
+    const mavlink_message_t& msg) {
+  const auto target = get_target_from_message_if_available(msg);
+  openhd::telemetry::MavlinkRouter::RouteInfo ret{};
+  ret.msg_id = msg.msgid;
+  ret.sys_id = msg.sysid;
+  ret.comp_id = msg.compid;
+  ret.target_sys_id = (uint8_t)target.sys_id;
+  ret.target_comp_id = (uint8_t)target.comp_id;
   return ret;
 }
 
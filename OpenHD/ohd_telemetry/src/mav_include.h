@@ -34,16 +34,36 @@ static constexpr auto OHD_SYS_ID_FC_BETAFLIGHT = 0;
 static constexpr auto OHD_GROUND_CLIENT_UDP_PORT_OUT = 14550;
 static constexpr auto OHD_GROUND_CLIENT_UDP_PORT_IN = 14551;
 
-struct MavlinkMessage {
-  mavlink_message_t m{};
+class MavlinkMessage {
+ public:
+  MavlinkMessage() = default;
+  explicit MavlinkMessage(const mavlink_message_t& m) : m_msg(m) {}
+  const mavlink_message_t& m() const { return m_msg; }
+  // For (re-) encoding the message, discards what has been packed so far.
+  // Copies made before keep their packed data.
+  mavlink_message_t* mutable_m() {
+    m_cached_pack = nullptr;
+    return &m_msg;
+  }
+  // Serialized on the first call, copies made after that share the result -
+  // a message that is forwarded to multiple endpoints is only serialized once.
+  // The same instance must not be packed from multiple threads at the same
+  // time.
+  const std::vector<uint8_t>& pack() const {
+    if (m_cached_pack == nullptr) {
+      uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+      const auto size = mavlink_msg_to_send_buffer(buf, &m_msg);
+      m_cached_pack =
+          std::make_shared<const std::vector<uint8_t>>(buf, buf + size);
+    }
+    return *m_cached_pack;
+  }
   // how often this packet should be injected (increase reliability)
   int recommended_n_injections = 1;
-  [[nodiscard]] std::vector<uint8_t> pack() const {
-    std::vector<uint8_t> buf(MAVLINK_MAX_PACKET_LEN);
-    auto size = mavlink_msg_to_send_buffer(buf.data(), &m);
-    buf.resize(size);
-    return buf;
-  }
+
+ private:
+  mavlink_message_t m_msg{};
+  mutable std::shared_ptr<const std::vector<uint8_t>> m_cached_pack = nullptr;
 };
 
 struct AggregatedMavlinkPacket {
@@ -57,42 +77,53 @@ struct AggregatedMavlinkPacket {
  * of using a wb packet for each of them - Aggregates the given mavlink
  * message(s) int packets >=@param max_mtu The n of recommended retransmissions
  * is the highest recommended number of all aggregated mavlink messages.
+ * Calls @param cb with each aggregated packet, the data is only valid for the
+ * duration of the call (a thread local buffer is re-used).
  */
-static std::vector<AggregatedMavlinkPacket> aggregate_pack_messages(
-    const std::vector<MavlinkMessage>& messages, uint32_t max_mtu = 1024) {
-  std::vector<AggregatedMavlinkPacket> ret;
-  auto buff = std::make_shared<std::vector<uint8_t>>();
-  buff->reserve(max_mtu);
+static void aggregate_pack_messages(
+    const std::vector<MavlinkMessage>& messages, uint32_t max_mtu,
+    const std::function<void(const std::vector<uint8_t>& aggregated_data,
+                             int recommended_n_retransmissions,
+                             int n_aggregated_mavlink_packets)>& cb) {
+  thread_local std::vector<uint8_t> buff;
+  buff.clear();
+  buff.reserve(max_mtu);
   int recommended_n_retransmissions = 1;
   int n_aggregated_mavlink_packets = 0;
   for (const auto& msg : messages) {
-    auto data = msg.pack();
-    if (buff->size() + data.size() <= max_mtu) {
-      // we haven't reached MTU yet
-      buff->insert(buff->end(), data.begin(), data.end());
-      n_aggregated_mavlink_packets++;
-      if (msg.recommended_n_injections > recommended_n_retransmissions) {
-        recommended_n_retransmissions = msg.recommended_n_injections;
-      }
-    } else {
-      // MTU is reached or we need to allocate a new buffer
-      if (!buff->empty()) {
-        ret.push_back({buff, recommended_n_retransmissions});
-        buff = std::make_shared<std::vector<uint8_t>>();
-        buff->reserve(max_mtu);
-        recommended_n_retransmissions = 1;
-        n_aggregated_mavlink_packets = 0;
-      }
-      buff->insert(buff->end(), data.begin(), data.end());
-      n_aggregated_mavlink_packets++;
-      if (msg.recommended_n_injections > recommended_n_retransmissions) {
-        recommended_n_retransmissions = msg.recommended_n_injections;
-      }
+    const auto& data = msg.pack();
+    if (buff.size() + data.size() > max_mtu && !buff.empty()) {
+      // MTU is reached
+      cb(buff, recommended_n_retransmissions, n_aggregated_mavlink_packets);
+      buff.clear();
+      recommended_n_retransmissions = 1;
+      n_aggregated_mavlink_packets = 0;
+    }
+    buff.insert(buff.end(), data.begin(), data.end());
+    n_aggregated_mavlink_packets++;
+    if (msg.recommended_n_injections > recommended_n_retransmissions) {
+      recommended_n_retransmissions = msg.recommended_n_injections;
     }
   }
-  if (!buff->empty()) {
-    ret.push_back({buff, recommended_n_retransmissions});
+  if (!buff.empty()) {
+    cb(buff, recommended_n_retransmissions, n_aggregated_mavlink_packets);
   }
+}
+
+// Same as above, but each aggregated packet is a buffer of its own - for
+// consumers that keep the data
+static std::vector<AggregatedMavlinkPacket> aggregate_pack_messages(
+    const std::vector<MavlinkMessage>& messages, uint32_t max_mtu = 1024) {
+  std::vector<AggregatedMavlinkPacket> ret;
+  aggregate_pack_messages(
+      messages, max_mtu,
+      [&ret](const std::vector<uint8_t>& aggregated_data,
+             int recommended_n_retransmissions,
+             int n_aggregated_mavlink_packets) {
+        ret.push_back({std::make_shared<std::vector<uint8_t>>(aggregated_data),
+                       recommended_n_retransmissions,
+                       n_aggregated_mavlink_packets});
+      });
   return ret;
 }
 
@@ -105,8 +136,10 @@ static int get_size(const std::vector<MavlinkMessage>& messages) {
 }
 
 // For registering a callback that is called every time component X receives one
-// or more mavlink messages
-typedef std::function<void(const std::vector<MavlinkMessage> messages)>
+// or more mavlink messages. The messages are only valid for the duration of the
+// call (the endpoint re-uses them for the next data it receives), copy them if
+// needed later.
+typedef std::function<void(const std::vector<MavlinkMessage>& messages)>
     MAV_MSG_CALLBACK;
 
 static int64_t get_time_microseconds() {
@@ -50,7 +50,7 @@ void XMavlinkParamProvider::set_ready() {
 }
 
 std::vector<MavlinkMessage> XMavlinkParamProvider::process_mavlink_messages(
-    std::vector<MavlinkMessage> messages) {
+    const std::vector<MavlinkMessage>& messages) {
   std::lock_guard<std::mutex> lock(_mutex);
   for (const auto& setting : m_int_settings_with_update_functionality) {
     const auto intSetting = std::get<openhd::IntSetting>(setting.setting);
@@ -69,7 +69,7 @@ std::vector<MavlinkMessage> XMavlinkParamProvider::process_mavlink_messages(
     }
   }
   for (const auto& msg : messages) {
-    _mavlink_message_handler->process_message(msg.m);
+    _mavlink_message_handler->process_message(msg.m());
   }
   for (int i = 0; i < 100; i++) {
     _mavlink_parameter_receiver->do_work();
@@ -31,7 +31,7 @@ class XMavlinkParamProvider : public MavlinkComponent {
   void set_ready();
   // override from component
   std::vector<MavlinkMessage> process_mavlink_messages(
-      std::vector<MavlinkMessage> messages) override;
+      const std::vector<MavlinkMessage>& messages) override;
   // override from component
   std::vector<MavlinkMessage> generate_mavlink_messages() override;
 
@@ -32,7 +32,7 @@ class MavlinkComponent {
    * unless the given message needs a response.
    */
   virtual std::vector<MavlinkMessage> process_mavlink_messages(
-      std::vector<MavlinkMessage> messages) = 0;
+      const std::vector<MavlinkMessage>& messages) = 0;
   /**
    * The parent should call this method in regular intervals and send out the
    * generated mavlink messages. This is for fire and forget messages. For
@@ -55,7 +55,7 @@ class MavlinkComponent {
    * even more (if wanted)
    */
   /*[[nodiscard]] std::optional<MavlinkMessage> handlePingMessage(const
-  MavlinkMessage &message) const { const auto msg=message.m;
+  MavlinkMessage &message) const { const auto msg=message.m();
     assert(msg.msgid==MAVLINK_MSG_ID_PING);
     mavlink_ping_t ping;
     mavlink_msg_ping_decode(&msg, &ping);
@@ -82,8 +82,9 @@ class MavlinkComponent {
     MavlinkMessage heartbeat;
     const MAV_TYPE mav_type =
         _mav_type.has_value() ? _mav_type.value() : MAV_TYPE_GENERIC;
-    mavlink_msg_heartbeat_pack(m_sys_id, m_comp_id, &heartbeat.m, mav_type,
-                               MAV_AUTOPILOT_INVALID, 0, 0, MAV_STATE_ACTIVE);
+    mavlink_msg_heartbeat_pack(m_sys_id, m_comp_id, heartbeat.mutable_m(),
+                               mav_type, MAV_AUTOPILOT_INVALID, 0, 0,
+                               MAV_STATE_ACTIVE);
     return heartbeat;
   }
 };
@@ -0,0 +1,125 @@
+//
+// Table driven mavlink routing, see MavlinkRouter
+//
+
+#include "MavlinkRouter.h"
+
+#include <cassert>
+#include <sstream>
+#include <utility>
+
+namespace openhd::telemetry {
+
+void MavlinkRouter::add_endpoint(const int endpoint_id, Filter filter) {
+  assert(endpoint_id >= 0 && endpoint_id < MAX_N_ENDPOINTS);
+  std::lock_guard<std::mutex> guard(m_mutex);
+  auto& endpoint = m_endpoints[endpoint_id];
+  endpoint.exists = true;
+  endpoint.filter = std::move(filter);
+  endpoint.last_sent.clear();
+  m_all_endpoints |= 1u << endpoint_id;
+}
+
+void MavlinkRouter::add_static_route(const uint8_t sys_id,
+                                     const int endpoint_id) {
+  assert(endpoint_id >= 0 && endpoint_id < MAX_N_ENDPOINTS);
+  std::lock_guard<std::mutex> guard(m_mutex);
+  m_routes[component_key(sys_id, 0)] |= 1u << endpoint_id;
+}
+
+MavlinkRouter::EndpointMask MavlinkRouter::route(
+    const int source_endpoint_id, const RouteInfo& info,
+    const std::chrono::steady_clock::time_point now) {
+  assert(source_endpoint_id >= 0 && source_endpoint_id < MAX_N_ENDPOINTS);
+  std::lock_guard<std::mutex> guard(m_mutex);
+  m_routes[component_key(info.sys_id, info.comp_id)] |=
+      1u << source_endpoint_id;
+  EndpointMask candidates;
+  if (info.target_sys_id == 0) {
+    candidates = m_all_endpoints;
+  } else if (info.target_comp_id == 0) {
+    candidates = get_endpoints_of_system(info.target_sys_id);
+  } else {
+    const auto it =
+        m_routes.find(component_key(info.target_sys_id, info.target_comp_id));
+    candidates = it != m_routes.end() ? it->second : 0;
+    const auto it_system = m_routes.find(component_key(info.target_sys_id, 0));
+    if (it_system != m_routes.end()) candidates |= it_system->second;
+    // Component not seen yet, but its system - let the system figure it out
+    if (candidates == 0) {
+      candidates = get_endpoints_of_system(info.target_sys_id);
+    }
+  }
+  // Never back to where it came from
+  candidates &= m_all_endpoints & ~(1u << source_endpoint_id);
+  if (candidates == 0 && info.target_sys_id != 0) {
+    m_stats.n_unknown_target++;
+  }
+  EndpointMask ret = 0;
+  for (int i = 0; i < MAX_N_ENDPOINTS && candidates != 0; i++) {
+    if (!contains(candidates, i)) continue;
+    candidates &= ~(1u << i);
+    if (passes_filter(m_endpoints[i], info, now)) {
+      ret |= 1u << i;
+    } else {
+      m_stats.n_filtered++;
+    }
+  }
+  m_stats.n_routed++;
+  return ret;
+}
+
+MavlinkRouter::Stats MavlinkRouter::get_stats() const {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  return m_stats;
+}
+
+std::string MavlinkRouter::create_debug() const {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  std::stringstream ss;
+  ss << "MavlinkRouter{routed:" << m_stats.n_routed
+     << " unknown_target:" << m_stats.n_unknown_target
+     << " filtered:" << m_stats.n_filtered << " routes:[";
+  for (const auto& [key, mask] : m_routes) {
+    ss << (key >> 8) << ":" << (key & 0xFF) << "->" << mask << ",";
+  }
+  ss << "]}";
+  return ss.str();
+}
+
+MavlinkRouter::EndpointMask MavlinkRouter::get_endpoints_of_system(
+    const uint8_t sys_id) const {
+  EndpointMask ret = 0;
+  const auto begin = m_routes.lower_bound(component_key(sys_id, 0));
+  const auto end = m_routes.upper_bound(component_key(sys_id, 255));
+  for (auto it = begin; it != end; ++it) ret |= it->second;
+  return ret;
+}
+
+bool MavlinkRouter::passes_filter(
+    Endpoint& endpoint, const RouteInfo& info,
+    const std::chrono::steady_clock::time_point now) {
+  const auto& filter = endpoint.filter;
+  if (!filter.allow_msg_ids.empty() &&
+      filter.allow_msg_ids.count(info.msg_id) == 0) {
+    return false;
+  }
+  if (filter.deny_msg_ids.count(info.msg_id) != 0) return false;
+  if (filter.deny_source_sys_ids.count(info.sys_id) != 0) return false;
+  const auto rate = filter.max_rate_hz.find(info.msg_id);
+  if (rate == filter.max_rate_hz.end() || rate->second <= 0) return true;
+  const auto min_interval =
+      std::chrono::microseconds(1000 * 1000 / rate->second);
+  const uint64_t key = ((uint64_t)info.msg_id << 16) |
+                       component_key(info.sys_id, info.comp_id);
+  auto it = endpoint.last_sent.find(key);
+  if (it != endpoint.last_sent.end()) {
+    if (now - it->second < min_interval) return false;
+    it->second = now;
+    return true;
+  }
+  endpoint.last_sent.emplace(key, now);
+  return true;
+}
+
+}  // namespace openhd::telemetry
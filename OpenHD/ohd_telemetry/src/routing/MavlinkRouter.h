@@ -0,0 +1,106 @@
+//
+// Table driven mavlink routing, see MavlinkRouter
+//
+
+#ifndef OPENHD_OPENHD_OHD_TELEMETRY_SRC_ROUTING_MAVLINKROUTER_H_
+#define OPENHD_OPENHD_OHD_TELEMETRY_SRC_ROUTING_MAVLINKROUTER_H_
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+namespace openhd::telemetry {
+
+/**
+ * Routes mavlink messages between the endpoints of a telemetry instance
+ * (e.g. FC, link, gcs clients and the openhd components themselves) following
+ * https://mavlink.io/en/guide/routing.html :
+ * The (sys id, comp id) of each message received on an endpoint is learned,
+ * broadcasts (target sys id 0 or no target at all) go to all other endpoints,
+ * targeted messages only to the endpoint(s) the target has been seen on.
+ * Messages for an unknown target are dropped.
+ * On top of that, each endpoint can have a filter (allow / deny by msg id,
+ * deny by source sys id and rate limits per msg id).
+ * Does not depend on the mavlink headers, see get_route_info() in mav_helper.h
+ * Thread-safe.
+ */
+class MavlinkRouter {
+ public:
+  static constexpr int MAX_N_ENDPOINTS = 32;
+  // bit n set = endpoint with id n
+  using EndpointMask = uint32_t;
+  struct RouteInfo {
+    uint32_t msg_id = 0;
+    uint8_t sys_id = 0;
+    uint8_t comp_id = 0;
+    // 0 = broadcast (or no target)
+    uint8_t target_sys_id = 0;
+    uint8_t target_comp_id = 0;
+  };
+  struct Filter {
+    // Empty = all message ids are allowed
+    std::set<uint32_t> allow_msg_ids;
+    std::set<uint32_t> deny_msg_ids;
+    std::set<uint8_t> deny_source_sys_ids;
+    // msg id -> max rate in Hz, per source (sys id, comp id)
+    std::map<uint32_t, int> max_rate_hz;
+  };
+  struct Stats {
+    int64_t n_routed = 0;
+    // Targeted messages no endpoint has seen the target on
+    int64_t n_unknown_target = 0;
+    // Not sent to an endpoint because of its filter
+    int64_t n_filtered = 0;
+  };
+  /**
+   * @param endpoint_id 0..MAX_N_ENDPOINTS-1, unique per endpoint
+   */
+  void add_endpoint(int endpoint_id, Filter filter = {});
+  // For system(s) that never (or not from the start) send anything on the
+  // endpoint they are reachable on - e.g. the openhd components themselves
+  void add_static_route(uint8_t sys_id, int endpoint_id);
+  /**
+   * Learns from the given message (received on source_endpoint_id) and
+   * returns the endpoint(s) it should be forwarded to.
+   */
+  EndpointMask route(int source_endpoint_id, const RouteInfo& info,
+                     std::chrono::steady_clock::time_point now =
+                         std::chrono::steady_clock::now());
+  static bool contains(EndpointMask mask, int endpoint_id) {
+    return (mask & (1u << endpoint_id)) != 0;
+  }
+  Stats get_stats() const;
+  std::string create_debug() const;
+
+ private:
+  struct Endpoint {
+    bool exists = false;
+    Filter filter;
+    // (msg id, sys id, comp id) -> last time a rate limited message was sent
+    std::map<uint64_t, std::chrono::steady_clock::time_point> last_sent;
+  };
+  static uint16_t component_key(uint8_t sys_id, uint8_t comp_id) {
+    return (uint16_t)((sys_id << 8) | comp_id);
+  }
+  EndpointMask get_endpoints_of_system(uint8_t sys_id) const;
+  bool passes_filter(Endpoint& endpoint, const RouteInfo& info,
+                     std::chrono::steady_clock::time_point now);
+
+ private:
+  mutable std::mutex m_mutex;
+  std::array<Endpoint, MAX_N_ENDPOINTS> m_endpoints{};
+  EndpointMask m_all_endpoints = 0;
+  // (sys id, comp id) -> endpoint(s) this component has been seen on.
+  // comp id 0 (MAV_COMP_ID_ALL) is never a source, it is used for the
+  // static (whole system) routes.
+  std::map<uint16_t, EndpointMask> m_routes;
+  Stats m_stats{};
+};
+
+}  // namespace openhd::telemetry
+
+#endif  // OPENHD_OPENHD_OHD_TELEMETRY_SRC_ROUTING_MAVLINKROUTER_H_
@@ -0,0 +1,45 @@
+//
+// Checks that MavlinkMessage::pack() matches mavlink_msg_to_send_buffer, that
+// copies share the packed data and that re-encoding discards it
+//
+
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "mav_include.h"
+
+static std::vector<uint8_t> to_send_buffer(const mavlink_message_t& m) {
+  uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+  const auto size = mavlink_msg_to_send_buffer(buf, &m);
+  return {buf, buf + size};
+}
+
+static void pack_heartbeat(MavlinkMessage& msg, uint8_t mav_type) {
+  mavlink_msg_heartbeat_pack(OHD_SYS_ID_AIR, 0, msg.mutable_m(), mav_type,
+                             MAV_AUTOPILOT_INVALID, 0, 0, MAV_STATE_ACTIVE);
+}
+
+int main() {
+  MavlinkMessage msg;
+  pack_heartbeat(msg, MAV_TYPE_GENERIC);
+  if (msg.pack() != to_send_buffer(msg.m())) throw std::runtime_error("pack");
+  // Packed only once, the copy shares the data
+  const auto* packed = &msg.pack();
+  if (&msg.pack() != packed) throw std::runtime_error("packed twice");
+  const MavlinkMessage copy = msg;
+  if (&copy.pack() != packed) {
+    throw std::runtime_error("copy does not share the packed data");
+  }
+  // Re-encoding discards the packed data of this instance only
+  pack_heartbeat(msg, MAV_TYPE_GCS);
+  if (msg.pack() != to_send_buffer(msg.m())) {
+    throw std::runtime_error("pack after re-encode");
+  }
+  if (msg.pack() == copy.pack()) throw std::runtime_error("stale packed data");
+  if (copy.pack() != to_send_buffer(copy.m())) {
+    throw std::runtime_error("copy changed");
+  }
+  std::cout << "mavlink message ok" << std::endl;
+  return 0;
+}
@@ -0,0 +1,90 @@
+//
+// Checks the routing table and the per-endpoint filters of the mavlink router
+//
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+#include "routing/MavlinkRouter.h"
+
+using openhd::telemetry::MavlinkRouter;
+
+static MavlinkRouter::RouteInfo make_info(uint32_t msg_id, uint8_t sys_id,
+                                          uint8_t comp_id,
+                                          uint8_t target_sys_id = 0,
+                                          uint8_t target_comp_id = 0) {
+  return MavlinkRouter::RouteInfo{msg_id, sys_id, comp_id, target_sys_id,
+                                  target_comp_id};
+}
+
+int main() {
+  static constexpr int LINK = 0;
+  static constexpr int GCS_UDP = 1;
+  static constexpr int GCS_TCP = 2;
+  static constexpr int TRACKER = 3;
+  static constexpr int LOCAL = 4;
+  static constexpr uint32_t HEARTBEAT = 0;
+  static constexpr uint32_t ATTITUDE = 30;
+  static constexpr uint32_t COMMAND_LONG = 76;
+  MavlinkRouter router;
+  router.add_endpoint(LINK);
+  router.add_endpoint(GCS_UDP);
+  router.add_endpoint(GCS_TCP);
+  MavlinkRouter::Filter tracker_filter{};
+  tracker_filter.deny_source_sys_ids = {100, 101, 255};
+  tracker_filter.max_rate_hz[ATTITUDE] = 10;
+  router.add_endpoint(TRACKER, tracker_filter);
+  router.add_endpoint(LOCAL);
+  router.add_static_route(100, LOCAL);
+  const auto now = std::chrono::steady_clock::now();
+  // Broadcast from the FC goes everywhere but back
+  auto mask = router.route(LINK, make_info(HEARTBEAT, 1, 1), now);
+  if (mask != ((1u << GCS_UDP) | (1u << GCS_TCP) | (1u << TRACKER) |
+               (1u << LOCAL))) {
+    throw std::runtime_error("broadcast");
+  }
+  // The tracker only gets the FC, rate limited
+  mask = router.route(LINK, make_info(HEARTBEAT, 101, 191), now);
+  if (MavlinkRouter::contains(mask, TRACKER)) {
+    throw std::runtime_error("source sys id filter");
+  }
+  mask = router.route(LINK, make_info(ATTITUDE, 1, 1), now);
+  if (!MavlinkRouter::contains(mask, TRACKER)) {
+    throw std::runtime_error("first rate limited");
+  }
+  mask = router.route(LINK, make_info(ATTITUDE, 1, 1),
+                      now + std::chrono::milliseconds(50));
+  if (MavlinkRouter::contains(mask, TRACKER)) {
+    throw std::runtime_error("rate limit");
+  }
+  mask = router.route(LINK, make_info(ATTITUDE, 1, 1),
+                      now + std::chrono::milliseconds(100));
+  if (!MavlinkRouter::contains(mask, TRACKER)) {
+    throw std::runtime_error("rate limit interval");
+  }
+  // Targeted at the FC, only the link
+  router.route(GCS_UDP, make_info(HEARTBEAT, 255, 190), now);
+  mask = router.route(GCS_UDP, make_info(COMMAND_LONG, 255, 190, 1, 1), now);
+  if (mask != (1u << LINK)) throw std::runtime_error("targeted at fc");
+  // Targeted at the ground unit, never over the link
+  mask = router.route(GCS_UDP, make_info(COMMAND_LONG, 255, 190, 100, 191),
+                      now);
+  if (mask != (1u << LOCAL)) throw std::runtime_error("targeted at ground");
+  // The answer only goes to the gcs that asked
+  mask = router.route(LOCAL, make_info(COMMAND_LONG, 100, 191, 255, 190), now);
+  if (mask != (1u << GCS_UDP)) throw std::runtime_error("answer");
+  // Unknown component of a known system
+  mask = router.route(GCS_UDP, make_info(COMMAND_LONG, 255, 190, 1, 100), now);
+  if (mask != (1u << LINK)) throw std::runtime_error("unknown component");
+  // Unknown system is dropped
+  mask = router.route(GCS_UDP, make_info(COMMAND_LONG, 255, 190, 42, 1), now);
+  if (mask != 0) throw std::runtime_error("unknown system");
+  const auto stats = router.get_stats();
+  if (stats.n_unknown_target != 1) {
+    throw std::runtime_error("unknown target stats");
+  }
+  std::cout << router.create_debug() << std::endl;
+  std::cout << "mavlink router ok" << std::endl;
+  return 0;
+}
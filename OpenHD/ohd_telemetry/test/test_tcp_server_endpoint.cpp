@@ -15,9 +15,9 @@ int main() {
   openhd::log::get_default()->debug("test_tcp_server_endpoint:end");
   std::unique_ptr<TCPEndpoint> m_server = std::make_unique<TCPEndpoint>(
       openhd::TCPServer::Config{TCPEndpoint::DEFAULT_PORT});  // 1445
-  auto cb = [](const std::vector<MavlinkMessage> messages) {
+  auto cb = [](const std::vector<MavlinkMessage>& messages) {
     for (const auto& msg : messages) {
-      debugMavlinkMessage(msg.m, "TCP received");
+      debugMavlinkMessage(msg.m(), "TCP received");
     }
   };
   m_server->registerCallback(cb);
@@ -22,9 +22,9 @@ int main() {
   std::cout << "UdpEndpointTest::start" << std::endl;
   UDPEndpoint udpEndpoint("UdpEndpoint", OHD_GROUND_CLIENT_UDP_PORT_OUT,
                           OHD_GROUND_CLIENT_UDP_PORT_IN);
-  auto cb = [](const std::vector<MavlinkMessage> messages) {
+  auto cb = [](const std::vector<MavlinkMessage>& messages) {
     for (const auto& msg : messages) {
-      debugMavlinkMessage(msg.m, "Udp");
+      debugMavlinkMessage(msg.m(), "Udp");
     }
   };
   udpEndpoint.registerCallback(cb);
@@ -6,6 +6,7 @@
 #define OPENHD_OPENHD_OHD_VIDEO_INC_AIRRECORDINGFILEHELPER_HPP_
 
 #include <iomanip>
+#include <mutex>
 #include <sstream>
 #include <string>
 
@@ -37,7 +38,19 @@ static std::string format_track_count(int count) {
   return oss.str();
 }
 
+// One for the whole process (inline), recordings are started from multiple
+// threads (e.g. one per camera)
+inline std::mutex& get_recording_index_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+// Thread-safe, each call returns a new (ascending) recording index
 static int get_recording_index_track_count() {
+  std::lock_guard<std::mutex> guard(get_recording_index_mutex());
+  if (!OHDFilesystemUtil::exists(std::string(getVideoPath()))) {
+    OHDFilesystemUtil::create_directories(std::string(getVideoPath()));
+  }
   const std::string recording_track_filename =
       std::string(getVideoPath()) + "track_count.txt";
   int track_count = 1;
@@ -56,24 +69,27 @@ static int get_recording_index_track_count() {
   return track_count;
 }
 
+// recording_N + suffix, for an index from get_recording_index_track_count()
+static std::string get_recording_filename(int track_index,
+                                          const std::string& suffix) {
+  std::stringstream ss;
+  ss << std::string(getVideoPath()) << "recording_" << track_index << suffix;
+  return ss.str();
+}
+
 /**
  * Creates a new not yet used filename (aka the file does not yet exists) to be
  * used for air recording.
  * @param suffix the suffix of the filename,e.g. ".avi" or ".mp4"
  */
 static std::string create_unused_recording_filename(const std::string& suffix) {
-  if (!OHDFilesystemUtil::exists(std::string(getVideoPath()))) {
-    OHDFilesystemUtil::create_directories(std::string(getVideoPath()));
-  }
   // TEMPORARY - considering how many users use RPI (where date is not reliable)
   // we just name the files ascending
   // recording-1, recording-2 ...
   // we also make sure that we always use ascending numbers, even if the user
   // deletes a video
   const int track_index = get_recording_index_track_count();
-  std::stringstream ss;
-  ss << std::string(getVideoPath()) << "recording_" << track_index << suffix;
-  return ss.str();
+  return get_recording_filename(track_index, suffix);
   /*for(int i=0;i<10000;i++){
     // Suffix might be either .
     std::stringstream filename;
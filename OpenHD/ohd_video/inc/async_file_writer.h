@@ -0,0 +1,91 @@
+#ifndef OPENHD_ASYNC_FILE_WRITER_H
+#define OPENHD_ASYNC_FILE_WRITER_H
+
+#include <sys/uio.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "openhd_spdlog.h"
+
+namespace openhd {
+
+/**
+ * Write-behind file writer: the caller only enqueues buffers, a dedicated
+ * thread writes everything queued so far in one batch (writev) and
+ * fdatasync()s the file regularly, so after a power loss at most the last
+ * sync interval of data is missing. The caller never blocks on disk I/O -
+ * if the disk can't keep up, buffers are dropped once more than
+ * max_queued_bytes are pending (enqueue whole, self-contained units, e.g.
+ * one fMP4 fragment per buffer).
+ * Optionally, preallocate_bytes are reserved for the file right away
+ * (fallocate), which avoids fragmentation and block allocation stalls while
+ * writing. The file size only ever covers the data written, the unused
+ * reserved space is released again on close.
+ * If a write fails (e.g. the disk is full), the file is truncated back to the
+ * end of the last buffer that was written completely, and nothing is written
+ * anymore - the file never ends with a partial unit.
+ */
+class AsyncFileWriter {
+ public:
+  explicit AsyncFileWriter(
+      std::string filename,
+      std::chrono::milliseconds sync_interval = std::chrono::seconds(2),
+      size_t max_queued_bytes = 64 * 1024 * 1024,
+      uint64_t preallocate_bytes = 0);
+  // Writes everything still queued, syncs and closes the file
+  ~AsyncFileWriter();
+  AsyncFileWriter(const AsyncFileWriter&) = delete;
+  AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+  // False if the file could not be created
+  bool is_open() const { return m_fd >= 0; }
+  const std::string& get_filename() const { return m_filename; }
+  // Thread-safe, returns false if the data has been dropped
+  bool enqueue(std::shared_ptr<std::vector<uint8_t>> data);
+  // A write failed, everything after the last complete buffer is dropped
+  bool has_failed() const { return m_failed; }
+  uint64_t get_n_bytes_written() const { return m_n_bytes_written; }
+  uint64_t get_n_bytes_dropped() const { return m_n_bytes_dropped; }
+  /**
+   * Writes all the given buffers, in as few writev calls as possible
+   * (handles partial writes and EINTR). Modifies iov.
+   * Returns the n of bytes written - less than the total size on error
+   * (errno is set).
+   */
+  static int64_t writev_all(int fd, std::vector<iovec>& iov);
+
+ private:
+  void loop();
+  bool write_batch(const std::vector<std::shared_ptr<std::vector<uint8_t>>>&
+                       batch);
+
+ private:
+  std::shared_ptr<spdlog::logger> m_console;
+  const std::string m_filename;
+  const std::chrono::milliseconds m_sync_interval;
+  const size_t m_max_queued_bytes;
+  int m_fd = -1;
+  bool m_preallocated = false;
+  std::mutex m_queue_mutex;
+  std::condition_variable m_queue_cv;
+  std::deque<std::shared_ptr<std::vector<uint8_t>>> m_queue;
+  size_t m_queued_bytes = 0;
+  bool m_stop = false;
+  // Also the size of the file - the end of the last complete buffer
+  std::atomic<uint64_t> m_n_bytes_written = 0;
+  std::atomic<bool> m_failed = false;
+  std::atomic<uint64_t> m_n_bytes_dropped = 0;
+  std::unique_ptr<std::thread> m_thread;
+};
+
+}  // namespace openhd
+
+#endif  // OPENHD_ASYNC_FILE_WRITER_H
@@ -23,6 +23,10 @@ static constexpr int DEFAULT_KEYFRAME_INTERVAL = 5;
 // should be stopped. This feature is r.n already implemented for all cameras
 // (in gstreamerstream)
 static constexpr auto MINIMUM_AMOUNT_FREE_SPACE_FOR_AIR_RECORDING_MB = 300;
+// Air recordings are split into segments of this duration, such that a crash
+// loses at most one segment and old segments can be deleted when running out
+// of space
+static constexpr int AIR_RECORDING_SEGMENT_DURATION_S = 60;
 static constexpr int RPI_LIBCAMERA_DEFAULT_EV = 0;
 
 static constexpr int OPENHD_BRIGHTNESS_DEFAULT = 100;
@@ -83,7 +87,9 @@ struct CameraSettings {
   // N of slices. Not supported on all hardware (none to be exact unless the
   // cisco sw encoder) as of now 0 == frame slicing off
   int h26x_num_slices = 0;
-  // enable/disable recording to file
+  // enable/disable recording to file. Recorded as fragmented mp4, in segments
+  // of AIR_RECORDING_SEGMENT_DURATION_S (recording_N_0001.mp4, ...) - older
+  // releases wrote one .mkv per recording.
   int air_recording = AIR_RECORDING_OFF;
   //
   // Below are params that most often only affect the ISP, not the encoder
@@ -0,0 +1,82 @@
+#ifndef OPENHD_FMP4_MUXER_H
+#define OPENHD_FMP4_MUXER_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace openhd {
+
+/**
+ * Minimal fragmented MP4 (ISO BMFF) muxer for a single H264 / H265 video
+ * track. Produces an init segment (ftyp + moov) once and then one moof + mdat
+ * fragment per call to create_fragment(). Since each fragment is self
+ * contained, a file written this way stays playable up to the last complete
+ * fragment if writing is interrupted (e.g. power loss) - no index at the end
+ * of the file is needed.
+ * Only produces bytes, writing them is up to the caller.
+ */
+class FMP4Muxer {
+ public:
+  struct TrackConfig {
+    bool is_h265 = false;
+    int width = 0;
+    int height = 0;
+    // avcC (H264) / hvcC (H265) decoder configuration record
+    std::vector<uint8_t> codec_config_record;
+  };
+  // Timestamps / durations are in this unit
+  static constexpr uint32_t TIMESCALE = 90000;
+  struct Sample {
+    // NAL units, each prefixed by their 4 byte (big endian) length
+    std::shared_ptr<std::vector<uint8_t>> data;
+    uint32_t duration = 0;
+    bool is_keyframe = false;
+  };
+  struct SampleInfo {
+    uint32_t size = 0;
+    uint32_t duration = 0;
+    bool is_keyframe = false;
+  };
+  explicit FMP4Muxer(TrackConfig config);
+  std::shared_ptr<std::vector<uint8_t>> create_init_segment() const;
+  // All samples in one moof + mdat, decode time continues from the
+  // previous fragment.
+  std::shared_ptr<std::vector<uint8_t>> create_fragment(
+      const std::vector<Sample>& samples);
+  /**
+   * Same as create_fragment, but only the moof and the mdat header - the
+   * caller has to write the data of all samples (in order) right after it.
+   * Allows writing the sample data without copying it (e.g. from a mmap'ed
+   * file).
+   */
+  std::vector<uint8_t> create_fragment_header(
+      const std::vector<SampleInfo>& samples);
+
+  /**
+   * Create the track config from the codec config NAL units (without start
+   * code). Returns std::nullopt if the SPS cannot be parsed.
+   */
+  static std::optional<TrackConfig> create_track_config_h264(
+      const std::vector<uint8_t>& sps, const std::vector<uint8_t>& pps);
+  static std::optional<TrackConfig> create_track_config_h265(
+      const std::vector<uint8_t>& vps, const std::vector<uint8_t>& sps,
+      const std::vector<uint8_t>& pps);
+  /**
+   * Converts annex b data (NAL units with 3 or 4 byte start codes) to 4 byte
+   * length prefixed NAL units. Codec config NAL units (VPS,SPS,PPS) and
+   * access unit delimiters are dropped, they are part of the track config.
+   */
+  static std::shared_ptr<std::vector<uint8_t>> annex_b_to_length_prefixed(
+      const uint8_t* data, int data_len, bool is_h265);
+
+ private:
+  const TrackConfig m_config;
+  uint32_t m_sequence_number = 1;
+  uint64_t m_decode_time = 0;
+};
+
+}  // namespace openhd
+
+#endif  // OPENHD_FMP4_MUXER_H
@@ -694,23 +694,6 @@ static std::string file_suffix_for_video_codec(const VideoCodec videoCodec) {
 // .mkv supports h264 and h265, but no mjpeg. It is the default in OBS though,
 // so we decided to use .mkv for h264 and h265 and .avi for mjpeg in case the
 // gst pipeline is not stopped properly
-static std::string createRecordingForVideoCodec(
-    const VideoCodec videoCodec, const std::string& out_filename) {
-  std::stringstream ss;
-  // don't forget the white space before the " t." !
-  ss << " t. ! queue ! ";
-  if (videoCodec == VideoCodec::H264) {
-    ss << "h264parse ! ";
-  } else if (videoCodec == VideoCodec::H265) {
-    ss << "h265parse ! ";
-  }
-  // ss <<"mp4mux ! filesink location="<<out_filename;
-  if (videoCodec == VideoCodec::H264 || videoCodec == VideoCodec::H265) {
-    ss << "matroskamux ! filesink location=" << out_filename;
-  }
-  return ss.str();
-}
-
 static std::string create_input_custom_udp_rtp_port(
     const CameraSettings& settings) {
   static constexpr auto input_port = 5500;
@@ -4,6 +4,8 @@
 #include <gst/gst.h>
 
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <mutex>
 #include <thread>
@@ -17,6 +19,7 @@
 // #include "gst_recorder.h"
 #include "nalu/CodecConfigFinder.hpp"
 #include "openhd_rtp.h"
+#include "video_recorder.h"
 
 // Implementation of OHD CameraStream for pretty much everything, using
 // gstreamer.
@@ -50,6 +53,15 @@ class GStreamerStream : public CameraStream {
   void handle_update_arming_state(bool armed) override;
   void loop_infinite();
   void stream_once();
+  // Air recording, without a gstreamer tee / filesink - a slow disk therefore
+  // can't block the encoder
+  void setup_recording(const CameraSettings& setting);
+  // Hands the frame to the link, then to the recorder (if recording)
+  void output_frame(openhd::FragmentedVideoFrame frame);
+  // Consumes (unrefs) the given sample - wraps its buffer and forwards it.
+  // Called from the loop thread (polling) or from the gstreamer streaming
+  // thread (appsink callback mode)
+  void on_new_sample(GstSample* sample);
   // To reduce the time on the param callback(s) - they need to return
   // immediately to not block the param server
   void request_restart();
@@ -62,9 +74,10 @@ class GStreamerStream : public CameraStream {
   // not supported by all camera(s).
   // for dynamically changing the bitrate
   std::optional<GstBitrateControlElement> m_bitrate_ctrl_element = std::nullopt;
-  // If a pipeline is started with air recording enabled, the file name the
-  // recording is written to is stored here otherwise, it is set to std::nullopt
-  std::optional<std::string> m_opt_curr_recording_filename = std::nullopt;
+  // If a pipeline is started with air recording enabled, the encoded video is
+  // re-assembled from the rtp fragments and recorded in segments (fragmented
+  // mp4) on the recorder's thread. Otherwise, nullptr.
+  std::unique_ptr<AsyncVideoRecorder> m_recorder;
   std::shared_ptr<spdlog::logger> m_console;
   // Set to true if armed, used for auto record on arm
   bool m_armed_enable_air_recording = false;
@@ -74,17 +87,29 @@ class GStreamerStream : public CameraStream {
   std::atomic_bool m_request_restart = false;
   std::atomic_bool m_keep_looping = false;
   std::unique_ptr<std::thread> m_loop_thread = nullptr;
+  // If enabled, samples are handed to us by the appsink "new-sample" callback
+  // on the gstreamer streaming thread, and the loop thread only does the
+  // control work (bitrate, restart, watchdog, recording space). Otherwise, the
+  // loop thread polls the appsink with a timeout and does both.
+  bool m_use_appsink_callback = false;
+  // For 'bugged camera restart' fix - written by whoever pulls the samples
+  std::atomic<std::chrono::steady_clock::time_point> m_last_camera_frame{};
+  // As soon as we get the first frame, we change the status to streaming
+  std::atomic_bool m_has_first_frame = false;
+  // Only accessed by whoever pulls the samples
+  std::optional<GstClockTime> m_gst_monotonic_base_time = std::nullopt;
 
  private:
   // The stuff here is to pull the data out of the gstreamer pipeline, such that
   // we can forward it to the WB link
-  void on_new_rtp_frame_fragment(std::shared_ptr<std::vector<uint8_t>> fragment,
-                                 uint64_t dts);
+  void on_new_rtp_frame_fragment(openhd::VideoFragment fragment, uint64_t dts);
   void on_new_rtp_fragmented_frame();
-  std::vector<std::shared_ptr<std::vector<uint8_t>>> m_frame_fragments;
+  std::vector<openhd::VideoFragment> m_frame_fragments;
+  // Trace of the frame that is currently being aggregated
+  openhd::FrameTrace m_curr_frame_trace{};
 
   void x_on_new_rtp_fragmented_frame(
-      std::vector<std::shared_ptr<std::vector<uint8_t>>> frame_fragments);
+      std::vector<openhd::VideoFragment> frame_fragments);
   bool m_last_fu_s_idr = false;
   bool dirty_use_raw = false;
   std::chrono::steady_clock::time_point m_last_log_streaming_disabled =
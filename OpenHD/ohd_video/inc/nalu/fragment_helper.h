@@ -7,6 +7,11 @@
 
 #include <unistd.h>
 
+#include <memory>
+#include <vector>
+
+#include "openhd_fragment_pool.h"
+
 static std::vector<std::shared_ptr<std::vector<uint8_t>>> make_fragments(
     const uint8_t* data, int data_len) {
   std::vector<std::shared_ptr<std::vector<uint8_t>>> fragments;
@@ -22,7 +27,7 @@ static std::vector<std::shared_ptr<std::vector<uint8_t>>> make_fragments(
       len = remaining;
     }
     std::shared_ptr<std::vector<uint8_t>> fragment =
-        std::make_shared<std::vector<uint8_t>>(p, p + len);
+        openhd::FragmentPool::instance().copy(p, len);
     fragments.emplace_back(fragment);
     p = p + len;
     bytes_used += len;
@@ -7,39 +7,110 @@
 
 #include <unistd.h>
 
-static int find_next_nal(const uint8_t* data, int data_len) {
-  int nalu_search_state = 0;
-  for (int i = 0; i < data_len; i++) {
-    switch (nalu_search_state) {
-      case 0:
-      case 1:
-        if (data[i] == 0)
-          nalu_search_state++;
-        else
-          nalu_search_state = 0;
-        break;
-      case 2:
-      case 3:
-        if (data[i] == 0) {
-          nalu_search_state++;
-        } else if (data[i] == 1) {
-          // 0,0,0,1 or 0,0,1
-          const int len = nalu_search_state == 2 ? 2 : 3;
-          if (i > len) {
-            return i - len;
-          }
-          nalu_search_state = 0;
-        } else {
-          nalu_search_state = 0;
-        }
-        break;
-      default:
-        break;
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// The start code 0,0,1 begins at k - if it is a 0,0,0,1 start code, the NAL
+// begins one byte earlier.
+static int x_start_code_begin(const uint8_t* data, int k) {
+  return (k > 0 && data[k - 1] == 0) ? k - 1 : k;
+}
+
+// Scalar implementation of find_next_nal, begins searching for 0,0,1 at
+// offset begin. Also used for the tail of the SIMD implementation(s).
+static int find_next_nal_scalar(const uint8_t* data, int data_len,
+                                int begin = 0) {
+  for (int k = begin; k + 2 < data_len; k++) {
+    if (data[k + 2] > 1) {
+      // Neither k, k+1 nor k+2 can be the beginning of 0,0,1
+      k += 2;
+      continue;
+    }
+    if (data[k] == 0 && data[k + 1] == 0 && data[k + 2] == 1) {
+      const int nal_begin = x_start_code_begin(data, k);
+      if (nal_begin > 0) return nal_begin;
     }
   }
   return data_len;
 }
 
+/**
+ * Returns the offset of the first annex b start code (0,0,1 or 0,0,0,1) in
+ * data that does not begin at offset 0 (the start code of the current NAL),
+ * or data_len if there is none.
+ * Since we might read up to data_len bytes, data_len has to be the remaining
+ * length from data on, not the length of the whole buffer.
+ * Uses SSE2 / AVX2 / NEON if available at compile time, since this is the
+ * dominant cost when splitting raw encoder output with high bitrates.
+ */
+static int find_next_nal(const uint8_t* data, int data_len) {
+  int i = 0;
+#if defined(__AVX2__)
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi8(1);
+  for (; i + 32 + 2 <= data_len; i += 32) {
+    const __m256i v0 = _mm256_loadu_si256((const __m256i*)(data + i));
+    const __m256i v1 = _mm256_loadu_si256((const __m256i*)(data + i + 1));
+    const __m256i v2 = _mm256_loadu_si256((const __m256i*)(data + i + 2));
+    const __m256i match =
+        _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(v0, zero),
+                                          _mm256_cmpeq_epi8(v1, zero)),
+                         _mm256_cmpeq_epi8(v2, one));
+    auto mask = (uint32_t)_mm256_movemask_epi8(match);
+    while (mask != 0) {
+      const int nal_begin =
+          x_start_code_begin(data, i + __builtin_ctz(mask));
+      if (nal_begin > 0) return nal_begin;
+      mask &= mask - 1;
+    }
+  }
+#elif defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi8(1);
+  for (; i + 16 + 2 <= data_len; i += 16) {
+    const __m128i v0 = _mm_loadu_si128((const __m128i*)(data + i));
+    const __m128i v1 = _mm_loadu_si128((const __m128i*)(data + i + 1));
+    const __m128i v2 = _mm_loadu_si128((const __m128i*)(data + i + 2));
+    const __m128i match = _mm_and_si128(
+        _mm_and_si128(_mm_cmpeq_epi8(v0, zero), _mm_cmpeq_epi8(v1, zero)),
+        _mm_cmpeq_epi8(v2, one));
+    auto mask = (uint32_t)_mm_movemask_epi8(match);
+    while (mask != 0) {
+      const int nal_begin =
+          x_start_code_begin(data, i + __builtin_ctz(mask));
+      if (nal_begin > 0) return nal_begin;
+      mask &= mask - 1;
+    }
+  }
+#elif defined(__ARM_NEON)
+  const uint8x16_t zero = vdupq_n_u8(0);
+  const uint8x16_t one = vdupq_n_u8(1);
+  for (; i + 16 + 2 <= data_len; i += 16) {
+    const uint8x16_t v0 = vld1q_u8(data + i);
+    const uint8x16_t v1 = vld1q_u8(data + i + 1);
+    const uint8x16_t v2 = vld1q_u8(data + i + 2);
+    const uint8x16_t match = vandq_u8(
+        vandq_u8(vceqq_u8(v0, zero), vceqq_u8(v1, zero)), vceqq_u8(v2, one));
+    const uint64x2_t match64 = vreinterpretq_u64_u8(match);
+    if ((vgetq_lane_u64(match64, 0) | vgetq_lane_u64(match64, 1)) == 0) {
+      continue;
+    }
+    // Start codes are rare, find the exact position(s) the scalar way
+    const int nal_begin = find_next_nal_scalar(data, i + 16 + 2, i);
+    if (nal_begin < i + 16 + 2) return nal_begin;
+  }
+#endif
+  return find_next_nal_scalar(data, data_len, i);
+}
+
 static std::array<uint8_t, 6> EXAMPLE_AUD = {0, 0, 0, 1, 9, 48};
 static std::shared_ptr<std::vector<uint8_t>> get_h264_aud() {
   return std::make_shared<std::vector<uint8_t>>(
@@ -5,8 +5,10 @@
 #ifndef OPENHD_OPENHD_OHD_VIDEO_INC_OHD_VIDEO_GROUND_H_
 #define OPENHD_OPENHD_OHD_VIDEO_INC_OHD_VIDEO_GROUND_H_
 
+#include "video_recorder.h"
 #include "openhd_external_device.h"
 #include "openhd_link.hpp"
+#include "openhd_rtp.h"
 #include "openhd_udp.h"
 
 // The ground just stupidly forwards video (rtp fragments, to be exact) via UDP
@@ -16,6 +18,10 @@
 // re-fragmentation is up to the displaying application (which is why we have
 // rtp ;) ) NOTE: There is no way to query any information or change
 // camera/streaming info on the ground. This design is by purpose !
+// In addition, the rtp data is re-assembled into complete access units
+// (see RTPFrameReassembler) for anything on the ground that needs whole
+// frames (e.g. recording, frame statistics) - only if there is such a
+// consumer, otherwise the rtp data is not touched at all.
 class OHDVideoGround {
  public:
   /**
@@ -24,6 +30,16 @@ class OHDVideoGround {
    */
   explicit OHDVideoGround(std::shared_ptr<OHDLink> link_handle);
   ~OHDVideoGround();
+  typedef std::function<void(
+      int stream_index,
+      const openhd::RTPFrameReassembler::AccessUnit& access_unit)>
+      ON_ACCESS_UNIT_CB;
+  /**
+   * Called (from the link rx thread) for each re-assembled access unit of
+   * the primary (0) and secondary (1) video stream.
+   * Set before any data is received, or nullptr to disable.
+   */
+  void set_on_access_unit_cb(ON_ACCESS_UNIT_CB cb);
 
  private:
   // Start forwarding to another ip
@@ -37,6 +53,24 @@ class OHDVideoGround {
   std::unique_ptr<openhd::UDPMultiForwarder> m_primary_video_forwarder;
   std::unique_ptr<openhd::UDPMultiForwarder> m_secondary_video_forwarder;
   std::unique_ptr<openhd::UDPMultiForwarder> m_audio_forwarder;
+  std::unique_ptr<openhd::RTPFrameReassembler> m_primary_reassembler;
+  std::unique_ptr<openhd::RTPFrameReassembler> m_secondary_reassembler;
+  ON_ACCESS_UNIT_CB m_access_unit_cb = nullptr;
+  // Re-assemble access units only if there is a recorder and / or callback
+  bool m_reassemble = false;
+  // Only if enabled in the hardware.config
+  std::unique_ptr<VideoRecorder> m_primary_recorder;
+  std::unique_ptr<VideoRecorder> m_secondary_recorder;
+  std::chrono::steady_clock::time_point m_last_reassembler_log =
+      std::chrono::steady_clock::now();
+  // The rtp fragments of the frame currently being received, forwarded with
+  // one (batched) send once the frame is complete
+  struct FrameBatch {
+    openhd::UDPPacketBatch packets;
+    uint32_t rtp_timestamp = 0;
+  };
+  FrameBatch m_primary_batch;
+  FrameBatch m_secondary_batch;
   /**
    * Forward video to all device(s) consuming video.
    * Called by the ohd link handle (aka only wb right now)
@@ -44,6 +78,15 @@ class OHDVideoGround {
    * @param data and @param data_len: r.n always a full rtp frame fragment
    */
   void on_video_data(int stream_index, const uint8_t* data, int data_len);
+  void on_access_unit(
+      int stream_index,
+      const openhd::RTPFrameReassembler::AccessUnit& access_unit);
+  // Adds the rtp fragment to the batch and forwards the batch once the frame
+  // is complete (marker bit set) - or the next frame starts, in case the
+  // fragment with the marker bit was lost.
+  static void batch_and_forward(FrameBatch& batch,
+                                openhd::UDPMultiForwarder& forwarder,
+                                const uint8_t* data, int data_len);
 
   /**
    * Forward audio. We only have up to 1 audio stream
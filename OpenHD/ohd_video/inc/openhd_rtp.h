@@ -5,10 +5,15 @@
 #ifndef OPENHD_OPENHD_RTP_H
 #define OPENHD_OPENHD_RTP_H
 
+#include <atomic>
+#include <optional>
+
 #include "nalu/CodecConfigFinder.hpp"
 #include "openhd_link.hpp"
+#include "openhd_rtp_packetizer.h"
 #include "openhd_spdlog.h"
-#include "rtp-payload-internal.h"
+#include "openhd_video_frame.h"
+#include "rtp-payload.h"
 
 namespace openhd {
 
@@ -19,17 +24,15 @@ namespace openhd {
  * properly forward a fragmented frame 2) We use gstreamer or something else for
  * h264/h265 encoding, but not rtp encoding - in this case, we get
  * TODO: Be specific on the format
- * NALUs and packetize them using lib rtp. The first
+ * NALUs and packetize them (see RTPPacketizer). The first
  * approach is much more reliable, but the second approach has its own
  * advantages, too.
  */
 class RTPHelper {
  public:
   explicit RTPHelper(bool is_h265);
-  ~RTPHelper();
 
-  typedef std::function<void(
-      std::vector<std::shared_ptr<std::vector<uint8_t>>> frame_fragments)>
+  typedef std::function<void(std::vector<VideoFragment> frame_fragments)>
       OUT_CB;
   void set_out_cb(RTPHelper::OUT_CB cb);
 
@@ -40,20 +43,14 @@ class RTPHelper {
   // Feeds exactly one NALU
   void feed_nalu(const uint8_t* data, int data_len);
 
- public:
-  // public due to c/c++ mix (callbacks)
-  void on_new_rtp_fragment(const uint8_t* nalu, int bytes, uint32_t timestamp,
-                           int last);
-
  private:
   void on_new_split_nalu(const uint8_t* data, int data_len);
   void on_new_nalu_frame(const uint8_t* data, int data_len);
   const bool m_is_h265;
   OUT_CB m_out_cb = nullptr;
-  rtp_payload_t m_handler{};
-  void* encoder;
+  RTPPacketizer m_packetizer;
   std::shared_ptr<spdlog::logger> m_console;
-  std::vector<std::shared_ptr<std::vector<uint8_t>>> m_frame_fragments;
+  std::vector<VideoFragment> m_frame_fragments;
   CodecConfigFinder m_config_finder;
   std::chrono::steady_clock::time_point m_last_codec_config_send_ts =
       std::chrono::steady_clock::now();
@@ -62,8 +59,7 @@ class RTPHelper {
 class RTPFragmentBuffer {
  public:
   explicit RTPFragmentBuffer();
-  void buffer_and_forward(std::shared_ptr<std::vector<uint8_t>> fragment,
-                          uint64_t dts);
+  void buffer_and_forward(VideoFragment fragment, uint64_t dts);
 
  public:
   bool m_enable_ultra_secure_encryption = false;
@@ -77,7 +73,81 @@ class RTPFragmentBuffer {
  private:
   std::shared_ptr<spdlog::logger> m_console;
   bool m_last_fu_s_idr = false;
-  std::vector<std::shared_ptr<std::vector<uint8_t>>> m_frame_fragments;
+  std::vector<VideoFragment> m_frame_fragments;
+};
+
+/**
+ * Ground: De-packetizes H264 / H265 rtp (single NAL unit, STAP-A / AP, FU-A /
+ * FU) using librtp and re-assembles complete access units in annex b format.
+ * The codec is detected from the codec config the air unit sends
+ * regularly, until then, all data is discarded. The codec is detected again
+ * if the config of the other codec arrives, or after a burst of invalid
+ * packets (without a complete access unit in between).
+ * wifibroadcast already delivers the packets in order, so there is no jitter
+ * buffer - an access unit is emitted as soon as its last packet (marker bit)
+ * is received, or once the rtp timestamp changes.
+ * Not thread-safe, feed from one thread.
+ */
+class RTPFrameReassembler {
+ public:
+  struct AccessUnit {
+    // Each NAL unit prefixed with a 0,0,0,1 start code
+    std::shared_ptr<std::vector<uint8_t>> data;
+    uint32_t rtp_timestamp = 0;
+    bool is_h265 = false;
+    // Contains an IDR (H264) / IRAP (H265) NAL unit
+    bool is_keyframe = false;
+    // Contains SPS / PPS (/ VPS)
+    bool has_config = false;
+    // Packet(s) of this access unit (or right before it) have been lost, it
+    // most likely won't decode without artifacts
+    bool has_loss = false;
+    int n_nalus = 0;
+  };
+  typedef std::function<void(const AccessUnit& access_unit)> OUT_CB;
+  explicit RTPFrameReassembler(OUT_CB out_cb);
+  ~RTPFrameReassembler();
+  RTPFrameReassembler(const RTPFrameReassembler&) = delete;
+  RTPFrameReassembler& operator=(const RTPFrameReassembler&) = delete;
+  void on_rtp_packet(const uint8_t* data, int data_len);
+  struct Stats {
+    int n_frames = 0;
+    int n_keyframes = 0;
+    int n_frames_with_loss = 0;
+  };
+  // Thread-safe
+  Stats get_stats() const;
+
+ public:
+  // public due to c/c++ mix (callbacks)
+  void on_new_nalu(const uint8_t* nalu, int nalu_len, uint32_t timestamp,
+                   int flags);
+
+ private:
+  // Returns true if the codec could be detected from this rtp payload
+  bool detect_codec(const uint8_t* payload, int payload_len);
+  // Drops the decoder and the current access unit, the codec is detected
+  // again from the next codec config
+  void reset();
+  void forward_access_unit();
+
+ private:
+  std::shared_ptr<spdlog::logger> m_console;
+  OUT_CB m_out_cb;
+  std::optional<bool> m_is_h265 = std::nullopt;
+  void* m_decoder = nullptr;
+  rtp_payload_t m_handler{};
+  AccessUnit m_curr_access_unit{};
+  // The current access unit contains (a part of) a coded picture
+  bool m_curr_has_vcl = false;
+  // Reserve roughly the size of the previous access unit
+  size_t m_last_access_unit_size = 0;
+  // Invalid packets since the last access unit without loss
+  int m_n_decode_errors = 0;
+  static constexpr int MAX_DECODE_ERRORS = 50;
+  std::atomic<int> m_n_frames = 0;
+  std::atomic<int> m_n_keyframes = 0;
+  std::atomic<int> m_n_frames_with_loss = 0;
 };
 
 }  // namespace openhd
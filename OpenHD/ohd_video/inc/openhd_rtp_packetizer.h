@@ -0,0 +1,55 @@
+#ifndef OPENHD_OPENHD_RTP_PACKETIZER_H
+#define OPENHD_OPENHD_RTP_PACKETIZER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "openhd_video_frame.h"
+
+namespace openhd {
+
+/**
+ * Minimal RTP packetizer for H264 (RFC6184) / H265 (RFC7798), non-interleaved
+ * mode (single NAL unit packets and FU-A / FU packets, no aggregation).
+ * Unlike librtp (which serializes each packet into a scratch buffer we then
+ * have to copy) this writes the RTP header, the FU header(s) and the payload
+ * directly into pooled fragment buffers - one copy of the encoded data, and
+ * all state is per instance (safe with multiple cameras).
+ */
+class RTPPacketizer {
+ public:
+  // Same as the librtp default (from VLC)
+  static constexpr int DEFAULT_MAX_PACKET_SIZE = 1434;
+  static constexpr int RTP_HEADER_SIZE = 12;
+  explicit RTPPacketizer(bool is_h265,
+                         int max_packet_size = DEFAULT_MAX_PACKET_SIZE,
+                         uint8_t payload_type = 96, uint32_t ssrc = 0);
+  /**
+   * Packetizes one or more annex b NAL units (each with start code) and
+   * appends the resulting RTP packets to out. The marker bit is set on the
+   * last packet of the last (VCL) NAL unit.
+   */
+  void packetize(const uint8_t* data, int data_len, uint32_t timestamp,
+                 std::vector<VideoFragment>& out);
+
+ private:
+  // nalu without start code
+  void packetize_nalu(const uint8_t* nalu, int nalu_len, bool last,
+                      std::vector<VideoFragment>& out);
+  void packetize_fu(const uint8_t* nalu, int nalu_len, bool mark,
+                    std::vector<VideoFragment>& out);
+  void write_header(uint8_t* dst, bool mark);
+  bool is_vcl(const uint8_t* nalu) const;
+
+ private:
+  const bool m_is_h265;
+  const int m_max_packet_size;
+  const uint8_t m_payload_type;
+  const uint32_t m_ssrc;
+  uint16_t m_seq = 0;
+  uint32_t m_timestamp = 0;
+};
+
+}  // namespace openhd
+
+#endif  // OPENHD_OPENHD_RTP_PACKETIZER_H
@@ -0,0 +1,64 @@
+#ifndef OPENHD_RECORDING_REMUXER_H
+#define OPENHD_RECORDING_REMUXER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "openhd_spdlog.h"
+
+/**
+ * Converts .mkv (matroska) air recording files into more manageable .mp4
+ * files, in process (no gstreamer / gst-launch).
+ * The H264 / H265 data is moved from the mmap'ed .mkv straight into
+ * (fragmented) mp4 fragments, no re-encoding and no copy of the sample data.
+ * All files are processed one after another by a small pool of worker
+ * thread(s) with the lowest cpu and idle I/O priority, no matter how many
+ * files are queued - so this never competes with streaming / recording.
+ */
+class RecordingRemuxer {
+ public:
+  ~RecordingRemuxer();
+  static RecordingRemuxer& instance();
+  // Queue all files that end in .mkv in the openhd videos (air recording)
+  // directory, e.g. left over after an unsafe shutdown
+  void remux_all_remaining_mkv_files_async();
+  // Queue a specific .mkv file unless it is already queued / being
+  // converted. Thread-safe
+  void remux_mkv_file_async_threadsafe(const std::string& filename);
+  /**
+   * Converts in_file (.mkv) to out_file (.mp4) on the calling thread.
+   * Returns false if the input cannot be parsed (unsupported codec / no
+   * video data), the output cannot be written or it has been cancelled.
+   */
+  static bool remux_mkv_to_mp4(const std::string& in_file,
+                               const std::string& out_file,
+                               const std::atomic<bool>* cancel = nullptr);
+
+ private:
+  RecordingRemuxer();
+  void loop();
+  void remux_mkv(const std::string& in_file);
+
+ private:
+  // The SD card is the bottleneck, more than one worker doesn't really
+  // speed things up
+  static constexpr int N_WORKERS = 1;
+  std::shared_ptr<spdlog::logger> m_console;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::deque<std::string> m_queue;
+  // Queued or currently being converted
+  std::set<std::string> m_pending;
+  bool m_stop = false;
+  std::atomic<bool> m_cancel = false;
+  std::vector<std::thread> m_workers;
+};
+
+#endif  // OPENHD_RECORDING_REMUXER_H
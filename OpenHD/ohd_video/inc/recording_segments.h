@@ -0,0 +1,109 @@
+#ifndef OPENHD_RECORDING_SEGMENTS_H
+#define OPENHD_RECORDING_SEGMENTS_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "async_file_writer.h"
+#include "openhd_spdlog.h"
+
+/**
+ * Keeps track of all segments of (segmented) air recordings, oldest first,
+ * persisted in a small text file in the video directory. Used to
+ * 1) repair the segment(s) that were still being written when OpenHD
+ * stopped unexpectedly (e.g. power loss) and
+ * 2) free up space by deleting the oldest segments, instead of having to stop
+ * recording when the disk is full.
+ * Thread-safe.
+ */
+class RecordingSegmentIndex {
+ public:
+  static RecordingSegmentIndex& instance();
+  // Call once on startup, before any recording is started
+  void recover_unfinished_segments();
+  // A new segment is about to be written
+  void add_segment(const std::string& filename);
+  // The segment has been closed, an empty segment is deleted
+  void on_segment_closed(const std::string& filename, bool empty);
+  // Deletes the oldest closed segments until (at least) min_free_space_mb
+  // are available, or no closed segment is left.
+  void prune(int min_free_space_mb);
+  /**
+   * Truncates a (fragmented mp4) segment to its last complete fragment.
+   * Returns false if the segment does not contain a single complete
+   * fragment.
+   */
+  static bool repair_segment(const std::string& filename);
+
+ private:
+  explicit RecordingSegmentIndex(std::string index_filename);
+  void load();
+  void persist();
+  struct Entry {
+    std::string filename;
+    bool closed;
+  };
+
+ private:
+  std::shared_ptr<spdlog::logger> m_console;
+  const std::string m_index_filename;
+  std::mutex m_mutex;
+  std::vector<Entry> m_entries;
+};
+
+/**
+ * Provides the files for one air recording that is split into segments
+ * (recording_N_0001.mp4, recording_N_0002.mp4, ...). Everything that can
+ * stall on a slow SD card - creating and pre-allocating the next segment,
+ * flushing and closing the previous one, updating the index and pruning old
+ * segments - is done on a background thread. The recording thread only ever
+ * takes the already prepared next segment and hands back the finished one,
+ * so a slow disk can never block (backpressure) the encoder.
+ */
+class RecordingSegmentStore {
+ public:
+  /**
+   * @param base_filename recording_N (see create_unused_recording_filename),
+   * allocated by the caller - each store needs its own.
+   * @param segment_size_bytes the expected size of one segment, the space is
+   * reserved when the segment is created.
+   * @param min_free_space_mb old segments are pruned while less space is
+   * available.
+   */
+  RecordingSegmentStore(std::string base_filename, uint64_t segment_size_bytes,
+                        int min_free_space_mb);
+  // Closes all segments, blocks until they are written
+  ~RecordingSegmentStore();
+  RecordingSegmentStore(const RecordingSegmentStore&) = delete;
+  RecordingSegmentStore& operator=(const RecordingSegmentStore&) = delete;
+  // Non-blocking, returns nullptr if the next segment is not ready (yet)
+  std::unique_ptr<openhd::AsyncFileWriter> take_next_segment();
+  // Non-blocking, the segment is flushed and closed in the background
+  void retire_segment(std::unique_ptr<openhd::AsyncFileWriter> segment);
+
+ private:
+  void loop();
+  std::unique_ptr<openhd::AsyncFileWriter> create_segment();
+  void close_segment(std::unique_ptr<openhd::AsyncFileWriter> segment);
+
+ private:
+  std::shared_ptr<spdlog::logger> m_console;
+  const uint64_t m_segment_size_bytes;
+  const int m_min_free_space_mb;
+  const std::string m_base_filename;
+  // Only accessed by the background thread
+  int m_n_segments = 0;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::unique_ptr<openhd::AsyncFileWriter> m_next_segment;
+  std::vector<std::unique_ptr<openhd::AsyncFileWriter>> m_retired_segments;
+  bool m_stop = false;
+  std::unique_ptr<std::thread> m_thread;
+};
+
+#endif  // OPENHD_RECORDING_SEGMENTS_H
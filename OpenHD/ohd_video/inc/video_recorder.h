@@ -0,0 +1,149 @@
+#ifndef OPENHD_VIDEO_RECORDER_H
+#define OPENHD_VIDEO_RECORDER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "async_file_writer.h"
+#include "fmp4_muxer.h"
+#include "openhd_rtp.h"
+#include "openhd_spdlog.h"
+#include "openhd_video_frame.h"
+#include "recording_segments.h"
+
+/**
+ * Opens and closes the file(s) of a recording that is not split into
+ * segments (ground) on a background thread, like RecordingSegmentStore does
+ * for the air unit - creating a file and flushing / syncing / closing the
+ * previous one can stall on a slow disk, and the recorder is fed from the
+ * link rx thread. A file is only opened on request, such that there are no
+ * empty files if nothing is ever recorded.
+ */
+class RecordingFileStore {
+ public:
+  // Files are named recording_N + filename_suffix, recording_N_2 +
+  // filename_suffix, ...
+  RecordingFileStore(int recording_index, std::string filename_suffix);
+  // Closes all files, blocks until they are written
+  ~RecordingFileStore();
+  RecordingFileStore(const RecordingFileStore&) = delete;
+  RecordingFileStore& operator=(const RecordingFileStore&) = delete;
+  // Non-blocking, returns nullptr if the next file is not open yet - it is
+  // opened in the background then
+  std::unique_ptr<openhd::AsyncFileWriter> take_next_file();
+  // Non-blocking, the file is flushed and closed in the background
+  void retire_file(std::unique_ptr<openhd::AsyncFileWriter> file);
+
+ private:
+  void loop();
+  std::unique_ptr<openhd::AsyncFileWriter> open_file();
+
+ private:
+  std::shared_ptr<spdlog::logger> m_console;
+  const int m_recording_index;
+  const std::string m_filename_suffix;
+  // Only accessed by the background thread
+  int m_n_files = 0;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::unique_ptr<openhd::AsyncFileWriter> m_next_file;
+  bool m_next_file_requested = false;
+  std::vector<std::unique_ptr<openhd::AsyncFileWriter>> m_retired_files;
+  bool m_stop = false;
+  std::unique_ptr<std::thread> m_thread;
+};
+
+/**
+ * Records (re-assembled) video into fragmented mp4 file(s), without gstreamer
+ * and without touching the forwarding path. Used on the ground for the video
+ * received from the air unit, and on the air unit for the encoded video.
+ * Recording starts at the first keyframe after the codec config has been
+ * received, a new file is started if the codec config changes.
+ * Fragments are written by an AsyncFileWriter - a file is playable up to the
+ * last fragment that made it to disk, even after a power loss.
+ * Not thread-safe, feed from one thread.
+ */
+class VideoRecorder {
+ public:
+  // Records into the files provided by file_store
+  explicit VideoRecorder(std::unique_ptr<RecordingFileStore> file_store);
+  // Records into segments provided by segment_store, a new segment is started
+  // at the first keyframe after segment_duration.
+  VideoRecorder(std::shared_ptr<RecordingSegmentStore> segment_store,
+                std::chrono::seconds segment_duration);
+  ~VideoRecorder();
+  void on_access_unit(
+      const openhd::RTPFrameReassembler::AccessUnit& access_unit);
+
+ private:
+  // Returns true if the codec config changed
+  bool update_codec_config(const uint8_t* data, int data_len, bool is_h265);
+  // Stops the current file (if any) once the new one could be opened
+  void start_file(bool is_h265);
+  // nullptr if no file is available (yet)
+  std::unique_ptr<openhd::AsyncFileWriter> open_file();
+  void stop_file();
+  void write_fragment();
+
+ private:
+  std::shared_ptr<spdlog::logger> m_console;
+  const std::unique_ptr<RecordingFileStore> m_file_store;
+  const std::shared_ptr<RecordingSegmentStore> m_segment_store;
+  const std::chrono::seconds m_segment_duration{0};
+  std::chrono::steady_clock::time_point m_file_start;
+  std::vector<uint8_t> m_vps;
+  std::vector<uint8_t> m_sps;
+  std::vector<uint8_t> m_pps;
+  std::unique_ptr<openhd::FMP4Muxer> m_muxer;
+  std::unique_ptr<openhd::AsyncFileWriter> m_writer;
+  // The duration of the last sample is only known once the next one arrives
+  std::vector<openhd::FMP4Muxer::Sample> m_fragment_samples;
+  uint32_t m_last_sample_rtp_timestamp = 0;
+  uint64_t m_fragment_duration = 0;
+};
+
+/**
+ * Records rtp frames on its own thread - the frames are handed over right
+ * after they went to the link, such that re-assembly and muxing never delay
+ * (or take cpu from) the transmit path. The handover queue is bounded: the
+ * fragments might reference encoder memory (GstBuffer(s)), so only a few
+ * frames are held. If the recording thread falls behind, frames are dropped
+ * until the next keyframe (a recording with a gap instead of artifacts).
+ */
+class AsyncVideoRecorder {
+ public:
+  explicit AsyncVideoRecorder(std::unique_ptr<VideoRecorder> recorder);
+  // Records everything still queued, then stops the recorder
+  ~AsyncVideoRecorder();
+  AsyncVideoRecorder(const AsyncVideoRecorder&) = delete;
+  AsyncVideoRecorder& operator=(const AsyncVideoRecorder&) = delete;
+  // Non-blocking, feed from one thread
+  void enqueue_frame(std::vector<openhd::VideoFragment> rtp_fragments,
+                     bool is_keyframe, bool is_intra_stream);
+  static constexpr size_t MAX_QUEUED_FRAMES = 8;
+
+ private:
+  void loop();
+
+ private:
+  std::shared_ptr<spdlog::logger> m_console;
+  // Recording thread only
+  std::unique_ptr<VideoRecorder> m_recorder;
+  std::unique_ptr<openhd::RTPFrameReassembler> m_reassembler;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::deque<std::vector<openhd::VideoFragment>> m_queue;
+  bool m_stop = false;
+  // Feeding thread only
+  bool m_wait_for_keyframe = false;
+  int m_n_dropped_frames = 0;
+  std::unique_ptr<std::thread> m_thread;
+};
+
+#endif  // OPENHD_VIDEO_RECORDER_H
@@ -5,6 +5,10 @@
 
 #define RTP_FIXED_HEADER 12
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct rtp_packet_t
 {
 	rtp_header_t rtp;
@@ -22,4 +26,7 @@ int rtp_packet_deserialize(struct rtp_packet_t *pkt, const void* data, int bytes
 ///@return <0-error, >0-rtp packet size, =0-impossible
 int rtp_packet_serialize(const struct rtp_packet_t *pkt, void* data, int bytes);
 
+#ifdef __cplusplus
+}
+#endif
 #endif /* !_rtp_packet_h_ */
@@ -51,6 +51,8 @@ struct rtp_payload_encode_t *rtp_vp9_encode(void);
 struct rtp_payload_encode_t *rtp_av1_encode(void);*/
 struct rtp_payload_encode_t *rtp_h264_encode(void);
 struct rtp_payload_encode_t *rtp_h265_encode(void);
+struct rtp_payload_decode_t *rtp_h264_decode(void);
+struct rtp_payload_decode_t *rtp_h265_decode(void);
 /*struct rtp_payload_encode_t* rtp_h266_encode(void);
 struct rtp_payload_encode_t *rtp_common_encode(void);
 struct rtp_payload_encode_t *rtp_mp4v_es_encode(void);
@@ -63,8 +65,6 @@ struct rtp_payload_decode_t *rtp_ps_decode(void);
 struct rtp_payload_decode_t *rtp_vp8_decode(void);
 struct rtp_payload_decode_t *rtp_vp9_decode(void);
 struct rtp_payload_decode_t *rtp_av1_decode(void);
-struct rtp_payload_decode_t *rtp_h264_decode(void);
-struct rtp_payload_decode_t *rtp_h265_decode(void);
 struct rtp_payload_decode_t* rtp_h266_decode(void);
 struct rtp_payload_decode_t *rtp_common_decode(void);
 struct rtp_payload_decode_t *rtp_mp4v_es_decode(void);
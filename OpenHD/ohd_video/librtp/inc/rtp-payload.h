@@ -12,6 +12,8 @@ extern "C" {
 /// RTP packet lost(miss packet before this frame)
 #define RTP_PAYLOAD_FLAG_PACKET_LOST	0x0100 // some packets lost before the packet
 #define RTP_PAYLOAD_FLAG_PACKET_CORRUPT 0x0200 // the packet data is corrupt
+/// RTP marker bit set on the packet this data ends in (end of access unit)
+#define RTP_PAYLOAD_FLAG_PACKET_MARKER	0x0400
 
 struct rtp_payload_t
 {
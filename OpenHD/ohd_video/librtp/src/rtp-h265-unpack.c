@@ -0,0 +1,203 @@
+// RFC7798 RTP Payload Format for High Efficiency Video Coding (HEVC)
+//
+// Depacketizer for single NAL unit packets, aggregation packets (AP) and
+// fragmentation units (FU), without DONL (sprop-max-don-diff=0). PACI packets
+// are discarded.
+// Each NAL unit is passed to the handler without start code. Lost packets
+// (sequence number gap) are reported via RTP_PAYLOAD_FLAG_PACKET_LOST on the
+// next NAL unit, a FU with a missing fragment is discarded.
+
+#include "rtp-packet.h"
+#include "rtp-payload-internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+
+#define H265_NAL_AP     48
+#define H265_NAL_FU     49
+#define FU_START        0x80
+#define FU_END          0x40
+
+struct rtp_decode_h265_t
+{
+	struct rtp_payload_t handler;
+	void* cbparam;
+
+	uint16_t seq; // next expected sequence number
+	int have_seq;
+	int flags; // flags for the next NAL unit
+
+	// FU reassembly
+	int fu_active;
+	uint8_t* ptr;
+	int size;
+	int capacity;
+};
+
+static void* rtp_h265_unpack_create(struct rtp_payload_t *handler, void* param)
+{
+	struct rtp_decode_h265_t *unpacker;
+	unpacker = (struct rtp_decode_h265_t *)calloc(1, sizeof(*unpacker));
+	if(!unpacker)
+		return NULL;
+
+	memcpy(&unpacker->handler, handler, sizeof(unpacker->handler));
+	unpacker->cbparam = param;
+	return unpacker;
+}
+
+static void rtp_h265_unpack_destroy(void* p)
+{
+	struct rtp_decode_h265_t *unpacker;
+	unpacker = (struct rtp_decode_h265_t *)p;
+
+	if(unpacker->ptr)
+		free(unpacker->ptr);
+#if defined(_DEBUG) || defined(DEBUG)
+	memset(unpacker, 0xCC, sizeof(*unpacker));
+#endif
+	free(unpacker);
+}
+
+static int rtp_h265_unpack_emit(struct rtp_decode_h265_t *unpacker, const uint8_t* nalu, int bytes, uint32_t timestamp, int marker)
+{
+	int r, flags;
+	flags = unpacker->flags | (marker ? RTP_PAYLOAD_FLAG_PACKET_MARKER : 0);
+	unpacker->flags = 0;
+	r = unpacker->handler.packet(unpacker->cbparam, nalu, bytes, timestamp, flags);
+	return 0 == r ? 1 : r;
+}
+
+static int rtp_h265_unpack_fu_append(struct rtp_decode_h265_t *unpacker, const uint8_t* data, int bytes)
+{
+	void* p;
+	int capacity;
+	if (unpacker->size + bytes > unpacker->capacity)
+	{
+		capacity = unpacker->size + bytes + 64 * 1024;
+		p = realloc(unpacker->ptr, capacity);
+		if (!p)
+			return -ENOMEM;
+		unpacker->ptr = (uint8_t*)p;
+		unpacker->capacity = capacity;
+	}
+	memcpy(unpacker->ptr + unpacker->size, data, bytes);
+	unpacker->size += bytes;
+	return 0;
+}
+
+// 4.4.2. Aggregation Packets (APs) (p25)
+static int rtp_h265_unpack_ap(struct rtp_decode_h265_t *unpacker, const uint8_t* ptr, int bytes, uint32_t timestamp, int marker)
+{
+	int r, n;
+	r = 0;
+	ptr += 2; // skip AP payload header
+	bytes -= 2;
+	while (bytes > 2 && r >= 0)
+	{
+		n = (ptr[0] << 8) | ptr[1];
+		ptr += 2;
+		bytes -= 2;
+		if (n <= 0 || n > bytes)
+		{
+			unpacker->flags |= RTP_PAYLOAD_FLAG_PACKET_CORRUPT;
+			return 0;
+		}
+		r = rtp_h265_unpack_emit(unpacker, ptr, n, timestamp, marker && n == bytes);
+		ptr += n;
+		bytes -= n;
+	}
+	return r;
+}
+
+// 4.4.3. Fragmentation Units (p29)
+static int rtp_h265_unpack_fu(struct rtp_decode_h265_t *unpacker, const uint8_t* ptr, int bytes, uint32_t timestamp, int marker)
+{
+	uint8_t fu_header, nal_header[2];
+	if (bytes < 3)
+		return 0;
+
+	fu_header = ptr[2];
+	if (fu_header & FU_START)
+	{
+		if (unpacker->fu_active)
+			unpacker->flags |= RTP_PAYLOAD_FLAG_PACKET_LOST; // no end of previous FU
+		// Reconstruct the NAL unit header from payload header and FU header
+		nal_header[0] = (ptr[0] & 0x81) | ((fu_header & 0x3F) << 1);
+		nal_header[1] = ptr[1];
+		unpacker->size = 0;
+		unpacker->fu_active = 1;
+		if (0 != rtp_h265_unpack_fu_append(unpacker, nal_header, 2))
+			return -ENOMEM;
+	}
+	else if (!unpacker->fu_active)
+	{
+		// we didn't get the start of this NAL unit
+		unpacker->flags |= RTP_PAYLOAD_FLAG_PACKET_LOST;
+		return 0;
+	}
+
+	if (0 != rtp_h265_unpack_fu_append(unpacker, ptr + 3, bytes - 3))
+		return -ENOMEM;
+
+	if (fu_header & FU_END)
+	{
+		unpacker->fu_active = 0;
+		return rtp_h265_unpack_emit(unpacker, unpacker->ptr, unpacker->size, timestamp, marker);
+	}
+	return 1;
+}
+
+static int rtp_h265_unpack_input(void* p, const void* packet, int bytes)
+{
+	uint8_t nal_type;
+	const uint8_t* ptr;
+	struct rtp_packet_t pkt;
+	struct rtp_decode_h265_t *unpacker;
+
+	unpacker = (struct rtp_decode_h265_t *)p;
+	if (!unpacker || bytes < RTP_FIXED_HEADER || RTP_VERSION != (((const uint8_t*)packet)[0] >> 6))
+		return -EINVAL;
+	if (0 != rtp_packet_deserialize(&pkt, packet, bytes) || pkt.payloadlen < 2)
+		return -EINVAL;
+
+	if (unpacker->have_seq && (uint16_t)pkt.rtp.seq != unpacker->seq)
+	{
+		unpacker->flags |= RTP_PAYLOAD_FLAG_PACKET_LOST;
+		unpacker->fu_active = 0; // the FU in progress is incomplete
+	}
+	unpacker->seq = (uint16_t)(pkt.rtp.seq + 1);
+	unpacker->have_seq = 1;
+
+	ptr = (const uint8_t*)pkt.payload;
+	nal_type = (ptr[0] >> 1) & 0x3F;
+	if (nal_type < H265_NAL_AP)
+	{
+		// 4.4.1. Single NAL Unit Packets (p24)
+		unpacker->fu_active = 0;
+		return rtp_h265_unpack_emit(unpacker, ptr, pkt.payloadlen, pkt.rtp.timestamp, pkt.rtp.m);
+	}
+	else if (nal_type == H265_NAL_AP)
+	{
+		unpacker->fu_active = 0;
+		return rtp_h265_unpack_ap(unpacker, ptr, pkt.payloadlen, pkt.rtp.timestamp, pkt.rtp.m);
+	}
+	else if (nal_type == H265_NAL_FU)
+	{
+		return rtp_h265_unpack_fu(unpacker, ptr, pkt.payloadlen, pkt.rtp.timestamp, pkt.rtp.m);
+	}
+	// PACI and reserved
+	return 0;
+}
+
+struct rtp_payload_decode_t *rtp_h265_decode()
+{
+	static struct rtp_payload_decode_t unpacker = {
+		rtp_h265_unpack_create,
+		rtp_h265_unpack_destroy,
+		rtp_h265_unpack_input,
+	};
+
+	return &unpacker;
+}
@@ -116,13 +116,13 @@ static int rtp_payload_find(int payload, const char* encoding, struct rtp_payloa
     if (0 == strcasecmp(encoding, "H264")) {
       // H.264 video (MPEG-4 Part 10) (RFC 6184)
       codec->encoder = rtp_h264_encode();
-      //codec->decoder = rtp_h264_decode();
+      codec->decoder = rtp_h264_decode();
       return 0;
     }else if (0 == strcasecmp(encoding, "H265") || 0 == strcasecmp(encoding, "HEVC"))
     {
       // H.265 video (HEVC) (RFC 7798)
       codec->encoder = rtp_h265_encode();
-      //codec->decoder = rtp_h265_decode();
+      codec->decoder = rtp_h265_decode();
       return 0;
     }
   }
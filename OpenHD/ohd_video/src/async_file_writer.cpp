@@ -0,0 +1,193 @@
+#include "async_file_writer.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <utility>
+
+#include "openhd_spdlog_include.h"
+
+// Make the directory entry of a newly created file persistent, too
+static void fsync_parent_directory(const std::string& filename) {
+  const auto pos = filename.find_last_of('/');
+  const std::string dir =
+      pos == std::string::npos ? "." : filename.substr(0, pos + 1);
+  const int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (dir_fd < 0) return;
+  fsync(dir_fd);
+  close(dir_fd);
+}
+
+openhd::AsyncFileWriter::AsyncFileWriter(
+    std::string filename, std::chrono::milliseconds sync_interval,
+    size_t max_queued_bytes, uint64_t preallocate_bytes)
+    : m_filename(std::move(filename)),
+      m_sync_interval(sync_interval),
+      m_max_queued_bytes(max_queued_bytes) {
+  m_console = openhd::log::create_or_get("async_file_writer");
+  m_fd = open(m_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+              0644);
+  if (m_fd < 0) {
+    m_console->warn("Cannot open [{}] {}", m_filename, strerror(errno));
+    return;
+  }
+  if (preallocate_bytes > 0) {
+    // Keep the size, such that a file that wasn't closed properly doesn't
+    // end with (pre-allocated) zeroes
+    if (fallocate(m_fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)preallocate_bytes) ==
+        0) {
+      m_preallocated = true;
+    } else {
+      // e.g. not supported by the filesystem (vfat)
+      m_console->debug("Cannot preallocate [{}] {}", m_filename,
+                       strerror(errno));
+    }
+  }
+  fsync_parent_directory(m_filename);
+  m_thread = std::make_unique<std::thread>([this] { loop(); });
+}
+
+openhd::AsyncFileWriter::~AsyncFileWriter() {
+  if (m_thread) {
+    {
+      std::lock_guard<std::mutex> guard(m_queue_mutex);
+      m_stop = true;
+    }
+    m_queue_cv.notify_one();
+    m_thread->join();
+    m_thread = nullptr;
+  }
+  if (m_fd >= 0) {
+    if (m_preallocated) {
+      // Releases the reserved but unused blocks past the end of the file
+      ftruncate(m_fd, (off_t)m_n_bytes_written);
+    }
+    fdatasync(m_fd);
+    close(m_fd);
+    m_fd = -1;
+  }
+  m_console->debug("Closed [{}] written:{} dropped:{}", m_filename,
+                   m_n_bytes_written, m_n_bytes_dropped);
+}
+
+bool openhd::AsyncFileWriter::enqueue(
+    std::shared_ptr<std::vector<uint8_t>> data) {
+  if (!is_open() || !data || data->empty()) return false;
+  if (m_failed) {
+    m_n_bytes_dropped += data->size();
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> guard(m_queue_mutex);
+    if (m_queued_bytes + data->size() > m_max_queued_bytes) {
+      m_n_bytes_dropped += data->size();
+      return false;
+    }
+    m_queued_bytes += data->size();
+    m_queue.push_back(std::move(data));
+  }
+  m_queue_cv.notify_one();
+  return true;
+}
+
+void openhd::AsyncFileWriter::loop() {
+  auto last_sync = std::chrono::steady_clock::now();
+  bool dirty = false;
+  std::vector<std::shared_ptr<std::vector<uint8_t>>> batch;
+  while (true) {
+    bool stop;
+    {
+      std::unique_lock<std::mutex> lock(m_queue_mutex);
+      // Wake up at least once per sync interval, to sync data that has
+      // been written already
+      m_queue_cv.wait_for(lock, m_sync_interval,
+                          [this] { return m_stop || !m_queue.empty(); });
+      stop = m_stop;
+      batch.assign(std::make_move_iterator(m_queue.begin()),
+                   std::make_move_iterator(m_queue.end()));
+      m_queue.clear();
+      m_queued_bytes = 0;
+    }
+    if (!batch.empty()) {
+      if (m_failed) {
+        for (const auto& buff : batch) m_n_bytes_dropped += buff->size();
+      } else if (!write_batch(batch)) {
+        m_console->warn("Cannot write [{}] {}, stopped at {} bytes",
+                        m_filename, strerror(errno), m_n_bytes_written);
+        m_failed = true;
+      }
+      dirty = true;
+      batch.clear();
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (dirty && now - last_sync >= m_sync_interval) {
+      fdatasync(m_fd);
+      last_sync = now;
+      dirty = false;
+    }
+    if (stop) break;
+  }
+}
+
+bool openhd::AsyncFileWriter::write_batch(
+    const std::vector<std::shared_ptr<std::vector<uint8_t>>>& batch) {
+  std::vector<iovec> iov;
+  iov.reserve(batch.size());
+  for (const auto& buff : batch) {
+    iov.push_back(iovec{buff->data(), buff->size()});
+  }
+  const int64_t written = writev_all(m_fd, iov);
+  // End of the last buffer that has been written completely
+  int64_t complete = 0;
+  size_t n_complete = 0;
+  while (n_complete < batch.size() &&
+         complete + (int64_t)batch[n_complete]->size() <= written) {
+    complete += (int64_t)batch[n_complete]->size();
+    n_complete++;
+  }
+  if (n_complete == batch.size()) {
+    m_n_bytes_written += written;
+    return true;
+  }
+  const int error = errno;
+  // Don't leave a partial buffer (e.g. half an mp4 box) at the end of the file
+  const uint64_t size = m_n_bytes_written + complete;
+  if (ftruncate(m_fd, (off_t)size) != 0) {
+    m_console->warn("Cannot truncate [{}] {}", m_filename, strerror(errno));
+  }
+  m_n_bytes_written = size;
+  for (size_t i = n_complete; i < batch.size(); i++) {
+    m_n_bytes_dropped += batch[i]->size();
+  }
+  errno = error;
+  return false;
+}
+
+int64_t openhd::AsyncFileWriter::writev_all(int fd, std::vector<iovec>& iov) {
+  int64_t total = 0;
+  size_t idx = 0;
+  while (idx < iov.size()) {
+    const int n_iov = (int)std::min(iov.size() - idx, (size_t)IOV_MAX);
+    const ssize_t written = writev(fd, &iov[idx], n_iov);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return total;
+    }
+    total += written;
+    // Advance past everything written, handles partial writes
+    size_t remaining = written;
+    while (idx < iov.size() && remaining >= iov[idx].iov_len) {
+      remaining -= iov[idx].iov_len;
+      idx++;
+    }
+    if (remaining > 0) {
+      iov[idx].iov_base = (uint8_t*)iov[idx].iov_base + remaining;
+      iov[idx].iov_len -= remaining;
+    }
+  }
+  return total;
+}
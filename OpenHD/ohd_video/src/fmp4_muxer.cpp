@@ -0,0 +1,540 @@
+#include "fmp4_muxer.h"
+
+#include <cstring>
+#include <utility>
+
+#include "nalu/nalu_helper.h"
+
+namespace {
+
+// Big endian writer with (nested) box support
+class BoxWriter {
+ public:
+  explicit BoxWriter(std::vector<uint8_t>& out) : m_out(out) {}
+  void u8(uint8_t v) { m_out.push_back(v); }
+  void u16(uint16_t v) {
+    u8(v >> 8);
+    u8(v & 0xFF);
+  }
+  void u24(uint32_t v) {
+    u8((v >> 16) & 0xFF);
+    u16(v & 0xFFFF);
+  }
+  void u32(uint32_t v) {
+    u16(v >> 16);
+    u16(v & 0xFFFF);
+  }
+  void u64(uint64_t v) {
+    u32(v >> 32);
+    u32(v & 0xFFFFFFFF);
+  }
+  void zeroes(int n) { m_out.insert(m_out.end(), n, 0); }
+  void bytes(const uint8_t* data, size_t data_len) {
+    m_out.insert(m_out.end(), data, data + data_len);
+  }
+  void fourcc(const char* type) { bytes((const uint8_t*)type, 4); }
+  // Returns the offset of the box, pass it to end_box()
+  size_t begin_box(const char* type) {
+    const size_t offset = m_out.size();
+    u32(0);
+    fourcc(type);
+    return offset;
+  }
+  size_t begin_full_box(const char* type, uint8_t version, uint32_t flags) {
+    const size_t offset = begin_box(type);
+    u8(version);
+    u24(flags);
+    return offset;
+  }
+  void end_box(size_t offset) { patch_u32(offset, m_out.size() - offset); }
+  void patch_u32(size_t offset, uint32_t v) {
+    m_out[offset] = v >> 24;
+    m_out[offset + 1] = (v >> 16) & 0xFF;
+    m_out[offset + 2] = (v >> 8) & 0xFF;
+    m_out[offset + 3] = v & 0xFF;
+  }
+  size_t size() const { return m_out.size(); }
+  void unity_matrix() {
+    static constexpr uint32_t matrix[9] = {0x00010000, 0, 0, 0, 0x00010000,
+                                           0,          0, 0, 0x40000000};
+    for (auto v : matrix) u32(v);
+  }
+
+ private:
+  std::vector<uint8_t>& m_out;
+};
+
+// Exp-golomb reader on the RBSP (emulation prevention bytes removed)
+class BitReader {
+ public:
+  BitReader(const uint8_t* nalu, int nalu_len) {
+    m_rbsp.reserve(nalu_len);
+    int n_zeroes = 0;
+    for (int i = 0; i < nalu_len; i++) {
+      if (n_zeroes >= 2 && nalu[i] == 3) {
+        n_zeroes = 0;
+        continue;
+      }
+      n_zeroes = nalu[i] == 0 ? n_zeroes + 1 : 0;
+      m_rbsp.push_back(nalu[i]);
+    }
+  }
+  uint32_t bits(int n) {
+    uint32_t ret = 0;
+    for (int i = 0; i < n; i++) ret = (ret << 1) | bit();
+    return ret;
+  }
+  uint32_t bit() {
+    if (m_pos >= m_rbsp.size() * 8) {
+      m_overrun = true;
+      return 0;
+    }
+    const uint32_t ret = (m_rbsp[m_pos / 8] >> (7 - m_pos % 8)) & 1;
+    m_pos++;
+    return ret;
+  }
+  void skip(int n) { m_pos += n; }
+  uint32_t ue() {
+    int leading_zeroes = 0;
+    while (bit() == 0 && !m_overrun && leading_zeroes < 32) leading_zeroes++;
+    if (leading_zeroes == 0) return 0;
+    return ((1u << leading_zeroes) - 1) + bits(leading_zeroes);
+  }
+  int32_t se() {
+    const uint32_t v = ue();
+    return (v & 1) ? (int32_t)((v + 1) / 2) : -(int32_t)(v / 2);
+  }
+  bool ok() const { return !m_overrun && m_pos <= m_rbsp.size() * 8; }
+  const std::vector<uint8_t>& rbsp() const { return m_rbsp; }
+
+ private:
+  std::vector<uint8_t> m_rbsp;
+  size_t m_pos = 0;
+  bool m_overrun = false;
+};
+
+void skip_h264_scaling_list(BitReader& r, int size) {
+  int last_scale = 8;
+  int next_scale = 8;
+  for (int i = 0; i < size; i++) {
+    if (next_scale != 0) {
+      next_scale = (last_scale + r.se() + 256) % 256;
+    }
+    last_scale = next_scale == 0 ? last_scale : next_scale;
+  }
+}
+
+void write_visual_sample_entry_header(BoxWriter& w, int width, int height) {
+  w.zeroes(6);  // reserved
+  w.u16(1);     // data_reference_index
+  w.u16(0);     // pre_defined
+  w.u16(0);     // reserved
+  w.zeroes(12);  // pre_defined
+  w.u16(width);
+  w.u16(height);
+  w.u32(0x00480000);  // 72 dpi
+  w.u32(0x00480000);
+  w.u32(0);   // reserved
+  w.u16(1);   // frame_count
+  w.zeroes(32);  // compressorname
+  w.u16(0x0018);  // depth
+  w.u16(0xFFFF);  // pre_defined
+}
+
+// The parts of the H265 SPS needed for the hvcC
+struct H265SpsInfo {
+  int width = 0;
+  int height = 0;
+  int chroma_format_idc = 1;
+  int bit_depth_luma_minus8 = 0;
+  int bit_depth_chroma_minus8 = 0;
+  int max_sub_layers_minus1 = 0;
+  bool temporal_id_nesting = false;
+};
+
+}  // namespace
+
+openhd::FMP4Muxer::FMP4Muxer(TrackConfig config)
+    : m_config(std::move(config)) {}
+
+std::shared_ptr<std::vector<uint8_t>> openhd::FMP4Muxer::create_init_segment()
+    const {
+  auto ret = std::make_shared<std::vector<uint8_t>>();
+  ret->reserve(1024);
+  BoxWriter w(*ret);
+  auto ftyp = w.begin_box("ftyp");
+  w.fourcc("isom");
+  w.u32(0x200);
+  w.fourcc("isom");
+  w.fourcc("iso6");
+  w.fourcc("mp41");
+  w.end_box(ftyp);
+
+  auto moov = w.begin_box("moov");
+  {
+    auto mvhd = w.begin_full_box("mvhd", 0, 0);
+    w.u32(0);  // creation_time
+    w.u32(0);  // modification_time
+    w.u32(TIMESCALE);
+    w.u32(0);           // duration - unknown, fragmented
+    w.u32(0x00010000);  // rate
+    w.u16(0x0100);      // volume
+    w.zeroes(10);       // reserved
+    w.unity_matrix();
+    w.zeroes(24);  // pre_defined
+    w.u32(2);      // next_track_ID
+    w.end_box(mvhd);
+  }
+  auto trak = w.begin_box("trak");
+  {
+    // track_enabled | track_in_movie
+    auto tkhd = w.begin_full_box("tkhd", 0, 3);
+    w.u32(0);  // creation_time
+    w.u32(0);  // modification_time
+    w.u32(1);  // track_ID
+    w.u32(0);  // reserved
+    w.u32(0);  // duration
+    w.zeroes(8);  // reserved
+    w.u16(0);     // layer
+    w.u16(0);     // alternate_group
+    w.u16(0);     // volume
+    w.u16(0);     // reserved
+    w.unity_matrix();
+    w.u32(m_config.width << 16);
+    w.u32(m_config.height << 16);
+    w.end_box(tkhd);
+  }
+  auto mdia = w.begin_box("mdia");
+  {
+    auto mdhd = w.begin_full_box("mdhd", 0, 0);
+    w.u32(0);  // creation_time
+    w.u32(0);  // modification_time
+    w.u32(TIMESCALE);
+    w.u32(0);       // duration
+    w.u16(0x55C4);  // language "und"
+    w.u16(0);       // pre_defined
+    w.end_box(mdhd);
+    auto hdlr = w.begin_full_box("hdlr", 0, 0);
+    w.u32(0);  // pre_defined
+    w.fourcc("vide");
+    w.zeroes(12);  // reserved
+    static constexpr char name[] = "VideoHandler";
+    w.bytes((const uint8_t*)name, sizeof(name));
+    w.end_box(hdlr);
+  }
+  auto minf = w.begin_box("minf");
+  {
+    auto vmhd = w.begin_full_box("vmhd", 0, 1);
+    w.zeroes(8);  // graphicsmode, opcolor
+    w.end_box(vmhd);
+    auto dinf = w.begin_box("dinf");
+    auto dref = w.begin_full_box("dref", 0, 0);
+    w.u32(1);  // entry_count
+    // self contained
+    auto url = w.begin_full_box("url ", 0, 1);
+    w.end_box(url);
+    w.end_box(dref);
+    w.end_box(dinf);
+  }
+  auto stbl = w.begin_box("stbl");
+  {
+    auto stsd = w.begin_full_box("stsd", 0, 0);
+    w.u32(1);  // entry_count
+    auto entry = w.begin_box(m_config.is_h265 ? "hvc1" : "avc1");
+    write_visual_sample_entry_header(w, m_config.width, m_config.height);
+    auto config = w.begin_box(m_config.is_h265 ? "hvcC" : "avcC");
+    w.bytes(m_config.codec_config_record.data(),
+            m_config.codec_config_record.size());
+    w.end_box(config);
+    w.end_box(entry);
+    w.end_box(stsd);
+    // Empty sample tables, the samples are in the fragments
+    for (const char* type : {"stts", "stsc", "stco"}) {
+      auto box = w.begin_full_box(type, 0, 0);
+      w.u32(0);  // entry_count
+      w.end_box(box);
+    }
+    auto stsz = w.begin_full_box("stsz", 0, 0);
+    w.u32(0);  // sample_size
+    w.u32(0);  // sample_count
+    w.end_box(stsz);
+  }
+  w.end_box(stbl);
+  w.end_box(minf);
+  w.end_box(mdia);
+  w.end_box(trak);
+  auto mvex = w.begin_box("mvex");
+  {
+    auto trex = w.begin_full_box("trex", 0, 0);
+    w.u32(1);  // track_ID
+    w.u32(1);  // default_sample_description_index
+    w.u32(0);  // default_sample_duration
+    w.u32(0);  // default_sample_size
+    w.u32(0);  // default_sample_flags
+    w.end_box(trex);
+  }
+  w.end_box(mvex);
+  w.end_box(moov);
+  return ret;
+}
+
+std::shared_ptr<std::vector<uint8_t>> openhd::FMP4Muxer::create_fragment(
+    const std::vector<Sample>& samples) {
+  std::vector<SampleInfo> infos;
+  infos.reserve(samples.size());
+  size_t mdat_payload_size = 0;
+  for (const auto& sample : samples) {
+    infos.push_back(SampleInfo{(uint32_t)sample.data->size(), sample.duration,
+                               sample.is_keyframe});
+    mdat_payload_size += sample.data->size();
+  }
+  auto ret = std::make_shared<std::vector<uint8_t>>(
+      create_fragment_header(infos));
+  ret->reserve(ret->size() + mdat_payload_size);
+  for (const auto& sample : samples) {
+    ret->insert(ret->end(), sample.data->begin(), sample.data->end());
+  }
+  return ret;
+}
+
+std::vector<uint8_t> openhd::FMP4Muxer::create_fragment_header(
+    const std::vector<SampleInfo>& samples) {
+  uint64_t mdat_payload_size = 0;
+  for (const auto& sample : samples) mdat_payload_size += sample.size;
+  std::vector<uint8_t> ret;
+  ret.reserve(128 + samples.size() * 12);
+  BoxWriter w(ret);
+  auto moof = w.begin_box("moof");
+  auto mfhd = w.begin_full_box("mfhd", 0, 0);
+  w.u32(m_sequence_number++);
+  w.end_box(mfhd);
+  auto traf = w.begin_box("traf");
+  // default-base-is-moof
+  auto tfhd = w.begin_full_box("tfhd", 0, 0x020000);
+  w.u32(1);  // track_ID
+  w.end_box(tfhd);
+  auto tfdt = w.begin_full_box("tfdt", 1, 0);
+  w.u64(m_decode_time);
+  w.end_box(tfdt);
+  // data-offset, sample-duration, sample-size and sample-flags present
+  auto trun = w.begin_full_box("trun", 0, 0x000001 | 0x000100 | 0x000200 |
+                                              0x000400);
+  w.u32(samples.size());
+  const size_t data_offset_pos = w.size();
+  w.u32(0);  // data_offset, patched below
+  for (const auto& sample : samples) {
+    w.u32(sample.duration);
+    w.u32(sample.size);
+    // sample_depends_on=2 (I frame) / sample_depends_on=1 and
+    // sample_is_non_sync_sample
+    w.u32(sample.is_keyframe ? 0x02000000 : 0x01010000);
+    m_decode_time += sample.duration;
+  }
+  w.end_box(trun);
+  w.end_box(traf);
+  w.end_box(moof);
+  // The data begins right after the mdat header
+  w.patch_u32(data_offset_pos, w.size() + 8);
+  w.u32(8 + mdat_payload_size);
+  w.fourcc("mdat");
+  return ret;
+}
+
+std::optional<openhd::FMP4Muxer::TrackConfig>
+openhd::FMP4Muxer::create_track_config_h264(const std::vector<uint8_t>& sps,
+                                            const std::vector<uint8_t>& pps) {
+  if (sps.size() < 4 || pps.empty()) return std::nullopt;
+  BitReader r(sps.data() + 1, sps.size() - 1);
+  const int profile_idc = r.bits(8);
+  r.skip(16);  // constraint flags, level_idc
+  r.ue();      // seq_parameter_set_id
+  int chroma_format_idc = 1;
+  bool separate_colour_plane = false;
+  if (profile_idc == 100 || profile_idc == 110 || profile_idc == 122 ||
+      profile_idc == 244 || profile_idc == 44 || profile_idc == 83 ||
+      profile_idc == 86 || profile_idc == 118 || profile_idc == 128 ||
+      profile_idc == 138 || profile_idc == 139 || profile_idc == 134 ||
+      profile_idc == 135) {
+    chroma_format_idc = r.ue();
+    if (chroma_format_idc == 3) separate_colour_plane = r.bit();
+    r.ue();      // bit_depth_luma_minus8
+    r.ue();      // bit_depth_chroma_minus8
+    r.bit();     // qpprime_y_zero_transform_bypass_flag
+    if (r.bit()) {  // seq_scaling_matrix_present_flag
+      for (int i = 0; i < (chroma_format_idc != 3 ? 8 : 12); i++) {
+        if (r.bit()) skip_h264_scaling_list(r, i < 6 ? 16 : 64);
+      }
+    }
+  }
+  r.ue();  // log2_max_frame_num_minus4
+  const uint32_t pic_order_cnt_type = r.ue();
+  if (pic_order_cnt_type == 0) {
+    r.ue();  // log2_max_pic_order_cnt_lsb_minus4
+  } else if (pic_order_cnt_type == 1) {
+    r.bit();  // delta_pic_order_always_zero_flag
+    r.se();   // offset_for_non_ref_pic
+    r.se();   // offset_for_top_to_bottom_field
+    const uint32_t n = r.ue();
+    for (uint32_t i = 0; i < n && r.ok(); i++) r.se();
+  }
+  r.ue();   // max_num_ref_frames
+  r.bit();  // gaps_in_frame_num_value_allowed_flag
+  const int pic_width_in_mbs = r.ue() + 1;
+  const int pic_height_in_map_units = r.ue() + 1;
+  const int frame_mbs_only = r.bit();
+  if (!frame_mbs_only) r.bit();  // mb_adaptive_frame_field_flag
+  r.bit();                       // direct_8x8_inference_flag
+  int crop_left = 0, crop_right = 0, crop_top = 0, crop_bottom = 0;
+  if (r.bit()) {
+    crop_left = r.ue();
+    crop_right = r.ue();
+    crop_top = r.ue();
+    crop_bottom = r.ue();
+  }
+  if (!r.ok()) return std::nullopt;
+  const int chroma_array_type = separate_colour_plane ? 0 : chroma_format_idc;
+  const int crop_unit_x =
+      (chroma_array_type == 1 || chroma_array_type == 2) ? 2 : 1;
+  const int crop_unit_y = (chroma_array_type == 1 ? 2 : 1) * (2 - frame_mbs_only);
+  TrackConfig ret{};
+  ret.is_h265 = false;
+  ret.width = pic_width_in_mbs * 16 - crop_unit_x * (crop_left + crop_right);
+  ret.height = (2 - frame_mbs_only) * pic_height_in_map_units * 16 -
+               crop_unit_y * (crop_top + crop_bottom);
+  // AVCDecoderConfigurationRecord (ISO/IEC 14496-15 5.3.3.1)
+  auto& rec = ret.codec_config_record;
+  rec.push_back(1);       // configurationVersion
+  rec.push_back(sps[1]);  // AVCProfileIndication
+  rec.push_back(sps[2]);  // profile_compatibility
+  rec.push_back(sps[3]);  // AVCLevelIndication
+  rec.push_back(0xFF);    // lengthSizeMinusOne = 3
+  rec.push_back(0xE1);    // numOfSequenceParameterSets = 1
+  rec.push_back(sps.size() >> 8);
+  rec.push_back(sps.size() & 0xFF);
+  rec.insert(rec.end(), sps.begin(), sps.end());
+  rec.push_back(1);  // numOfPictureParameterSets
+  rec.push_back(pps.size() >> 8);
+  rec.push_back(pps.size() & 0xFF);
+  rec.insert(rec.end(), pps.begin(), pps.end());
+  return ret;
+}
+
+std::optional<openhd::FMP4Muxer::TrackConfig>
+openhd::FMP4Muxer::create_track_config_h265(const std::vector<uint8_t>& vps,
+                                            const std::vector<uint8_t>& sps,
+                                            const std::vector<uint8_t>& pps) {
+  if (vps.empty() || sps.size() < 16 || pps.empty()) return std::nullopt;
+  // Skip the 2 byte NAL unit header
+  BitReader r(sps.data() + 2, sps.size() - 2);
+  H265SpsInfo info{};
+  r.skip(4);  // sps_video_parameter_set_id
+  info.max_sub_layers_minus1 = r.bits(3);
+  info.temporal_id_nesting = r.bit();
+  // profile_tier_level - general part: 2+1+5+32+4+43+1 bits profile, 8 level
+  r.skip(96);
+  std::vector<bool> sub_layer_profile_present, sub_layer_level_present;
+  for (int i = 0; i < info.max_sub_layers_minus1; i++) {
+    sub_layer_profile_present.push_back(r.bit());
+    sub_layer_level_present.push_back(r.bit());
+  }
+  if (info.max_sub_layers_minus1 > 0) {
+    r.skip(2 * (8 - info.max_sub_layers_minus1));  // reserved_zero_2bits
+  }
+  for (int i = 0; i < info.max_sub_layers_minus1; i++) {
+    if (sub_layer_profile_present[i]) r.skip(88);
+    if (sub_layer_level_present[i]) r.skip(8);
+  }
+  r.ue();  // sps_seq_parameter_set_id
+  info.chroma_format_idc = r.ue();
+  bool separate_colour_plane = false;
+  if (info.chroma_format_idc == 3) separate_colour_plane = r.bit();
+  info.width = r.ue();
+  info.height = r.ue();
+  if (r.bit()) {  // conformance_window_flag
+    const int chroma_array_type =
+        separate_colour_plane ? 0 : info.chroma_format_idc;
+    const int sub_width_c =
+        (chroma_array_type == 1 || chroma_array_type == 2) ? 2 : 1;
+    const int sub_height_c = chroma_array_type == 1 ? 2 : 1;
+    const int left = r.ue();
+    const int right = r.ue();
+    const int top = r.ue();
+    const int bottom = r.ue();
+    info.width -= sub_width_c * (left + right);
+    info.height -= sub_height_c * (top + bottom);
+  }
+  info.bit_depth_luma_minus8 = r.ue();
+  info.bit_depth_chroma_minus8 = r.ue();
+  if (!r.ok() || r.rbsp().size() < 13) return std::nullopt;
+  TrackConfig ret{};
+  ret.is_h265 = true;
+  ret.width = info.width;
+  ret.height = info.height;
+  // HEVCDecoderConfigurationRecord (ISO/IEC 14496-15 8.3.3.1)
+  auto& rec = ret.codec_config_record;
+  rec.push_back(1);  // configurationVersion
+  // general_profile_space ... general_level_idc (12 bytes), same layout as
+  // the general part of profile_tier_level in the SPS
+  const auto& rbsp = r.rbsp();
+  rec.insert(rec.end(), rbsp.begin() + 1, rbsp.begin() + 13);
+  rec.push_back(0xF0);  // min_spatial_segmentation_idc = 0
+  rec.push_back(0x00);
+  rec.push_back(0xFC);  // parallelismType = 0
+  rec.push_back(0xFC | (info.chroma_format_idc & 0x03));
+  rec.push_back(0xF8 | (info.bit_depth_luma_minus8 & 0x07));
+  rec.push_back(0xF8 | (info.bit_depth_chroma_minus8 & 0x07));
+  rec.push_back(0);  // avgFrameRate
+  rec.push_back(0);
+  // constantFrameRate = 0, numTemporalLayers, temporalIdNested,
+  // lengthSizeMinusOne = 3
+  rec.push_back(((info.max_sub_layers_minus1 + 1) << 3) |
+                (info.temporal_id_nesting ? 0x04 : 0) | 0x03);
+  rec.push_back(3);  // numOfArrays
+  for (const auto* nalu : {&vps, &sps, &pps}) {
+    // array_completeness = 1, NAL_unit_type
+    rec.push_back(0x80 | (((*nalu)[0] >> 1) & 0x3F));
+    rec.push_back(0);  // numNalus
+    rec.push_back(1);
+    rec.push_back(nalu->size() >> 8);
+    rec.push_back(nalu->size() & 0xFF);
+    rec.insert(rec.end(), nalu->begin(), nalu->end());
+  }
+  return ret;
+}
+
+std::shared_ptr<std::vector<uint8_t>>
+openhd::FMP4Muxer::annex_b_to_length_prefixed(const uint8_t* data,
+                                              int data_len, bool is_h265) {
+  auto ret = std::make_shared<std::vector<uint8_t>>();
+  ret->reserve(data_len + 64);
+  int offset = 0;
+  while (offset < data_len) {
+    const int chunk_len = find_next_nal(&data[offset], data_len - offset);
+    const uint8_t* chunk = &data[offset];
+    offset += chunk_len;
+    int begin = 0;
+    while (begin < chunk_len && chunk[begin] == 0) begin++;
+    if (begin < 2 || begin >= chunk_len || chunk[begin] != 1) continue;
+    begin++;
+    int end = chunk_len;
+    while (end > begin && chunk[end - 1] == 0) end--;
+    const int nalu_len = end - begin;
+    if (nalu_len < (is_h265 ? 3 : 2)) continue;
+    const uint8_t* nalu = chunk + begin;
+    if (is_h265) {
+      const int nal_type = (nalu[0] >> 1) & 0x3F;
+      // VPS, SPS, PPS, AUD
+      if (nal_type >= 32 && nal_type <= 35) continue;
+    } else {
+      const int nal_type = nalu[0] & 0x1F;
+      // SPS, PPS, AUD
+      if (nal_type >= 7 && nal_type <= 9) continue;
+    }
+    ret->push_back(nalu_len >> 24);
+    ret->push_back((nalu_len >> 16) & 0xFF);
+    ret->push_back((nalu_len >> 8) & 0xFF);
+    ret->push_back(nalu_len & 0xFF);
+    ret->insert(ret->end(), nalu, nalu + nalu_len);
+  }
+  return ret;
+}
@@ -8,9 +8,12 @@
 #include <gst/app/gstappsink.h>
 #include <gst/gst.h>
 
+#include <chrono>
 #include <optional>
 
+#include "openhd_fragment_pool.h"
 #include "openhd_spdlog.h"
+#include "openhd_video_frame.h"
 
 namespace openhd {
 
@@ -24,12 +27,42 @@ static std::shared_ptr<std::vector<uint8_t>> gst_copy_buffer(
   gst_buffer_map(buffer, &map, GST_MAP_READ);
   assert(map.size == buff_size);
   // std::memcpy(ret->data(), map.data, buff_size);
-  auto ret =
-      std::make_shared<std::vector<uint8_t>>(map.data, map.data + buff_size);
+  auto ret = openhd::FragmentPool::instance().copy(map.data, buff_size);
   gst_buffer_unmap(buffer, &map);
   return ret;
 }
 
+/**
+ * Zero-copy alternative to gst_copy_buffer - the returned fragment holds a
+ * reference on the (mapped) buffer, which is unmapped and unref'd once the last
+ * owner of the fragment is gone. Returns an empty fragment if the buffer cannot
+ * be mapped.
+ */
+static openhd::VideoFragment gst_wrap_buffer(GstBuffer* buffer) {
+  assert(buffer);
+  struct MappedGstBuffer {
+    GstBuffer* buffer = nullptr;
+    GstMapInfo map{};
+    bool mapped = false;
+    ~MappedGstBuffer() {
+      if (mapped) gst_buffer_unmap(buffer, &map);
+      if (buffer) gst_buffer_unref(buffer);
+    }
+  };
+  // Pooled, to not allocate a control block per fragment
+  auto holder =
+      openhd::FragmentPool::instance().make_shared<MappedGstBuffer>();
+  holder->buffer = gst_buffer_ref(buffer);
+  holder->mapped = gst_buffer_map(holder->buffer, &holder->map, GST_MAP_READ);
+  if (!holder->mapped) {
+    openhd::log::get_default()->warn("Cannot map gst buffer");
+    return {};
+  }
+  const uint8_t* data = holder->map.data;
+  const size_t data_len = holder->map.size;
+  return openhd::VideoFragment{std::move(holder), data, data_len};
+}
+
 struct GstBufferX {
   std::shared_ptr<std::vector<uint8_t>> buffer;
   uint64_t buffer_dts = 0;
@@ -97,6 +130,43 @@ static void gst_debug_sample(GstSample* sample) {
   openhd::log::get_default()->debug("{}", ss.str());
 }
 
+/**
+ * Returns the base time of the given (playing) pipeline if it runs on the
+ * monotonic system clock - in this case, base time + buffer running time
+ * (pts / dts) is on the same time base as std::chrono::steady_clock (for live
+ * pipelines, where the segment starts at 0).
+ * Otherwise (e.g. a clock provided by an element), returns std::nullopt.
+ */
+static std::optional<GstClockTime> gst_get_monotonic_base_time(
+    GstElement* pipeline) {
+  GstClock* clock = gst_pipeline_get_clock(GST_PIPELINE(pipeline));
+  if (clock == nullptr) return std::nullopt;
+  bool is_monotonic = false;
+  if (GST_IS_SYSTEM_CLOCK(clock)) {
+    GstClockType clock_type = GST_CLOCK_TYPE_REALTIME;
+    g_object_get(clock, "clock-type", &clock_type, nullptr);
+    is_monotonic = clock_type == GST_CLOCK_TYPE_MONOTONIC;
+  }
+  gst_object_unref(clock);
+  if (!is_monotonic) return std::nullopt;
+  return gst_element_get_base_time(pipeline);
+}
+
+// Converts the buffer pts (or dts, if no pts is set) to the steady clock, see
+// above
+static std::optional<std::chrono::steady_clock::time_point>
+gst_buffer_timestamp_to_steady_clock(GstBuffer* buffer,
+                                     std::optional<GstClockTime> base_time) {
+  if (!base_time.has_value()) return std::nullopt;
+  GstClockTime running_time = GST_BUFFER_PTS(buffer);
+  if (!GST_CLOCK_TIME_IS_VALID(running_time)) {
+    running_time = GST_BUFFER_DTS(buffer);
+  }
+  if (!GST_CLOCK_TIME_IS_VALID(running_time)) return std::nullopt;
+  return std::chrono::steady_clock::time_point(
+      std::chrono::nanoseconds(base_time.value() + running_time));
+}
+
 static void unref_appsink_element(GstElement* appsink) {
   if (appsink) {
     openhd::log::get_default()->debug("Unref appsink begin");
@@ -11,7 +11,6 @@
 #include "gst_appsink_helper.h"
 #include "gst_debug_helper.h"
 #include "gst_helper.hpp"
-#include "gst_recording_demuxer.h"
 #include "nalu/CodecConfigFinder.hpp"
 #include "nalu/fragment_helper.h"
 #include "nalu/nalu_helper.h"
@@ -34,6 +33,11 @@ GStreamerStream::GStreamerStream(std::shared_ptr<CameraHolder> camera_holder,
           (std::string(getConfigBasePath()) + "exp_raw.txt").c_str())) {
     dirty_use_raw = true;
   }
+  if (OHDFilesystemUtil::exists(
+          (std::string(getConfigBasePath()) + "exp_appsink_cb.txt").c_str())) {
+    m_use_appsink_callback = true;
+    m_console->info("Using appsink new-sample callback");
+  }
   m_camera_holder->register_listener([this]() {
     // right now, every time the settings for this camera change, we just
     // re-start the whole stream. That is not ideal, since some cameras support
@@ -196,12 +200,6 @@ void GStreamerStream::setup() {
       setting.air_recording == AIR_RECORDING_ON ||
       (setting.air_recording == AIR_RECORDING_AUTO_ARM_DISARM &&
        m_armed_enable_air_recording);
-  // for safety we only add the tee command at the right place if recording is
-  // enabled.
-  if (ADD_RECORDING_TO_PIPELINE) {
-    m_console->info("Air recording active");
-    pipeline_content << "tee name=t ! ";
-  }
   // After we've written the parts for the different camera implementation(s) we
   // just need to append the rtp part and the udp out add rtp part
   if (dirty_use_raw) {
@@ -226,16 +224,8 @@ void GStreamerStream::setup() {
     pipeline_content << OHDGstHelper::createOutputAppSink();
   }
   if (ADD_RECORDING_TO_PIPELINE) {
-    const auto recording_filename =
-        openhd::video::create_unused_recording_filename(
-            OHDGstHelper::file_suffix_for_video_codec(
-                setting.streamed_video_format.videoCodec));
-    m_console->debug("Using [{}] for recording", recording_filename);
-    pipeline_content << OHDGstHelper::createRecordingForVideoCodec(
-        setting.streamed_video_format.videoCodec, recording_filename);
-    m_opt_curr_recording_filename = recording_filename;
-  } else {
-    m_opt_curr_recording_filename = std::nullopt;
+    m_console->info("Air recording active");
+    setup_recording(setting);
   }
   {
     const auto index = m_camera_holder->get_camera().index;
@@ -273,14 +263,33 @@ void GStreamerStream::setup() {
       gst_bin_get_by_name(GST_BIN(m_gst_pipeline), "out_appsink");
   assert(m_app_sink_element);
   // m_console->debug("Cam encoding format: {}",(int)cam_info.encoding_format);
-  auto lol_cb =
-      [this](
-          std::vector<std::shared_ptr<std::vector<uint8_t>>> frame_fragments) {
-        x_on_new_rtp_fragmented_frame(frame_fragments);
-      };
+  auto lol_cb = [this](std::vector<openhd::VideoFragment> frame_fragments) {
+    x_on_new_rtp_fragmented_frame(std::move(frame_fragments));
+  };
   m_rtp_helper = std::make_shared<openhd::RTPHelper>(
       setting.streamed_video_format.videoCodec == VideoCodec::H265);
   m_rtp_helper->set_out_cb(lol_cb);
+  if (m_use_appsink_callback) {
+    // Needs to be set before the pipeline goes to PLAYING. The callback runs
+    // on the gstreamer streaming thread, which means we forward the data as
+    // soon as it is available. This is fine as long as the output cb doesn't
+    // block (the wb link only enqueues).
+    GstAppSinkCallbacks callbacks{};
+    callbacks.new_sample = [](GstAppSink* appsink,
+                              gpointer user_data) -> GstFlowReturn {
+      auto self = static_cast<GStreamerStream*>(user_data);
+      // Doesn't block, we are notified because a sample is available
+      GstSample* sample = gst_app_sink_pull_sample(appsink);
+      if (sample == nullptr) {
+        // Flushing or EOS
+        return GST_FLOW_EOS;
+      }
+      self->on_new_sample(sample);
+      return GST_FLOW_OK;
+    };
+    gst_app_sink_set_callbacks(GST_APP_SINK(m_app_sink_element), &callbacks,
+                               this, nullptr);
+  }
 }
 
 void GStreamerStream::start() {
@@ -323,32 +332,46 @@ void GStreamerStream::cleanup_pipe() {
                                                    GST_STATE_NULL);
   gst_object_unref(m_gst_pipeline);
   m_gst_pipeline = nullptr;
-  if (m_opt_curr_recording_filename) {
-    // make file read / writeable by everybody
-    OHDFilesystemUtil::make_file_read_write_everyone(
-        m_opt_curr_recording_filename.value());
-    // we do not want empty files - this can happen rarely in case the file is
-    // created, but no video data is actually written to it actually, looks like
-    // it is possible the file might be empty until the gst pipeline is actually
-    // terminating - annoying gst crap ! why is there no way to properly
-    // terminate ! better leave the file there
-    /*if(OHDFilesystemUtil::get_file_size_bytes(m_opt_curr_recording_filename.value())==0){
-      m_console->warn("Ground recording {} is
-    empty",m_opt_curr_recording_filename.value());
-      OHDFilesystemUtil::remove_if_existing(m_opt_curr_recording_filename.value());
-    }*/
-    m_opt_curr_recording_filename = std::nullopt;
-  }
-  // start demuxing of (all) .mkv files unless the FC is currently armed ( we
-  // are in flight) this will of course also de-mux the new ground recording (if
-  // there is any)
-  // if(m_opt_action_handler &&
-  // !m_opt_action_handler->arm_state.is_currently_armed()){
-  // GstRecordingDemuxer::instance().demux_all_remaining_mkv_files_async();
-  //}
+  // The pipeline is stopped, so nothing is fed to the recorder anymore.
+  // Flushes the current segment.
+  m_recorder = nullptr;
   m_console->debug("GStreamerStream::cleanup_pipe() end");
 }
 
+void GStreamerStream::setup_recording(const CameraSettings& setting) {
+  // Reserve a bit more than needed at the configured bitrate
+  const uint64_t segment_size_bytes = (uint64_t)setting.h26x_bitrate_kbits *
+                                      1000 / 8 *
+                                      AIR_RECORDING_SEGMENT_DURATION_S * 5 / 4;
+  // Delete old segments before we'd have to stop recording
+  const int min_free_space_mb = MINIMUM_AMOUNT_FREE_SPACE_FOR_AIR_RECORDING_MB +
+                                2 * (int)(segment_size_bytes / (1024 * 1024));
+  // Allocated here (and not on the store's thread), such that each camera
+  // gets its own recording_N
+  auto segment_store = std::make_shared<RecordingSegmentStore>(
+      openhd::video::create_unused_recording_filename(""), segment_size_bytes,
+      min_free_space_mb);
+  m_recorder = std::make_unique<AsyncVideoRecorder>(
+      std::make_unique<VideoRecorder>(
+          std::move(segment_store),
+          std::chrono::seconds(AIR_RECORDING_SEGMENT_DURATION_S)));
+}
+
+void GStreamerStream::output_frame(openhd::FragmentedVideoFrame frame) {
+  if (m_output_cb) {
+    const auto stream_index = m_camera_holder->get_camera().index;
+    // m_console->debug("{}",frame.to_string());
+    m_output_cb(stream_index, frame);
+  } else {
+    m_console->debug("No output cb");
+  }
+  // After the frame is on its way to the link
+  if (m_recorder) {
+    m_recorder->enqueue_frame(std::move(frame.rtp_fragments),
+                              frame.is_idr_frame, frame.is_intra_stream);
+  }
+}
+
 void GStreamerStream::request_restart() { m_request_restart = true; }
 
 void GStreamerStream::handle_change_bitrate_request(
@@ -425,6 +448,12 @@ void GStreamerStream::stream_once() {
   openhd::LinkActionHandler::instance().set_cam_info_status(
       m_camera_holder->get_camera().index, CAM_STATUS_RESTARTING);
   setup();
+  // Reset before starting - in callback mode, samples might arrive as soon as
+  // the pipeline is playing
+  m_last_camera_frame = std::chrono::steady_clock::now();
+  m_frame_fragments.resize(0);
+  m_curr_frame_trace = {};
+  m_has_first_frame = false;
   if (OHDPlatform::instance().is_x20()) {
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
   }
@@ -465,17 +494,12 @@ void GStreamerStream::stream_once() {
   // Now we should have a running pipeline and are able to pull samples from it
   // We use a timeout of 40ms to not unnecessarily wake up the thread on up to
   // 30fps (33ms) but also quickly respond to restart requests or bitrate
-  // change(s)
+  // change(s). In callback mode, we only sleep for the same amount of time
+  // between checks.
+  const auto loop_timeout = std::chrono::milliseconds(40);
   const uint64_t timeout_ns =
-      std::chrono::duration_cast<std::chrono::nanoseconds>(
-          std::chrono::milliseconds(40))
+      std::chrono::duration_cast<std::chrono::nanoseconds>(loop_timeout)
           .count();
-  // For 'bugged camera restart' fix
-  std::chrono::steady_clock::time_point m_last_camera_frame =
-      std::chrono::steady_clock::now();
-  m_frame_fragments.resize(0);
-  // As soon as we get the first frame, we change the status to streaming
-  bool has_first_frame = false;
   // Every X seconds, we check if we are about to run out of space
   std::chrono::steady_clock::time_point
       m_last_air_recording_remaining_space_check =
@@ -485,7 +509,7 @@ void GStreamerStream::stream_once() {
     if (!m_keep_looping) break;
     // ANNOYING BUGGED CAMERAS FIX - we restart the pipeline if we don't get a
     // frame from the camera for more than X seconds
-    if (std::chrono::steady_clock::now() - m_last_camera_frame >
+    if (std::chrono::steady_clock::now() - m_last_camera_frame.load() >
         std::chrono::seconds(5)) {
       m_console->warn("Restarting camera due to no frame after 5 seconds");
       m_request_restart = true;
@@ -535,38 +559,16 @@ void GStreamerStream::stream_once() {
       m_last_air_recording_remaining_space_check =
           std::chrono::steady_clock::now();
     }
+    if (m_use_appsink_callback) {
+      // The data is pulled by the streaming thread
+      std::this_thread::sleep_for(loop_timeout);
+      continue;
+    }
     // try get a new frame fragment from gst
     GstSample* sample = gst_app_sink_try_pull_sample(
         GST_APP_SINK(m_app_sink_element), timeout_ns);
     if (sample) {
-      if (!has_first_frame) {
-        has_first_frame = true;
-        openhd::LinkActionHandler::instance().set_cam_info_status(
-            m_camera_holder->get_camera().index, CAM_STATUS_STREAMING);
-      }
-      GstBuffer* buffer = gst_sample_get_buffer(sample);
-      // tmp declaration for give sample back early optimization
-      std::shared_ptr<std::vector<uint8_t>> fragment_data = nullptr;
-      uint64_t buffer_dts = 0;
-      if (buffer && gst_buffer_get_size(buffer) > 0) {
-        fragment_data = openhd::gst_copy_buffer(buffer);
-        buffer_dts = buffer->dts;
-      }
-      // Optimization: Give the buffer back to gstreamer as soon as possible.
-      // After copying the data from the sample, unref it first, then forward
-      // the data via cb
-      gst_sample_unref(sample);
-      sample = nullptr;
-      if (fragment_data && !fragment_data->empty()) {
-        // If we got a new sample, aggregate then forward
-        if (dirty_use_raw) {
-          m_rtp_helper->feed_multiple_nalu(fragment_data->data(),
-                                           fragment_data->size());
-        } else {
-          on_new_rtp_frame_fragment(std::move(fragment_data), buffer_dts);
-        }
-        m_last_camera_frame = std::chrono::steady_clock::now();
-      }
+      on_new_sample(sample);
     }
   }
   // If we land here, we need to clean up the pipe and (re) start
@@ -580,20 +582,64 @@ void GStreamerStream::stream_once() {
                        .count());
 }
 
-void GStreamerStream::on_new_rtp_frame_fragment(
-    std::shared_ptr<std::vector<uint8_t>> fragment, uint64_t dts) {
-  m_frame_fragments.push_back(fragment);
+void GStreamerStream::on_new_sample(GstSample* sample) {
+  const auto pull_time = std::chrono::steady_clock::now();
+  bool tmp_false = false;
+  if (m_has_first_frame.compare_exchange_strong(tmp_false, true)) {
+    openhd::LinkActionHandler::instance().set_cam_info_status(
+        m_camera_holder->get_camera().index, CAM_STATUS_STREAMING);
+    // The pipeline is playing, so the base time is valid
+    m_gst_monotonic_base_time =
+        openhd::gst_get_monotonic_base_time(m_gst_pipeline);
+    m_console->debug("Buffer timestamps usable for latency trace: {}",
+                     m_gst_monotonic_base_time.has_value());
+  }
+  GstBuffer* buffer = gst_sample_get_buffer(sample);
+  // tmp declaration for give sample back early optimization
+  openhd::VideoFragment fragment_data{};
+  uint64_t buffer_dts = 0;
+  if (buffer && gst_buffer_get_size(buffer) > 0) {
+    // No copy - the fragment keeps a reference on the buffer until the
+    // link is done with it
+    fragment_data = openhd::gst_wrap_buffer(buffer);
+    buffer_dts = buffer->dts;
+    if (!m_curr_frame_trace.first_fragment_pull.has_value()) {
+      m_curr_frame_trace.first_fragment_pull = pull_time;
+      m_curr_frame_trace.buffer_timestamp =
+          openhd::gst_buffer_timestamp_to_steady_clock(
+              buffer, m_gst_monotonic_base_time);
+    }
+    m_curr_frame_trace.last_fragment_pull = pull_time;
+  }
+  // Optimization: Give the sample back to gstreamer as soon as possible.
+  // The buffer itself is still referenced by the fragment (if any)
+  gst_sample_unref(sample);
+  if (!fragment_data.empty()) {
+    // If we got a new sample, aggregate then forward
+    if (dirty_use_raw) {
+      m_rtp_helper->feed_multiple_nalu(fragment_data.data(),
+                                       fragment_data.size());
+    } else {
+      on_new_rtp_frame_fragment(std::move(fragment_data), buffer_dts);
+    }
+    m_last_camera_frame = std::chrono::steady_clock::now();
+  }
+}
+
+void GStreamerStream::on_new_rtp_frame_fragment(openhd::VideoFragment fragment,
+                                                uint64_t dts) {
   const auto curr_video_codec =
       m_camera_holder->get_settings().streamed_video_format.videoCodec;
   openhd::rtp_eof_helper::RTPFragmentInfo info{};
   const bool is_h265 = curr_video_codec == VideoCodec::H265;
   if (is_h265) {
-    info = openhd::rtp_eof_helper::h265_more_info(fragment->data(),
-                                                  fragment->size());
+    info = openhd::rtp_eof_helper::h265_more_info(fragment.data(),
+                                                  fragment.size());
   } else {
-    info = openhd::rtp_eof_helper::h264_more_info(fragment->data(),
-                                                  fragment->size());
+    info = openhd::rtp_eof_helper::h264_more_info(fragment.data(),
+                                                  fragment.size());
   }
+  m_frame_fragments.push_back(std::move(fragment));
   if (info.is_fu_start) {
     if (is_idr_frame(info.nal_unit_type, is_h265)) {
       m_last_fu_s_idr = true;
@@ -615,50 +661,46 @@ void GStreamerStream::on_new_rtp_frame_fragment(
   if (is_last_fragment_of_frame) {
     on_new_rtp_fragmented_frame();
     m_frame_fragments.resize(0);
+    m_curr_frame_trace = {};
     m_last_fu_s_idr = false;
   }
 }
 
 void GStreamerStream::on_new_rtp_fragmented_frame() {
   // m_console->debug("Got frame with {} fragments",rtp_fragments.size());
-  if (m_output_cb) {
-    const auto stream_index = m_camera_holder->get_camera().index;
-    const bool enable_ultra_secure_encryption =
-        m_camera_holder->get_settings().enable_ultra_secure_encryption;
-    const bool is_intra_enabled =
-        m_camera_holder->get_settings().h26x_intra_refresh_type != -1;
-    const bool is_intra_frame = m_last_fu_s_idr;
-    auto frame = openhd::FragmentedVideoFrame{m_frame_fragments,
-                                              std::chrono::steady_clock::now(),
-                                              enable_ultra_secure_encryption,
-                                              nullptr,
-                                              is_intra_enabled,
-                                              is_intra_frame};
-    // m_console->debug("{}",frame.to_string());
-    m_output_cb(stream_index, frame);
-  } else {
-    m_console->debug("No output cb");
-  }
+  const bool enable_ultra_secure_encryption =
+      m_camera_holder->get_settings().enable_ultra_secure_encryption;
+  const bool is_intra_enabled =
+      m_camera_holder->get_settings().h26x_intra_refresh_type != -1;
+  const bool is_intra_frame = m_last_fu_s_idr;
+  auto frame = openhd::FragmentedVideoFrame{m_frame_fragments,
+                                            std::chrono::steady_clock::now(),
+                                            enable_ultra_secure_encryption,
+                                            nullptr,
+                                            is_intra_enabled,
+                                            is_intra_frame};
+  frame.trace = m_curr_frame_trace;
+  frame.trace.aggregated = frame.creation_time;
+  output_frame(std::move(frame));
 }
 
 void GStreamerStream::x_on_new_rtp_fragmented_frame(
-    std::vector<std::shared_ptr<std::vector<uint8_t>>> frame_fragments) {
-  if (m_output_cb) {
-    const auto stream_index = m_camera_holder->get_camera().index;
-    const bool enable_ultra_secure_encryption =
-        m_camera_holder->get_settings().enable_ultra_secure_encryption;
-    const bool is_intra_enabled =
-        m_camera_holder->get_settings().h26x_intra_refresh_type != -1;
-    const bool is_intra_frame = m_last_fu_s_idr;
-    auto frame = openhd::FragmentedVideoFrame{frame_fragments,
-                                              std::chrono::steady_clock::now(),
-                                              enable_ultra_secure_encryption,
-                                              nullptr,
-                                              is_intra_enabled,
-                                              is_intra_frame};
-    // m_console->debug("{}",frame.to_string());
-    m_output_cb(stream_index, frame);
-  } else {
-    m_console->debug("No output cb");
-  }
+    std::vector<openhd::VideoFragment> frame_fragments) {
+  const bool enable_ultra_secure_encryption =
+      m_camera_holder->get_settings().enable_ultra_secure_encryption;
+  const bool is_intra_enabled =
+      m_camera_holder->get_settings().h26x_intra_refresh_type != -1;
+  const bool is_intra_frame = m_last_fu_s_idr;
+  auto frame = openhd::FragmentedVideoFrame{std::move(frame_fragments),
+                                            std::chrono::steady_clock::now(),
+                                            enable_ultra_secure_encryption,
+                                            nullptr,
+                                            is_intra_enabled,
+                                            is_intra_frame};
+  frame.trace = m_curr_frame_trace;
+  frame.trace.aggregated = frame.creation_time;
+  output_frame(std::move(frame));
+  // Multiple frames can be found in one sample (raw), only the first one gets
+  // the pull time(s) of this sample
+  m_curr_frame_trace = {};
 }
@@ -11,6 +11,8 @@
 #include "nalu/fragment_helper.h"
 #include "openhd_config.h"
 #include "openhd_reboot_util.h"
+#include "recording_remuxer.h"
+#include "recording_segments.h"
 
 OHDVideoAir::OHDVideoAir(std::vector<XCamera> cameras,
                          std::shared_ptr<OHDLink> link)
@@ -19,6 +21,9 @@ OHDVideoAir::OHDVideoAir(std::vector<XCamera> cameras,
   assert(m_console);
   assert(!cameras.empty());
   m_console->debug("OHDVideo::OHDVideo()");
+  // Before any recording is started - repair the segment(s) of a recording
+  // that was interrupted (e.g. power loss)
+  RecordingSegmentIndex::instance().recover_unfinished_segments();
   m_primary_video_forwarder = std::make_unique<openhd::UDPMultiForwarder>();
   m_secondary_video_forwarder = std::make_unique<openhd::UDPMultiForwarder>();
   m_audio_forwarder = std::make_unique<openhd::UDPMultiForwarder>();
@@ -75,9 +80,9 @@ OHDVideoAir::OHDVideoAir(std::vector<XCamera> cameras,
       [this](openhd::ExternalDevice external_device, bool connected) {
         start_stop_forwarding_external_device(external_device, connected);
       });
-  // In case any non-demuxed recordings exists (e.g. due to a openhd crash,
-  // unsafe shutdown,...)
-  // GstRecordingDemuxer::instance().demux_all_remaining_mkv_files_async();
+  // In case any non-demuxed .mkv recordings (written by older versions)
+  // exist
+  RecordingRemuxer::instance().remux_all_remaining_mkv_files_async();
   m_console->debug("OHDVideo::running");
 }
 
@@ -255,17 +260,20 @@ void OHDVideoAir::on_video_data(
     // {}",stream_index,fragmented_video_frame.rtp_fragments.size());
     auto& forwarder = stream_index == 0 ? m_primary_video_forwarder
                                         : m_secondary_video_forwarder;
+    // The whole frame with one (batched) send
+    std::vector<struct iovec> packets;
     for (auto& fragment : fragmented_video_frame.rtp_fragments) {
-      forwarder->forwardPacketViaUDP(fragment->data(), fragment->size());
+      packets.push_back({(void*)fragment.data(), fragment.size()});
     }
+    std::vector<std::shared_ptr<std::vector<uint8_t>>> fragments;
     if (fragmented_video_frame.dirty_frame) {
-      auto fragments =
-          make_fragments(fragmented_video_frame.dirty_frame->data(),
-                         fragmented_video_frame.dirty_frame->size());
+      fragments = make_fragments(fragmented_video_frame.dirty_frame->data(),
+                                 fragmented_video_frame.dirty_frame->size());
       for (auto& fragment : fragments) {
-        forwarder->forwardPacketViaUDP(fragment->data(), fragment->size());
+        packets.push_back({fragment->data(), fragment->size()});
       }
     }
+    forwarder->forwardPacketsViaUDP(packets.data(), (int)packets.size());
   }
 }
 
@@ -6,6 +6,7 @@
 
 #include <utility>
 
+#include "air_recording_helper.hpp"
 #include "openhd_config.h"
 #include "openhd_util.h"
 
@@ -15,6 +16,14 @@ OHDVideoGround::OHDVideoGround(std::shared_ptr<OHDLink> link_handle)
   m_primary_video_forwarder = std::make_unique<openhd::UDPMultiForwarder>();
   m_secondary_video_forwarder = std::make_unique<openhd::UDPMultiForwarder>();
   m_audio_forwarder = std::make_unique<openhd::UDPMultiForwarder>();
+  m_primary_reassembler = std::make_unique<openhd::RTPFrameReassembler>(
+      [this](const openhd::RTPFrameReassembler::AccessUnit& access_unit) {
+        on_access_unit(0, access_unit);
+      });
+  m_secondary_reassembler = std::make_unique<openhd::RTPFrameReassembler>(
+      [this](const openhd::RTPFrameReassembler::AccessUnit& access_unit) {
+        on_access_unit(1, access_unit);
+      });
   // We always forward video to localhost::5600 (primary) and 5601 (secondary)
   // for the default Ground control application (e.g. QOpenHD) to pick up
   addForwarder("127.0.0.1");
@@ -25,6 +34,18 @@ OHDVideoGround::OHDVideoGround(std::shared_ptr<OHDLink> link_handle)
     m_primary_video_forwarder->addForwarder("127.0.0.1", 5800);
     m_secondary_video_forwarder->addForwarder("127.0.0.1", 5801);
   }
+  if (openhd::load_config().GEN_GROUND_RECORDING) {
+    m_console->debug("Ground recording enabled");
+    // One recording_N for both streams, such that they are easy to match
+    const int recording_index =
+        openhd::video::get_recording_index_track_count();
+    m_primary_recorder = std::make_unique<VideoRecorder>(
+        std::make_unique<RecordingFileStore>(recording_index, ".mp4"));
+    m_secondary_recorder = std::make_unique<VideoRecorder>(
+        std::make_unique<RecordingFileStore>(recording_index,
+                                             "_secondary.mp4"));
+    m_reassemble = true;
+  }
   if (m_link_handle) {
     m_link_handle->register_on_receive_video_data_cb(
         [this](int stream_index, const uint8_t* data, int data_len) {
@@ -69,14 +90,74 @@ void OHDVideoGround::on_video_data(int stream_index, const uint8_t* data,
                                    int data_len) {
   // openhd::log::get_default()->debug("on_video_data {}",stream_index);
   if (stream_index == 0) {
-    m_primary_video_forwarder->forwardPacketViaUDP(data, data_len);
+    batch_and_forward(m_primary_batch, *m_primary_video_forwarder, data,
+                      data_len);
+    if (m_reassemble) m_primary_reassembler->on_rtp_packet(data, data_len);
   } else if (stream_index == 1) {
-    m_secondary_video_forwarder->forwardPacketViaUDP(data, data_len);
+    batch_and_forward(m_secondary_batch, *m_secondary_video_forwarder, data,
+                      data_len);
+    if (m_reassemble) m_secondary_reassembler->on_rtp_packet(data, data_len);
   } else {
     openhd::log::get_default()->debug("Invalid stream index {}", stream_index);
   }
 }
 
+void OHDVideoGround::batch_and_forward(FrameBatch& batch,
+                                       openhd::UDPMultiForwarder& forwarder,
+                                       const uint8_t* data,
+                                       const int data_len) {
+  // A large keyframe is forwarded in multiple batches
+  static constexpr int MAX_BATCH_SIZE = 128;
+  auto flush = [&batch, &forwarder]() {
+    if (batch.packets.empty()) return;
+    forwarder.forwardPacketsViaUDP(batch.packets.get_packets(),
+                                   batch.packets.size());
+    batch.packets.clear();
+  };
+  const bool is_rtp = data_len >= 12 && (data[0] >> 6) == 2;
+  if (!is_rtp) {
+    flush();
+    forwarder.forwardPacketViaUDP(data, data_len);
+    return;
+  }
+  const bool marker = (data[1] & 0x80) != 0;
+  const uint32_t rtp_timestamp = (uint32_t)data[4] << 24 |
+                                 (uint32_t)data[5] << 16 |
+                                 (uint32_t)data[6] << 8 | (uint32_t)data[7];
+  if (rtp_timestamp != batch.rtp_timestamp) flush();
+  batch.rtp_timestamp = rtp_timestamp;
+  batch.packets.add(data, data_len);
+  if (marker || batch.packets.size() >= MAX_BATCH_SIZE) flush();
+}
+
+void OHDVideoGround::set_on_access_unit_cb(ON_ACCESS_UNIT_CB cb) {
+  m_reassemble = cb != nullptr || m_primary_recorder != nullptr;
+  m_access_unit_cb = std::move(cb);
+}
+
+void OHDVideoGround::on_access_unit(
+    int stream_index,
+    const openhd::RTPFrameReassembler::AccessUnit& access_unit) {
+  if (m_access_unit_cb) {
+    m_access_unit_cb(stream_index, access_unit);
+  }
+  auto& recorder =
+      stream_index == 0 ? m_primary_recorder : m_secondary_recorder;
+  if (recorder) {
+    recorder->on_access_unit(access_unit);
+  }
+  // Only the primary stream, to not spam the log
+  if (stream_index == 0 && std::chrono::steady_clock::now() -
+                                   m_last_reassembler_log >=
+                               std::chrono::seconds(10)) {
+    m_last_reassembler_log = std::chrono::steady_clock::now();
+    const auto stats = m_primary_reassembler->get_stats();
+    m_console->debug("Primary video frames:{} keyframes:{} with loss:{}",
+                     stats.n_frames, stats.n_keyframes,
+                     stats.n_frames_with_loss);
+  }
+}
+
 static bool ip_is_host_self(const std::string& ip) {
   if (OHDUtil::str_equal(ip, "127.0.0.1")) {
     // always self
@@ -10,58 +10,18 @@
 #include "nalu/fragment_helper.h"
 #include "nalu/nalu_helper.h"
 #include "openhd_util_time.h"
-#include "rtp-profile.h"
+#include "rtp-packet.h"
 #include "rtp_eof_helper.h"
 
-static void* rtp_alloc(void* /*param*/, int bytes) {
-  static uint8_t buffer[2 * 1024 * 1024 + 4] = {
-      0,
-      0,
-      0,
-      1,
-  };
-  assert(bytes <= sizeof(buffer) - 4);
-  return buffer + 4;
-}
-
-static void rtp_free(void* /*param*/, void* /*packet*/) {}
-
-static int rtp_encode_packet(void* param, const void* packet, int bytes,
-                             uint32_t timestamp, int flags) {
-  auto self = (openhd::RTPHelper*)param;
-  // openhd::log::get_default()->debug(" rtp_encode_packet {} {}
-  // {}",bytes,timestamp,flags);
-  self->on_new_rtp_fragment((const uint8_t*)packet, bytes, timestamp, flags);
-  // TODO
-  return 0;
-}
-
-openhd::RTPHelper::RTPHelper(bool is_h265) : m_is_h265(is_h265) {
+openhd::RTPHelper::RTPHelper(bool is_h265)
+    : m_is_h265(is_h265), m_packetizer(is_h265) {
   m_console = openhd::log::create_or_get("RTPHelp");
-
-  m_handler.alloc = rtp_alloc;
-  m_handler.free = rtp_free;
-  m_handler.packet = rtp_encode_packet;
-
-  int payload = 96;  // WEIRD RTP_PAYLOAD_H264
-  const char* encoding = "H264";
-  if (m_is_h265) {
-    encoding = "H265";
-  }
-  uint16_t seq = 0;
-  uint32_t ssrc = 0;
-
-  encoder =
-      rtp_payload_encode_create(payload, encoding, seq, ssrc, &m_handler, this);
-  assert(encoder);
 }
 
-openhd::RTPHelper::~RTPHelper() { rtp_payload_encode_destroy(encoder); }
-
 void openhd::RTPHelper::feed_multiple_nalu(const uint8_t* data, int data_len) {
   int offset = 0;
   while (offset < data_len) {
-    int nalu_len = find_next_nal(&data[offset], data_len);
+    const int nalu_len = find_next_nal(&data[offset], data_len - offset);
     on_new_split_nalu(&data[offset], nalu_len);
     offset += nalu_len;
   }
@@ -69,26 +29,18 @@ void openhd::RTPHelper::feed_multiple_nalu(const uint8_t* data, int data_len) {
 
 void openhd::RTPHelper::feed_nalu(const uint8_t* data, int data_len) {
   // m_console->debug("feed_nalu {}", data_len);
-  int32_t timestamp = 0;
-  timestamp = openhd::util::steady_clock_time_epoch_ms();
-  rtp_payload_encode_input(encoder, data, data_len, timestamp);
+  // 90kHz rtp clock (RFC 6184 / RFC 7798), wraps around
+  const uint32_t timestamp =
+      (uint32_t)openhd::util::steady_clock_time_epoch_ms() * 90;
+  m_packetizer.packetize(data, data_len, timestamp, m_frame_fragments);
   // all frames processed
   // m_console->debug("Done, got {} fragments", m_frame_fragments.size());
   if (m_out_cb) {
-    m_out_cb(m_frame_fragments);
+    m_out_cb(std::move(m_frame_fragments));
   }
   m_frame_fragments.clear();
 }
 
-void openhd::RTPHelper::on_new_rtp_fragment(const uint8_t* data, int data_len,
-                                            uint32_t timestamp, int last) {
-  // m_console->debug("on_new_rtp_fragment {} ts:{} last:{}", data_len,
-  // timestamp,
-  //                  last);
-  auto shared = std::make_shared<std::vector<uint8_t>>(data, data + data_len);
-  m_frame_fragments.emplace_back(shared);
-}
-
 void openhd::RTPHelper::set_out_cb(openhd::RTPHelper::OUT_CB cb) {
   m_out_cb = std::move(cb);
 }
@@ -136,17 +88,17 @@ openhd::RTPFragmentBuffer::RTPFragmentBuffer() {
   m_console = openhd::log::create_or_get("RTPFragmentBuffer");
 }
 
-void openhd::RTPFragmentBuffer::buffer_and_forward(
-    std::shared_ptr<std::vector<uint8_t>> fragment, uint64_t dts) {
-  m_frame_fragments.push_back(fragment);
+void openhd::RTPFragmentBuffer::buffer_and_forward(VideoFragment fragment,
+                                                   uint64_t dts) {
   openhd::rtp_eof_helper::RTPFragmentInfo info{};
   if (m_is_h265) {
-    info = openhd::rtp_eof_helper::h265_more_info(fragment->data(),
-                                                  fragment->size());
+    info = openhd::rtp_eof_helper::h265_more_info(fragment.data(),
+                                                  fragment.size());
   } else {
-    info = openhd::rtp_eof_helper::h264_more_info(fragment->data(),
-                                                  fragment->size());
+    info = openhd::rtp_eof_helper::h264_more_info(fragment.data(),
+                                                  fragment.size());
   }
+  m_frame_fragments.push_back(std::move(fragment));
   if (info.is_fu_start) {
     if (is_idr_frame(info.nal_unit_type, m_is_h265)) {
       m_last_fu_s_idr = true;
@@ -182,3 +134,214 @@ void openhd::RTPFragmentBuffer::on_new_rtp_fragmented_frame() {
                                             is_intra_frame};
   // m_console->debug("{}",frame.to_string());
 }
+
+static void* rtp_unpack_alloc(void* /*param*/, int /*bytes*/) {
+  // Only needed for packing
+  return nullptr;
+}
+static void rtp_unpack_free(void* /*param*/, void* /*packet*/) {}
+static int rtp_unpack_nalu(void* param, const void* packet, int bytes,
+                           uint32_t timestamp, int flags) {
+  auto self = (openhd::RTPFrameReassembler*)param;
+  self->on_new_nalu((const uint8_t*)packet, bytes, timestamp, flags);
+  return 0;
+}
+
+// Check if this rtp payload contains (the beginning of) a VPS / SPS.
+// A H265 VPS / SPS always has layer and temporal id 0 (second header byte 1),
+// and a H264 SPS always has a nal_ref_idc != 0 - which rules out that the
+// (common) NAL units of one codec look like the codec config of the other.
+static bool rtp_payload_starts_with_sps(const uint8_t* payload,
+                                        int payload_len, bool is_h265) {
+  if (is_h265) {
+    if (payload_len < 3) return false;
+    // Offset of the (first) NAL unit header
+    int offset = 0;
+    int nal_type = (payload[0] >> 1) & 0x3F;
+    if (nal_type == 48 && payload_len >= 7) {
+      // AP - first aggregated NAL unit
+      offset = 4;
+      nal_type = (payload[4] >> 1) & 0x3F;
+    } else if (nal_type == 49 && (payload[2] & 0x80)) {
+      // FU start, the payload header has the layer / temporal id of the NAL
+      nal_type = payload[2] & 0x3F;
+    }
+    if ((payload[offset] & 0x81) != 0 || payload[offset + 1] != 1) {
+      return false;
+    }
+    return nal_type == NALUnitType::H265::NAL_UNIT_VPS ||
+           nal_type == NALUnitType::H265::NAL_UNIT_SPS;
+  }
+  if (payload_len < 2) return false;
+  int offset = 0;
+  int nal_type = payload[0] & 0x1F;
+  if (nal_type == 24 && payload_len >= 4) {
+    // STAP-A - first aggregated NAL unit
+    offset = 3;
+    nal_type = payload[3] & 0x1F;
+  } else if (nal_type == 28 && (payload[1] & 0x80)) {
+    // FU-A start, the indicator has the nal_ref_idc of the NAL
+    nal_type = payload[1] & 0x1F;
+  }
+  if ((payload[offset] & 0x80) != 0 || (payload[offset] & 0x60) == 0) {
+    return false;
+  }
+  return nal_type == NALUnitType::H264::NAL_UNIT_TYPE_SPS;
+}
+
+openhd::RTPFrameReassembler::RTPFrameReassembler(OUT_CB out_cb)
+    : m_out_cb(std::move(out_cb)) {
+  m_console = openhd::log::create_or_get("RTPReassembler");
+  m_handler.alloc = rtp_unpack_alloc;
+  m_handler.free = rtp_unpack_free;
+  m_handler.packet = rtp_unpack_nalu;
+}
+
+openhd::RTPFrameReassembler::~RTPFrameReassembler() { reset(); }
+
+void openhd::RTPFrameReassembler::reset() {
+  if (m_decoder) {
+    rtp_payload_decode_destroy(m_decoder);
+    m_decoder = nullptr;
+  }
+  m_is_h265 = std::nullopt;
+  m_curr_access_unit = AccessUnit{};
+  m_curr_has_vcl = false;
+  m_n_decode_errors = 0;
+}
+
+bool openhd::RTPFrameReassembler::detect_codec(const uint8_t* payload,
+                                               int payload_len) {
+  bool is_h265;
+  if (rtp_payload_starts_with_sps(payload, payload_len, true)) {
+    is_h265 = true;
+  } else if (rtp_payload_starts_with_sps(payload, payload_len, false)) {
+    is_h265 = false;
+  } else {
+    return false;
+  }
+  m_decoder = rtp_payload_decode_create(96, is_h265 ? "H265" : "H264",
+                                        &m_handler, this);
+  if (m_decoder == nullptr) {
+    m_console->warn("Cannot create rtp decoder");
+    return false;
+  }
+  m_console->debug("Detected {}", is_h265 ? "H265" : "H264");
+  m_is_h265 = is_h265;
+  return true;
+}
+
+void openhd::RTPFrameReassembler::on_rtp_packet(const uint8_t* data,
+                                                int data_len) {
+  rtp_packet_t pkt{};
+  if (rtp_packet_deserialize(&pkt, data, data_len) != 0) return;
+  const auto payload = (const uint8_t*)pkt.payload;
+  if (m_is_h265.has_value() &&
+      rtp_payload_starts_with_sps(payload, pkt.payloadlen,
+                                  !m_is_h265.value())) {
+    // The air unit switched the codec (e.g. camera settings changed)
+    m_console->info("Codec changed to {}",
+                    m_is_h265.value() ? "H264" : "H265");
+    reset();
+  }
+  if (!m_is_h265.has_value()) {
+    if (!detect_codec(payload, pkt.payloadlen)) {
+      return;
+    }
+  }
+  const int res = rtp_payload_decode_input(m_decoder, data, data_len);
+  if (res < 0) {
+    m_console->debug("Invalid rtp packet {}", res);
+    if (++m_n_decode_errors >= MAX_DECODE_ERRORS) {
+      // Most likely the codec changed and we missed its config - detect again
+      m_console->info("{} invalid rtp packets, detecting codec again",
+                      m_n_decode_errors);
+      reset();
+    }
+  }
+}
+
+void openhd::RTPFrameReassembler::on_new_nalu(const uint8_t* nalu,
+                                              int nalu_len, uint32_t timestamp,
+                                              int flags) {
+  const bool is_h265 = m_is_h265.value_or(false);
+  if (nalu_len < (is_h265 ? 3 : 2)) return;
+  auto& au = m_curr_access_unit;
+  if (au.data && au.rtp_timestamp != timestamp) {
+    if (m_curr_has_vcl) {
+      // We didn't get the marker bit of the previous access unit
+      au.has_loss = true;
+      forward_access_unit();
+    } else {
+      // Only config / SEI (e.g. the codec config RTPHelper sends without a
+      // marker bit) - belongs to the following frame
+      au.rtp_timestamp = timestamp;
+    }
+  }
+  if (!au.data) {
+    au.data = std::make_shared<std::vector<uint8_t>>();
+    au.data->reserve(m_last_access_unit_size);
+    au.rtp_timestamp = timestamp;
+    au.is_h265 = is_h265;
+  }
+  if (flags & (RTP_PAYLOAD_FLAG_PACKET_LOST | RTP_PAYLOAD_FLAG_PACKET_CORRUPT)) {
+    au.has_loss = true;
+  }
+  const int nal_type = extract_nal_unit_type(nalu[0], is_h265);
+  if (is_h265 ? nal_type < 32 : (nal_type >= 1 && nal_type <= 5)) {
+    m_curr_has_vcl = true;
+  }
+  if (is_h265) {
+    // IRAP: BLA, IDR, CRA
+    if (nal_type >= NALUnitType::H265::NAL_UNIT_CODED_SLICE_BLA_W_LP &&
+        nal_type <= NALUnitType::H265::NAL_UNIT_CODED_SLICE_CRA) {
+      au.is_keyframe = true;
+    }
+    if (nal_type == NALUnitType::H265::NAL_UNIT_VPS ||
+        nal_type == NALUnitType::H265::NAL_UNIT_SPS ||
+        nal_type == NALUnitType::H265::NAL_UNIT_PPS) {
+      au.has_config = true;
+    }
+  } else {
+    if (nal_type == NALUnitType::H264::NAL_UNIT_TYPE_CODED_SLICE_IDR) {
+      au.is_keyframe = true;
+    }
+    if (nal_type == NALUnitType::H264::NAL_UNIT_TYPE_SPS ||
+        nal_type == NALUnitType::H264::NAL_UNIT_TYPE_PPS) {
+      au.has_config = true;
+    }
+  }
+  static constexpr uint8_t START_CODE[4] = {0, 0, 0, 1};
+  au.data->insert(au.data->end(), START_CODE, START_CODE + 4);
+  au.data->insert(au.data->end(), nalu, nalu + nalu_len);
+  au.n_nalus++;
+  if (flags & RTP_PAYLOAD_FLAG_PACKET_MARKER) {
+    forward_access_unit();
+  }
+}
+
+void openhd::RTPFrameReassembler::forward_access_unit() {
+  auto& au = m_curr_access_unit;
+  m_last_access_unit_size = au.data->size();
+  m_n_frames++;
+  if (au.is_keyframe) m_n_keyframes++;
+  if (au.has_loss) {
+    m_n_frames_with_loss++;
+  } else {
+    m_n_decode_errors = 0;
+  }
+  if (m_out_cb) {
+    m_out_cb(au);
+  }
+  au = AccessUnit{};
+  m_curr_has_vcl = false;
+}
+
+openhd::RTPFrameReassembler::Stats openhd::RTPFrameReassembler::get_stats()
+    const {
+  Stats ret{};
+  ret.n_frames = m_n_frames;
+  ret.n_keyframes = m_n_keyframes;
+  ret.n_frames_with_loss = m_n_frames_with_loss;
+  return ret;
+}
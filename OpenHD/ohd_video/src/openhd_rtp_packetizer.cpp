@@ -0,0 +1,128 @@
+#include "openhd_rtp_packetizer.h"
+
+#include <cassert>
+#include <cstring>
+
+#include "nalu/nalu_helper.h"
+#include "openhd_fragment_pool.h"
+
+static constexpr uint8_t FU_START = 0x80;
+static constexpr uint8_t FU_END = 0x40;
+static constexpr uint8_t H264_FU_A = 28;
+static constexpr uint8_t H265_FU = 49;
+
+openhd::RTPPacketizer::RTPPacketizer(bool is_h265, int max_packet_size,
+                                     uint8_t payload_type, uint32_t ssrc)
+    : m_is_h265(is_h265),
+      m_max_packet_size(max_packet_size),
+      m_payload_type(payload_type),
+      m_ssrc(ssrc) {
+  assert(m_max_packet_size > RTP_HEADER_SIZE + 3);
+}
+
+void openhd::RTPPacketizer::packetize(const uint8_t* data, int data_len,
+                                      uint32_t timestamp,
+                                      std::vector<VideoFragment>& out) {
+  m_timestamp = timestamp;
+  int offset = 0;
+  while (offset < data_len) {
+    const int chunk_len = find_next_nal(&data[offset], data_len - offset);
+    const uint8_t* chunk = &data[offset];
+    offset += chunk_len;
+    // Skip the start code (0,0,1 or 0,0,0,1)
+    int begin = 0;
+    while (begin < chunk_len && chunk[begin] == 0) begin++;
+    if (begin < 2 || begin >= chunk_len || chunk[begin] != 1) {
+      // Not annex b (or garbage before the first start code)
+      continue;
+    }
+    begin++;
+    // Trailing zeroes are not part of the NAL unit
+    int end = chunk_len;
+    while (end > begin && chunk[end - 1] == 0) end--;
+    if (end - begin < (m_is_h265 ? 3 : 2)) continue;
+    packetize_nalu(chunk + begin, end - begin, offset >= data_len, out);
+  }
+}
+
+void openhd::RTPPacketizer::packetize_nalu(const uint8_t* nalu, int nalu_len,
+                                           bool last,
+                                           std::vector<VideoFragment>& out) {
+  if (RTP_HEADER_SIZE + nalu_len > m_max_packet_size) {
+    packetize_fu(nalu, nalu_len, last, out);
+    return;
+  }
+  // Single NAL unit packet
+  auto buff = FragmentPool::instance().allocate(RTP_HEADER_SIZE + nalu_len);
+  write_header(buff->data(), last && is_vcl(nalu));
+  std::memcpy(buff->data() + RTP_HEADER_SIZE, nalu, nalu_len);
+  out.emplace_back(std::move(buff));
+}
+
+void openhd::RTPPacketizer::packetize_fu(const uint8_t* nalu, int nalu_len,
+                                         bool mark,
+                                         std::vector<VideoFragment>& out) {
+  // The FU indicator / payload header replaces the NAL unit header, the
+  // original NAL unit type goes into the FU header
+  uint8_t fu_prefix[3];
+  int n_prefix;
+  int nalu_header_len;
+  if (m_is_h265) {
+    // RFC7798 4.4.3: payload header (type 49) + FU header
+    fu_prefix[0] = (nalu[0] & 0x81) | (H265_FU << 1);
+    fu_prefix[1] = nalu[1];
+    fu_prefix[2] = (nalu[0] >> 1) & 0x3F;
+    n_prefix = 3;
+    nalu_header_len = 2;
+  } else {
+    // RFC6184 5.8: FU indicator (type 28) + FU header
+    fu_prefix[0] = (nalu[0] & 0xE0) | H264_FU_A;
+    fu_prefix[1] = nalu[0] & 0x1F;
+    n_prefix = 2;
+    nalu_header_len = 1;
+  }
+  uint8_t& fu_header = fu_prefix[n_prefix - 1];
+  const int max_payload = m_max_packet_size - RTP_HEADER_SIZE - n_prefix;
+  const uint8_t* payload = nalu + nalu_header_len;
+  int remaining = nalu_len - nalu_header_len;
+  fu_header |= FU_START;
+  while (remaining > 0) {
+    const bool is_end = remaining <= max_payload;
+    const int payload_len = is_end ? remaining : max_payload;
+    if (is_end) fu_header |= FU_END;
+    const int packet_len = RTP_HEADER_SIZE + n_prefix + payload_len;
+    auto buff = FragmentPool::instance().allocate(packet_len);
+    uint8_t* dst = buff->data();
+    write_header(dst, is_end && mark);
+    std::memcpy(dst + RTP_HEADER_SIZE, fu_prefix, n_prefix);
+    std::memcpy(dst + RTP_HEADER_SIZE + n_prefix, payload, payload_len);
+    out.emplace_back(std::move(buff));
+    payload += payload_len;
+    remaining -= payload_len;
+    fu_header &= ~(FU_START | FU_END);
+  }
+}
+
+void openhd::RTPPacketizer::write_header(uint8_t* dst, bool mark) {
+  // RFC3550 5.1: V=2, no padding, no extension, no CSRC
+  dst[0] = 0x80;
+  dst[1] = (mark ? 0x80 : 0x00) | (m_payload_type & 0x7F);
+  dst[2] = (uint8_t)(m_seq >> 8);
+  dst[3] = (uint8_t)(m_seq & 0xFF);
+  dst[4] = (uint8_t)(m_timestamp >> 24);
+  dst[5] = (uint8_t)(m_timestamp >> 16);
+  dst[6] = (uint8_t)(m_timestamp >> 8);
+  dst[7] = (uint8_t)(m_timestamp & 0xFF);
+  dst[8] = (uint8_t)(m_ssrc >> 24);
+  dst[9] = (uint8_t)(m_ssrc >> 16);
+  dst[10] = (uint8_t)(m_ssrc >> 8);
+  dst[11] = (uint8_t)(m_ssrc & 0xFF);
+  m_seq++;
+}
+
+bool openhd::RTPPacketizer::is_vcl(const uint8_t* nalu) const {
+  if (m_is_h265) {
+    return ((nalu[0] >> 1) & 0x3F) < 32;
+  }
+  return (nalu[0] & 0x1F) <= 5;
+}
@@ -0,0 +1,517 @@
+#include "recording_remuxer.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+
+#include "async_file_writer.h"
+#include "config_paths.h"
+#include "fmp4_muxer.h"
+#include "openhd_spdlog_include.h"
+#include "openhd_util.h"
+#include "openhd_util_filesystem.h"
+
+namespace {
+
+// Matroska element ids (including the length marker)
+constexpr uint32_t MKV_EBML = 0x1A45DFA3;
+constexpr uint32_t MKV_SEGMENT = 0x18538067;
+constexpr uint32_t MKV_SEEK_HEAD = 0x114D9B74;
+constexpr uint32_t MKV_INFO = 0x1549A966;
+constexpr uint32_t MKV_TIMESTAMP_SCALE = 0x2AD7B1;
+constexpr uint32_t MKV_TRACKS = 0x1654AE6B;
+constexpr uint32_t MKV_TRACK_ENTRY = 0xAE;
+constexpr uint32_t MKV_TRACK_NUMBER = 0xD7;
+constexpr uint32_t MKV_TRACK_TYPE = 0x83;
+constexpr uint32_t MKV_CODEC_ID = 0x86;
+constexpr uint32_t MKV_CODEC_PRIVATE = 0x63A2;
+constexpr uint32_t MKV_VIDEO = 0xE0;
+constexpr uint32_t MKV_PIXEL_WIDTH = 0xB0;
+constexpr uint32_t MKV_PIXEL_HEIGHT = 0xBA;
+constexpr uint32_t MKV_CLUSTER = 0x1F43B675;
+constexpr uint32_t MKV_CLUSTER_TIMESTAMP = 0xE7;
+constexpr uint32_t MKV_SIMPLE_BLOCK = 0xA3;
+constexpr uint32_t MKV_BLOCK_GROUP = 0xA0;
+constexpr uint32_t MKV_BLOCK = 0xA1;
+constexpr uint32_t MKV_REFERENCE_BLOCK = 0xFB;
+constexpr uint32_t MKV_CUES = 0x1C53BB6B;
+constexpr uint32_t MKV_CHAPTERS = 0x1043A770;
+constexpr uint32_t MKV_TAGS = 0x1254C367;
+constexpr uint32_t MKV_ATTACHMENTS = 0x1941A469;
+constexpr uint64_t MKV_UNKNOWN_SIZE = UINT64_MAX;
+
+// Write the samples of about 2 seconds with one writev call
+constexpr uint64_t FRAGMENT_DURATION = 2 * openhd::FMP4Muxer::TIMESCALE;
+
+bool is_top_level_id(uint32_t id) {
+  return id == MKV_CLUSTER || id == MKV_CUES || id == MKV_TAGS ||
+         id == MKV_INFO || id == MKV_TRACKS || id == MKV_SEEK_HEAD ||
+         id == MKV_CHAPTERS || id == MKV_ATTACHMENTS;
+}
+
+struct EbmlElement {
+  uint32_t id;
+  // MKV_UNKNOWN_SIZE if unknown (e.g. file not finalized)
+  uint64_t size;
+  size_t data_offset;
+  // End of the element, limited to end of parent / file
+  size_t end;
+};
+
+class EbmlReader {
+ public:
+  explicit EbmlReader(const uint8_t* data) : m_data(data) {}
+  // Returns std::nullopt if there is no complete element header at offset
+  std::optional<EbmlElement> read_element(size_t offset, size_t limit) const {
+    int id_len;
+    uint64_t id;
+    if (!read_vint(offset, limit, 4, false, id, id_len)) return std::nullopt;
+    int size_len;
+    uint64_t size;
+    if (!read_vint(offset + id_len, limit, 8, true, size, size_len)) {
+      return std::nullopt;
+    }
+    EbmlElement ret{};
+    ret.id = (uint32_t)id;
+    ret.size = size;
+    ret.data_offset = offset + id_len + size_len;
+    if (size == MKV_UNKNOWN_SIZE || ret.data_offset + size > limit) {
+      ret.end = limit;
+    } else {
+      ret.end = ret.data_offset + size;
+    }
+    return ret;
+  }
+  uint64_t read_uint(const EbmlElement& element) const {
+    uint64_t ret = 0;
+    for (size_t i = element.data_offset; i < element.end; i++) {
+      ret = (ret << 8) | m_data[i];
+    }
+    return ret;
+  }
+  // Variable size integer, with the length marker (ids) or without (sizes)
+  bool read_vint(size_t offset, size_t limit, int max_len, bool strip_marker,
+                 uint64_t& value, int& len) const {
+    if (offset >= limit) return false;
+    const uint8_t first = m_data[offset];
+    len = 1;
+    while (len <= 8 && !(first & (0x80 >> (len - 1)))) len++;
+    if (len > max_len || offset + len > limit) return false;
+    value = strip_marker ? (first & (0xFF >> len)) : first;
+    bool all_ones = value == (uint64_t)(0xFF >> len);
+    for (int i = 1; i < len; i++) {
+      value = (value << 8) | m_data[offset + i];
+      all_ones &= m_data[offset + i] == 0xFF;
+    }
+    if (strip_marker && all_ones) value = MKV_UNKNOWN_SIZE;
+    return true;
+  }
+  const uint8_t* data() const { return m_data; }
+
+ private:
+  const uint8_t* m_data;
+};
+
+struct MkvVideoTrack {
+  uint64_t track_number = 0;
+  openhd::FMP4Muxer::TrackConfig config;
+};
+
+std::optional<MkvVideoTrack> parse_tracks(const EbmlReader& reader,
+                                          const EbmlElement& tracks) {
+  size_t offset = tracks.data_offset;
+  while (auto entry = reader.read_element(offset, tracks.end)) {
+    offset = entry->end;
+    if (entry->id != MKV_TRACK_ENTRY) continue;
+    MkvVideoTrack track{};
+    uint64_t track_type = 0;
+    std::string codec_id;
+    size_t child_offset = entry->data_offset;
+    while (auto child = reader.read_element(child_offset, entry->end)) {
+      child_offset = child->end;
+      const uint8_t* child_data = reader.data() + child->data_offset;
+      const size_t child_len = child->end - child->data_offset;
+      if (child->id == MKV_TRACK_NUMBER) {
+        track.track_number = reader.read_uint(*child);
+      } else if (child->id == MKV_TRACK_TYPE) {
+        track_type = reader.read_uint(*child);
+      } else if (child->id == MKV_CODEC_ID) {
+        codec_id.assign((const char*)child_data, child_len);
+      } else if (child->id == MKV_CODEC_PRIVATE) {
+        track.config.codec_config_record.assign(child_data,
+                                                child_data + child_len);
+      } else if (child->id == MKV_VIDEO) {
+        size_t video_offset = child->data_offset;
+        while (auto video = reader.read_element(video_offset, child->end)) {
+          video_offset = video->end;
+          if (video->id == MKV_PIXEL_WIDTH) {
+            track.config.width = (int)reader.read_uint(*video);
+          } else if (video->id == MKV_PIXEL_HEIGHT) {
+            track.config.height = (int)reader.read_uint(*video);
+          }
+        }
+      }
+    }
+    // codec id might be zero-terminated
+    codec_id = codec_id.c_str();
+    if (track_type != 1 || track.config.codec_config_record.empty()) continue;
+    if (codec_id == "V_MPEG4/ISO/AVC") {
+      track.config.is_h265 = false;
+      return track;
+    }
+    if (codec_id == "V_MPEGH/ISO/HEVC") {
+      track.config.is_h265 = true;
+      return track;
+    }
+  }
+  return std::nullopt;
+}
+
+struct PendingSample {
+  size_t offset;
+  uint32_t size;
+  int64_t timestamp_ns;
+  bool is_keyframe;
+};
+
+// Writes the samples (straight from the mmap'ed input) as fmp4 fragments
+class Mp4FragmentWriter {
+ public:
+  Mp4FragmentWriter(int fd, const uint8_t* in_data,
+                    openhd::FMP4Muxer::TrackConfig config)
+      : m_fd(fd), m_in_data(in_data), m_muxer(std::move(config)) {
+    auto init = m_muxer.create_init_segment();
+    std::vector<iovec> iov = {iovec{init->data(), init->size()}};
+    m_ok = openhd::AsyncFileWriter::writev_all(m_fd, iov) >= 0;
+  }
+  void add_sample(const PendingSample& sample) {
+    if (m_samples.empty() && !sample.is_keyframe) {
+      // Needs to begin with a keyframe
+      return;
+    }
+    if (!m_samples.empty()) {
+      // OpenHD doesn't use B-frames, presentation == decode order
+      const int64_t delta_ns =
+          sample.timestamp_ns - m_samples.back().timestamp_ns;
+      m_last_duration = std::max<int64_t>(
+          1, delta_ns * openhd::FMP4Muxer::TIMESCALE / 1000000000);
+      m_durations.push_back(m_last_duration);
+      m_fragment_duration += m_last_duration;
+      if (m_fragment_duration >= FRAGMENT_DURATION) {
+        write_fragment();
+      }
+    }
+    m_samples.push_back(sample);
+  }
+  // Writes the remaining samples
+  bool finish() {
+    if (!m_samples.empty()) {
+      m_durations.push_back(m_last_duration);
+      write_fragment();
+    }
+    return m_ok && m_n_samples_written > 0;
+  }
+  bool ok() const { return m_ok; }
+
+ private:
+  // Writes all samples but the last one (its duration is not known yet)
+  void write_fragment() {
+    const size_t n = m_durations.size();
+    std::vector<openhd::FMP4Muxer::SampleInfo> infos;
+    infos.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+      infos.push_back({m_samples[i].size, m_durations[i],
+                       m_samples[i].is_keyframe});
+    }
+    const auto header = m_muxer.create_fragment_header(infos);
+    std::vector<iovec> iov;
+    iov.reserve(n + 1);
+    iov.push_back(iovec{(void*)header.data(), header.size()});
+    for (size_t i = 0; i < n; i++) {
+      iov.push_back(iovec{(void*)(m_in_data + m_samples[i].offset),
+                          m_samples[i].size});
+    }
+    if (openhd::AsyncFileWriter::writev_all(m_fd, iov) < 0) m_ok = false;
+    m_n_samples_written += n;
+    m_samples.erase(m_samples.begin(), m_samples.begin() + n);
+    m_durations.clear();
+    m_fragment_duration = 0;
+  }
+
+ private:
+  const int m_fd;
+  const uint8_t* m_in_data;
+  openhd::FMP4Muxer m_muxer;
+  bool m_ok = true;
+  std::vector<PendingSample> m_samples;
+  std::vector<uint32_t> m_durations;
+  uint32_t m_last_duration = openhd::FMP4Muxer::TIMESCALE / 30;
+  uint64_t m_fragment_duration = 0;
+  size_t m_n_samples_written = 0;
+};
+
+// Parses the block header, returns false if the block is not for the video
+// track or uses lacing (not used for video)
+bool parse_block(const EbmlReader& reader, const EbmlElement& block,
+                 uint64_t track_number, int64_t cluster_timestamp,
+                 uint64_t timestamp_scale, bool simple_block,
+                 PendingSample& out) {
+  uint64_t block_track;
+  int track_len;
+  if (!reader.read_vint(block.data_offset, block.end, 8, true, block_track,
+                        track_len)) {
+    return false;
+  }
+  const size_t header_len = track_len + 3;
+  if (block_track != track_number || block.size == MKV_UNKNOWN_SIZE ||
+      block.data_offset + block.size > block.end ||
+      block.size <= header_len) {
+    return false;
+  }
+  const uint8_t* p = reader.data() + block.data_offset + track_len;
+  const int16_t relative_timestamp = (int16_t)((p[0] << 8) | p[1]);
+  const uint8_t flags = p[2];
+  if (flags & 0x06) return false;
+  out.offset = block.data_offset + header_len;
+  out.size = (uint32_t)(block.size - header_len);
+  out.timestamp_ns =
+      (cluster_timestamp + relative_timestamp) * (int64_t)timestamp_scale;
+  out.is_keyframe = simple_block ? (flags & 0x80) != 0 : true;
+  return true;
+}
+
+// Lowest cpu and idle I/O priority for the calling thread
+void set_thread_background_priority() {
+  const auto tid = (id_t)syscall(SYS_gettid);
+  setpriority(PRIO_PROCESS, tid, 19);
+  // IOPRIO_WHO_PROCESS, IOPRIO_CLASS_IDLE
+  static constexpr int IOPRIO_CLASS_SHIFT = 13;
+  static constexpr int IOPRIO_CLASS_IDLE = 3;
+  syscall(SYS_ioprio_set, 1, tid, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+}
+
+}  // namespace
+
+bool RecordingRemuxer::remux_mkv_to_mp4(const std::string& in_file,
+                                        const std::string& out_file,
+                                        const std::atomic<bool>* cancel) {
+  auto console = openhd::log::create_or_get("remuxer");
+  const int in_fd = open(in_file.c_str(), O_RDONLY | O_CLOEXEC);
+  if (in_fd < 0) {
+    console->warn("Cannot open {}", in_file);
+    return false;
+  }
+  struct stat st {};
+  if (fstat(in_fd, &st) != 0 || st.st_size == 0) {
+    close(in_fd);
+    return false;
+  }
+  const size_t in_len = st.st_size;
+  void* mapped = mmap(nullptr, in_len, PROT_READ, MAP_PRIVATE, in_fd, 0);
+  close(in_fd);
+  if (mapped == MAP_FAILED) {
+    console->warn("Cannot mmap {}", in_file);
+    return false;
+  }
+  madvise(mapped, in_len, MADV_SEQUENTIAL);
+  const auto in_data = (const uint8_t*)mapped;
+  const EbmlReader reader(in_data);
+  std::optional<MkvVideoTrack> track;
+  std::unique_ptr<Mp4FragmentWriter> writer;
+  int out_fd = -1;
+  uint64_t timestamp_scale = 1000000;
+  bool ok = false;
+  auto ebml = reader.read_element(0, in_len);
+  auto segment = ebml && ebml->id == MKV_EBML
+                     ? reader.read_element(ebml->end, in_len)
+                     : std::nullopt;
+  if (segment && segment->id == MKV_SEGMENT) {
+    // Files that have not been finalized (e.g. power loss during recording)
+    // have elements of unknown size - and might be truncated
+    size_t offset = segment->data_offset;
+    while (auto element = reader.read_element(offset, segment->end)) {
+      offset = element->end;
+      if (element->id == MKV_INFO) {
+        size_t child_offset = element->data_offset;
+        while (auto child = reader.read_element(child_offset, element->end)) {
+          child_offset = child->end;
+          if (child->id == MKV_TIMESTAMP_SCALE) {
+            timestamp_scale = reader.read_uint(*child);
+          }
+        }
+      } else if (element->id == MKV_TRACKS && !track) {
+        track = parse_tracks(reader, *element);
+        if (!track) {
+          console->warn("{}: no supported video track", in_file);
+          break;
+        }
+        out_fd = open(out_file.c_str(),
+                      O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (out_fd < 0) {
+          console->warn("Cannot open {}", out_file);
+          break;
+        }
+        writer = std::make_unique<Mp4FragmentWriter>(out_fd, in_data,
+                                                     track->config);
+      } else if (element->id == MKV_CLUSTER && writer) {
+        int64_t cluster_timestamp = 0;
+        size_t child_offset = element->data_offset;
+        while (auto child = reader.read_element(child_offset, element->end)) {
+          if (element->size == MKV_UNKNOWN_SIZE &&
+              is_top_level_id(child->id)) {
+            // End of a cluster of unknown size
+            break;
+          }
+          child_offset = child->end;
+          PendingSample sample{};
+          if (child->id == MKV_CLUSTER_TIMESTAMP) {
+            cluster_timestamp = (int64_t)reader.read_uint(*child);
+          } else if (child->id == MKV_SIMPLE_BLOCK) {
+            if (parse_block(reader, *child, track->track_number,
+                            cluster_timestamp, timestamp_scale, true,
+                            sample)) {
+              writer->add_sample(sample);
+            }
+          } else if (child->id == MKV_BLOCK_GROUP) {
+            bool has_reference = false;
+            std::optional<EbmlElement> block;
+            size_t group_offset = child->data_offset;
+            while (auto x = reader.read_element(group_offset, child->end)) {
+              group_offset = x->end;
+              if (x->id == MKV_BLOCK) block = x;
+              if (x->id == MKV_REFERENCE_BLOCK) has_reference = true;
+            }
+            if (block && parse_block(reader, *block, track->track_number,
+                                     cluster_timestamp, timestamp_scale, false,
+                                     sample)) {
+              sample.is_keyframe = !has_reference;
+              writer->add_sample(sample);
+            }
+          }
+        }
+        if (element->size == MKV_UNKNOWN_SIZE) offset = child_offset;
+        if (!writer->ok() || (cancel && *cancel)) break;
+      } else if (element->size == MKV_UNKNOWN_SIZE) {
+        // Cannot skip this one
+        break;
+      }
+    }
+    ok = writer && writer->finish() && !(cancel && *cancel);
+  } else {
+    console->warn("{} is not a matroska file", in_file);
+  }
+  munmap(mapped, in_len);
+  if (out_fd >= 0) {
+    if (fdatasync(out_fd) != 0) ok = false;
+    close(out_fd);
+  }
+  return ok;
+}
+
+RecordingRemuxer::RecordingRemuxer() {
+  m_console = openhd::log::create_or_get("remuxer");
+  for (int i = 0; i < N_WORKERS; i++) {
+    m_workers.emplace_back([this] { loop(); });
+  }
+}
+
+RecordingRemuxer::~RecordingRemuxer() {
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_stop = true;
+    // Don't delay shutdown by a conversion in progress, it is re-done on the
+    // next boot
+    m_cancel = true;
+    if (!m_queue.empty()) {
+      m_console->debug("Terminating, {} files not remuxed", m_queue.size());
+    }
+  }
+  m_cv.notify_all();
+  for (auto& worker : m_workers) {
+    worker.join();
+  }
+}
+
+RecordingRemuxer& RecordingRemuxer::instance() {
+  static RecordingRemuxer remuxer;
+  return remuxer;
+}
+
+void RecordingRemuxer::remux_all_remaining_mkv_files_async() {
+  const auto files = OHDFilesystemUtil::getAllEntriesFullPathInDirectory(
+      std::string(getVideoPath()));
+  for (const auto& file : files) {
+    if (OHDUtil::endsWith(file, ".mkv")) {
+      remux_mkv_file_async_threadsafe(file);
+    }
+  }
+}
+
+void RecordingRemuxer::remux_mkv_file_async_threadsafe(
+    const std::string& filename) {
+  if (!OHDUtil::endsWith(filename, ".mkv")) {
+    m_console->debug("{} not a .mkv file", filename);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (m_pending.count(filename) > 0) {
+      m_console->debug("Already remuxing {}", filename);
+      return;
+    }
+    m_pending.insert(filename);
+    m_queue.push_back(filename);
+  }
+  m_cv.notify_one();
+}
+
+void RecordingRemuxer::loop() {
+  set_thread_background_priority();
+  while (true) {
+    std::string filename;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+      if (m_stop) return;
+      filename = m_queue.front();
+      m_queue.pop_front();
+    }
+    remux_mkv(filename);
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_pending.erase(filename);
+  }
+}
+
+void RecordingRemuxer::remux_mkv(const std::string& in_file) {
+  if (!OHDFilesystemUtil::exists(in_file)) return;
+  m_console->debug("Remuxing {}", in_file);
+  const std::string file_without_suffix =
+      in_file.substr(0, in_file.size() - 4);
+  const std::string out_file_mp4 = file_without_suffix + ".mp4";
+  // Only visible as .mp4 once complete
+  const std::string tmp_file = out_file_mp4 + ".part";
+  if (!remux_mkv_to_mp4(in_file, tmp_file, &m_cancel)) {
+    m_console->warn("Cannot convert {} to {}", in_file, out_file_mp4);
+    OHDFilesystemUtil::remove_if_existing(tmp_file);
+    return;
+  }
+  if (std::rename(tmp_file.c_str(), out_file_mp4.c_str()) != 0) {
+    m_console->warn("Cannot rename {}", tmp_file);
+    OHDFilesystemUtil::remove_if_existing(tmp_file);
+    return;
+  }
+  // Now we can safely delete the old file
+  OHDFilesystemUtil::remove_if_existing(in_file);
+  // and make the new file rw everybody
+  OHDFilesystemUtil::make_file_read_write_everyone(out_file_mp4);
+  m_console->debug("Remuxing {} done", in_file);
+}
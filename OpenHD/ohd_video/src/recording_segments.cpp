@@ -0,0 +1,303 @@
+#include "recording_segments.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <utility>
+
+#include "config_paths.h"
+#include "openhd_spdlog_include.h"
+#include "openhd_util_filesystem.h"
+
+// Also how often the free space is checked
+static constexpr auto LOOP_INTERVAL = std::chrono::seconds(1);
+
+RecordingSegmentIndex& RecordingSegmentIndex::instance() {
+  static RecordingSegmentIndex instance(std::string(getVideoPath()) +
+                                        "recording_segments.txt");
+  return instance;
+}
+
+RecordingSegmentIndex::RecordingSegmentIndex(std::string index_filename)
+    : m_index_filename(std::move(index_filename)) {
+  m_console = openhd::log::create_or_get("v_segments");
+  load();
+}
+
+void RecordingSegmentIndex::recover_unfinished_segments() {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  const size_t n_entries_before = m_entries.size();
+  bool changed = false;
+  for (auto it = m_entries.begin(); it != m_entries.end();) {
+    if (!OHDFilesystemUtil::exists(it->filename)) {
+      // Deleted by the user
+      it = m_entries.erase(it);
+      continue;
+    }
+    if (!it->closed) {
+      changed = true;
+      if (!repair_segment(it->filename)) {
+        m_console->warn("Deleting unusable segment [{}]", it->filename);
+        OHDFilesystemUtil::remove_if_existing(it->filename);
+        it = m_entries.erase(it);
+        continue;
+      }
+      m_console->info("Recovered segment [{}]", it->filename);
+      it->closed = true;
+    }
+    ++it;
+  }
+  if (changed || m_entries.size() != n_entries_before) {
+    persist();
+  }
+}
+
+void RecordingSegmentIndex::add_segment(const std::string& filename) {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  m_entries.push_back(Entry{filename, false});
+  persist();
+}
+
+void RecordingSegmentIndex::on_segment_closed(const std::string& filename,
+                                              bool empty) {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+    if (it->filename != filename) continue;
+    if (empty) {
+      OHDFilesystemUtil::remove_if_existing(filename);
+      m_entries.erase(it);
+    } else {
+      it->closed = true;
+    }
+    persist();
+    return;
+  }
+}
+
+void RecordingSegmentIndex::prune(const int min_free_space_mb) {
+  std::lock_guard<std::mutex> guard(m_mutex);
+  const int free_space_mb = OHDFilesystemUtil::get_remaining_space_in_mb();
+  if (free_space_mb >= min_free_space_mb) return;
+  // The file system might report the freed space with a delay, count it
+  // ourselves to not delete more than needed
+  int64_t freed_bytes = 0;
+  bool changed = false;
+  for (auto it = m_entries.begin(); it != m_entries.end();) {
+    if (free_space_mb + freed_bytes / (1024 * 1024) >= min_free_space_mb) {
+      break;
+    }
+    if (!it->closed) {
+      ++it;
+      continue;
+    }
+    const long size = OHDFilesystemUtil::get_file_size_bytes(it->filename);
+    m_console->warn("Low on space ({}MB), deleting oldest segment [{}]",
+                    free_space_mb, it->filename);
+    OHDFilesystemUtil::remove_if_existing(it->filename);
+    freed_bytes += std::max(size, 0L);
+    it = m_entries.erase(it);
+    changed = true;
+  }
+  if (changed) persist();
+}
+
+bool RecordingSegmentIndex::repair_segment(const std::string& filename) {
+  const int fd = open(filename.c_str(), O_RDWR | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat st {};
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+  // Walk the top level boxes, the file is valid up to the end of the last
+  // moof + mdat pair that has been written completely. Anything after it is
+  // either incomplete or garbage (e.g. zeroes, if the file size has been
+  // persisted but the data hasn't)
+  const int64_t file_size = st.st_size;
+  int64_t offset = 0;
+  int64_t valid_size = 0;
+  bool has_fragment = false;
+  bool pending_moof = false;
+  while (offset + 8 <= file_size) {
+    uint8_t header[8];
+    if (pread(fd, header, sizeof(header), offset) != sizeof(header)) break;
+    const uint32_t box_size = (header[0] << 24) | (header[1] << 16) |
+                              (header[2] << 8) | header[3];
+    if (box_size < 8 || offset + box_size > file_size) break;
+    const std::string type((const char*)&header[4], 4);
+    if (type == "moof") {
+      pending_moof = true;
+    } else if (type == "mdat") {
+      if (!pending_moof) break;
+      pending_moof = false;
+      has_fragment = true;
+      valid_size = offset + box_size;
+    } else if (type == "ftyp" || type == "moov") {
+      if (has_fragment || pending_moof) break;
+      valid_size = offset + box_size;
+    } else {
+      break;
+    }
+    offset += box_size;
+  }
+  if (has_fragment && valid_size < file_size) {
+    if (ftruncate(fd, valid_size) == 0) {
+      fdatasync(fd);
+    } else {
+      has_fragment = false;
+    }
+  }
+  close(fd);
+  return has_fragment;
+}
+
+void RecordingSegmentIndex::load() {
+  const auto content = OHDFilesystemUtil::opt_read_file(m_index_filename);
+  if (!content.has_value()) return;
+  std::istringstream iss(content.value());
+  std::string line;
+  while (std::getline(iss, line)) {
+    // <0|1> <filename>
+    if (line.size() < 3 || line[1] != ' ') continue;
+    m_entries.push_back(Entry{line.substr(2), line[0] == '1'});
+  }
+}
+
+void RecordingSegmentIndex::persist() {
+  std::stringstream ss;
+  for (const auto& entry : m_entries) {
+    ss << (entry.closed ? '1' : '0') << ' ' << entry.filename << '\n';
+  }
+  const std::string content = ss.str();
+  // Write a new file and replace the old one, such that the index is never
+  // incomplete
+  const std::string tmp_filename = m_index_filename + ".tmp";
+  FILE* file = fopen(tmp_filename.c_str(), "w");
+  if (file == nullptr) {
+    m_console->warn("Cannot write [{}] {}", tmp_filename, strerror(errno));
+    return;
+  }
+  const bool written =
+      fwrite(content.data(), 1, content.size(), file) == content.size() &&
+      fflush(file) == 0 && fdatasync(fileno(file)) == 0;
+  fclose(file);
+  if (!written ||
+      rename(tmp_filename.c_str(), m_index_filename.c_str()) != 0) {
+    m_console->warn("Cannot write [{}] {}", m_index_filename, strerror(errno));
+  }
+}
+
+RecordingSegmentStore::RecordingSegmentStore(std::string base_filename,
+                                             uint64_t segment_size_bytes,
+                                             int min_free_space_mb)
+    : m_base_filename(std::move(base_filename)),
+      m_segment_size_bytes(segment_size_bytes),
+      m_min_free_space_mb(min_free_space_mb) {
+  m_console = openhd::log::create_or_get("v_segments");
+  m_thread = std::make_unique<std::thread>([this] { loop(); });
+}
+
+RecordingSegmentStore::~RecordingSegmentStore() {
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_one();
+  m_thread->join();
+  m_thread = nullptr;
+}
+
+std::unique_ptr<openhd::AsyncFileWriter>
+RecordingSegmentStore::take_next_segment() {
+  std::unique_ptr<openhd::AsyncFileWriter> ret;
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    ret = std::move(m_next_segment);
+  }
+  // Prepare the one after
+  if (ret) m_cv.notify_one();
+  return ret;
+}
+
+void RecordingSegmentStore::retire_segment(
+    std::unique_ptr<openhd::AsyncFileWriter> segment) {
+  if (!segment) return;
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_retired_segments.push_back(std::move(segment));
+  }
+  m_cv.notify_one();
+}
+
+void RecordingSegmentStore::loop() {
+  while (true) {
+    std::vector<std::unique_ptr<openhd::AsyncFileWriter>> retired;
+    bool stop;
+    bool needs_next;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait_for(lock, LOOP_INTERVAL, [this] {
+        return m_stop || !m_retired_segments.empty() ||
+               m_next_segment == nullptr;
+      });
+      stop = m_stop;
+      retired = std::move(m_retired_segments);
+      m_retired_segments.clear();
+      needs_next = m_next_segment == nullptr;
+      if (stop && m_next_segment) {
+        // Not used
+        retired.push_back(std::move(m_next_segment));
+      }
+    }
+    for (auto& segment : retired) {
+      close_segment(std::move(segment));
+    }
+    if (stop) break;
+    // Make space first, then reserve it for the next segment
+    RecordingSegmentIndex::instance().prune(m_min_free_space_mb);
+    if (needs_next) {
+      auto segment = create_segment();
+      if (segment == nullptr) {
+        // Don't retry in a busy loop
+        std::this_thread::sleep_for(LOOP_INTERVAL);
+        continue;
+      }
+      std::lock_guard<std::mutex> guard(m_mutex);
+      m_next_segment = std::move(segment);
+    }
+  }
+}
+
+std::unique_ptr<openhd::AsyncFileWriter>
+RecordingSegmentStore::create_segment() {
+  m_n_segments++;
+  const std::string filename =
+      fmt::format("{}_{:04d}.mp4", m_base_filename, m_n_segments);
+  RecordingSegmentIndex::instance().add_segment(filename);
+  auto segment = std::make_unique<openhd::AsyncFileWriter>(
+      filename, std::chrono::seconds(2), 64 * 1024 * 1024,
+      m_segment_size_bytes);
+  if (!segment->is_open()) {
+    RecordingSegmentIndex::instance().on_segment_closed(filename, true);
+    return nullptr;
+  }
+  m_console->debug("Prepared segment [{}]", filename);
+  return segment;
+}
+
+void RecordingSegmentStore::close_segment(
+    std::unique_ptr<openhd::AsyncFileWriter> segment) {
+  const std::string filename = segment->get_filename();
+  // Writes everything that is still queued, syncs and closes
+  segment = nullptr;
+  const bool empty = OHDFilesystemUtil::get_file_size_bytes(filename) <= 0;
+  if (!empty) {
+    OHDFilesystemUtil::make_file_read_write_everyone(filename);
+  }
+  RecordingSegmentIndex::instance().on_segment_closed(filename, empty);
+}
@@ -0,0 +1,326 @@
+#include "video_recorder.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "air_recording_helper.hpp"
+#include "nalu/nalu_helper.h"
+#include "openhd_util_filesystem.h"
+
+// Write a fragment (and therefore at most lose) about every second
+static constexpr uint64_t FRAGMENT_DURATION = openhd::FMP4Muxer::TIMESCALE;
+// Used for the last sample, whose duration we don't know
+static constexpr uint32_t DEFAULT_SAMPLE_DURATION =
+    openhd::FMP4Muxer::TIMESCALE / 30;
+// A longer gap between 2 frames (e.g. link loss) is kept in the recording
+static constexpr uint32_t MAX_SAMPLE_DURATION =
+    openhd::FMP4Muxer::TIMESCALE * 10;
+
+RecordingFileStore::RecordingFileStore(const int recording_index,
+                                       std::string filename_suffix)
+    : m_recording_index(recording_index),
+      m_filename_suffix(std::move(filename_suffix)) {
+  m_console = openhd::log::create_or_get("v_recorder");
+  m_thread = std::make_unique<std::thread>([this] { loop(); });
+}
+
+RecordingFileStore::~RecordingFileStore() {
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_one();
+  m_thread->join();
+  m_thread = nullptr;
+  if (m_next_file) {
+    // Opened, but not used
+    const std::string filename = m_next_file->get_filename();
+    m_next_file = nullptr;
+    OHDFilesystemUtil::remove_if_existing(filename);
+  }
+}
+
+std::unique_ptr<openhd::AsyncFileWriter> RecordingFileStore::take_next_file() {
+  std::unique_ptr<openhd::AsyncFileWriter> ret;
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    ret = std::move(m_next_file);
+    if (ret) return ret;
+    m_next_file_requested = true;
+  }
+  m_cv.notify_one();
+  return nullptr;
+}
+
+void RecordingFileStore::retire_file(
+    std::unique_ptr<openhd::AsyncFileWriter> file) {
+  if (!file) return;
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_retired_files.push_back(std::move(file));
+  }
+  m_cv.notify_one();
+}
+
+void RecordingFileStore::loop() {
+  while (true) {
+    std::vector<std::unique_ptr<openhd::AsyncFileWriter>> retired;
+    bool stop;
+    bool open_next;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock, [this] {
+        return m_stop || !m_retired_files.empty() || m_next_file_requested;
+      });
+      stop = m_stop;
+      retired = std::move(m_retired_files);
+      m_retired_files.clear();
+      open_next = m_next_file_requested && m_next_file == nullptr;
+      m_next_file_requested = false;
+    }
+    // Writes everything that is still queued, syncs and closes
+    retired.clear();
+    if (stop) break;
+    if (open_next) {
+      // On failure, we try again on the next request
+      auto file = open_file();
+      std::lock_guard<std::mutex> guard(m_mutex);
+      m_next_file = std::move(file);
+    }
+  }
+}
+
+std::unique_ptr<openhd::AsyncFileWriter> RecordingFileStore::open_file() {
+  const int n_file = m_n_files + 1;
+  const auto filename = openhd::video::get_recording_filename(
+      m_recording_index,
+      n_file == 1 ? m_filename_suffix
+                  : fmt::format("_{}{}", n_file, m_filename_suffix));
+  auto file = std::make_unique<openhd::AsyncFileWriter>(filename);
+  if (!file->is_open()) {
+    return nullptr;
+  }
+  m_n_files = n_file;
+  return file;
+}
+
+VideoRecorder::VideoRecorder(std::unique_ptr<RecordingFileStore> file_store)
+    : m_file_store(std::move(file_store)) {
+  m_console = openhd::log::create_or_get("v_recorder");
+}
+
+VideoRecorder::VideoRecorder(
+    std::shared_ptr<RecordingSegmentStore> segment_store,
+    std::chrono::seconds segment_duration)
+    : m_segment_store(std::move(segment_store)),
+      m_segment_duration(segment_duration) {
+  m_console = openhd::log::create_or_get("v_recorder");
+}
+
+VideoRecorder::~VideoRecorder() { stop_file(); }
+
+void VideoRecorder::on_access_unit(
+    const openhd::RTPFrameReassembler::AccessUnit& access_unit) {
+  const bool is_h265 = access_unit.is_h265;
+  if (access_unit.has_config) {
+    if (update_codec_config(access_unit.data->data(),
+                            (int)access_unit.data->size(), is_h265) &&
+        m_muxer) {
+      m_console->debug("Codec config changed, starting new recording");
+      stop_file();
+    }
+  }
+  const auto now = std::chrono::steady_clock::now();
+  if (!m_fragment_samples.empty()) {
+    // The rtp clock of H264 / H265 is 90kHz, the same as our time scale -
+    // not affected by when the access unit arrived (link / scheduling jitter)
+    uint32_t duration =
+        access_unit.rtp_timestamp - m_last_sample_rtp_timestamp;
+    if (duration == 0 || duration > MAX_SAMPLE_DURATION) {
+      // Not a sane frame interval (e.g. the encoder restarted)
+      duration = DEFAULT_SAMPLE_DURATION;
+    }
+    m_fragment_samples.back().duration = duration;
+    m_fragment_duration += duration;
+    if (m_fragment_duration >= FRAGMENT_DURATION) {
+      write_fragment();
+    }
+  }
+  if (!m_muxer) {
+    if (!access_unit.is_keyframe) return;
+    start_file(is_h265);
+    if (!m_muxer) return;
+  } else if (m_segment_store && access_unit.is_keyframe &&
+             now - m_file_start >= m_segment_duration) {
+    // If the next segment is not ready yet, we just keep writing to the
+    // current one
+    start_file(is_h265);
+  }
+  openhd::FMP4Muxer::Sample sample{};
+  sample.data = openhd::FMP4Muxer::annex_b_to_length_prefixed(
+      access_unit.data->data(), (int)access_unit.data->size(), is_h265);
+  sample.is_keyframe = access_unit.is_keyframe;
+  if (sample.data->empty()) return;
+  m_fragment_samples.push_back(std::move(sample));
+  m_last_sample_rtp_timestamp = access_unit.rtp_timestamp;
+}
+
+bool VideoRecorder::update_codec_config(const uint8_t* data, int data_len,
+                                        bool is_h265) {
+  bool changed = false;
+  int offset = 0;
+  while (offset < data_len) {
+    const int chunk_len = find_next_nal(&data[offset], data_len - offset);
+    const uint8_t* chunk = &data[offset];
+    offset += chunk_len;
+    int begin = 0;
+    while (begin < chunk_len && chunk[begin] == 0) begin++;
+    if (begin < 2 || begin >= chunk_len || chunk[begin] != 1) continue;
+    begin++;
+    int end = chunk_len;
+    while (end > begin && chunk[end - 1] == 0) end--;
+    if (end - begin < (is_h265 ? 3 : 2)) continue;
+    const int nal_type = extract_nal_unit_type(chunk[begin], is_h265);
+    std::vector<uint8_t>* dst = nullptr;
+    if (is_h265) {
+      if (nal_type == NALUnitType::H265::NAL_UNIT_VPS) dst = &m_vps;
+      if (nal_type == NALUnitType::H265::NAL_UNIT_SPS) dst = &m_sps;
+      if (nal_type == NALUnitType::H265::NAL_UNIT_PPS) dst = &m_pps;
+    } else {
+      if (nal_type == NALUnitType::H264::NAL_UNIT_TYPE_SPS) dst = &m_sps;
+      if (nal_type == NALUnitType::H264::NAL_UNIT_TYPE_PPS) dst = &m_pps;
+    }
+    if (dst == nullptr) continue;
+    if (dst->size() != (size_t)(end - begin) ||
+        !std::equal(dst->begin(), dst->end(), chunk + begin)) {
+      // The first config is not a change
+      changed |= !dst->empty();
+      dst->assign(chunk + begin, chunk + end);
+    }
+  }
+  return changed;
+}
+
+void VideoRecorder::start_file(bool is_h265) {
+  std::optional<openhd::FMP4Muxer::TrackConfig> config;
+  if (is_h265) {
+    config = openhd::FMP4Muxer::create_track_config_h265(m_vps, m_sps, m_pps);
+  } else {
+    config = openhd::FMP4Muxer::create_track_config_h264(m_sps, m_pps);
+  }
+  if (!config.has_value()) {
+    // Not all config data yet / cannot parse the SPS
+    return;
+  }
+  auto writer = open_file();
+  if (!writer) {
+    return;
+  }
+  stop_file();
+  m_console->debug("Recording {} {}x{} to [{}]", is_h265 ? "H265" : "H264",
+                   config->width, config->height, writer->get_filename());
+  m_muxer = std::make_unique<openhd::FMP4Muxer>(config.value());
+  m_writer = std::move(writer);
+  m_writer->enqueue(m_muxer->create_init_segment());
+  m_fragment_samples.clear();
+  m_fragment_duration = 0;
+  m_file_start = std::chrono::steady_clock::now();
+}
+
+std::unique_ptr<openhd::AsyncFileWriter> VideoRecorder::open_file() {
+  if (m_segment_store) {
+    return m_segment_store->take_next_segment();
+  }
+  return m_file_store->take_next_file();
+}
+
+void VideoRecorder::stop_file() {
+  if (!m_muxer) return;
+  if (!m_fragment_samples.empty()) {
+    if (m_fragment_samples.back().duration == 0) {
+      m_fragment_samples.back().duration = DEFAULT_SAMPLE_DURATION;
+    }
+    write_fragment();
+  }
+  // Flushed and closed in the background
+  if (m_segment_store) {
+    m_segment_store->retire_segment(std::move(m_writer));
+  } else {
+    m_file_store->retire_file(std::move(m_writer));
+  }
+  m_muxer = nullptr;
+}
+
+void VideoRecorder::write_fragment() {
+  if (!m_fragment_samples.empty()) {
+    if (!m_writer->enqueue(m_muxer->create_fragment(m_fragment_samples)) &&
+        !m_writer->has_failed()) {
+      // (A failed write has been logged already)
+      m_console->warn("Disk too slow, dropped {} frames",
+                      m_fragment_samples.size());
+    }
+  }
+  m_fragment_samples.clear();
+  m_fragment_duration = 0;
+}
+
+AsyncVideoRecorder::AsyncVideoRecorder(std::unique_ptr<VideoRecorder> recorder)
+    : m_recorder(std::move(recorder)) {
+  m_console = openhd::log::create_or_get("v_recorder");
+  m_reassembler = std::make_unique<openhd::RTPFrameReassembler>(
+      [this](const openhd::RTPFrameReassembler::AccessUnit& access_unit) {
+        m_recorder->on_access_unit(access_unit);
+      });
+  m_thread = std::make_unique<std::thread>([this] { loop(); });
+}
+
+AsyncVideoRecorder::~AsyncVideoRecorder() {
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_one();
+  m_thread->join();
+  m_thread = nullptr;
+  m_reassembler = nullptr;
+  // Flushes the current file / segment
+  m_recorder = nullptr;
+}
+
+void AsyncVideoRecorder::enqueue_frame(
+    std::vector<openhd::VideoFragment> rtp_fragments, const bool is_keyframe,
+    const bool is_intra_stream) {
+  // An intra refresh stream has no keyframes to wait for
+  if (is_keyframe || is_intra_stream) m_wait_for_keyframe = false;
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (m_wait_for_keyframe || m_queue.size() >= MAX_QUEUED_FRAMES) {
+      m_wait_for_keyframe = !is_intra_stream;
+      m_n_dropped_frames++;
+      return;
+    }
+    m_queue.push_back(std::move(rtp_fragments));
+  }
+  m_cv.notify_one();
+  if (m_n_dropped_frames > 0) {
+    m_console->warn("Recording too slow, dropped {} frames",
+                    m_n_dropped_frames);
+    m_n_dropped_frames = 0;
+  }
+}
+
+void AsyncVideoRecorder::loop() {
+  while (true) {
+    std::vector<openhd::VideoFragment> frame;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+      if (m_queue.empty()) break;
+      frame = std::move(m_queue.front());
+      m_queue.pop_front();
+    }
+    for (const auto& fragment : frame) {
+      m_reassembler->on_rtp_packet(fragment.data(), (int)fragment.size());
+    }
+  }
+}
@@ -0,0 +1,34 @@
+#ifndef OPENHD_OHD_VIDEO_TEST_RECORDING_TEST_HELPER_H
+#define OPENHD_OHD_VIDEO_TEST_RECORDING_TEST_HELPER_H
+
+#include <cstdint>
+#include <vector>
+
+// Shared by the muxer / recording tests
+namespace recording_test_helper {
+
+// Returns the first NAL unit (without start code) of the given type in the
+// annex b data, empty if there is none
+static std::vector<uint8_t> find_nalu(const uint8_t* data, int data_len,
+                                      bool is_h265, int type) {
+  for (int i = 0; i + 4 < data_len; i++) {
+    if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+      const int begin = i + 3;
+      const int nal_type =
+          is_h265 ? (data[begin] >> 1) & 0x3F : data[begin] & 0x1F;
+      if (nal_type != type) continue;
+      int end = begin;
+      while (end + 3 <= data_len &&
+             !(data[end] == 0 && data[end + 1] == 0 && data[end + 2] <= 1)) {
+        end++;
+      }
+      if (end + 3 > data_len) end = data_len;
+      return {data + begin, data + end};
+    }
+  }
+  return {};
+}
+
+}  // namespace recording_test_helper
+
+#endif  // OPENHD_OHD_VIDEO_TEST_RECORDING_TEST_HELPER_H
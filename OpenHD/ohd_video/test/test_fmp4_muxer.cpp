@@ -0,0 +1,98 @@
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "async_file_writer.h"
+#include "ffmpeg_videosamples.hpp"
+#include "fmp4_muxer.h"
+#include "recording_test_helper.h"
+
+using recording_test_helper::find_nalu;
+
+// Muxes the test frame(s) into fragmented mp4 file(s) in /tmp and validates
+// the resulting box structure. The files can be checked with e.g. ffprobe.
+
+static uint32_t read_u32(const uint8_t* p) {
+  return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void validate(const uint8_t* data, int data_len, bool is_h265,
+                     const char* tag, const std::string& filename) {
+  std::optional<openhd::FMP4Muxer::TrackConfig> config;
+  if (is_h265) {
+    config = openhd::FMP4Muxer::create_track_config_h265(
+        find_nalu(data, data_len, true, 32), find_nalu(data, data_len, true, 33),
+        find_nalu(data, data_len, true, 34));
+  } else {
+    config = openhd::FMP4Muxer::create_track_config_h264(
+        find_nalu(data, data_len, false, 7), find_nalu(data, data_len, false, 8));
+  }
+  if (!config.has_value()) {
+    throw std::runtime_error(std::string(tag) + ": cannot parse sps");
+  }
+  // All test frames are 720p
+  if (config->width != 1280 || config->height != 720) {
+    throw std::runtime_error(std::string(tag) + ": wrong resolution");
+  }
+  openhd::FMP4Muxer muxer(config.value());
+  const int n_fragments = 3;
+  const int n_samples_per_fragment = 30;
+  {
+    openhd::AsyncFileWriter writer(filename);
+    if (!writer.is_open()) {
+      throw std::runtime_error(std::string(tag) + ": cannot open file");
+    }
+    writer.enqueue(muxer.create_init_segment());
+    for (int i = 0; i < n_fragments; i++) {
+      std::vector<openhd::FMP4Muxer::Sample> samples;
+      for (int j = 0; j < n_samples_per_fragment; j++) {
+        openhd::FMP4Muxer::Sample sample{};
+        sample.data = openhd::FMP4Muxer::annex_b_to_length_prefixed(
+            data, data_len, is_h265);
+        sample.duration = openhd::FMP4Muxer::TIMESCALE / 30;
+        sample.is_keyframe = true;
+        samples.push_back(sample);
+      }
+      writer.enqueue(muxer.create_fragment(samples));
+    }
+  }
+  std::ifstream file(filename, std::ios::binary);
+  const std::vector<uint8_t> content((std::istreambuf_iterator<char>(file)),
+                                     std::istreambuf_iterator<char>());
+  // Top level boxes need to cover the file exactly
+  std::vector<std::string> boxes;
+  size_t offset = 0;
+  while (offset + 8 <= content.size()) {
+    const uint32_t size = read_u32(&content[offset]);
+    if (size < 8 || offset + size > content.size()) {
+      throw std::runtime_error(std::string(tag) + ": invalid box");
+    }
+    boxes.emplace_back((const char*)&content[offset + 4], 4);
+    offset += size;
+  }
+  if (offset != content.size()) {
+    throw std::runtime_error(std::string(tag) + ": trailing data");
+  }
+  std::vector<std::string> expected = {"ftyp", "moov"};
+  for (int i = 0; i < n_fragments; i++) {
+    expected.emplace_back("moof");
+    expected.emplace_back("mdat");
+  }
+  if (boxes != expected) {
+    throw std::runtime_error(std::string(tag) + ": unexpected boxes");
+  }
+  std::cout << tag << ": " << filename << " " << content.size() << " bytes"
+            << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  validate(k_H264TestFrame, sizeof(k_H264TestFrame), false, "H264",
+           "/tmp/test_fmp4_h264.mp4");
+  validate(k_HEVCMainTestFrame, sizeof(k_HEVCMainTestFrame), true, "H265",
+           "/tmp/test_fmp4_h265.mp4");
+  validate(k_HEVCMain10TestFrame, sizeof(k_HEVCMain10TestFrame), true,
+           "H265 10bit", "/tmp/test_fmp4_h265_10bit.mp4");
+  std::cout << "Done" << std::endl;
+  return 0;
+}
@@ -0,0 +1,79 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "ffmpeg_videosamples.hpp"
+#include "nalu/nalu_helper.h"
+
+// Validates the (SIMD) annex b start code scan against the scalar
+// implementation and measures the throughput of both.
+
+static std::vector<int> split_all(const uint8_t* data, int data_len,
+                                  bool scalar) {
+  std::vector<int> ret;
+  int offset = 0;
+  while (offset < data_len) {
+    const int remaining = data_len - offset;
+    const int nalu_len = scalar ? find_next_nal_scalar(&data[offset], remaining)
+                                : find_next_nal(&data[offset], remaining);
+    ret.push_back(nalu_len);
+    offset += nalu_len;
+  }
+  return ret;
+}
+
+static void validate(const uint8_t* data, int data_len, const char* tag) {
+  const auto expected = split_all(data, data_len, true);
+  const auto actual = split_all(data, data_len, false);
+  if (expected != actual) {
+    std::cerr << tag << ": mismatch" << std::endl;
+    exit(1);
+  }
+  std::cout << tag << ": " << actual.size() << " NALUs" << std::endl;
+}
+
+static double benchmark_mbytes_per_second(const std::vector<uint8_t>& data,
+                                          bool scalar) {
+  const int n_iterations = 200;
+  const auto begin = std::chrono::steady_clock::now();
+  size_t n_nalus = 0;
+  for (int i = 0; i < n_iterations; i++) {
+    n_nalus += split_all(data.data(), (int)data.size(), scalar).size();
+  }
+  const auto elapsed_s = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - begin)
+                             .count();
+  // Prevent the compiler from optimizing the loop out
+  if (n_nalus == 0) std::cout << "No NALUs" << std::endl;
+  return (double)data.size() * n_iterations / elapsed_s / (1024 * 1024);
+}
+
+int main(int argc, char* argv[]) {
+  validate(k_H264TestFrame, sizeof(k_H264TestFrame), "H264");
+  validate(k_HEVCMainTestFrame, sizeof(k_HEVCMainTestFrame), "H265");
+  validate(k_HEVCMain10TestFrame, sizeof(k_HEVCMain10TestFrame), "H265 10bit");
+  // Random data with a lot of zeroes, to hit the edge cases (4 byte start
+  // codes, start codes at the buffer boundaries, runs of zeroes)
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> dist(0, 3);
+  for (int len = 0; len < 200; len++) {
+    std::vector<uint8_t> random(len);
+    for (auto& value : random) value = dist(gen) == 3 ? 1 : 0;
+    validate(random.data(), len, "Random");
+  }
+  // For the benchmark, ~ 4MB of the H264 test frame, such that it doesn't
+  // fit into the cache(s) of a typical air unit
+  std::vector<uint8_t> big;
+  while (big.size() < 4 * 1024 * 1024) {
+    big.insert(big.end(), k_H264TestFrame,
+               k_H264TestFrame + sizeof(k_H264TestFrame));
+  }
+  validate(big.data(), (int)big.size(), "H264 big");
+  const auto scalar = benchmark_mbytes_per_second(big, true);
+  const auto simd = benchmark_mbytes_per_second(big, false);
+  std::cout << "Scalar: " << scalar << " MB/s" << std::endl;
+  std::cout << "SIMD:   " << simd << " MB/s" << std::endl;
+  return 0;
+}
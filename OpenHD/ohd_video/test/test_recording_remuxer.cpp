@@ -0,0 +1,153 @@
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "ffmpeg_videosamples.hpp"
+#include "fmp4_muxer.h"
+#include "recording_remuxer.h"
+#include "recording_test_helper.h"
+
+using recording_test_helper::find_nalu;
+
+// Writes a minimal .mkv (like matroskamux, both finalized and as left over
+// after a power loss) with the H264 test frame, remuxes it and validates
+// the resulting mp4.
+
+static uint32_t read_u32(const uint8_t* p) {
+  return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void put_id(std::vector<uint8_t>& out, uint32_t id) {
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    if ((id >> shift) != 0) out.push_back((id >> shift) & 0xFF);
+  }
+}
+
+// 8 byte size, or unknown
+static void put_size(std::vector<uint8_t>& out, uint64_t size, bool unknown) {
+  out.push_back(0x01);
+  for (int shift = 48; shift >= 0; shift -= 8) {
+    out.push_back(unknown ? 0xFF : (size >> shift) & 0xFF);
+  }
+}
+
+static void put_element(std::vector<uint8_t>& out, uint32_t id,
+                        const std::vector<uint8_t>& data) {
+  put_id(out, id);
+  put_size(out, data.size(), false);
+  out.insert(out.end(), data.begin(), data.end());
+}
+
+static std::vector<uint8_t> uint_data(uint64_t v) {
+  return {(uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8),
+          (uint8_t)v};
+}
+
+static std::vector<uint8_t> create_mkv(int n_frames, bool finalized) {
+  const auto config = openhd::FMP4Muxer::create_track_config_h264(
+      find_nalu(k_H264TestFrame, sizeof(k_H264TestFrame), false, 7),
+      find_nalu(k_H264TestFrame, sizeof(k_H264TestFrame), false, 8));
+  const auto frame = openhd::FMP4Muxer::annex_b_to_length_prefixed(
+      k_H264TestFrame, sizeof(k_H264TestFrame), false);
+  std::vector<uint8_t> out;
+  put_element(out, 0x1A45DFA3, {0x42, 0x82, 0x88, 'm', 'a', 't', 'r', 'o',
+                                's', 'k', 'a', 0});
+  std::vector<uint8_t> segment;
+  put_element(segment, 0x1549A966, [] {
+    std::vector<uint8_t> info;
+    put_element(info, 0x2AD7B1, uint_data(1000000));
+    return info;
+  }());
+  std::vector<uint8_t> track_entry;
+  put_element(track_entry, 0xD7, uint_data(1));
+  put_element(track_entry, 0x83, uint_data(1));
+  put_element(track_entry, 0x86, {'V', '_', 'M', 'P', 'E', 'G', '4', '/', 'I',
+                                  'S', 'O', '/', 'A', 'V', 'C'});
+  put_element(track_entry, 0x63A2, config->codec_config_record);
+  std::vector<uint8_t> video;
+  put_element(video, 0xB0, uint_data(1280));
+  put_element(video, 0xBA, uint_data(720));
+  put_element(track_entry, 0xE0, video);
+  std::vector<uint8_t> tracks;
+  put_element(tracks, 0xAE, track_entry);
+  put_element(segment, 0x1654AE6B, tracks);
+  // One cluster per 30 frames (1 second)
+  for (int i = 0; i < n_frames; i += 30) {
+    std::vector<uint8_t> cluster;
+    put_element(cluster, 0xE7, uint_data(i * 1000 / 30));
+    for (int j = i; j < n_frames && j < i + 30; j++) {
+      const int16_t relative = (j - i) * 1000 / 30;
+      std::vector<uint8_t> block = {0x81, (uint8_t)(relative >> 8),
+                                    (uint8_t)relative,
+                                    (uint8_t)(j % 10 == 0 ? 0x80 : 0)};
+      block.insert(block.end(), frame->begin(), frame->end());
+      put_element(cluster, 0xA3, block);
+    }
+    if (finalized) {
+      put_element(segment, 0x1F43B675, cluster);
+    } else {
+      put_id(segment, 0x1F43B675);
+      put_size(segment, 0, true);
+      segment.insert(segment.end(), cluster.begin(), cluster.end());
+    }
+  }
+  put_id(out, 0x18538067);
+  put_size(out, segment.size(), !finalized);
+  out.insert(out.end(), segment.begin(), segment.end());
+  if (!finalized) {
+    // Last block only partially written
+    out.resize(out.size() - frame->size() / 2);
+  }
+  return out;
+}
+
+static void validate(bool finalized, int n_frames, int n_expected_samples,
+                     const char* tag) {
+  const std::string in_file = "/tmp/test_remuxer.mkv";
+  const std::string out_file = "/tmp/test_remuxer.mp4";
+  {
+    const auto mkv = create_mkv(n_frames, finalized);
+    std::ofstream file(in_file, std::ios::binary);
+    file.write((const char*)mkv.data(), mkv.size());
+  }
+  if (!RecordingRemuxer::remux_mkv_to_mp4(in_file, out_file)) {
+    throw std::runtime_error(std::string(tag) + ": remux failed");
+  }
+  std::ifstream file(out_file, std::ios::binary);
+  const std::vector<uint8_t> content((std::istreambuf_iterator<char>(file)),
+                                     std::istreambuf_iterator<char>());
+  size_t offset = 0;
+  int n_samples = 0;
+  while (offset + 8 <= content.size()) {
+    const uint32_t size = read_u32(&content[offset]);
+    if (size < 8 || offset + size > content.size()) {
+      throw std::runtime_error(std::string(tag) + ": invalid box");
+    }
+    if (std::string((const char*)&content[offset + 4], 4) == "moof") {
+      // moof > mfhd(16) > traf > tfhd(16) > tfdt(20) > trun
+      const size_t trun = offset + 8 + 16 + 8 + 16 + 20;
+      if (std::string((const char*)&content[trun + 4], 4) != "trun") {
+        throw std::runtime_error(std::string(tag) + ": no trun");
+      }
+      n_samples += read_u32(&content[trun + 12]);
+    }
+    offset += size;
+  }
+  if (offset != content.size()) {
+    throw std::runtime_error(std::string(tag) + ": trailing data");
+  }
+  if (n_samples != n_expected_samples) {
+    throw std::runtime_error(std::string(tag) + ": wrong n of samples");
+  }
+  std::cout << tag << ": " << n_samples << " samples, " << content.size()
+            << " bytes" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  validate(true, 100, 100, "finalized");
+  // The truncated last frame is lost
+  validate(false, 100, 99, "not finalized");
+  std::cout << "Done" << std::endl;
+  return 0;
+}
@@ -0,0 +1,151 @@
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "async_file_writer.h"
+#include "ffmpeg_videosamples.hpp"
+#include "fmp4_muxer.h"
+#include "openhd_util_filesystem.h"
+#include "recording_segments.h"
+#include "recording_test_helper.h"
+
+using recording_test_helper::find_nalu;
+
+// Simulates segment(s) that were still being written on a power loss and
+// checks they are repaired to their last complete fragment. Also checks that
+// pre-allocated space is released on close, and that a failing write (disk
+// full) doesn't leave a partial buffer at the end of the file.
+
+// Returns the size of init segment + n complete fragments, appends half a
+// fragment (optional) and the given garbage after them
+static size_t write_segment(const std::string& filename, int n_fragments,
+                            bool partial_fragment,
+                            const std::vector<uint8_t>& garbage) {
+  const auto config = openhd::FMP4Muxer::create_track_config_h264(
+      find_nalu(k_H264TestFrame, sizeof(k_H264TestFrame), false, 7),
+      find_nalu(k_H264TestFrame, sizeof(k_H264TestFrame), false, 8));
+  if (!config.has_value()) {
+    throw std::runtime_error("segment: cannot parse sps");
+  }
+  openhd::FMP4Muxer muxer(config.value());
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  const auto init = muxer.create_init_segment();
+  file.write((const char*)init->data(), init->size());
+  size_t size = init->size();
+  for (int i = 0; i < n_fragments; i++) {
+    openhd::FMP4Muxer::Sample sample{};
+    sample.data = openhd::FMP4Muxer::annex_b_to_length_prefixed(
+        k_H264TestFrame, sizeof(k_H264TestFrame), false);
+    sample.duration = openhd::FMP4Muxer::TIMESCALE / 30;
+    sample.is_keyframe = true;
+    const auto fragment = muxer.create_fragment({sample, sample});
+    file.write((const char*)fragment->data(), fragment->size());
+    size += fragment->size();
+    if (partial_fragment && i == n_fragments - 1) {
+      // Part of the fragment after
+      file.write((const char*)fragment->data(), fragment->size() / 2);
+    }
+  }
+  file.write((const char*)garbage.data(), garbage.size());
+  return size;
+}
+
+static void validate_repair(int n_fragments, bool partial_fragment,
+                            const std::vector<uint8_t>& garbage,
+                            const char* tag) {
+  const std::string filename = "/tmp/test_segment.mp4";
+  const size_t valid_size =
+      write_segment(filename, n_fragments, partial_fragment, garbage);
+  const bool repaired = RecordingSegmentIndex::repair_segment(filename);
+  if (n_fragments == 0) {
+    if (repaired) {
+      throw std::runtime_error(
+          std::string(tag) + ": segment without fragment repaired");
+    }
+  } else {
+    if (!repaired) {
+      throw std::runtime_error(std::string(tag) + ": cannot repair");
+    }
+    if (OHDFilesystemUtil::get_file_size_bytes(filename) != (long)valid_size) {
+      throw std::runtime_error(std::string(tag) + ": wrong size after repair");
+    }
+  }
+  std::cout << tag << ": ok" << std::endl;
+}
+
+static void validate_preallocation() {
+  const std::string filename = "/tmp/test_segment_preallocated.mp4";
+  const uint64_t preallocate_bytes = 16 * 1024 * 1024;
+  struct stat st {};
+  {
+    openhd::AsyncFileWriter writer(filename, std::chrono::seconds(2),
+                                   64 * 1024 * 1024, preallocate_bytes);
+    if (!writer.is_open()) {
+      throw std::runtime_error("preallocation: cannot open");
+    }
+    writer.enqueue(std::make_shared<std::vector<uint8_t>>(1000, 0xAB));
+    stat(filename.c_str(), &st);
+    std::cout << "preallocation: while writing " << st.st_blocks * 512
+              << " bytes allocated" << std::endl;
+  }
+  stat(filename.c_str(), &st);
+  if (st.st_size != 1000) throw std::runtime_error("preallocation: wrong size");
+  if ((uint64_t)st.st_blocks * 512 >= preallocate_bytes) {
+    throw std::runtime_error("preallocation: space not released");
+  }
+  std::cout << "preallocation: after close " << st.st_blocks * 512
+            << " bytes allocated" << std::endl;
+}
+
+static void validate_write_error() {
+  const std::string filename = "/tmp/test_segment_write_error.mp4";
+  // The file size limit makes writev fail like a full disk, in the middle of
+  // the 3rd buffer
+  signal(SIGXFSZ, SIG_IGN);
+  struct rlimit old_limit {};
+  getrlimit(RLIMIT_FSIZE, &old_limit);
+  struct rlimit limit = old_limit;
+  limit.rlim_cur = 2500;
+  if (setrlimit(RLIMIT_FSIZE, &limit) != 0) {
+    throw std::runtime_error("write error: setrlimit");
+  }
+  {
+    openhd::AsyncFileWriter writer(filename);
+    if (!writer.is_open()) throw std::runtime_error("write error: cannot open");
+    for (int i = 0; i < 5; i++) {
+      writer.enqueue(std::make_shared<std::vector<uint8_t>>(1000, i));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (!writer.has_failed()) {
+      throw std::runtime_error("write error: not detected");
+    }
+    if (writer.enqueue(std::make_shared<std::vector<uint8_t>>(10, 0))) {
+      throw std::runtime_error("write error: still writing");
+    }
+  }
+  setrlimit(RLIMIT_FSIZE, &old_limit);
+  if (OHDFilesystemUtil::get_file_size_bytes(filename) != 2000) {
+    throw std::runtime_error("write error: partial buffer not removed");
+  }
+  std::cout << "write error: ok" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  validate_repair(3, true, {}, "partial fragment");
+  // The file size has been persisted, but not the data
+  validate_repair(3, false, std::vector<uint8_t>(4096, 0), "zeroes");
+  validate_repair(2, false, {0, 0, 0, 12, 'm', 'o', 'o', 'f', 1, 2, 3, 4},
+                  "moof without mdat");
+  validate_repair(0, false, {}, "no fragment");
+  validate_repair(3, false, {}, "complete");
+  validate_preallocation();
+  validate_write_error();
+  std::cout << "Done" << std::endl;
+  return 0;
+}
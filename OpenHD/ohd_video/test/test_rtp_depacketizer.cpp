@@ -0,0 +1,145 @@
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "ffmpeg_videosamples.hpp"
+#include "openhd_rtp.h"
+#include "openhd_rtp_packetizer.h"
+
+// Packetizes the test frame(s) with RTPPacketizer and validates that the
+// RTPFrameReassembler gives back exactly the same annex b data.
+
+static std::vector<openhd::VideoFragment> packetize(const uint8_t* data,
+                                                    int data_len, bool is_h265,
+                                                    uint32_t timestamp) {
+  static openhd::RTPPacketizer packetizer_h264(false);
+  static openhd::RTPPacketizer packetizer_h265(true);
+  auto& packetizer = is_h265 ? packetizer_h265 : packetizer_h264;
+  std::vector<openhd::VideoFragment> fragments;
+  packetizer.packetize(data, data_len, timestamp, fragments);
+  return fragments;
+}
+
+// Same NAL units, but always with a 4 byte start code
+static std::vector<uint8_t> as_annex_b_4(const uint8_t* data, int data_len) {
+  std::vector<uint8_t> ret;
+  int i = 0;
+  while (i + 3 <= data_len) {
+    if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+      ret.insert(ret.end(), {0, 0, 0, 1});
+      i += 3;
+      const int begin = i;
+      while (i + 3 <= data_len &&
+             !(data[i] == 0 && data[i + 1] == 0 &&
+               (data[i + 2] == 1 || data[i + 2] == 0))) {
+        i++;
+      }
+      if (i + 3 > data_len) i = data_len;
+      ret.insert(ret.end(), data + begin, data + i);
+    } else {
+      i++;
+    }
+  }
+  return ret;
+}
+
+static void validate(const uint8_t* data, int data_len, bool is_h265,
+                     const char* tag) {
+  std::vector<openhd::RTPFrameReassembler::AccessUnit> access_units;
+  openhd::RTPFrameReassembler reassembler(
+      [&access_units](const openhd::RTPFrameReassembler::AccessUnit& au) {
+        access_units.push_back(au);
+      });
+  // The test frames start with the codec config, which is needed for
+  // detecting the codec.
+  const int n_frames = 10;
+  for (int i = 0; i < n_frames; i++) {
+    for (const auto& fragment : packetize(data, data_len, is_h265, i * 3000)) {
+      reassembler.on_rtp_packet(fragment.data(), (int)fragment.size());
+    }
+  }
+  if (access_units.size() != n_frames) {
+    throw std::runtime_error(std::string(tag) + ": wrong n of access units");
+  }
+  const auto expected = as_annex_b_4(data, data_len);
+  for (const auto& au : access_units) {
+    if (*au.data != expected) {
+      throw std::runtime_error(std::string(tag) + ": data mismatch");
+    }
+    if (au.has_loss) {
+      throw std::runtime_error(std::string(tag) + ": unexpected loss");
+    }
+    if (!au.has_config) {
+      throw std::runtime_error(std::string(tag) + ": no config");
+    }
+    if (au.is_h265 != is_h265) {
+      throw std::runtime_error(std::string(tag) + ": wrong codec");
+    }
+  }
+  // Drop one packet in the middle of a frame
+  auto fragments = packetize(data, data_len, is_h265, n_frames * 3000);
+  if (fragments.size() >= 3) {
+    fragments.erase(fragments.begin() + (int)fragments.size() / 2);
+    for (const auto& fragment : fragments) {
+      reassembler.on_rtp_packet(fragment.data(), (int)fragment.size());
+    }
+    if (access_units.size() != n_frames + 1) {
+      throw std::runtime_error(std::string(tag) + ": lost access unit");
+    }
+    if (!access_units.back().has_loss) {
+      throw std::runtime_error(std::string(tag) + ": loss not detected");
+    }
+  }
+  const auto stats = reassembler.get_stats();
+  std::cout << tag << ": frames:" << stats.n_frames
+            << " keyframes:" << stats.n_keyframes
+            << " with loss:" << stats.n_frames_with_loss << std::endl;
+}
+
+// The air unit switches from H264 to H265 (and back), the reassembler has to
+// follow without a restart
+static void validate_codec_switch() {
+  std::vector<openhd::RTPFrameReassembler::AccessUnit> access_units;
+  openhd::RTPFrameReassembler reassembler(
+      [&access_units](const openhd::RTPFrameReassembler::AccessUnit& au) {
+        access_units.push_back(au);
+      });
+  const bool codecs[] = {false, true, false};
+  uint32_t timestamp = 0;
+  for (const bool is_h265 : codecs) {
+    const uint8_t* data = is_h265 ? k_HEVCMainTestFrame : k_H264TestFrame;
+    const int data_len =
+        is_h265 ? sizeof(k_HEVCMainTestFrame) : sizeof(k_H264TestFrame);
+    access_units.clear();
+    for (int i = 0; i < 3; i++) {
+      timestamp += 3000;
+      for (const auto& fragment :
+           packetize(data, data_len, is_h265, timestamp)) {
+        reassembler.on_rtp_packet(fragment.data(), (int)fragment.size());
+      }
+    }
+    if (access_units.size() != 3) {
+      throw std::runtime_error("switch: wrong n of access units");
+    }
+    for (const auto& au : access_units) {
+      if (au.is_h265 != is_h265) {
+        throw std::runtime_error("switch: wrong codec");
+      }
+      if (*au.data != as_annex_b_4(data, data_len)) {
+        throw std::runtime_error("switch: data mismatch");
+      }
+    }
+  }
+  std::cout << "codec switch: ok" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  validate(k_H264TestFrame, sizeof(k_H264TestFrame), false, "H264");
+  validate(k_HEVCMainTestFrame, sizeof(k_HEVCMainTestFrame), true, "H265");
+  validate(k_HEVCMain10TestFrame, sizeof(k_HEVCMain10TestFrame), true,
+           "H265 10bit");
+  validate_codec_switch();
+  std::cout << "Done" << std::endl;
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "ffmpeg_videosamples.hpp"
+#include "openhd_rtp_packetizer.h"
+#include "rtp-payload.h"
+
+// Validates the RTPPacketizer against librtp - both need to produce exactly
+// the same rtp packets for the same input.
+
+static void* rtp_alloc(void* /*param*/, int bytes) {
+  static uint8_t buffer[2 * 1024 * 1024];
+  return buffer;
+}
+static void rtp_free(void* /*param*/, void* /*packet*/) {}
+static int rtp_encode_packet(void* param, const void* packet, int bytes,
+                             uint32_t /*timestamp*/, int /*flags*/) {
+  auto packets = (std::vector<std::vector<uint8_t>>*)param;
+  auto data = (const uint8_t*)packet;
+  packets->emplace_back(data, data + bytes);
+  return 0;
+}
+
+static std::vector<std::vector<uint8_t>> packetize_librtp(const uint8_t* data,
+                                                          int data_len,
+                                                          bool is_h265) {
+  std::vector<std::vector<uint8_t>> ret;
+  rtp_payload_t handler{};
+  handler.alloc = rtp_alloc;
+  handler.free = rtp_free;
+  handler.packet = rtp_encode_packet;
+  void* encoder = rtp_payload_encode_create(96, is_h265 ? "H265" : "H264", 0,
+                                            0, &handler, &ret);
+  rtp_payload_encode_input(encoder, data, data_len, 1234);
+  rtp_payload_encode_destroy(encoder);
+  return ret;
+}
+
+static std::vector<std::vector<uint8_t>> packetize_openhd(const uint8_t* data,
+                                                          int data_len,
+                                                          bool is_h265) {
+  openhd::RTPPacketizer packetizer(is_h265);
+  std::vector<openhd::VideoFragment> fragments;
+  packetizer.packetize(data, data_len, 1234, fragments);
+  std::vector<std::vector<uint8_t>> ret;
+  for (const auto& fragment : fragments) {
+    ret.emplace_back(fragment.data(), fragment.data() + fragment.size());
+  }
+  return ret;
+}
+
+static void validate(const uint8_t* data, int data_len, bool is_h265,
+                     const char* tag) {
+  const auto expected = packetize_librtp(data, data_len, is_h265);
+  const auto actual = packetize_openhd(data, data_len, is_h265);
+  if (expected != actual) {
+    std::cerr << tag << ": mismatch, librtp:" << expected.size()
+              << " packets, openhd:" << actual.size() << " packets"
+              << std::endl;
+    exit(1);
+  }
+  std::cout << tag << ": " << actual.size() << " packets" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  validate(k_H264TestFrame, sizeof(k_H264TestFrame), false, "H264");
+  validate(k_HEVCMainTestFrame, sizeof(k_HEVCMainTestFrame), true, "H265");
+  validate(k_HEVCMain10TestFrame, sizeof(k_HEVCMain10TestFrame), true,
+           "H265 10bit");
+  // Big NAL units, to test FU-A / FU
+  for (const bool is_h265 : {false, true}) {
+    for (int nalu_len : {100, 1421, 1422, 1423, 5000, 100000}) {
+      std::vector<uint8_t> nalu(nalu_len);
+      for (int i = 0; i < nalu_len; i++) nalu[i] = (uint8_t)(i % 251 + 2);
+      // IDR, 4 byte start code
+      std::vector<uint8_t> data = {0, 0, 0, 1};
+      if (is_h265) {
+        data.push_back(19 << 1);
+        data.push_back(1);
+      } else {
+        data.push_back(0x65);
+      }
+      data.insert(data.end(), nalu.begin(), nalu.end());
+      validate(data.data(), (int)data.size(), is_h265,
+               is_h265 ? "H265 FU" : "H264 FU-A");
+    }
+  }
+  std::cout << "Done" << std::endl;
+  return 0;
+}
@@ -32,8 +32,8 @@ int main(int argc, char* argv[]) {
                 const openhd::FragmentedVideoFrame& fragmented_video_frame) {
     int total_size = 0;
     for (auto& fragemnt : fragmented_video_frame.rtp_fragments) {
-      forwarder.forwardPacketViaUDP(fragemnt->data(), fragemnt->size());
-      total_size += fragemnt->size();
+      forwarder.forwardPacketViaUDP(fragemnt.data(), fragemnt.size());
+      total_size += fragemnt.size();
     }
     if (fragmented_video_frame.dirty_frame) {
       auto fragments =